@@ -0,0 +1,194 @@
+/*
+ * Copyright © 2026 The Annland Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Prints the contents of a file-backed flight recorder, oldest data first,
+ * e.g. after the compositor that wrote it has crashed. See
+ * weston --flight-rec-file.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "libweston/weston-log-flight-rec.h"
+
+static void
+print_help(void)
+{
+	fprintf(stderr,
+		"Usage: weston-flight-rec [options] FILE\n"
+		"Prints the contents of the flight recorder file FILE, oldest\n"
+		"first.\n"
+		"Where options may be:\n"
+		"  -h, --help\n"
+		"     This help text, and exit with success.\n"
+		"  -o FILE, --output FILE\n"
+		"     Direct output to file named FILE. Use - for stdout.\n"
+		"     Stdout is the default.\n"
+		"  -i, --info\n"
+		"     Only print the header information.\n"
+		);
+}
+
+static int
+copy_range(int fd, off_t offset, size_t len, FILE *out)
+{
+	char buf[64 * 1024];
+	size_t chunk;
+	ssize_t ret;
+
+	while (len > 0) {
+		chunk = len < sizeof(buf) ? len : sizeof(buf);
+		ret = pread(fd, buf, chunk, offset);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0)
+			return -1;
+		if (fwrite(buf, 1, ret, out) != (size_t)ret)
+			return -1;
+		offset += ret;
+		len -= ret;
+	}
+
+	return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+	static const struct option opts[] = {
+		{ "help", no_argument, NULL, 'h' },
+		{ "output", required_argument, NULL, 'o' },
+		{ "info", no_argument, NULL, 'i' },
+		{ 0 }
+	};
+	struct weston_flight_rec_header header;
+	const char *output = NULL;
+	bool info_only = false;
+	FILE *out = stdout;
+	uint64_t pos, len;
+	int c, fd, ret = 0;
+
+	while ((c = getopt_long(argc, argv, "ho:i", opts, NULL)) != -1) {
+		switch (c) {
+		case 'h':
+			print_help();
+			return 0;
+		case 'o':
+			output = optarg;
+			break;
+		case 'i':
+			info_only = true;
+			break;
+		default:
+			print_help();
+			return 1;
+		}
+	}
+
+	if (argc - optind != 1) {
+		print_help();
+		return 1;
+	}
+
+	fd = open(argv[optind], O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		fprintf(stderr, "Error: opening %s: %s\n",
+			argv[optind], strerror(errno));
+		return 1;
+	}
+
+	if (pread(fd, &header, sizeof(header), 0) != sizeof(header) ||
+	    header.magic != WESTON_FLIGHT_REC_MAGIC) {
+		fprintf(stderr, "Error: %s is not a flight recorder file.\n",
+			argv[optind]);
+		close(fd);
+		return 1;
+	}
+
+	if (header.version != WESTON_FLIGHT_REC_VERSION ||
+	    header.size == 0 || header.header_size < sizeof(header)) {
+		fprintf(stderr, "Error: unsupported flight recorder version "
+			"%u.\n", header.version);
+		close(fd);
+		return 1;
+	}
+
+	fprintf(stderr, "flight recorder of pid %u: %" PRIu64 " bytes "
+		"written, ring of %" PRIu64 " bytes%s\n",
+		header.pid, header.written, header.size,
+		header.written > header.size ? ", wrapped" : "");
+	if (header.committed != header.written)
+		fprintf(stderr, "warning: the last %" PRIu64 " bytes were "
+			"not completely written\n",
+			header.written - header.committed);
+
+	if (info_only) {
+		close(fd);
+		return 0;
+	}
+
+	if (output && strcmp(output, "-") != 0) {
+		out = fopen(output, "w");
+		if (!out) {
+			fprintf(stderr, "Error: opening %s: %s\n",
+				output, strerror(errno));
+			close(fd);
+			return 1;
+		}
+	}
+
+	/* The oldest data starts at the append position once the ring has
+	 * wrapped, and at the beginning before that. */
+	pos = header.written % header.size;
+	if (header.written >= header.size) {
+		len = header.size - pos;
+		if (copy_range(fd, header.header_size + pos, len, out) < 0)
+			ret = -1;
+	} else {
+		pos = header.written;
+	}
+	if (ret == 0 && copy_range(fd, header.header_size, pos, out) < 0)
+		ret = -1;
+
+	if (ret < 0)
+		fprintf(stderr, "Error: reading %s failed.\n", argv[optind]);
+
+	if (out != stdout && fclose(out) != 0)
+		ret = -1;
+	close(fd);
+
+	return ret < 0 ? 1 : 0;
+}
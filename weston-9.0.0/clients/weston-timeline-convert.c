@@ -0,0 +1,325 @@
+/*
+ * Copyright © 2026 The Annland Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Converts a stream recorded from the 'timeline-binary' debug scope into
+ * the JSON written by the 'timeline' scope, for use with wesgr.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "libweston/timeline-binary.h"
+
+struct converter {
+	FILE *in;
+	FILE *out;
+	char **names;		/* indexed by name id */
+	uint32_t n_names;
+	unsigned long n_points;
+};
+
+static void
+print_help(void)
+{
+	fprintf(stderr,
+		"Usage: weston-timeline-convert [options] [FILE]\n"
+		"Converts the binary timeline in FILE, or stdin if none or -\n"
+		"is given, to the JSON format of the 'timeline' debug scope.\n"
+		"Where options may be:\n"
+		"  -h, --help\n"
+		"     This help text, and exit with success.\n"
+		"  -o FILE, --output FILE\n"
+		"     Direct output to file named FILE. Use - for stdout.\n"
+		"     Stdout is the default.\n"
+		"\n"
+		"A binary timeline is recorded with e.g.\n"
+		"  weston-debug timeline-binary -o timeline.bin\n"
+		);
+}
+
+static void
+print_quoted_string(FILE *out, const char *str)
+{
+	if (!str) {
+		fputs("null", out);
+		return;
+	}
+
+	fputc('"', out);
+	for (; *str; str++) {
+		if (*str == '"' || *str == '\\')
+			fputc('\\', out);
+		if ((unsigned char)*str < 0x20)
+			fprintf(out, "\\u%04x", *str);
+		else
+			fputc(*str, out);
+	}
+	fputc('"', out);
+}
+
+static void
+print_timestamp(FILE *out, const char *key, uint64_t ns)
+{
+	fprintf(out, ", \"%s\":[%" PRIu64 ", %" PRIu64 "]",
+		key, ns / 1000000000, ns % 1000000000);
+}
+
+static void
+reset_names(struct converter *conv)
+{
+	uint32_t i;
+
+	for (i = 0; i < conv->n_names; i++)
+		free(conv->names[i]);
+	free(conv->names);
+	conv->names = NULL;
+	conv->n_names = 0;
+}
+
+/* Reads the string blocks following a record; NULL if there are none. */
+static int
+read_string(struct converter *conv, const struct weston_timeline_record *r,
+	    char **str)
+{
+	size_t size = r->n_blocks * WESTON_TIMELINE_BLOCK_SIZE;
+
+	*str = NULL;
+	if (size == 0)
+		return 0;
+
+	*str = malloc(size);
+	if (!*str)
+		return -1;
+
+	if (fread(*str, 1, size, conv->in) != size) {
+		free(*str);
+		*str = NULL;
+		return -1;
+	}
+	(*str)[size - 1] = '\0';
+
+	return 0;
+}
+
+static int
+set_name(struct converter *conv, uint32_t id, char *name)
+{
+	char **names;
+
+	if (id == 0) {
+		free(name);
+		return -1;
+	}
+
+	if (id > conv->n_names) {
+		names = realloc(conv->names, id * sizeof(*names));
+		if (!names) {
+			free(name);
+			return -1;
+		}
+		memset(names + conv->n_names, 0,
+		       (id - conv->n_names) * sizeof(*names));
+		conv->names = names;
+		conv->n_names = id;
+	}
+
+	free(conv->names[id - 1]);
+	conv->names[id - 1] = name;
+
+	return 0;
+}
+
+static void
+print_point(struct converter *conv, const struct weston_timeline_record *r)
+{
+	const char *name = NULL;
+
+	if (r->id > 0 && r->id <= conv->n_names)
+		name = conv->names[r->id - 1];
+
+	fprintf(conv->out, "{ \"T\":[%" PRIu64 ", %" PRIu64 "], \"N\":",
+		r->time / 1000000000, r->time % 1000000000);
+	print_quoted_string(conv->out, name ? name : "unknown");
+
+	if (r->output)
+		fprintf(conv->out, ", \"wo\":%u", r->output);
+	if (r->surface)
+		fprintf(conv->out, ", \"ws\":%u", r->surface);
+	if (r->flags & WESTON_TIMELINE_POINT_VBLANK)
+		print_timestamp(conv->out, "vblank_monotonic", r->extra);
+	if (r->flags & WESTON_TIMELINE_POINT_GPU)
+		print_timestamp(conv->out, "gpu", r->extra);
+
+	fprintf(conv->out, " }\n");
+	conv->n_points++;
+}
+
+static int
+convert(struct converter *conv)
+{
+	struct weston_timeline_record r;
+	bool have_header = false;
+	char *str;
+
+	while (fread(&r, sizeof(r), 1, conv->in) == 1) {
+		if (r.kind == WESTON_TIMELINE_RECORD_HEADER) {
+			if (r.id != WESTON_TIMELINE_BINARY_MAGIC ||
+			    r.aux != WESTON_TIMELINE_BINARY_VERSION) {
+				fprintf(stderr, "Error: unsupported stream "
+					"header 0x%08x version %u.\n",
+					r.id, r.aux);
+				return -1;
+			}
+
+			/* Streams may be concatenated; ids start over. */
+			reset_names(conv);
+			have_header = true;
+			continue;
+		}
+
+		if (!have_header) {
+			fprintf(stderr, "Error: not a binary timeline.\n");
+			return -1;
+		}
+
+		if (read_string(conv, &r, &str) < 0) {
+			fprintf(stderr, "Warning: truncated record.\n");
+			break;
+		}
+
+		switch (r.kind) {
+		case WESTON_TIMELINE_RECORD_NAME:
+			if (set_name(conv, r.id, str) < 0)
+				fprintf(stderr, "Warning: bad name %u.\n",
+					r.id);
+			str = NULL;
+			break;
+		case WESTON_TIMELINE_RECORD_OUTPUT:
+			fprintf(conv->out, "{ \"id\":%u, "
+				"\"type\":\"weston_output\", \"name\":", r.id);
+			print_quoted_string(conv->out, str);
+			fprintf(conv->out, " }\n");
+			break;
+		case WESTON_TIMELINE_RECORD_SURFACE:
+			fprintf(conv->out, "{ \"id\":%u, "
+				"\"type\":\"weston_surface\", \"desc\":", r.id);
+			print_quoted_string(conv->out, str);
+			if (r.aux)
+				fprintf(conv->out, ", \"main_surface\":%u",
+					r.aux);
+			fprintf(conv->out, " }\n");
+			break;
+		case WESTON_TIMELINE_RECORD_POINT:
+			print_point(conv, &r);
+			break;
+		default:
+			/* Skip kinds added by later versions. */
+			break;
+		}
+
+		free(str);
+	}
+
+	if (ferror(conv->in)) {
+		fprintf(stderr, "Error: reading input: %s\n", strerror(errno));
+		return -1;
+	}
+
+	return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+	static const struct option opts[] = {
+		{ "help", no_argument, NULL, 'h' },
+		{ "output", required_argument, NULL, 'o' },
+		{ 0 }
+	};
+	struct converter conv = {};
+	const char *output = NULL;
+	int c, ret;
+
+	while ((c = getopt_long(argc, argv, "ho:", opts, NULL)) != -1) {
+		switch (c) {
+		case 'h':
+			print_help();
+			return 0;
+		case 'o':
+			output = optarg;
+			break;
+		default:
+			print_help();
+			return 1;
+		}
+	}
+
+	if (argc - optind > 1) {
+		print_help();
+		return 1;
+	}
+
+	if (optind < argc && strcmp(argv[optind], "-") != 0) {
+		conv.in = fopen(argv[optind], "rb");
+		if (!conv.in) {
+			fprintf(stderr, "Error: opening %s: %s\n",
+				argv[optind], strerror(errno));
+			return 1;
+		}
+	} else {
+		conv.in = stdin;
+	}
+
+	if (output && strcmp(output, "-") != 0) {
+		conv.out = fopen(output, "w");
+		if (!conv.out) {
+			fprintf(stderr, "Error: opening %s: %s\n",
+				output, strerror(errno));
+			return 1;
+		}
+	} else {
+		conv.out = stdout;
+	}
+
+	ret = convert(&conv);
+	fprintf(stderr, "%lu timeline points converted.\n", conv.n_points);
+
+	reset_names(&conv);
+	if (conv.in != stdin)
+		fclose(conv.in);
+	if (conv.out != stdout && fclose(conv.out) != 0)
+		ret = -1;
+
+	return ret < 0 ? 1 : 0;
+}
@@ -667,6 +667,10 @@ usage(int error_code)
 		"  -f, --flight-rec-scopes=SCOPE\n\t\t\tSpecify log scopes to "
 			"subscribe to.\n\t\t\tCan specify multiple scopes, "
 			"each followed by comma\n"
+		"  --flight-rec-file=FILE\n\t\t\tKeep the flight recorder in FILE, "
+			"to be read\n\t\t\twith weston-flight-rec\n"
+		"  --flight-rec-size=KB\tSize of the flight recorder, "
+			"defaults to 5120\n"
 		"  -h, --help\t\tThis help message\n\n");
 
 #if defined(BUILD_DRM_COMPOSITOR)
@@ -686,6 +690,7 @@ usage(int error_code)
 		"  --tty=TTY\t\tThe tty to use\n"
 		"  --device=DEVICE\tThe framebuffer device to use\n"
 		"  --seat=SEAT\t\tThe seat that weston should run on, instead of the seat defined in XDG_SEAT\n"
+		"  --pixman-threads=N\tComposite each output on N threads\n"
 		"\n");
 #endif
 
@@ -699,6 +704,7 @@ usage(int error_code)
 		"\tnormal 90 180 270 flipped flipped-90 flipped-180 flipped-270\n"
 		"  --use-pixman\t\tUse the pixman (CPU) renderer (default: no rendering)\n"
 		"  --use-gl\t\tUse the GL renderer (default: no rendering)\n"
+		"  --pixman-threads=N\tComposite each output on N threads\n"
 		"  --no-outputs\t\tDo not create any virtual outputs\n"
 		"\n");
 #endif
@@ -715,6 +721,7 @@ usage(int error_code)
 		"  --rdp4-key=FILE\tThe file containing the key for RDP4 encryption\n"
 		"  --rdp-tls-cert=FILE\tThe file containing the certificate for TLS encryption\n"
 		"  --rdp-tls-key=FILE\tThe file containing the private key for TLS encryption\n"
+		"  --pixman-threads=N\tComposite each output on N threads\n"
 		"\n");
 #endif
 
@@ -739,6 +746,7 @@ usage(int error_code)
 		"  --scale=SCALE\t\tScale factor of output\n"
 		"  --fullscreen\t\tRun in fullscreen mode\n"
 		"  --use-pixman\t\tUse the pixman (CPU) renderer\n"
+		"  --pixman-threads=N\tComposite each output on N threads\n"
 		"  --output-count=COUNT\tCreate multiple outputs\n"
 		"  --no-input\t\tDont create input devices\n\n");
 #endif
@@ -1050,6 +1058,9 @@ weston_compositor_init_config(struct weston_compositor *ec,
 	struct xkb_rule_names xkb_names;
 	struct weston_config_section *s;
 	int repaint_msec;
+	int damage_max_rects;
+	double damage_max_overhead;
+	bool view_index;
 	bool cal;
 
 	/* weston.ini [keyboard] */
@@ -1089,6 +1100,17 @@ weston_compositor_init_config(struct weston_compositor *ec,
 	weston_log("Output repaint window is %d ms maximum.\n",
 		   ec->repaint_msec);
 
+	weston_config_section_get_bool(s, "view-index", &view_index, false);
+	if (view_index && weston_compositor_enable_view_index(ec) < 0)
+		weston_log("Failed to enable the view index.\n");
+
+	weston_config_section_get_int(s, "damage-max-rects",
+				      &damage_max_rects, 0);
+	weston_config_section_get_double(s, "damage-max-overhead",
+					 &damage_max_overhead, 0.25);
+	weston_compositor_set_damage_simplification(ec, damage_max_rects,
+						    damage_max_overhead);
+
 	/* weston.ini [libinput] */
 	s = weston_config_get_section(config, "libinput", NULL, NULL);
 	weston_config_section_get_bool(s, "touchscreen_calibrator", &cal, 0);
@@ -2518,6 +2540,10 @@ load_drm_backend(struct weston_compositor *c,
 	weston_config_section_get_bool(section, "use-pixman", &config.use_pixman,
 				       false);
 
+	section = weston_config_get_section(wc, "libinput", NULL, NULL);
+	weston_config_section_get_bool(section, "coalesce-motion",
+				       &config.coalesce_pointer_motion, false);
+
 	const struct weston_option options[] = {
 		{ WESTON_OPTION_STRING, "seat", 0, &config.seat_id },
 		{ WESTON_OPTION_INTEGER, "tty", 0, &config.tty },
@@ -2594,6 +2620,8 @@ load_headless_backend(struct weston_compositor *c,
 				       false);
 	weston_config_section_get_bool(section, "use-gl", &config.use_gl,
 				       false);
+	weston_config_section_get_uint(section, "pixman-threads",
+				       &config.pixman_threads, 0);
 
 	const struct weston_option options[] = {
 		{ WESTON_OPTION_INTEGER, "width", 0, &parsed_options->width },
@@ -2601,6 +2629,7 @@ load_headless_backend(struct weston_compositor *c,
 		{ WESTON_OPTION_INTEGER, "scale", 0, &parsed_options->scale },
 		{ WESTON_OPTION_BOOLEAN, "use-pixman", 0, &config.use_pixman },
 		{ WESTON_OPTION_BOOLEAN, "use-gl", 0, &config.use_gl },
+		{ WESTON_OPTION_UNSIGNED_INTEGER, "pixman-threads", 0, &config.pixman_threads },
 		{ WESTON_OPTION_STRING, "transform", 0, &transform },
 		{ WESTON_OPTION_BOOLEAN, "no-outputs", 0, &no_outputs },
 	};
@@ -2690,6 +2719,7 @@ weston_rdp_backend_config_init(struct weston_rdp_backend_config *config)
 	config->env_socket = 0;
 	config->no_clients_resize = 0;
 	config->force_no_compression = 0;
+	config->pixman_threads = 0;
 }
 
 static int
@@ -2697,6 +2727,7 @@ load_rdp_backend(struct weston_compositor *c,
 		int *argc, char *argv[], struct weston_config *wc)
 {
 	struct weston_rdp_backend_config config  = {{ 0, }};
+	struct weston_config_section *section;
 	int ret = 0;
 
 	struct wet_output_config *parsed_options = wet_init_parsed_options(c);
@@ -2705,6 +2736,10 @@ load_rdp_backend(struct weston_compositor *c,
 
 	weston_rdp_backend_config_init(&config);
 
+	section = weston_config_get_section(wc, "core", NULL, NULL);
+	weston_config_section_get_uint(section, "pixman-threads",
+				       &config.pixman_threads, 0);
+
 	const struct weston_option rdp_options[] = {
 		{ WESTON_OPTION_BOOLEAN, "env-socket", 0, &config.env_socket },
 		{ WESTON_OPTION_INTEGER, "width", 0, &parsed_options->width },
@@ -2716,6 +2751,7 @@ load_rdp_backend(struct weston_compositor *c,
 		{ WESTON_OPTION_STRING,  "rdp-tls-cert", 0, &config.server_cert },
 		{ WESTON_OPTION_STRING,  "rdp-tls-key", 0, &config.server_key },
 		{ WESTON_OPTION_BOOLEAN, "force-no-compression", 0, &config.force_no_compression },
+		{ WESTON_OPTION_UNSIGNED_INTEGER, "pixman-threads", 0, &config.pixman_threads },
 	};
 
 	parse_options(rdp_options, ARRAY_LENGTH(rdp_options), argc, argv);
@@ -2757,12 +2793,18 @@ load_fbdev_backend(struct weston_compositor *c,
 		      int *argc, char **argv, struct weston_config *wc)
 {
 	struct weston_fbdev_backend_config config = {{ 0, }};
+	struct weston_config_section *section;
 	int ret = 0;
 
+	section = weston_config_get_section(wc, "core", NULL, NULL);
+	weston_config_section_get_uint(section, "pixman-threads",
+				       &config.pixman_threads, 0);
+
 	const struct weston_option fbdev_options[] = {
 		{ WESTON_OPTION_INTEGER, "tty", 0, &config.tty },
 		{ WESTON_OPTION_STRING, "device", 0, &config.device },
 		{ WESTON_OPTION_STRING, "seat", 0, &config.seat_id },
+		{ WESTON_OPTION_UNSIGNED_INTEGER, "pixman-threads", 0, &config.pixman_threads },
 	};
 
 	parse_options(fbdev_options, ARRAY_LENGTH(fbdev_options), argc, argv);
@@ -2815,6 +2857,8 @@ load_x11_backend(struct weston_compositor *c,
 	section = weston_config_get_section(wc, "core", NULL, NULL);
 	weston_config_section_get_bool(section, "use-pixman", &config.use_pixman,
 				       false);
+	weston_config_section_get_uint(section, "pixman-threads",
+				       &config.pixman_threads, 0);
 
 	const struct weston_option options[] = {
 	       { WESTON_OPTION_INTEGER, "width", 0, &parsed_options->width },
@@ -2824,6 +2868,7 @@ load_x11_backend(struct weston_compositor *c,
 	       { WESTON_OPTION_INTEGER, "output-count", 0, &option_count },
 	       { WESTON_OPTION_BOOLEAN, "no-input", 0, &config.no_input },
 	       { WESTON_OPTION_BOOLEAN, "use-pixman", 0, &config.use_pixman },
+	       { WESTON_OPTION_UNSIGNED_INTEGER, "pixman-threads", 0, &config.pixman_threads },
 	};
 
 	parse_options(options, ARRAY_LENGTH(options), argc, argv);
@@ -3131,6 +3176,8 @@ wet_main(int argc, char *argv[])
 	char *log = NULL;
 	char *log_scopes = NULL;
 	char *flight_rec_scopes = NULL;
+	char *flight_rec_file = NULL;
+	int32_t flight_rec_size = DEFAULT_FLIGHT_REC_SIZE / 1024;
 	char *server_socket = NULL;
 	int32_t idle_time = -1;
 	int32_t help = 0;
@@ -3172,6 +3219,8 @@ wet_main(int argc, char *argv[])
 		{ WESTON_OPTION_BOOLEAN, "debug", 0, &debug_protocol },
 		{ WESTON_OPTION_STRING, "logger-scopes", 'l', &log_scopes },
 		{ WESTON_OPTION_STRING, "flight-rec-scopes", 'f', &flight_rec_scopes },
+		{ WESTON_OPTION_STRING, "flight-rec-file", 0, &flight_rec_file },
+		{ WESTON_OPTION_INTEGER, "flight-rec-size", 0, &flight_rec_size },
 	};
 
 	wl_list_init(&wet.layoutput_list);
@@ -3208,7 +3257,23 @@ wet_main(int argc, char *argv[])
 	weston_log_set_handler(vlog, vlog_continue);
 
 	logger = weston_log_subscriber_create_log(weston_logfile);
-	flight_rec = weston_log_subscriber_create_flight_rec(DEFAULT_FLIGHT_REC_SIZE);
+	if (flight_rec_size <= 0) {
+		fprintf(stderr, "Invalid flight recorder size %d\n",
+			flight_rec_size);
+		return EXIT_FAILURE;
+	}
+	if (flight_rec_file) {
+		flight_rec = weston_log_subscriber_create_flight_rec_file(
+					flight_rec_file,
+					(size_t)flight_rec_size * 1024);
+		if (!flight_rec)
+			fprintf(stderr, "Failed to create flight recorder "
+				"file %s, keeping it in memory\n",
+				flight_rec_file);
+	}
+	if (!flight_rec)
+		flight_rec = weston_log_subscriber_create_flight_rec(
+					(size_t)flight_rec_size * 1024);
 
 	weston_log_subscribe_to_scopes(log_ctx, logger, flight_rec,
 				       log_scopes, flight_rec_scopes);
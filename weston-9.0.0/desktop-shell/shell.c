@@ -5180,6 +5180,10 @@ wet_shell_init(struct weston_compositor *ec,
 	weston_layer_set_position(&shell->background_layer,
 				  WESTON_LAYER_POSITION_BACKGROUND);
 
+	/* Both change far less often than the windows above them. */
+	weston_layer_set_flattened(&shell->panel_layer, true);
+	weston_layer_set_flattened(&shell->background_layer, true);
+
 	wl_array_init(&shell->workspaces.array);
 	wl_list_init(&shell->workspaces.client_list);
 
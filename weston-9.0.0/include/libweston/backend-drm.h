@@ -35,7 +35,7 @@
 extern "C" {
 #endif
 
-#define WESTON_DRM_BACKEND_CONFIG_VERSION 3
+#define WESTON_DRM_BACKEND_CONFIG_VERSION 4
 
 struct libinput_device;
 
@@ -226,6 +226,12 @@ struct weston_drm_backend_config {
 
 	/** Allow compositor to start without input devices. */
 	bool continue_without_input;
+
+	/** Coalesce the relative pointer motion read in one libinput dispatch
+	 * into a single motion event. Clients bound to zwp_relative_pointer
+	 * still receive every event.
+	 */
+	bool coalesce_pointer_motion;
 };
 
 #ifdef  __cplusplus
@@ -34,7 +34,7 @@ extern "C" {
 
 #include <libweston/libweston.h>
 
-#define WESTON_FBDEV_BACKEND_CONFIG_VERSION 2
+#define WESTON_FBDEV_BACKEND_CONFIG_VERSION 3
 
 struct libinput_device;
 
@@ -61,6 +61,10 @@ struct weston_fbdev_backend_config {
 	 * backend destruction.
 	 */
 	char *seat_id;
+
+	/** Number of threads compositing each output with the pixman
+	 * renderer, 0 or 1 to render on the compositor thread only */
+	uint32_t pixman_threads;
 };
 
 #ifdef  __cplusplus
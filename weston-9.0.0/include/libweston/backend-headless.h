@@ -34,7 +34,7 @@ extern "C" {
 
 #include <libweston/libweston.h>
 
-#define WESTON_HEADLESS_BACKEND_CONFIG_VERSION 2
+#define WESTON_HEADLESS_BACKEND_CONFIG_VERSION 3
 
 struct weston_headless_backend_config {
 	struct weston_backend_config base;
@@ -44,6 +44,10 @@ struct weston_headless_backend_config {
 
 	/** Whether to use the GL renderer, conflicts with use_pixman */
 	bool use_gl;
+
+	/** Number of threads compositing each output with the pixman
+	 * renderer, 0 or 1 to render on the compositor thread only */
+	uint32_t pixman_threads;
 };
 
 #ifdef  __cplusplus
@@ -34,7 +34,7 @@ extern "C" {
 
 #include <libweston/libweston.h>
 
-#define WESTON_X11_BACKEND_CONFIG_VERSION 2
+#define WESTON_X11_BACKEND_CONFIG_VERSION 3
 
 struct weston_x11_backend_config {
 	struct weston_backend_config base;
@@ -44,6 +44,10 @@ struct weston_x11_backend_config {
 
 	/** Whether to use the pixman renderer instead of the OpenGL ES renderer. */
 	bool use_pixman;
+
+	/** Number of threads compositing each output with the pixman
+	 * renderer, 0 or 1 to render on the compositor thread only */
+	uint32_t pixman_threads;
 };
 
 #ifdef  __cplusplus
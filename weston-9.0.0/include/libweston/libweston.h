@@ -78,6 +78,8 @@ struct weston_pointer;
 struct linux_dmabuf_buffer;
 struct weston_recorder;
 struct weston_pointer_constraint;
+struct weston_view_index;
+struct weston_frame_timing;
 struct ro_anonymous_file;
 
 enum weston_keyboard_modifier {
@@ -256,6 +258,11 @@ struct weston_output {
 	/** Output area in global coordinates, simple rect */
 	pixman_region32_t region;
 
+	/** Views of the surfaces on this output, in view_list order,
+	 *  struct weston_view *; rebuilt lazily when view_list_dirty */
+	struct wl_array view_list;
+	bool view_list_dirty;
+
 	/** True if damage has occurred since the last repaint for this output;
 	 *  if set, a repaint will eventually occur. */
 	bool repaint_needed;
@@ -285,6 +292,16 @@ struct weston_output {
 	int move_x, move_y;
 	struct timespec frame_time; /* presentation timestamp */
 	uint64_t msc;        /* media stream counter */
+	/** Repaint loop statistics, see the 'frame-timing' debug scope */
+	struct weston_frame_timing *frame_timing;
+	/** Damage simplification totals, see the 'damage' debug scope */
+	struct {
+		uint64_t repaints;
+		uint64_t rects_in;
+		uint64_t rects_out;
+		uint64_t pixels_damaged;
+		uint64_t pixels_overdrawn;
+	} damage_stats;
 	int disable_planes;
 	int destroying;
 	struct wl_list feedback_list;
@@ -872,6 +889,9 @@ struct weston_layer {
 	enum weston_layer_position position;
 	pixman_box32_t mask;
 	struct weston_layer_entry view_list;
+	/** Let renderers draw the layer from a cached image, see
+	 * weston_layer_set_flattened() */
+	bool flattened;
 };
 
 struct weston_plane {
@@ -1049,6 +1069,11 @@ struct weston_compositor {
 	struct wl_list seat_list;
 	struct wl_list layer_list;	/* struct weston_layer::link */
 	struct wl_list view_list;	/* struct weston_view::link */
+	/* layer or sub-surface topology changed since view_list was built */
+	bool view_list_needs_rebuild;
+	/* optional spatial index of view_list, see
+	 * weston_compositor_enable_view_index() */
+	struct weston_view_index *view_index;
 	struct wl_list plane_list;
 	struct wl_list key_binding_list;
 	struct wl_list modifier_binding_list;
@@ -1121,6 +1146,16 @@ struct weston_compositor {
 	struct weston_log_context *weston_log_ctx;
 	struct weston_log_scope *debug_scene;
 	struct weston_log_scope *timeline;
+	struct weston_log_scope *timeline_binary;
+	struct weston_log_scope *frame_timing;
+	struct wl_event_source *frame_timing_timer;
+	struct weston_log_scope *damage_scope;
+
+	/* see weston_compositor_set_damage_simplification() */
+	struct {
+		int max_rects;
+		double max_overhead;
+	} damage_simplify;
 
 	struct content_protection *content_protection;
 };
@@ -1306,6 +1341,14 @@ struct weston_view {
 	uint32_t psf_flags;
 
 	bool is_mapped;
+
+	/* Managed by the compositor's view index, read-only. */
+	struct {
+		bool indexed;		/* in weston_compositor::view_index */
+		bool large;		/* in the large view list */
+		uint32_t order;		/* position in view_list */
+		pixman_box32_t cells;	/* registered cell range */
+	} index;
 };
 
 struct weston_surface_state {
@@ -1391,6 +1434,9 @@ struct weston_surface {
 
 	/** Damage in local coordinates from the client, for tex upload. */
 	pixman_region32_t damage;
+	/** Changes whenever the surface content may have changed, unique
+	 * among all surfaces of the compositor */
+	uint32_t content_serial;
 
 	pixman_region32_t opaque;        /* part of geometry, see below */
 	pixman_region32_t input;
@@ -1441,6 +1487,16 @@ struct weston_surface {
 	struct weston_matrix buffer_to_surface_matrix;
 	struct weston_matrix surface_to_buffer_matrix;
 
+	/* The inputs the matrices above were last built from. Commits that
+	 * change none of them, e.g. damage-only commits, keep the matrices
+	 * as they are. */
+	struct {
+		bool valid;
+		struct weston_buffer_viewport viewport;
+		int32_t width_from_buffer;
+		int32_t height_from_buffer;
+	} buffer_matrix_key;
+
 	/*
 	 * If non-NULL, this function will be called on
 	 * wl_surface::commit after a new buffer has been set up for
@@ -1598,6 +1654,9 @@ weston_layer_set_mask_infinite(struct weston_layer *layer);
 bool
 weston_layer_mask_is_infinite(struct weston_layer *layer);
 
+void
+weston_layer_set_flattened(struct weston_layer *layer, bool flattened);
+
 /* An invalid flag in presented_flags to catch logic errors. */
 #define WP_PRESENTATION_FEEDBACK_INVALID (1U << 31)
 
@@ -2055,6 +2114,14 @@ weston_log_ctx_destroy(struct weston_log_context *log_ctx);
 int
 weston_compositor_enable_content_protection(struct weston_compositor *compositor);
 
+int
+weston_compositor_enable_view_index(struct weston_compositor *compositor);
+
+void
+weston_compositor_set_damage_simplification(struct weston_compositor *compositor,
+					    int max_rects,
+					    double max_overhead);
+
 void
 weston_timeline_refresh_subscription_objects(struct weston_compositor *wc,
 					     void *object);
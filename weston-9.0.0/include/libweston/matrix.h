@@ -40,6 +40,10 @@ enum weston_matrix_transform_type {
 
 struct weston_matrix {
 	float d[16];
+	/* Bitmask of weston_matrix_transform_type. The matrix operations
+	 * use it to pick a fast path, so code that fills in d by hand must
+	 * set WESTON_MATRIX_TRANSFORM_OTHER unless the content is known to
+	 * match the bits. */
 	unsigned int type;
 };
 
@@ -32,6 +32,19 @@
 #include "ivi-layout-export.h"
 #include <libweston-desktop/libweston-desktop.h>
 
+/* Entry of an ivi_layout_id_index, embedded in surfaces and layers. */
+struct ivi_layout_id_node {
+	struct wl_list link;	/* ivi_layout_id_index::buckets */
+	uint32_t id;
+};
+
+/* Chained hash table of surfaces or layers by ID. */
+struct ivi_layout_id_index {
+	struct wl_list *buckets;	/* ivi_layout_id_node::link */
+	uint32_t size;	/* power of two, 0 until the first insert */
+	uint32_t count;
+};
+
 struct ivi_layout_view {
 	struct wl_list link;	/* ivi_layout::view_list */
 	struct wl_list surf_link;	/*ivi_layout_surface::view_list */
@@ -47,6 +60,8 @@ struct ivi_layout_view {
 
 struct ivi_layout_surface {
 	struct wl_list link;	/* ivi_layout::surface_list */
+	struct wl_list changed_link;	/* ivi_layout::changed_surface_list */
+	struct ivi_layout_id_node id_node;	/* ivi_layout::surface_index */
 	struct wl_signal property_changed;
 	int32_t update_count;
 	uint32_t id_surface;
@@ -58,6 +73,7 @@ struct ivi_layout_surface {
 	struct ivi_layout_surface_properties prop;
 
 	struct {
+		int dirty;
 		struct ivi_layout_surface_properties prop;
 	} pending;
 
@@ -66,6 +82,8 @@ struct ivi_layout_surface {
 
 struct ivi_layout_layer {
 	struct wl_list link;	/* ivi_layout::layer_list */
+	struct wl_list changed_link;	/* ivi_layout::changed_layer_list */
+	struct ivi_layout_id_node id_node;	/* ivi_layout::layer_index */
 	struct wl_signal property_changed;
 	uint32_t id_layer;
 
@@ -75,6 +93,7 @@ struct ivi_layout_layer {
 	struct ivi_layout_layer_properties prop;
 
 	struct {
+		int dirty;
 		struct ivi_layout_layer_properties prop;
 		struct wl_list view_list;	/* ivi_layout_view::pending_link */
 		struct wl_list link;	/* ivi_layout_screen::pending.layer_list */
@@ -97,6 +116,14 @@ struct ivi_layout {
 	struct wl_list screen_list;	/* ivi_layout_screen::link */
 	struct wl_list view_list;	/* ivi_layout_view::link */
 
+	struct ivi_layout_id_index surface_index;
+	struct ivi_layout_id_index layer_index;
+
+	/* Surfaces and layers to look at in the next commit: their pending
+	 * state changed, or they have notifications to send. */
+	struct wl_list changed_surface_list;	/* ivi_layout_surface::changed_link */
+	struct wl_list changed_layer_list;	/* ivi_layout_layer::changed_link */
+
 	struct {
 		struct wl_signal created;
 		struct wl_signal removed;
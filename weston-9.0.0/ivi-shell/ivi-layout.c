@@ -73,6 +73,8 @@
 
 #define max(a, b) ((a) > (b) ? (a) : (b))
 
+#define ID_INDEX_INITIAL_SIZE 64
+
 struct ivi_layout;
 
 struct ivi_layout_screen {
@@ -108,36 +110,148 @@ get_instance(void)
 }
 
 /**
- * Internal API to add/remove an ivi_layer to/from ivi_screen.
+ * Internal API to index ivi_surfaces and ivi_layers by ID.
  */
-static struct ivi_layout_surface *
-get_surface(struct wl_list *surf_list, uint32_t id_surface)
+static struct wl_list *
+id_index_bucket(struct wl_list *buckets, uint32_t size, uint32_t id)
+{
+	uint32_t h = id * 0x9e3779b1u;
+
+	return &buckets[(h ^ (h >> 16)) & (size - 1)];
+}
+
+static bool
+id_index_resize(struct ivi_layout_id_index *index, uint32_t size)
 {
-	struct ivi_layout_surface *ivisurf;
+	struct ivi_layout_id_node *node, *next;
+	struct wl_list *buckets;
+	uint32_t i;
+
+	buckets = calloc(size, sizeof *buckets);
+	if (buckets == NULL)
+		return false;
 
-	wl_list_for_each(ivisurf, surf_list, link) {
-		if (ivisurf->id_surface == id_surface) {
-			return ivisurf;
+	for (i = 0; i < size; i++)
+		wl_list_init(&buckets[i]);
+
+	for (i = 0; i < index->size; i++) {
+		wl_list_for_each_safe(node, next, &index->buckets[i], link) {
+			wl_list_remove(&node->link);
+			wl_list_insert(id_index_bucket(buckets, size, node->id),
+				       &node->link);
 		}
 	}
 
-	return NULL;
+	free(index->buckets);
+	index->buckets = buckets;
+	index->size = size;
+
+	return true;
 }
 
-static struct ivi_layout_layer *
-get_layer(struct wl_list *layer_list, uint32_t id_layer)
+static bool
+id_index_insert(struct ivi_layout_id_index *index,
+		struct ivi_layout_id_node *node, uint32_t id)
 {
-	struct ivi_layout_layer *ivilayer;
+	/* Failing to grow only makes the chains longer. */
+	if (index->count >= index->size &&
+	    !id_index_resize(index, index->size ? index->size * 2 :
+					     ID_INDEX_INITIAL_SIZE) &&
+	    index->size == 0)
+		return false;
 
-	wl_list_for_each(ivilayer, layer_list, link) {
-		if (ivilayer->id_layer == id_layer) {
-			return ivilayer;
-		}
+	node->id = id;
+	wl_list_insert(id_index_bucket(index->buckets, index->size, id),
+		       &node->link);
+	index->count++;
+
+	return true;
+}
+
+static void
+id_index_remove(struct ivi_layout_id_index *index,
+		struct ivi_layout_id_node *node)
+{
+	wl_list_remove(&node->link);
+	index->count--;
+}
+
+static struct ivi_layout_id_node *
+id_index_find(struct ivi_layout_id_index *index, uint32_t id)
+{
+	struct ivi_layout_id_node *node;
+
+	if (index->size == 0)
+		return NULL;
+
+	wl_list_for_each(node,
+			 id_index_bucket(index->buckets, index->size, id),
+			 link) {
+		if (node->id == id)
+			return node;
 	}
 
 	return NULL;
 }
 
+static struct ivi_layout_surface *
+get_surface(struct ivi_layout *layout, uint32_t id_surface)
+{
+	struct ivi_layout_id_node *node;
+
+	node = id_index_find(&layout->surface_index, id_surface);
+	if (node == NULL)
+		return NULL;
+
+	return container_of(node, struct ivi_layout_surface, id_node);
+}
+
+static struct ivi_layout_layer *
+get_layer(struct ivi_layout *layout, uint32_t id_layer)
+{
+	struct ivi_layout_id_node *node;
+
+	node = id_index_find(&layout->layer_index, id_layer);
+	if (node == NULL)
+		return NULL;
+
+	return container_of(node, struct ivi_layout_layer, id_node);
+}
+
+/**
+ * Internal API to track which ivi_surfaces and ivi_layers the next
+ * ivi_layout_commit_changes has to look at.
+ */
+static void
+surface_changed(struct ivi_layout_surface *ivisurf)
+{
+	if (wl_list_empty(&ivisurf->changed_link))
+		wl_list_insert(ivisurf->layout->changed_surface_list.prev,
+			       &ivisurf->changed_link);
+}
+
+static void
+surface_pending_changed(struct ivi_layout_surface *ivisurf)
+{
+	ivisurf->pending.dirty = 1;
+	surface_changed(ivisurf);
+}
+
+static void
+layer_changed(struct ivi_layout_layer *ivilayer)
+{
+	if (wl_list_empty(&ivilayer->changed_link))
+		wl_list_insert(ivilayer->layout->changed_layer_list.prev,
+			       &ivilayer->changed_link);
+}
+
+static void
+layer_pending_changed(struct ivi_layout_layer *ivilayer)
+{
+	ivilayer->pending.dirty = 1;
+	layer_changed(ivilayer);
+}
+
 static bool
 ivi_view_is_rendered(struct ivi_layout_view *view)
 {
@@ -246,6 +360,8 @@ ivi_layout_surface_destroy(struct ivi_layout_surface *ivisurf)
 	}
 
 	wl_list_remove(&ivisurf->link);
+	wl_list_remove(&ivisurf->changed_link);
+	id_index_remove(&layout->surface_index, &ivisurf->id_node);
 
 	wl_list_for_each_safe(ivi_view, next, &ivisurf->view_list, surf_link) {
 		ivi_view_destroy(ivi_view);
@@ -610,17 +726,32 @@ ivi_view_is_mapped(struct ivi_layout_view *ivi_view)
 static void
 commit_changes(struct ivi_layout *layout)
 {
+	struct ivi_layout_layer *ivilayer = NULL;
+	struct ivi_layout_surface *ivisurf = NULL;
 	struct ivi_layout_view *ivi_view  = NULL;
 
-	wl_list_for_each(ivi_view, &layout->view_list, link) {
-		/*
-		 * If the view is not on the currently rendered scenegraph,
-		 * we do not need to update its properties.
-		 */
-		if (!ivi_view_is_mapped(ivi_view))
-			continue;
+	/*
+	 * Only views of changed layers and surfaces can have new properties.
+	 * If the view is not on the currently rendered scenegraph,
+	 * we do not need to update its properties.
+	 */
+	wl_list_for_each(ivilayer, &layout->changed_layer_list, changed_link) {
+		wl_list_for_each(ivi_view, &ivilayer->order.view_list,
+				 order_link) {
+			if (ivi_view_is_mapped(ivi_view))
+				update_prop(ivi_view);
+		}
+	}
+
+	wl_list_for_each(ivisurf, &layout->changed_surface_list, changed_link) {
+		wl_list_for_each(ivi_view, &ivisurf->view_list, surf_link) {
+			/* Already updated with its layer. */
+			if (!wl_list_empty(&ivi_view->on_layer->changed_link))
+				continue;
 
-		update_prop(ivi_view);
+			if (ivi_view_is_mapped(ivi_view))
+				update_prop(ivi_view);
+		}
 	}
 }
 
@@ -634,7 +765,9 @@ commit_surface_list(struct ivi_layout *layout)
 	int32_t dest_height = 0;
 	int32_t configured = 0;
 
-	wl_list_for_each(ivisurf, &layout->surface_list, link) {
+	wl_list_for_each(ivisurf, &layout->changed_surface_list, changed_link) {
+		ivisurf->pending.dirty = 0;
+
 		if (ivisurf->pending.prop.transition_type == IVI_LAYOUT_TRANSITION_VIEW_DEFAULT) {
 			dest_x = ivisurf->prop.dest_x;
 			dest_y = ivisurf->prop.dest_y;
@@ -733,7 +866,9 @@ commit_layer_list(struct ivi_layout *layout)
 	struct ivi_layout_layer   *ivilayer = NULL;
 	struct ivi_layout_view *next     = NULL;
 
-	wl_list_for_each(ivilayer, &layout->layer_list, link) {
+	wl_list_for_each(ivilayer, &layout->changed_layer_list, changed_link) {
+		ivilayer->pending.dirty = 0;
+
 		if (ivilayer->pending.prop.transition_type == IVI_LAYOUT_TRANSITION_LAYER_MOVE) {
 			ivi_layout_transition_move_layer(ivilayer, ivilayer->pending.prop.dest_x, ivilayer->pending.prop.dest_y, ivilayer->pending.prop.transition_duration);
 		} else if (ivilayer->pending.prop.transition_type == IVI_LAYOUT_TRANSITION_LAYER_FADE) {
@@ -755,6 +890,7 @@ commit_layer_list(struct ivi_layout *layout)
 			wl_list_remove(&ivi_view->order_link);
 			wl_list_init(&ivi_view->order_link);
 			ivi_view->ivisurf->prop.event_mask |= IVI_NOTIFICATION_REMOVE;
+			surface_changed(ivi_view->ivisurf);
 		}
 
 		assert(wl_list_empty(&ivilayer->order.view_list));
@@ -764,6 +900,7 @@ commit_layer_list(struct ivi_layout *layout)
 			wl_list_remove(&ivi_view->order_link);
 			wl_list_insert(&ivilayer->order.view_list, &ivi_view->order_link);
 			ivi_view->ivisurf->prop.event_mask |= IVI_NOTIFICATION_ADD;
+			surface_changed(ivi_view->ivisurf);
 		}
 
 		ivilayer->order.dirty = 0;
@@ -785,6 +922,7 @@ commit_screen_list(struct ivi_layout *layout)
 				wl_list_remove(&ivilayer->order.link);
 				wl_list_init(&ivilayer->order.link);
 				ivilayer->prop.event_mask |= IVI_NOTIFICATION_REMOVE;
+				layer_changed(ivilayer);
 			}
 
 			assert(wl_list_empty(&iviscrn->order.layer_list));
@@ -798,6 +936,7 @@ commit_screen_list(struct ivi_layout *layout)
 					       &ivilayer->order.link);
 				ivilayer->on_screen = iviscrn;
 				ivilayer->prop.event_mask |= IVI_NOTIFICATION_ADD;
+				layer_changed(ivilayer);
 			}
 
 			iviscrn->order.dirty = 0;
@@ -877,17 +1016,67 @@ send_prop(struct ivi_layout *layout)
 	struct ivi_layout_layer   *ivilayer = NULL;
 	struct ivi_layout_surface *ivisurf  = NULL;
 
-	wl_list_for_each_reverse(ivilayer, &layout->layer_list, link) {
+	wl_list_for_each(ivilayer, &layout->changed_layer_list, changed_link) {
 		if (ivilayer->prop.event_mask)
 			send_layer_prop(ivilayer);
 	}
 
-	wl_list_for_each_reverse(ivisurf, &layout->surface_list, link) {
+	wl_list_for_each(ivisurf, &layout->changed_surface_list, changed_link) {
 		if (ivisurf->prop.event_mask)
 			send_surface_prop(ivisurf);
 	}
 }
 
+/*
+ * A surface whose destination rectangle is left to a transition keeps the
+ * old one until the transition sets it, or until the next commit.
+ */
+static bool
+surface_dest_rect_pending(struct ivi_layout_surface *ivisurf)
+{
+	const struct ivi_layout_surface_properties *prop = &ivisurf->prop;
+	const struct ivi_layout_surface_properties *pending =
+		&ivisurf->pending.prop;
+
+	return prop->dest_x != pending->dest_x ||
+	       prop->dest_y != pending->dest_y ||
+	       prop->dest_width != pending->dest_width ||
+	       prop->dest_height != pending->dest_height;
+}
+
+/*
+ * The notifications are sent, so only keep what changed since, e.g. from
+ * the listeners.
+ */
+static void
+clear_changed_lists(struct ivi_layout *layout)
+{
+	struct ivi_layout_layer   *ivilayer, *layer_next;
+	struct ivi_layout_surface *ivisurf, *surf_next;
+
+	wl_list_for_each_safe(ivilayer, layer_next,
+			      &layout->changed_layer_list, changed_link) {
+		ivilayer->prop.event_mask = 0;
+
+		if (ivilayer->pending.dirty || ivilayer->order.dirty)
+			continue;
+
+		wl_list_remove(&ivilayer->changed_link);
+		wl_list_init(&ivilayer->changed_link);
+	}
+
+	wl_list_for_each_safe(ivisurf, surf_next,
+			      &layout->changed_surface_list, changed_link) {
+		ivisurf->prop.event_mask = 0;
+
+		if (ivisurf->pending.dirty || surface_dest_rect_pending(ivisurf))
+			continue;
+
+		wl_list_remove(&ivisurf->changed_link);
+		wl_list_init(&ivisurf->changed_link);
+	}
+}
+
 static void
 clear_view_pending_list(struct ivi_layout_layer *ivilayer)
 {
@@ -1011,30 +1200,16 @@ static struct ivi_layout_layer *
 ivi_layout_get_layer_from_id(uint32_t id_layer)
 {
 	struct ivi_layout *layout = get_instance();
-	struct ivi_layout_layer *ivilayer = NULL;
 
-	wl_list_for_each(ivilayer, &layout->layer_list, link) {
-		if (ivilayer->id_layer == id_layer) {
-			return ivilayer;
-		}
-	}
-
-	return NULL;
+	return get_layer(layout, id_layer);
 }
 
 struct ivi_layout_surface *
 ivi_layout_get_surface_from_id(uint32_t id_surface)
 {
 	struct ivi_layout *layout = get_instance();
-	struct ivi_layout_surface *ivisurf = NULL;
-
-	wl_list_for_each(ivisurf, &layout->surface_list, link) {
-		if (ivisurf->id_surface == id_surface) {
-			return ivisurf;
-		}
-	}
 
-	return NULL;
+	return get_surface(layout, id_surface);
 }
 
 static int32_t
@@ -1279,7 +1454,7 @@ ivi_layout_layer_create_with_dimension(uint32_t id_layer,
 	struct ivi_layout *layout = get_instance();
 	struct ivi_layout_layer *ivilayer = NULL;
 
-	ivilayer = get_layer(&layout->layer_list, id_layer);
+	ivilayer = get_layer(layout, id_layer);
 	if (ivilayer != NULL) {
 		weston_log("id_layer is already created\n");
 		++ivilayer->ref_count;
@@ -1292,6 +1467,13 @@ ivi_layout_layer_create_with_dimension(uint32_t id_layer,
 		return NULL;
 	}
 
+	if (!id_index_insert(&layout->layer_index, &ivilayer->id_node,
+			     id_layer)) {
+		weston_log("fails to allocate memory\n");
+		free(ivilayer);
+		return NULL;
+	}
+
 	ivilayer->ref_count = 1;
 	wl_signal_init(&ivilayer->property_changed);
 	ivilayer->layout = layout;
@@ -1305,6 +1487,7 @@ ivi_layout_layer_create_with_dimension(uint32_t id_layer,
 
 	wl_list_init(&ivilayer->order.view_list);
 	wl_list_init(&ivilayer->order.link);
+	wl_list_init(&ivilayer->changed_link);
 
 	wl_list_insert(&layout->layer_list, &ivilayer->link);
 
@@ -1337,7 +1520,9 @@ ivi_layout_layer_destroy(struct ivi_layout_layer *ivilayer)
 
 	wl_list_remove(&ivilayer->pending.link);
 	wl_list_remove(&ivilayer->order.link);
+	wl_list_remove(&ivilayer->changed_link);
 	wl_list_remove(&ivilayer->link);
+	id_index_remove(&layout->layer_index, &ivilayer->id_node);
 
 	free(ivilayer);
 }
@@ -1361,6 +1546,8 @@ ivi_layout_layer_set_visibility(struct ivi_layout_layer *ivilayer,
 	else
 		prop->event_mask &= ~IVI_NOTIFICATION_VISIBILITY;
 
+	layer_pending_changed(ivilayer);
+
 	return IVI_SUCCEEDED;
 }
 
@@ -1385,6 +1572,8 @@ ivi_layout_layer_set_opacity(struct ivi_layout_layer *ivilayer,
 	else
 		prop->event_mask &= ~IVI_NOTIFICATION_OPACITY;
 
+	layer_pending_changed(ivilayer);
+
 	return IVI_SUCCEEDED;
 }
 
@@ -1413,6 +1602,8 @@ ivi_layout_layer_set_source_rectangle(struct ivi_layout_layer *ivilayer,
 	else
 		prop->event_mask &= ~IVI_NOTIFICATION_SOURCE_RECT;
 
+	layer_pending_changed(ivilayer);
+
 	return IVI_SUCCEEDED;
 }
 
@@ -1441,6 +1632,8 @@ ivi_layout_layer_set_destination_rectangle(struct ivi_layout_layer *ivilayer,
 	else
 		prop->event_mask &= ~IVI_NOTIFICATION_DEST_RECT;
 
+	layer_pending_changed(ivilayer);
+
 	return IVI_SUCCEEDED;
 }
 
@@ -1471,6 +1664,7 @@ ivi_layout_layer_set_render_order(struct ivi_layout_layer *ivilayer,
 	}
 
 	ivilayer->order.dirty = 1;
+	layer_changed(ivilayer);
 
 	return IVI_SUCCEEDED;
 }
@@ -1494,6 +1688,8 @@ ivi_layout_surface_set_visibility(struct ivi_layout_surface *ivisurf,
 	else
 		prop->event_mask &= ~IVI_NOTIFICATION_VISIBILITY;
 
+	surface_pending_changed(ivisurf);
+
 	return IVI_SUCCEEDED;
 }
 
@@ -1518,6 +1714,8 @@ ivi_layout_surface_set_opacity(struct ivi_layout_surface *ivisurf,
 	else
 		prop->event_mask &= ~IVI_NOTIFICATION_OPACITY;
 
+	surface_pending_changed(ivisurf);
+
 	return IVI_SUCCEEDED;
 }
 
@@ -1550,6 +1748,8 @@ ivi_layout_surface_set_destination_rectangle(struct ivi_layout_surface *ivisurf,
 	else
 		prop->event_mask &= ~IVI_NOTIFICATION_DEST_RECT;
 
+	surface_pending_changed(ivisurf);
+
 	return IVI_SUCCEEDED;
 }
 
@@ -1732,6 +1932,7 @@ ivi_layout_layer_add_surface(struct ivi_layout_layer *ivilayer,
 	wl_list_insert(&ivilayer->pending.view_list, &ivi_view->pending_link);
 
 	ivilayer->order.dirty = 1;
+	layer_changed(ivilayer);
 
 	return IVI_SUCCEEDED;
 }
@@ -1753,6 +1954,7 @@ ivi_layout_layer_remove_surface(struct ivi_layout_layer *ivilayer,
 		wl_list_init(&ivi_view->pending_link);
 
 		ivilayer->order.dirty = 1;
+		layer_changed(ivilayer);
 	}
 }
 
@@ -1781,6 +1983,8 @@ ivi_layout_surface_set_source_rectangle(struct ivi_layout_surface *ivisurf,
 	else
 		prop->event_mask &= ~IVI_NOTIFICATION_SOURCE_RECT;
 
+	surface_pending_changed(ivisurf);
+
 	return IVI_SUCCEEDED;
 }
 
@@ -1798,6 +2002,7 @@ ivi_layout_commit_changes(void)
 
 	commit_changes(layout);
 	send_prop(layout);
+	clear_changed_lists(layout);
 
 	return IVI_SUCCEEDED;
 }
@@ -1815,6 +2020,8 @@ ivi_layout_layer_set_transition(struct ivi_layout_layer *ivilayer,
 	ivilayer->pending.prop.transition_type = type;
 	ivilayer->pending.prop.transition_duration = duration;
 
+	layer_pending_changed(ivilayer);
+
 	return 0;
 }
 
@@ -1832,6 +2039,8 @@ ivi_layout_layer_set_fade_info(struct ivi_layout_layer* ivilayer,
 	ivilayer->pending.prop.start_alpha = start_alpha;
 	ivilayer->pending.prop.end_alpha = end_alpha;
 
+	layer_pending_changed(ivilayer);
+
 	return 0;
 }
 
@@ -1848,6 +2057,9 @@ ivi_layout_surface_set_transition_duration(struct ivi_layout_surface *ivisurf,
 
 	prop = &ivisurf->pending.prop;
 	prop->transition_duration = duration*10;
+
+	surface_pending_changed(ivisurf);
+
 	return 0;
 }
 
@@ -1874,12 +2086,15 @@ ivi_layout_surface_set_id(struct ivi_layout_surface *ivisurf,
 		return IVI_FAILED;
 	}
 
-	search_ivisurf = get_surface(&layout->surface_list, id_surface);
+	search_ivisurf = get_surface(layout, id_surface);
 	if (search_ivisurf) {
 		weston_log("id_surface(%d) is already created\n", id_surface);
 		return IVI_FAILED;
 	}
 
+	/* Cannot fail: the index does not grow when an entry is moved. */
+	id_index_remove(&layout->surface_index, &ivisurf->id_node);
+	id_index_insert(&layout->surface_index, &ivisurf->id_node, id_surface);
 	ivisurf->id_surface = id_surface;
 
 	wl_signal_emit(&layout->surface_notification.created, ivisurf);
@@ -1904,6 +2119,9 @@ ivi_layout_surface_set_transition(struct ivi_layout_surface *ivisurf,
 	prop = &ivisurf->pending.prop;
 	prop->transition_type = type;
 	prop->transition_duration = duration;
+
+	surface_pending_changed(ivisurf);
+
 	return 0;
 }
 
@@ -1947,6 +2165,13 @@ surface_create(struct weston_surface *wl_surface, uint32_t id_surface)
 		return NULL;
 	}
 
+	if (!id_index_insert(&layout->surface_index, &ivisurf->id_node,
+			     id_surface)) {
+		weston_log("fails to allocate memory\n");
+		free(ivisurf);
+		return NULL;
+	}
+
 	wl_signal_init(&ivisurf->property_changed);
 	ivisurf->id_surface = id_surface;
 	ivisurf->layout = layout;
@@ -1961,6 +2186,7 @@ surface_create(struct weston_surface *wl_surface, uint32_t id_surface)
 	ivisurf->pending.prop = ivisurf->prop;
 
 	wl_list_init(&ivisurf->view_list);
+	wl_list_init(&ivisurf->changed_link);
 
 	wl_list_insert(&layout->surface_list, &ivisurf->link);
 
@@ -2002,7 +2228,7 @@ ivi_layout_surface_create(struct weston_surface *wl_surface,
 	struct ivi_layout *layout = get_instance();
 	struct ivi_layout_surface *ivisurf = NULL;
 
-	ivisurf = get_surface(&layout->surface_list, id_surface);
+	ivisurf = get_surface(layout, id_surface);
 	if (ivisurf) {
 		weston_log("id_surface(%d) is already created\n", id_surface);
 		return NULL;
@@ -2029,6 +2255,8 @@ ivi_layout_init_with_compositor(struct weston_compositor *ec)
 	wl_list_init(&layout->layer_list);
 	wl_list_init(&layout->screen_list);
 	wl_list_init(&layout->view_list);
+	wl_list_init(&layout->changed_surface_list);
+	wl_list_init(&layout->changed_layer_list);
 
 	wl_signal_init(&layout->layer_notification.created);
 	wl_signal_init(&layout->layer_notification.removed);
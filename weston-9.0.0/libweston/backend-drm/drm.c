@@ -2932,6 +2932,7 @@ drm_backend_create(struct weston_compositor *compositor,
 		weston_log("failed to create input devices\n");
 		goto err_sprite;
 	}
+	b->input.coalesce_motion = config->coalesce_pointer_motion;
 
 	if (drm_backend_create_heads(b, drm_device) < 0) {
 		weston_log("Failed to create heads for %s\n", b->drm.filename);
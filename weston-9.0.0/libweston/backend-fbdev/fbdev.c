@@ -60,6 +60,7 @@ struct fbdev_backend {
 	struct udev *udev;
 	struct udev_input input;
 	uint32_t output_transform;
+	uint32_t pixman_threads;
 	struct wl_listener session_listener;
 };
 
@@ -530,6 +531,7 @@ fbdev_output_enable(struct weston_output *base)
 	struct wl_event_loop *loop;
 	const struct pixman_renderer_output_options options = {
 		.use_shadow = true,
+		.render_threads = backend->pixman_threads,
 	};
 
 	head = fbdev_output_get_head(output);
@@ -899,6 +901,7 @@ fbdev_backend_create(struct weston_compositor *compositor,
 		return NULL;
 
 	backend->compositor = compositor;
+	backend->pixman_threads = param->pixman_threads;
 	compositor->backend = &backend->base;
 	if (weston_compositor_set_presentation_clock_software(
 							compositor) < 0)
@@ -970,6 +973,7 @@ config_init_to_defaults(struct weston_fbdev_backend_config *config)
 	config->tty = 0; /* default to current tty */
 	config->device = NULL;
 	config->seat_id = NULL;
+	config->pixman_threads = 0;
 }
 
 WL_EXPORT int
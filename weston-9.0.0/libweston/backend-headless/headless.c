@@ -57,6 +57,7 @@ struct headless_backend {
 
 	struct weston_seat fake_seat;
 	enum headless_renderer_type renderer_type;
+	uint32_t pixman_threads;
 
 	struct gl_renderer_interface *glri;
 };
@@ -214,8 +215,10 @@ headless_output_enable_gl(struct headless_output *output)
 static int
 headless_output_enable_pixman(struct headless_output *output)
 {
+	struct headless_backend *b = to_headless_backend(output->base.compositor);
 	const struct pixman_renderer_output_options options = {
 		.use_shadow = true,
+		.render_threads = b->pixman_threads,
 	};
 
 	output->image_buf = malloc(output->base.current_mode->width *
@@ -444,6 +447,8 @@ headless_backend_create(struct weston_compositor *compositor,
 	else
 		b->renderer_type = HEADLESS_NOOP;
 
+	b->pixman_threads = config->pixman_threads;
+
 	switch (b->renderer_type) {
 	case HEADLESS_GL:
 		ret = headless_gl_renderer_init(b);
@@ -132,6 +132,7 @@ struct rdp_backend {
 	int tls_enabled;
 	int no_clients_resize;
 	int force_no_compression;
+	uint32_t pixman_threads;
 };
 
 enum peer_item_flags {
@@ -472,11 +473,14 @@ static int
 rdp_switch_mode(struct weston_output *output, struct weston_mode *target_mode)
 {
 	struct rdp_output *rdpOutput = container_of(output, struct rdp_output, base);
+	struct rdp_backend *b = to_rdp_backend(output->compositor);
 	struct rdp_peers_item *rdpPeer;
 	rdpSettings *settings;
 	pixman_image_t *new_shadow_buffer;
 	struct weston_mode *local_mode;
-	const struct pixman_renderer_output_options options = { };
+	const struct pixman_renderer_output_options options = {
+		.render_threads = b->pixman_threads,
+	};
 
 	local_mode = ensure_matching_mode(output, target_mode);
 	if (!local_mode) {
@@ -571,6 +575,7 @@ rdp_output_enable(struct weston_output *base)
 	struct wl_event_loop *loop;
 	const struct pixman_renderer_output_options options = {
 		.use_shadow = true,
+		.render_threads = b->pixman_threads,
 	};
 
 	output->shadow_surface = pixman_image_create_bits(PIXMAN_x8r8g8b8,
@@ -1392,6 +1397,7 @@ rdp_backend_create(struct weston_compositor *compositor,
 	b->rdp_key = config->rdp_key ? strdup(config->rdp_key) : NULL;
 	b->no_clients_resize = config->no_clients_resize;
 	b->force_no_compression = config->force_no_compression;
+	b->pixman_threads = config->pixman_threads;
 
 	compositor->backend = &b->base;
 
@@ -1476,6 +1482,7 @@ config_init_to_defaults(struct weston_rdp_backend_config *config)
 	config->env_socket = 0;
 	config->no_clients_resize = 0;
 	config->force_no_compression = 0;
+	config->pixman_threads = 0;
 }
 
 WL_EXPORT int
@@ -93,6 +93,7 @@ struct x11_backend {
 	int			 fullscreen;
 	int			 no_input;
 	int			 use_pixman;
+	uint32_t		 pixman_threads;
 
 	int			 has_net_wm_state_fullscreen;
 
@@ -838,6 +839,7 @@ x11_output_switch_mode(struct weston_output *base, struct weston_mode *mode)
 	if (b->use_pixman) {
 		const struct pixman_renderer_output_options options = {
 			.use_shadow = true,
+			.render_threads = b->pixman_threads,
 		};
 		pixman_renderer_output_destroy(&output->base);
 		x11_output_deinit_shm(b, output);
@@ -1018,6 +1020,7 @@ x11_output_enable(struct weston_output *base)
 	if (b->use_pixman) {
 		const struct pixman_renderer_output_options options = {
 			.use_shadow = true,
+			.render_threads = b->pixman_threads,
 		};
 		if (x11_output_init_shm(b, output,
 					output->base.current_mode->width,
@@ -1867,6 +1870,7 @@ x11_backend_create(struct weston_compositor *compositor,
 	}
 
 	b->use_pixman = config->use_pixman;
+	b->pixman_threads = config->pixman_threads;
 	if (b->use_pixman) {
 		if (pixman_renderer_init(compositor) < 0) {
 			weston_log("Failed to initialize pixman renderer for X11 backend\n");
@@ -199,6 +199,9 @@ void
 notify_motion_absolute(struct weston_seat *seat, const struct timespec *time,
 		       double x, double y);
 void
+notify_relative_motion(struct weston_seat *seat, const struct timespec *time,
+		       struct weston_pointer_motion_event *event);
+void
 notify_modifiers(struct weston_seat *seat, uint32_t serial);
 
 void
@@ -25,26 +25,72 @@
 
 #include "config.h"
 
+#include <errno.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <linux/input.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <sys/sendfile.h>
 #include <sys/uio.h>
 
 #include <libweston/libweston.h>
 #include "libweston-internal.h"
 #include "shared/helpers.h"
+#include "shared/os-compatibility.h"
+
+/*
+ * The clipboard keeps a copy of the selection, so that it can still be
+ * pasted after the client that set it is gone. Each offered MIME type is
+ * fetched in turn into its own memfd with splice(), sealed once complete,
+ * and pastes are served from it with sendfile(), so the data never goes
+ * through a user space buffer.
+ */
+
+/* A selection bigger than this in total is not kept whole: the MIME types
+ * that do not fit are dropped. */
+#define CLIPBOARD_MAX_SIZE (256 * 1024 * 1024)
+
+/* Bytes moved per splice() or sendfile() call, and the number of calls
+ * per wake-up so that a large transfer does not hog the event loop. */
+#define CLIPBOARD_CHUNK (1024 * 1024)
+#define CLIPBOARD_CHUNKS_PER_DISPATCH 16
+
+enum clipboard_contents_state {
+	CLIPBOARD_CONTENTS_PENDING,
+	CLIPBOARD_CONTENTS_FETCHING,
+	CLIPBOARD_CONTENTS_COMPLETE,
+};
+
+struct clipboard_contents {
+	struct clipboard_source *source;
+	struct wl_list link; /* clipboard_source::contents */
+	char *mime_type;
+	enum clipboard_contents_state state;
+	/* memfd holding the data, sealed once complete */
+	int fd;
+	size_t size;
+	/* read end of the pipe the data comes from, while fetching */
+	int pipe_fd;
+	struct wl_event_source *event_source;
+	/* clipboard_client::link */
+	struct wl_list clients;
+};
 
 struct clipboard_source {
 	struct weston_data_source base;
-	struct wl_array contents;
+	/* clipboard_contents::link, in the order the MIME types were
+	 * offered; base.mime_types points to their strings */
+	struct wl_list contents;
+	struct clipboard_contents *fetching;
+	size_t total_size;
+	/* the source the data is fetched from, until it is destroyed */
+	struct weston_data_source *origin;
+	struct wl_listener origin_destroy_listener;
 	struct clipboard *clipboard;
-	struct wl_event_source *event_source;
 	uint32_t serial;
 	int refcount;
-	int fd;
 };
 
 struct clipboard {
@@ -54,79 +100,269 @@ struct clipboard {
 	struct clipboard_source *source;
 };
 
-static void clipboard_client_create(struct clipboard_source *source, int fd);
+struct clipboard_client {
+	struct wl_list link; /* clipboard_contents::clients */
+	struct wl_event_source *event_source;
+	struct clipboard_contents *contents;
+	off_t offset;
+	int fd;
+};
+
+static void clipboard_client_destroy(struct clipboard_client *client);
+static void clipboard_source_fetch_next(struct clipboard_source *source);
 
 static void
-clipboard_source_unref(struct clipboard_source *source)
+clipboard_contents_destroy(struct clipboard_contents *contents)
 {
+	struct clipboard_source *source = contents->source;
+	struct clipboard_client *client, *tmp;
 	char **s;
 
+	wl_list_for_each_safe(client, tmp, &contents->clients, link)
+		clipboard_client_destroy(client);
+
+	if (source->fetching == contents)
+		source->fetching = NULL;
+
+	/* Stop offering it. */
+	wl_array_for_each(s, &source->base.mime_types) {
+		if (*s == contents->mime_type) {
+			memmove(s, s + 1, (char *) source->base.mime_types.data +
+				source->base.mime_types.size -
+				(char *) (s + 1));
+			source->base.mime_types.size -= sizeof *s;
+			break;
+		}
+	}
+
+	if (contents->event_source)
+		wl_event_source_remove(contents->event_source);
+	if (contents->pipe_fd >= 0)
+		close(contents->pipe_fd);
+	if (contents->fd >= 0)
+		close(contents->fd);
+
+	source->total_size -= contents->size;
+	wl_list_remove(&contents->link);
+	free(contents->mime_type);
+	free(contents);
+}
+
+static void
+clipboard_source_unref(struct clipboard_source *source)
+{
+	struct clipboard_contents *contents, *tmp;
+
 	source->refcount--;
 	if (source->refcount > 0)
 		return;
 
-	if (source->event_source) {
-		wl_event_source_remove(source->event_source);
-		close(source->fd);
-	}
+	wl_list_for_each_safe(contents, tmp, &source->contents, link)
+		clipboard_contents_destroy(contents);
+
+	if (source->origin)
+		wl_list_remove(&source->origin_destroy_listener.link);
+
 	wl_signal_emit(&source->base.destroy_signal,
 		       &source->base);
-	s = source->base.mime_types.data;
-	free(*s);
 	wl_array_release(&source->base.mime_types);
-	wl_array_release(&source->contents);
 	free(source);
 }
 
-static int
-clipboard_source_data(int fd, uint32_t mask, void *data)
+/* Give up on a MIME type, and on the whole source once none is left. */
+static void
+clipboard_contents_fail(struct clipboard_contents *contents)
 {
-	struct clipboard_source *source = data;
+	struct clipboard_source *source = contents->source;
 	struct clipboard *clipboard = source->clipboard;
-	char *p;
-	int len, size;
 
-	if (source->contents.alloc - source->contents.size < 1024) {
-		wl_array_add(&source->contents, 1024);
-		source->contents.size -= 1024;
+	/* The clients destroyed with the contents may hold the last
+	 * references. */
+	source->refcount++;
+
+	clipboard_contents_destroy(contents);
+
+	if (wl_list_empty(&source->contents)) {
+		if (clipboard->source == source) {
+			clipboard->source = NULL;
+			clipboard_source_unref(source);
+		}
+	} else if (!source->fetching) {
+		clipboard_source_fetch_next(source);
 	}
 
-	p = source->contents.data + source->contents.size;
-	size = source->contents.alloc - source->contents.size;
-	len = read(fd, p, size);
-	if (len == 0) {
-		wl_event_source_remove(source->event_source);
-		close(fd);
-		source->event_source = NULL;
-	} else if (len < 0) {
-		clipboard_source_unref(source);
-		clipboard->source = NULL;
-	} else {
-		source->contents.size += len;
+	clipboard_source_unref(source);
+}
+
+static void
+clipboard_contents_complete(struct clipboard_contents *contents)
+{
+	struct clipboard_source *source = contents->source;
+	struct clipboard_client *client;
+
+	wl_event_source_remove(contents->event_source);
+	contents->event_source = NULL;
+	close(contents->pipe_fd);
+	contents->pipe_fd = -1;
+
+	/* Not supported by the tmpfile fallback, nothing depends on it. */
+	fcntl(contents->fd, F_ADD_SEALS,
+	      F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL);
+
+	contents->state = CLIPBOARD_CONTENTS_COMPLETE;
+	wl_list_for_each(client, &contents->clients, link)
+		wl_event_source_fd_update(client->event_source,
+					  WL_EVENT_WRITABLE);
+
+	source->fetching = NULL;
+	clipboard_source_fetch_next(source);
+}
+
+/* For files splice() cannot write to. */
+static ssize_t
+copy_to_file(int in, int out, off_t offset, size_t len)
+{
+	char buf[64 * 1024];
+	ssize_t n;
+
+	n = read(in, buf, MIN(len, sizeof buf));
+	if (n <= 0)
+		return n;
+
+	return pwrite(out, buf, n, offset);
+}
+
+static int
+clipboard_contents_data(int fd, uint32_t mask, void *data)
+{
+	struct clipboard_contents *contents = data;
+	struct clipboard_source *source = contents->source;
+	loff_t offset;
+	size_t len;
+	ssize_t n;
+	int i;
+
+	for (i = 0; i < CLIPBOARD_CHUNKS_PER_DISPATCH; i++) {
+		/* One byte over the limit tells whether there is more. */
+		len = MIN(CLIPBOARD_CHUNK,
+			  CLIPBOARD_MAX_SIZE - source->total_size + 1);
+		offset = contents->size;
+		n = splice(fd, NULL, contents->fd, &offset, len,
+			   SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+		if (n < 0 && errno == EINVAL)
+			n = copy_to_file(fd, contents->fd, contents->size,
+					 len);
+
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0 && errno == EAGAIN)
+			break;
+		if (n < 0) {
+			weston_log("clipboard: reading %s failed: %s\n",
+				   contents->mime_type, strerror(errno));
+			clipboard_contents_fail(contents);
+			break;
+		}
+		if (n == 0) {
+			clipboard_contents_complete(contents);
+			break;
+		}
+
+		contents->size += n;
+		source->total_size += n;
+		if (source->total_size > CLIPBOARD_MAX_SIZE) {
+			weston_log("clipboard: dropping %s, the selection is "
+				   "over %d MiB\n", contents->mime_type,
+				   CLIPBOARD_MAX_SIZE / (1024 * 1024));
+			clipboard_contents_fail(contents);
+			break;
+		}
 	}
 
 	return 1;
 }
 
+static int
+clipboard_contents_fetch(struct clipboard_contents *contents)
+{
+	struct clipboard_source *source = contents->source;
+	struct wl_display *display =
+		source->clipboard->seat->compositor->wl_display;
+	struct wl_event_loop *loop = wl_display_get_event_loop(display);
+	int p[2];
+
+	contents->fd = os_create_anonymous_file(0);
+	if (contents->fd < 0)
+		return -1;
+
+	if (pipe2(p, O_CLOEXEC) == -1)
+		return -1;
+
+	/* Only our end is non-blocking, the other one goes to the source.
+	 * A bigger pipe means fewer wake-ups; failing that is harmless. */
+	fcntl(p[0], F_SETFL, O_NONBLOCK);
+	fcntl(p[0], F_SETPIPE_SZ, CLIPBOARD_CHUNK);
+	contents->pipe_fd = p[0];
+
+	contents->event_source =
+		wl_event_loop_add_fd(loop, p[0], WL_EVENT_READABLE,
+				     clipboard_contents_data, contents);
+	if (contents->event_source == NULL) {
+		close(p[1]);
+		return -1;
+	}
+
+	contents->state = CLIPBOARD_CONTENTS_FETCHING;
+	source->fetching = contents;
+	source->origin->send(source->origin, contents->mime_type, p[1]);
+
+	return 0;
+}
+
+/* MIME types are fetched one at a time: some sources, like Xwayland,
+ * cannot serve several transfers at once. */
+static void
+clipboard_source_fetch_next(struct clipboard_source *source)
+{
+	struct clipboard_contents *contents;
+
+	wl_list_for_each(contents, &source->contents, link) {
+		if (contents->state != CLIPBOARD_CONTENTS_PENDING)
+			continue;
+
+		/* Without the source there is nothing left to fetch;
+		 * failing calls back in here for the next one. */
+		if (!source->origin || clipboard_contents_fetch(contents) < 0)
+			clipboard_contents_fail(contents);
+		return;
+	}
+}
+
 static void
 clipboard_source_accept(struct weston_data_source *source,
 			uint32_t time, const char *mime_type)
 {
 }
 
+static void
+clipboard_client_create(struct clipboard_contents *contents, int fd);
+
 static void
 clipboard_source_send(struct weston_data_source *base,
 		      const char *mime_type, int32_t fd)
 {
 	struct clipboard_source *source =
 		container_of(base, struct clipboard_source, base);
-	char **s;
+	struct clipboard_contents *contents;
 
-	s = source->base.mime_types.data;
-	if (strcmp(mime_type, s[0]) == 0)
-		clipboard_client_create(source, fd);
-	else
-		close(fd);
+	wl_list_for_each(contents, &source->contents, link) {
+		if (strcmp(mime_type, contents->mime_type) == 0) {
+			clipboard_client_create(contents, fd);
+			return;
+		}
+	}
+
+	close(fd);
 }
 
 static void
@@ -134,20 +370,31 @@ clipboard_source_cancel(struct weston_data_source *source)
 {
 }
 
+static void
+clipboard_source_origin_destroy(struct wl_listener *listener, void *data)
+{
+	struct clipboard_source *source =
+		container_of(listener, struct clipboard_source,
+			     origin_destroy_listener);
+
+	wl_list_remove(&source->origin_destroy_listener.link);
+	source->origin = NULL;
+}
+
 static struct clipboard_source *
 clipboard_source_create(struct clipboard *clipboard,
-			const char *mime_type, uint32_t serial, int fd)
+			struct weston_data_source *origin, uint32_t serial)
 {
-	struct wl_display *display = clipboard->seat->compositor->wl_display;
-	struct wl_event_loop *loop = wl_display_get_event_loop(display);
 	struct clipboard_source *source;
+	struct clipboard_contents *contents;
+	const char **mime_type;
 	char **s;
 
 	source = zalloc(sizeof *source);
 	if (source == NULL)
 		return NULL;
 
-	wl_array_init(&source->contents);
+	wl_list_init(&source->contents);
 	wl_array_init(&source->base.mime_types);
 	source->base.resource = NULL;
 	source->base.accept = clipboard_source_accept;
@@ -157,79 +404,130 @@ clipboard_source_create(struct clipboard *clipboard,
 	source->refcount = 1;
 	source->clipboard = clipboard;
 	source->serial = serial;
-	source->fd = fd;
-
-	s = wl_array_add(&source->base.mime_types, sizeof *s);
-	if (s == NULL)
-		goto err_add;
-	*s = strdup(mime_type);
-	if (*s == NULL)
-		goto err_strdup;
-	source->event_source =
-		wl_event_loop_add_fd(loop, fd, WL_EVENT_READABLE,
-				     clipboard_source_data, source);
-	if (source->event_source == NULL)
-		goto err_source;
+
+	source->origin = origin;
+	source->origin_destroy_listener.notify =
+		clipboard_source_origin_destroy;
+	wl_signal_add(&origin->destroy_signal,
+		      &source->origin_destroy_listener);
+
+	wl_array_for_each(mime_type, &origin->mime_types) {
+		contents = zalloc(sizeof *contents);
+		if (contents == NULL)
+			goto err;
+
+		contents->source = source;
+		contents->fd = -1;
+		contents->pipe_fd = -1;
+		wl_list_init(&contents->clients);
+		wl_list_insert(source->contents.prev, &contents->link);
+
+		contents->mime_type = strdup(*mime_type);
+		s = wl_array_add(&source->base.mime_types, sizeof *s);
+		if (contents->mime_type == NULL || s == NULL)
+			goto err;
+		*s = contents->mime_type;
+	}
 
 	return source;
 
- err_source:
-	free(*s);
- err_strdup:
-	wl_array_release(&source->base.mime_types);
- err_add:
-	free(source);
+ err:
+	clipboard_source_unref(source);
 
 	return NULL;
 }
 
-struct clipboard_client {
-	struct wl_event_source *event_source;
-	size_t offset;
-	struct clipboard_source *source;
-};
-
 static int
 clipboard_client_data(int fd, uint32_t mask, void *data)
 {
 	struct clipboard_client *client = data;
-	char *p;
-	size_t size;
-	int len;
-
-	size = client->source->contents.size;
-	p = client->source->contents.data;
-	len = write(fd, p + client->offset, size - client->offset);
-	if (len > 0)
-		client->offset += len;
-
-	if (client->offset == size || len <= 0) {
-		close(fd);
-		wl_event_source_remove(client->event_source);
-		clipboard_source_unref(client->source);
-		free(client);
+	struct clipboard_contents *contents = client->contents;
+	char buf[64 * 1024];
+	size_t len;
+	ssize_t n = 0;
+	int i;
+
+	for (i = 0; i < CLIPBOARD_CHUNKS_PER_DISPATCH; i++) {
+		if ((size_t) client->offset == contents->size)
+			break;
+
+		len = MIN(CLIPBOARD_CHUNK, contents->size - client->offset);
+		n = sendfile(fd, contents->fd, &client->offset, len);
+		if (n < 0 && (errno == EINVAL || errno == ENOSYS)) {
+			n = pread(contents->fd, buf, MIN(len, sizeof buf),
+				  client->offset);
+			if (n > 0)
+				n = write(fd, buf, n);
+			if (n > 0)
+				client->offset += n;
+		}
+
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			break;
 	}
 
+	if ((size_t) client->offset == contents->size ||
+	    (n < 0 && errno != EAGAIN) || n == 0)
+		clipboard_client_destroy(client);
+
 	return 1;
 }
 
 static void
-clipboard_client_create(struct clipboard_source *source, int fd)
+clipboard_client_create(struct clipboard_contents *contents, int fd)
 {
+	struct clipboard_source *source = contents->source;
 	struct weston_seat *seat = source->clipboard->seat;
 	struct clipboard_client *client;
 	struct wl_event_loop *loop =
 		wl_display_get_event_loop(seat->compositor->wl_display);
+	uint32_t mask = 0;
+	int flags;
 
 	client = zalloc(sizeof *client);
-	if (client == NULL)
+	if (client == NULL) {
+		close(fd);
 		return;
+	}
+
+	/* The receiving end only reads, so making the shared file
+	 * description non-blocking does not affect it. */
+	flags = fcntl(fd, F_GETFL);
+	if (flags != -1)
+		fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+
+	/* Wait for the data when it is still being fetched. */
+	if (contents->state == CLIPBOARD_CONTENTS_COMPLETE)
+		mask = WL_EVENT_WRITABLE;
 
-	client->source = source;
-	source->refcount++;
 	client->event_source =
-		wl_event_loop_add_fd(loop, fd, WL_EVENT_WRITABLE,
+		wl_event_loop_add_fd(loop, fd, mask,
 				     clipboard_client_data, client);
+	if (client->event_source == NULL) {
+		close(fd);
+		free(client);
+		return;
+	}
+
+	client->fd = fd;
+	client->contents = contents;
+	wl_list_insert(&contents->clients, &client->link);
+	source->refcount++;
+}
+
+static void
+clipboard_client_destroy(struct clipboard_client *client)
+{
+	struct clipboard_source *source = client->contents->source;
+
+	wl_list_remove(&client->link);
+	wl_event_source_remove(client->event_source);
+	close(client->fd);
+	free(client);
+
+	clipboard_source_unref(source);
 }
 
 static void
@@ -239,8 +537,6 @@ clipboard_set_selection(struct wl_listener *listener, void *data)
 		container_of(listener, struct clipboard, selection_listener);
 	struct weston_seat *seat = data;
 	struct weston_data_source *source = seat->selection_data_source;
-	const char **mime_types;
-	int p[2];
 
 	if (source == NULL) {
 		if (clipboard->source)
@@ -258,20 +554,16 @@ clipboard_set_selection(struct wl_listener *listener, void *data)
 
 	clipboard->source = NULL;
 
-	mime_types = source->mime_types.data;
-
-	if (!mime_types || pipe2(p, O_CLOEXEC) == -1)
+	if (source->mime_types.size == 0)
 		return;
 
-	source->send(source, mime_types[0], p[1]);
-
 	clipboard->source =
-		clipboard_source_create(clipboard, mime_types[0],
-					seat->selection_serial, p[0]);
-	if (clipboard->source == NULL) {
-		close(p[0]);
+		clipboard_source_create(clipboard, source,
+					seat->selection_serial);
+	if (clipboard->source == NULL)
 		return;
-	}
+
+	clipboard_source_fetch_next(clipboard->source);
 }
 
 static void
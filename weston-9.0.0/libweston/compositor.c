@@ -76,6 +76,9 @@
 #include "libweston-internal.h"
 
 #include "weston-log-internal.h"
+#include "view-index.h"
+#include "frame-timing.h"
+#include "damage-simplify.h"
 
 /**
  * \defgroup head Head
@@ -95,6 +98,13 @@ weston_output_transform_scale_init(struct weston_output *output,
 static void
 weston_compositor_build_view_list(struct weston_compositor *compositor);
 
+static void
+weston_compositor_view_list_dirty(struct weston_compositor *compositor);
+
+static void
+weston_compositor_output_view_lists_dirty(struct weston_compositor *compositor,
+					  uint32_t output_mask);
+
 static char *
 weston_output_create_heads_string(struct weston_output *output);
 
@@ -540,6 +550,7 @@ weston_surface_create(struct weston_compositor *compositor)
 
 	surface->compositor = compositor;
 	surface->ref_count = 1;
+	surface->content_serial = wl_display_next_serial(compositor->wl_display);
 
 	surface->buffer_viewport.buffer.transform = WL_OUTPUT_TRANSFORM_NORMAL;
 	surface->buffer_viewport.buffer.scale = 1;
@@ -580,6 +591,8 @@ weston_surface_set_color(struct weston_surface *surface,
 {
 	surface->compositor->renderer->surface_set_color(surface, red, green, blue, alpha);
 	surface->is_opaque = !(alpha < 1.0);
+	surface->content_serial =
+		wl_display_next_serial(surface->compositor->wl_display);
 }
 
 WL_EXPORT void
@@ -1264,6 +1277,8 @@ weston_view_set_output(struct weston_view *view, struct weston_output *output)
 static void
 weston_surface_assign_output(struct weston_surface *es)
 {
+	struct weston_output *old_output = es->output;
+	uint32_t old_mask = es->output_mask;
 	struct weston_output *new_output;
 	struct weston_view *view;
 	pixman_region32_t region;
@@ -1295,6 +1310,15 @@ weston_surface_assign_output(struct weston_surface *es)
 
 	es->output = new_output;
 	weston_surface_update_output_mask(es, mask);
+
+	if (old_output != new_output || old_mask != mask) {
+		if (old_output)
+			old_mask |= 1u << old_output->id;
+		if (new_output)
+			mask |= 1u << new_output->id;
+		weston_compositor_output_view_lists_dirty(es->compositor,
+							  old_mask | mask);
+	}
 }
 
 /** Recalculate which output(s) the view is displayed on
@@ -1456,6 +1480,45 @@ weston_view_update_transform_disable(struct weston_view *view)
 	}
 }
 
+/* For a scaled view, keep only the global pixels that are entirely
+ * covered by the opaque region, so that it can still occlude what is
+ * below it. The edges are pulled in by one more pixel, since filtering
+ * may blend them with neighbouring translucent texels. Rotated views do
+ * not occlude anything. */
+static void
+view_compute_scaled_opaque(struct weston_view *view)
+{
+	struct weston_matrix *matrix = &view->transform.matrix;
+	pixman_box32_t *rects;
+	float xa, ya, xb, yb;
+	int x1, y1, x2, y2;
+	int inset = 0;
+	int nrects, i;
+
+	if (fabsf(matrix->d[0]) != 1.0f || fabsf(matrix->d[5]) != 1.0f)
+		inset = 1;
+
+	rects = pixman_region32_rectangles(&view->surface->opaque, &nrects);
+	for (i = 0; i < nrects; i++) {
+		/* A negative scale flips the rectangle. */
+		xa = rects[i].x1 * matrix->d[0] + matrix->d[12];
+		xb = rects[i].x2 * matrix->d[0] + matrix->d[12];
+		ya = rects[i].y1 * matrix->d[5] + matrix->d[13];
+		yb = rects[i].y2 * matrix->d[5] + matrix->d[13];
+
+		x1 = ceilf(fminf(xa, xb)) + inset;
+		x2 = floorf(fmaxf(xa, xb)) - inset;
+		y1 = ceilf(fminf(ya, yb)) + inset;
+		y2 = floorf(fmaxf(ya, yb)) - inset;
+		if (x2 <= x1 || y2 <= y1)
+			continue;
+
+		pixman_region32_union_rect(&view->transform.opaque,
+					   &view->transform.opaque,
+					   x1, y1, x2 - x1, y2 - y1);
+	}
+}
+
 static int
 weston_view_update_transform_enable(struct weston_view *view)
 {
@@ -1494,6 +1557,10 @@ weston_view_update_transform_enable(struct weston_view *view)
 		pixman_region32_translate(&view->transform.opaque,
 					  matrix->d[12],
 					  matrix->d[13]);
+	} else if (view->alpha == 1.0 &&
+		   !(matrix->type & ~(WESTON_MATRIX_TRANSFORM_TRANSLATE |
+				      WESTON_MATRIX_TRANSFORM_SCALE))) {
+		view_compute_scaled_opaque(view);
 	}
 
 	pixman_region32_init_rect(&surfregion, 0, 0,
@@ -1573,6 +1640,10 @@ weston_view_update_transform(struct weston_view *view)
 
 	weston_view_assign_output(view);
 
+	if (view->surface->compositor->view_index)
+		weston_view_index_update(view->surface->compositor->view_index,
+					 view);
+
 	wl_signal_emit(&view->surface->compositor->transform_signal,
 		       view->surface);
 }
@@ -2064,41 +2135,62 @@ weston_compositor_get_time(struct timespec *time)
 	clock_gettime(CLOCK_REALTIME, time);
 }
 
-/** weston_compositor_pick_view
- * \ingroup compositor
- */
-WL_EXPORT struct weston_view *
-weston_compositor_pick_view(struct weston_compositor *compositor,
-			    wl_fixed_t x, wl_fixed_t y,
-			    wl_fixed_t *vx, wl_fixed_t *vy)
+static bool
+view_accepts_input_at(struct weston_view *view,
+		      wl_fixed_t x, wl_fixed_t y,
+		      wl_fixed_t *vx, wl_fixed_t *vy)
 {
-	struct weston_view *view;
 	wl_fixed_t view_x, view_y;
 	int view_ix, view_iy;
 	int ix = wl_fixed_to_int(x);
 	int iy = wl_fixed_to_int(y);
 
-	wl_list_for_each(view, &compositor->view_list, link) {
-		if (!pixman_region32_contains_point(
-				&view->transform.boundingbox, ix, iy, NULL))
-			continue;
+	if (!pixman_region32_contains_point(&view->transform.boundingbox,
+					    ix, iy, NULL))
+		return false;
 
-		weston_view_from_global_fixed(view, x, y, &view_x, &view_y);
-		view_ix = wl_fixed_to_int(view_x);
-		view_iy = wl_fixed_to_int(view_y);
+	weston_view_from_global_fixed(view, x, y, &view_x, &view_y);
+	view_ix = wl_fixed_to_int(view_x);
+	view_iy = wl_fixed_to_int(view_y);
 
-		if (!pixman_region32_contains_point(&view->surface->input,
-						    view_ix, view_iy, NULL))
-			continue;
+	if (!pixman_region32_contains_point(&view->surface->input,
+					    view_ix, view_iy, NULL))
+		return false;
 
-		if (view->geometry.scissor_enabled &&
-		    !pixman_region32_contains_point(&view->geometry.scissor,
-						    view_ix, view_iy, NULL))
-			continue;
+	if (view->geometry.scissor_enabled &&
+	    !pixman_region32_contains_point(&view->geometry.scissor,
+					    view_ix, view_iy, NULL))
+		return false;
 
-		*vx = view_x;
-		*vy = view_y;
-		return view;
+	*vx = view_x;
+	*vy = view_y;
+	return true;
+}
+
+/** weston_compositor_pick_view
+ * \ingroup compositor
+ */
+WL_EXPORT struct weston_view *
+weston_compositor_pick_view(struct weston_compositor *compositor,
+			    wl_fixed_t x, wl_fixed_t y,
+			    wl_fixed_t *vx, wl_fixed_t *vy)
+{
+	struct weston_view_index_iter iter;
+	struct weston_view *view;
+
+	if (compositor->view_index) {
+		weston_view_index_iter_init(&iter, compositor->view_index,
+					    wl_fixed_to_int(x),
+					    wl_fixed_to_int(y));
+		while ((view = weston_view_index_iter_next(&iter))) {
+			if (view_accepts_input_at(view, x, y, vx, vy))
+				return view;
+		}
+	} else {
+		wl_list_for_each(view, &compositor->view_list, link) {
+			if (view_accepts_input_at(view, x, y, vx, vy))
+				return view;
+		}
 	}
 
 	*vx = wl_fixed_from_int(-1000000);
@@ -2128,11 +2220,17 @@ weston_view_unmap(struct weston_view *view)
 
 	weston_view_damage_below(view);
 	weston_view_set_output(view, NULL);
+	weston_compositor_view_list_dirty(view->surface->compositor);
 	view->plane = NULL;
 	view->is_mapped = false;
 	weston_layer_entry_remove(&view->layer_link);
+	if (view->surface->compositor->view_index)
+		weston_view_index_remove(view->surface->compositor->view_index,
+					 view);
 	wl_list_remove(&view->link);
 	wl_list_init(&view->link);
+	weston_compositor_output_view_lists_dirty(view->surface->compositor,
+						  ~0u);
 	view->output_mask = 0;
 	weston_surface_assign_output(view->surface);
 
@@ -2159,6 +2257,9 @@ weston_surface_unmap(struct weston_surface *surface)
 {
 	struct weston_view *view;
 
+	if (surface->is_mapped)
+		weston_compositor_view_list_dirty(surface->compositor);
+
 	surface->is_mapped = false;
 	wl_list_for_each(view, &surface->views, surface_link)
 		weston_view_unmap(view);
@@ -2187,7 +2288,12 @@ weston_view_destroy(struct weston_view *view)
 		weston_compositor_build_view_list(view->surface->compositor);
 	}
 
+	if (view->surface->compositor->view_index)
+		weston_view_index_remove(view->surface->compositor->view_index,
+					 view);
 	wl_list_remove(&view->link);
+	weston_compositor_output_view_lists_dirty(view->surface->compositor,
+						  ~0u);
 	weston_layer_entry_remove(&view->layer_link);
 
 	pixman_region32_fini(&view->clip);
@@ -2489,12 +2595,41 @@ view_accumulate_damage(struct weston_view *view,
 }
 
 static void
-output_accumulate_damage(struct weston_output *output)
+output_flush_view_damage(struct weston_output *output,
+			 struct weston_view *ev)
+{
+	/* Ignore views not visible on the current output */
+	if (!(ev->output_mask & (1u << output->id)))
+		return;
+	if (ev->surface->touched)
+		return;
+	ev->surface->touched = true;
+
+	surface_flush_damage(ev->surface);
+
+	/* Both the renderer and the backend have seen the buffer
+	 * by now. If renderer needs the buffer, it has its own
+	 * reference set. If the backend wants to keep the buffer
+	 * around for migrating the surface into a non-primary plane
+	 * later, keep_buffer is true. Otherwise, drop the core
+	 * reference now, and allow early buffer release. This enables
+	 * clients to use single-buffering.
+	 */
+	if (!ev->surface->keep_buffer) {
+		weston_buffer_reference(&ev->surface->buffer_ref, NULL);
+		weston_buffer_release_reference(
+			&ev->surface->buffer_release_ref, NULL);
+	}
+}
+
+static void
+output_accumulate_damage(struct weston_output *output,
+			 struct weston_view **views, size_t n_views)
 {
 	struct weston_compositor *ec = output->compositor;
 	struct weston_plane *plane;
-	struct weston_view *ev;
 	pixman_region32_t opaque, clip;
+	size_t i;
 
 	pixman_region32_init(&clip);
 
@@ -2503,11 +2638,11 @@ output_accumulate_damage(struct weston_output *output)
 
 		pixman_region32_init(&opaque);
 
-		wl_list_for_each(ev, &ec->view_list, link) {
-			if (ev->plane != plane)
+		for (i = 0; i < n_views; i++) {
+			if (views[i]->plane != plane)
 				continue;
 
-			view_accumulate_damage(ev, &opaque);
+			view_accumulate_damage(views[i], &opaque);
 		}
 
 		pixman_region32_union(&clip, &clip, &opaque);
@@ -2516,33 +2651,71 @@ output_accumulate_damage(struct weston_output *output)
 
 	pixman_region32_fini(&clip);
 
-	wl_list_for_each(ev, &ec->view_list, link)
-		ev->surface->touched = false;
+	for (i = 0; i < n_views; i++)
+		views[i]->surface->touched = false;
 
-	wl_list_for_each(ev, &ec->view_list, link) {
-		/* Ignore views not visible on the current output */
-		if (!(ev->output_mask & (1u << output->id)))
-			continue;
-		if (ev->surface->touched)
-			continue;
-		ev->surface->touched = true;
+	for (i = 0; i < n_views; i++)
+		output_flush_view_damage(output, views[i]);
+}
 
-		surface_flush_damage(ev->surface);
+/** Bound the number of damage rectangles handed to the renderer
+ *
+ * \param compositor The compositor.
+ * \param max_rects The most rectangles an output repaint may be given,
+ * or 0 to pass the damage on as accumulated, which is the default.
+ * \param max_overhead The fraction of a merged rectangle that may be
+ * undamaged, between 0 and 1.
+ *
+ * Fragmented damage makes renderers composite every rectangle separately.
+ * With this set, nearby damage rectangles of an output are merged into
+ * their bounding box while that adds little area, and merged regardless
+ * of area when there are more than max_rects of them. The 'damage' debug
+ * scope reports the effect.
+ *
+ * \ingroup compositor
+ */
+WL_EXPORT void
+weston_compositor_set_damage_simplification(struct weston_compositor *compositor,
+					    int max_rects,
+					    double max_overhead)
+{
+	if (max_overhead < 0.0)
+		max_overhead = 0.0;
+	if (max_overhead > 1.0)
+		max_overhead = 1.0;
 
-		/* Both the renderer and the backend have seen the buffer
-		 * by now. If renderer needs the buffer, it has its own
-		 * reference set. If the backend wants to keep the buffer
-		 * around for migrating the surface into a non-primary plane
-		 * later, keep_buffer is true. Otherwise, drop the core
-		 * reference now, and allow early buffer release. This enables
-		 * clients to use single-buffering.
-		 */
-		if (!ev->surface->keep_buffer) {
-			weston_buffer_reference(&ev->surface->buffer_ref, NULL);
-			weston_buffer_release_reference(
-				&ev->surface->buffer_release_ref, NULL);
-		}
-	}
+	compositor->damage_simplify.max_rects = max_rects > 0 ? max_rects : 0;
+	compositor->damage_simplify.max_overhead = max_overhead;
+}
+
+static void
+output_simplify_damage(struct weston_output *output,
+		       pixman_region32_t *damage)
+{
+	struct weston_compositor *ec = output->compositor;
+	struct weston_damage_simplify_result res;
+	char timestr[128];
+
+	weston_damage_simplify(damage, ec->damage_simplify.max_rects,
+			       ec->damage_simplify.max_overhead, &res);
+
+	output->damage_stats.repaints++;
+	output->damage_stats.rects_in += res.rects_in;
+	output->damage_stats.rects_out += res.rects_out;
+	output->damage_stats.pixels_damaged += res.area_in;
+	output->damage_stats.pixels_overdrawn += res.area_overdrawn;
+
+	if (!weston_log_scope_is_enabled(ec->damage_scope))
+		return;
+
+	weston_log_scope_timestamp(ec->damage_scope, timestr, sizeof timestr);
+	weston_log_scope_printf(ec->damage_scope,
+				"%s output %s: %d -> %d rects, "
+				"%" PRIu64 " px damaged, "
+				"%" PRIu64 " px overdrawn\n",
+				timestr, output->name,
+				res.rects_in, res.rects_out,
+				res.area_in, res.area_overdrawn);
 }
 
 static void
@@ -2664,8 +2837,10 @@ weston_compositor_build_view_list(struct weston_compositor *compositor)
 		wl_list_for_each(view, &layer->view_list.link, layer_link.link)
 			surface_stash_subsurface_views(view->surface);
 
-	wl_list_for_each_safe(view, tmp, &compositor->view_list, link)
+	wl_list_for_each_safe(view, tmp, &compositor->view_list, link) {
 		wl_list_init(&view->link);
+		view->index.indexed = false;
+	}
 	wl_list_init(&compositor->view_list);
 
 	wl_list_for_each(layer, &compositor->layer_list, link) {
@@ -2677,6 +2852,109 @@ weston_compositor_build_view_list(struct weston_compositor *compositor)
 	wl_list_for_each(layer, &compositor->layer_list, link)
 		wl_list_for_each(view, &layer->view_list.link, layer_link.link)
 			surface_free_unused_subsurface_views(view->surface);
+
+	if (compositor->view_index)
+		weston_view_index_rebuild(compositor->view_index,
+					  &compositor->view_list);
+
+	weston_compositor_output_view_lists_dirty(compositor, ~0u);
+
+	compositor->view_list_needs_rebuild = false;
+}
+
+/** Mark the view list as stale
+ *
+ * Called whenever layers, layer entries, sub-surface stacking or
+ * sub-surface mappedness change, so the next repaint rebuilds the list.
+ */
+static void
+weston_compositor_view_list_dirty(struct weston_compositor *compositor)
+{
+	compositor->view_list_needs_rebuild = true;
+}
+
+/** Bring the view list and view transforms up to date for a repaint
+ *
+ * The list is only rebuilt if the topology changed since the last build,
+ * so all outputs repainted in one pass share it. Otherwise only dirty view
+ * transforms need updating, which weston_view_update_transform() does in
+ * list order, i.e. parents before their sub-surfaces.
+ */
+static void
+weston_compositor_update_view_list(struct weston_compositor *compositor)
+{
+	struct weston_view *view;
+
+	if (compositor->view_list_needs_rebuild) {
+		weston_compositor_build_view_list(compositor);
+		return;
+	}
+
+	wl_list_for_each(view, &compositor->view_list, link)
+		weston_view_update_transform(view);
+}
+
+/** Mark the per-output view lists of the given outputs as stale
+ *
+ * \param compositor The compositor.
+ * \param output_mask Bit mask of weston_output::id, ~0u for all outputs.
+ */
+static void
+weston_compositor_output_view_lists_dirty(struct weston_compositor *compositor,
+					  uint32_t output_mask)
+{
+	struct weston_output *output;
+
+	wl_list_for_each(output, &compositor->output_list, link) {
+		if (output_mask & (1u << output->id))
+			output->view_list_dirty = true;
+	}
+}
+
+/** Bring the output's own view list up to date
+ *
+ * \param output The output.
+ * \return 0 on success, -1 if out of memory.
+ *
+ * The output's view list holds, in compositor view list order, the views
+ * of every surface that is shown on the output or has it as its primary
+ * output. Views of such a surface that are elsewhere are included too,
+ * because flushing the surface's damage for this output consumes it for
+ * all of its views.
+ *
+ * It is rebuilt only when the compositor view list was rebuilt, a view
+ * left it, or some surface's outputs changed; see
+ * weston_compositor_output_view_lists_dirty().
+ */
+static int
+weston_output_update_view_list(struct weston_output *output)
+{
+	struct weston_compositor *ec = output->compositor;
+	uint32_t output_bit = 1u << output->id;
+	struct weston_view *ev, **p;
+
+	if (!output->view_list_dirty)
+		return 0;
+
+	output->view_list.size = 0;
+
+	wl_list_for_each(ev, &ec->view_list, link) {
+		if (!(ev->surface->output_mask & output_bit) &&
+		    ev->surface->output != output)
+			continue;
+
+		p = wl_array_add(&output->view_list, sizeof *p);
+		if (!p) {
+			weston_log("%s: out of memory\n", __func__);
+			output->view_list.size = 0;
+			return -1;
+		}
+		*p = ev;
+	}
+
+	output->view_list_dirty = false;
+
+	return 0;
 }
 
 static void
@@ -2704,15 +2982,28 @@ weston_output_take_feedback_list(struct weston_output *output,
 	wl_list_init(&surface->feedback_list);
 }
 
-static int
+/** Repaint an output now
+ *
+ * \param output The output to repaint.
+ * \param repaint_data The backend's data for this repaint cycle.
+ * \return 0 on success, -1 on failure.
+ *
+ * Normally called only from the repaint timer; the plugin tests call it
+ * directly to repaint without running the event loop.
+ *
+ * \internal
+ */
+WESTON_EXPORT_FOR_TESTS int
 weston_output_repaint(struct weston_output *output, void *repaint_data)
 {
 	struct weston_compositor *ec = output->compositor;
-	struct weston_view *ev;
+	struct weston_view *ev, **views;
+	size_t n_views, i;
 	struct weston_animation *animation, *next;
 	struct weston_frame_callback *cb, *cnext;
 	struct wl_list frame_callback_list;
 	pixman_region32_t output_damage;
+	struct timespec now;
 	int r;
 	uint32_t frame_time_msec;
 	enum weston_hdcp_protection highest_requested = WESTON_HDCP_DISABLE;
@@ -2722,11 +3013,25 @@ weston_output_repaint(struct weston_output *output, void *repaint_data)
 
 	TL_POINT(ec, "core_repaint_begin", TLP_OUTPUT(output), TLP_END);
 
-	/* Rebuild the surface list and update surface transforms up front. */
-	weston_compositor_build_view_list(ec);
+	if (output->frame_timing) {
+		weston_compositor_read_presentation_clock(ec, &now);
+		weston_frame_timing_repaint_begin(output->frame_timing, &now);
+	}
+
+	/* Rebuild the surface list if needed and update surface transforms
+	 * up front. */
+	weston_compositor_update_view_list(ec);
+
+	/* Only the views of surfaces on this output need to be visited
+	 * from here on, except for the plane reset below. */
+	if (weston_output_update_view_list(output) < 0)
+		return -1;
+	views = output->view_list.data;
+	n_views = output->view_list.size / sizeof *views;
 
 	/* Find the highest protection desired for an output */
-	wl_list_for_each(ev, &ec->view_list, link) {
+	for (i = 0; i < n_views; i++) {
+		ev = views[i];
 		if (ev->surface->output_mask & (1u << output->id)) {
 			/*
 			 * The desired_protection of the output should be the
@@ -2752,7 +3057,8 @@ weston_output_repaint(struct weston_output *output, void *repaint_data)
 	}
 
 	wl_list_init(&frame_callback_list);
-	wl_list_for_each(ev, &ec->view_list, link) {
+	for (i = 0; i < n_views; i++) {
+		ev = views[i];
 		/* Note: This operation is safe to do multiple times on the
 		 * same surface.
 		 */
@@ -2765,13 +3071,14 @@ weston_output_repaint(struct weston_output *output, void *repaint_data)
 		}
 	}
 
-	output_accumulate_damage(output);
+	output_accumulate_damage(output, views, n_views);
 
 	pixman_region32_init(&output_damage);
 	pixman_region32_intersect(&output_damage,
 				  &ec->primary_plane.damage, &output->region);
 	pixman_region32_subtract(&output_damage,
 				 &output_damage, &ec->primary_plane.clip);
+	output_simplify_damage(output, &output_damage);
 
 	if (output->dirty)
 		weston_output_update_matrix(output);
@@ -2784,6 +3091,12 @@ weston_output_repaint(struct weston_output *output, void *repaint_data)
 	if (r == 0)
 		output->repaint_status = REPAINT_AWAITING_COMPLETION;
 
+	if (output->frame_timing) {
+		weston_compositor_read_presentation_clock(ec, &now);
+		weston_frame_timing_repaint_end(output->frame_timing, &now,
+						r == 0);
+	}
+
 	weston_compositor_repick(ec);
 
 	frame_time_msec = timespec_to_msec(&output->frame_time);
@@ -2996,6 +3309,9 @@ weston_output_finish_frame(struct weston_output *output,
 	 * timebase to work against, so any delay just wastes time. Push a
 	 * repaint as soon as possible so we can get on with it. */
 	if (!stamp) {
+		if (output->frame_timing)
+			weston_frame_timing_present(output->frame_timing,
+						    NULL, 0, presented_flags);
 		output->next_repaint = now;
 		goto out;
 	}
@@ -3007,6 +3323,10 @@ weston_output_finish_frame(struct weston_output *output,
 		 TLP_VBLANK(&vblank_monotonic), TLP_END);
 
 	refresh_nsec = millihz_to_nsec(output->current_mode->refresh);
+	if (output->frame_timing)
+		weston_frame_timing_present(output->frame_timing, stamp,
+					    refresh_nsec, presented_flags);
+
 	weston_presentation_feedback_present_list(&output->feedback_list,
 						  output, refresh_nsec, stamp,
 						  output->msc,
@@ -3068,11 +3388,17 @@ weston_layer_entry_insert(struct weston_layer_entry *list,
 {
 	wl_list_insert(&list->link, &entry->link);
 	entry->layer = list->layer;
+
+	if (entry->layer)
+		weston_compositor_view_list_dirty(entry->layer->compositor);
 }
 
 WL_EXPORT void
 weston_layer_entry_remove(struct weston_layer_entry *entry)
 {
+	if (entry->layer)
+		weston_compositor_view_list_dirty(entry->layer->compositor);
+
 	wl_list_remove(&entry->link);
 	wl_list_init(&entry->link);
 	entry->layer = NULL;
@@ -3109,6 +3435,7 @@ weston_layer_set_position(struct weston_layer *layer,
 {
 	struct weston_layer *below;
 
+	weston_compositor_view_list_dirty(layer->compositor);
 	wl_list_remove(&layer->link);
 
 	/* layer_list is ordered from top to bottom, the last layer being the
@@ -3132,6 +3459,7 @@ weston_layer_set_position(struct weston_layer *layer,
 WL_EXPORT void
 weston_layer_unset_position(struct weston_layer *layer)
 {
+	weston_compositor_view_list_dirty(layer->compositor);
 	wl_list_remove(&layer->link);
 	wl_list_init(&layer->link);
 }
@@ -3176,6 +3504,31 @@ weston_layer_mask_is_infinite(struct weston_layer *layer)
 	       layer->mask.y2 == INT32_MAX;
 }
 
+/** Mark a layer as rarely changing
+ *
+ * \param layer The layer to modify
+ * \param flattened Whether renderers may cache the layer
+ *
+ * Renderers supporting it composite the views of a flattened layer on the
+ * primary plane, including their subsurfaces, once per output into an
+ * intermediate image and draw that image until one of the views changes.
+ * This suits layers that change much less often than what is stacked above
+ * them, like backgrounds and panels; for anything else it only adds a copy.
+ */
+WL_EXPORT void
+weston_layer_set_flattened(struct weston_layer *layer, bool flattened)
+{
+	struct weston_view *view;
+
+	if (layer->flattened == flattened)
+		return;
+
+	layer->flattened = flattened;
+
+	wl_list_for_each(view, &layer->view_list.link, layer_link.link)
+		weston_view_schedule_repaint(view);
+}
+
 /**
  * \ingroup output
  */
@@ -3381,8 +3734,10 @@ weston_surface_commit_subsurface_order(struct weston_surface *surface)
 		wl_list_remove(&sub->parent_link);
 		wl_list_insert(&surface->subsurface_list, &sub->parent_link);
 
-		if (sub->reordered)
+		if (sub->reordered) {
 			weston_surface_damage_subsurfaces(sub);
+			weston_compositor_view_list_dirty(surface->compositor);
+		}
 	}
 }
 
@@ -3462,6 +3817,54 @@ weston_surface_build_buffer_matrix(const struct weston_surface *surface,
 	weston_matrix_scale(matrix, vp->buffer.scale, vp->buffer.scale, 1);
 }
 
+static bool
+weston_surface_buffer_matrix_is_current(const struct weston_surface *surface)
+{
+	const struct weston_buffer_viewport *vp = &surface->buffer_viewport;
+	const struct weston_buffer_viewport *key =
+		&surface->buffer_matrix_key.viewport;
+
+	return surface->buffer_matrix_key.valid &&
+	       surface->buffer_matrix_key.width_from_buffer ==
+			surface->width_from_buffer &&
+	       surface->buffer_matrix_key.height_from_buffer ==
+			surface->height_from_buffer &&
+	       key->buffer.transform == vp->buffer.transform &&
+	       key->buffer.scale == vp->buffer.scale &&
+	       key->buffer.src_x == vp->buffer.src_x &&
+	       key->buffer.src_y == vp->buffer.src_y &&
+	       key->buffer.src_width == vp->buffer.src_width &&
+	       key->buffer.src_height == vp->buffer.src_height &&
+	       key->surface.width == vp->surface.width &&
+	       key->surface.height == vp->surface.height;
+}
+
+/** Rebuild the buffer matrices if their inputs changed
+ *
+ * Building the matrix is cheap, but inverting it is not, and most commits
+ * only attach new content or add damage.
+ *
+ * \internal
+ */
+WESTON_EXPORT_FOR_TESTS void
+weston_surface_update_buffer_matrix(struct weston_surface *surface)
+{
+	if (weston_surface_buffer_matrix_is_current(surface))
+		return;
+
+	weston_surface_build_buffer_matrix(surface,
+					   &surface->surface_to_buffer_matrix);
+	weston_matrix_invert(&surface->buffer_to_surface_matrix,
+			     &surface->surface_to_buffer_matrix);
+
+	surface->buffer_matrix_key.viewport = surface->buffer_viewport;
+	surface->buffer_matrix_key.width_from_buffer =
+		surface->width_from_buffer;
+	surface->buffer_matrix_key.height_from_buffer =
+		surface->height_from_buffer;
+	surface->buffer_matrix_key.valid = true;
+}
+
 /**
  * Compute a + b > c while being safe to overflows.
  */
@@ -3615,6 +4018,7 @@ weston_surface_commit_state(struct weston_surface *surface,
 {
 	struct weston_view *view;
 	pixman_region32_t opaque;
+	bool newly_attached = state->newly_attached;
 
 	/* wl_surface.set_buffer_transform */
 	/* wl_surface.set_buffer_scale */
@@ -3636,10 +4040,7 @@ weston_surface_commit_state(struct weston_surface *surface,
 	assert(state->acquire_fence_fd == -1);
 	assert(state->buffer_release_ref.buffer_release == NULL);
 
-	weston_surface_build_buffer_matrix(surface,
-					   &surface->surface_to_buffer_matrix);
-	weston_matrix_invert(&surface->buffer_to_surface_matrix,
-			     &surface->surface_to_buffer_matrix);
+	weston_surface_update_buffer_matrix(surface);
 
 	if (state->newly_attached || state->buffer_viewport.changed) {
 		weston_surface_update_size(surface);
@@ -3666,6 +4067,10 @@ weston_surface_commit_state(struct weston_surface *surface,
 				       0, 0, surface->width, surface->height);
 	pixman_region32_clear(&state->damage_surface);
 
+	if (newly_attached || pixman_region32_not_empty(&surface->damage))
+		surface->content_serial =
+			wl_display_next_serial(surface->compositor->wl_display);
+
 	/* wl_surface.set_opaque_region */
 	pixman_region32_init(&opaque);
 	pixman_region32_intersect_rect(&opaque, &state->opaque,
@@ -4141,6 +4546,7 @@ subsurface_committed(struct weston_surface *surface, int32_t dx, int32_t dy)
 
 	if (!weston_surface_is_mapped(surface)) {
 		surface->is_mapped = true;
+		weston_compositor_view_list_dirty(surface->compositor);
 
 		/* Cannot call weston_view_update_transform(),
 		 * because that would call it also for the parent surface,
@@ -4479,6 +4885,7 @@ subsurface_set_desync(struct wl_client *client, struct wl_resource *resource)
 static void
 weston_subsurface_unlink_parent(struct weston_subsurface *sub)
 {
+	weston_compositor_view_list_dirty(sub->surface->compositor);
 	wl_list_remove(&sub->parent_link);
 	wl_list_remove(&sub->parent_link_pending);
 	wl_list_remove(&sub->parent_destroy_listener.link);
@@ -4542,6 +4949,7 @@ weston_subsurface_link_parent(struct weston_subsurface *sub,
 	wl_signal_add(&parent->destroy_signal,
 		      &sub->parent_destroy_listener);
 
+	weston_compositor_view_list_dirty(parent->compositor);
 	wl_list_insert(&parent->subsurface_list, &sub->parent_link);
 	wl_list_insert(&parent->subsurface_list_pending,
 		       &sub->parent_link_pending);
@@ -4587,6 +4995,7 @@ weston_subsurface_destroy(struct weston_subsurface *sub)
 	} else {
 		/* the dummy weston_subsurface for the parent itself */
 		assert(sub->parent_destroy_listener.notify == NULL);
+		weston_compositor_view_list_dirty(sub->surface->compositor);
 		wl_list_remove(&sub->parent_link);
 		wl_list_remove(&sub->parent_link_pending);
 	}
@@ -4650,6 +5059,7 @@ weston_subsurface_create_for_parent(struct weston_surface *parent)
 
 	weston_subsurface_link_surface(sub, parent);
 	sub->parent = parent;
+	weston_compositor_view_list_dirty(parent->compositor);
 	wl_list_insert(&parent->subsurface_list, &sub->parent_link);
 	wl_list_insert(&parent->subsurface_list_pending,
 		       &sub->parent_link_pending);
@@ -6001,6 +6411,7 @@ weston_compositor_add_output(struct weston_compositor *compositor,
 	wl_list_remove(&output->link);
 	wl_list_insert(compositor->output_list.prev, &output->link);
 	output->enabled = true;
+	output->view_list_dirty = true;
 
 	wl_list_for_each(head, &output->head_list, output_link)
 		weston_head_add_global(head);
@@ -6251,6 +6662,11 @@ weston_output_init(struct weston_output *output,
 
 	pixman_region32_init(&output->region);
 	wl_list_init(&output->mode_list);
+
+	wl_array_init(&output->view_list);
+	output->view_list_dirty = true;
+
+	output->frame_timing = weston_frame_timing_create();
 }
 
 /** Adds weston_output object to pending output list.
@@ -6562,6 +6978,12 @@ weston_output_release(struct weston_output *output)
 	pixman_region32_fini(&output->region);
 	wl_list_remove(&output->link);
 
+	wl_array_release(&output->view_list);
+
+	if (output->frame_timing)
+		weston_frame_timing_destroy(output->frame_timing);
+	output->frame_timing = NULL;
+
 	wl_list_for_each_safe(head, tmp, &output->head_list, output_link)
 		weston_head_detach(head);
 
@@ -7313,6 +7735,117 @@ debug_scene_graph_cb(struct weston_log_subscription *sub, void *data)
 	weston_log_subscription_complete(sub);
 }
 
+/* Seconds between two reports of the 'frame-timing' debug scope */
+#define FRAME_TIMING_REPORT_INTERVAL 5
+
+static char *
+weston_compositor_print_frame_timing(struct weston_compositor *ec)
+{
+	struct weston_output *output;
+	char timestr[128];
+	FILE *fp;
+	char *ret;
+	size_t len;
+	int err;
+
+	fp = open_memstream(&ret, &len);
+	assert(fp);
+
+	weston_log_scope_timestamp(ec->frame_timing, timestr, sizeof timestr);
+	fprintf(fp, "%s\n", timestr);
+
+	wl_list_for_each(output, &ec->output_list, link) {
+		if (output->frame_timing)
+			weston_frame_timing_print(output->frame_timing,
+						  output, fp);
+	}
+
+	err = fclose(fp);
+	assert(err == 0);
+
+	return ret;
+}
+
+/**
+ * Periodic report of the 'frame-timing' debug scope. Each report covers
+ * the frames presented since the previous one. The timer stops once the
+ * last subscriber is gone.
+ */
+static int
+frame_timing_timer_handler(void *data)
+{
+	struct weston_compositor *ec = data;
+	struct weston_output *output;
+	char *str;
+
+	if (!weston_log_scope_is_enabled(ec->frame_timing))
+		return 0;
+
+	str = weston_compositor_print_frame_timing(ec);
+	weston_log_scope_printf(ec->frame_timing, "%s", str);
+	free(str);
+
+	wl_list_for_each(output, &ec->output_list, link) {
+		if (output->frame_timing)
+			weston_frame_timing_reset(output->frame_timing);
+	}
+
+	wl_event_source_timer_update(ec->frame_timing_timer,
+				     FRAME_TIMING_REPORT_INTERVAL * 1000);
+
+	return 0;
+}
+
+/**
+ * Called when the 'frame-timing' debug scope is bound by a client. The
+ * statistics gathered so far are printed right away, and periodic
+ * reports start if they were not running yet.
+ */
+static void
+debug_frame_timing_cb(struct weston_log_subscription *sub, void *data)
+{
+	struct weston_compositor *ec = data;
+	char *str = weston_compositor_print_frame_timing(ec);
+
+	weston_log_subscription_printf(sub, "%s", str);
+	free(str);
+
+	wl_event_source_timer_update(ec->frame_timing_timer,
+				     FRAME_TIMING_REPORT_INTERVAL * 1000);
+}
+
+/**
+ * Called when the 'damage' debug scope is bound by a client: prints the
+ * damage simplification totals of every output so far. Every repaint is
+ * then reported as it happens.
+ */
+static void
+debug_damage_cb(struct weston_log_subscription *sub, void *data)
+{
+	struct weston_compositor *ec = data;
+	struct weston_output *output;
+
+	weston_log_subscription_printf(sub,
+				       "damage simplification: max %d rects, "
+				       "max overhead %.2f%s\n",
+				       ec->damage_simplify.max_rects,
+				       ec->damage_simplify.max_overhead,
+				       ec->damage_simplify.max_rects ?
+				       "" : " (disabled)");
+
+	wl_list_for_each(output, &ec->output_list, link) {
+		weston_log_subscription_printf(sub,
+			"output %s: %" PRIu64 " repaints, "
+			"%" PRIu64 " -> %" PRIu64 " rects, "
+			"%" PRIu64 " px damaged, %" PRIu64 " px overdrawn\n",
+			output->name, output->damage_stats.repaints,
+			output->damage_stats.rects_in,
+			output->damage_stats.rects_out,
+			output->damage_stats.pixels_damaged,
+			output->damage_stats.pixels_overdrawn);
+	}
+}
+
 /** Create the compositor.
  *
  * This functions creates and initializes a compositor instance.
@@ -7423,6 +7956,8 @@ weston_compositor_create(struct wl_display *display,
 	ec->repaint_timer =
 		wl_event_loop_add_timer(loop, output_repaint_timer_handler,
 					ec);
+	ec->frame_timing_timer =
+		wl_event_loop_add_timer(loop, frame_timing_timer_handler, ec);
 
 	weston_layer_init(&ec->fade_layer, ec);
 	weston_layer_init(&ec->cursor_layer, ec);
@@ -7443,6 +7978,28 @@ weston_compositor_create(struct wl_display *display,
 						weston_timeline_create_subscription,
 						weston_timeline_destroy_subscription,
 						ec);
+
+	ec->timeline_binary =
+		weston_compositor_add_log_scope(ec, "timeline-binary",
+						"Timeline event points, in the "
+						"binary format read by "
+						"weston-timeline-convert\n",
+						weston_timeline_binary_create_subscription,
+						weston_timeline_binary_destroy_subscription,
+						ec);
+
+	ec->frame_timing =
+		weston_compositor_add_log_scope(ec, "frame-timing",
+						"Repaint and presentation "
+						"timing statistics per output\n",
+						debug_frame_timing_cb, NULL,
+						ec);
+
+	ec->damage_scope =
+		weston_compositor_add_log_scope(ec, "damage",
+						"Damage rectangles before and "
+						"after simplification\n",
+						debug_damage_cb, NULL, ec);
 	return ec;
 
 fail:
@@ -7459,6 +8016,7 @@ weston_compositor_shutdown(struct weston_compositor *ec)
 	struct weston_output *output, *next;
 
 	wl_event_source_remove(ec->idle_source);
+	wl_event_source_remove(ec->frame_timing_timer);
 
 	/* Destroy all outputs associated with this compositor */
 	wl_list_for_each_safe(output, next, &ec->output_list, link)
@@ -7813,6 +8371,18 @@ weston_compositor_destroy(struct weston_compositor *compositor)
 	weston_log_scope_destroy(compositor->timeline);
 	compositor->timeline = NULL;
 
+	weston_log_scope_destroy(compositor->timeline_binary);
+	compositor->timeline_binary = NULL;
+
+	weston_log_scope_destroy(compositor->frame_timing);
+	compositor->frame_timing = NULL;
+
+	weston_log_scope_destroy(compositor->damage_scope);
+	compositor->damage_scope = NULL;
+
+	if (compositor->view_index)
+		weston_view_index_destroy(compositor->view_index);
+
 	free(compositor);
 }
 
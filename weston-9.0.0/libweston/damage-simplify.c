@@ -0,0 +1,200 @@
+/*
+ * Copyright © 2026 The Annland Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+
+#include "damage-simplify.h"
+
+/* How many of the most recent clusters a rectangle may join. Rectangles
+ * come sorted by band, so nearby damage is found among the last few. */
+#define MERGE_WINDOW 4
+
+struct damage_cluster {
+	pixman_box32_t box;
+	/* damaged pixels inside box that belong to this cluster */
+	uint64_t covered;
+};
+
+static uint64_t
+box_area(const pixman_box32_t *box)
+{
+	return (uint64_t)(box->x2 - box->x1) * (uint64_t)(box->y2 - box->y1);
+}
+
+static uint64_t
+region_area(pixman_region32_t *region)
+{
+	pixman_box32_t *boxes;
+	uint64_t area = 0;
+	int i, n;
+
+	boxes = pixman_region32_rectangles(region, &n);
+	for (i = 0; i < n; i++)
+		area += box_area(&boxes[i]);
+
+	return area;
+}
+
+static pixman_box32_t
+box_union(const pixman_box32_t *a, const pixman_box32_t *b)
+{
+	pixman_box32_t r;
+
+	r.x1 = a->x1 < b->x1 ? a->x1 : b->x1;
+	r.y1 = a->y1 < b->y1 ? a->y1 : b->y1;
+	r.x2 = a->x2 > b->x2 ? a->x2 : b->x2;
+	r.y2 = a->y2 > b->y2 ? a->y2 : b->y2;
+
+	return r;
+}
+
+static void
+cluster_merge(struct damage_cluster *into, const struct damage_cluster *c)
+{
+	into->box = box_union(&into->box, &c->box);
+	into->covered += c->covered;
+}
+
+/* Greedily add each rectangle to the recent cluster it wastes the fewest
+ * pixels with, if the undamaged part of the merged box stays within
+ * max_overhead of it. Returns the number of clusters. */
+static int
+cluster_boxes(const pixman_box32_t *boxes, int n, double max_overhead,
+	      struct damage_cluster *clusters)
+{
+	struct damage_cluster *c, *best;
+	pixman_box32_t merged;
+	uint64_t area, merged_area, waste, best_waste = 0;
+	int i, j, nc = 0;
+
+	for (i = 0; i < n; i++) {
+		area = box_area(&boxes[i]);
+		best = NULL;
+
+		for (j = nc - 1; j >= 0 && j >= nc - MERGE_WINDOW; j--) {
+			c = &clusters[j];
+			merged = box_union(&c->box, &boxes[i]);
+			merged_area = box_area(&merged);
+			waste = merged_area - c->covered - area;
+			if (waste > max_overhead * merged_area)
+				continue;
+			if (!best || waste < best_waste) {
+				best = c;
+				best_waste = waste;
+			}
+		}
+
+		if (best) {
+			best->box = box_union(&best->box, &boxes[i]);
+			best->covered += area;
+		} else {
+			clusters[nc].box = boxes[i];
+			clusters[nc].covered = area;
+			nc++;
+		}
+	}
+
+	return nc;
+}
+
+/** Reduce the number of rectangles of a damage region
+ *
+ * \param region The damage, replaced by a region that contains it.
+ * \param max_rects The most rectangles the result may have, or 0 to leave
+ * the region alone.
+ * \param max_overhead The fraction of a merged rectangle that may be
+ * undamaged, when merging is not needed to meet max_rects.
+ * \param result Receives rectangle counts and areas, may be NULL.
+ *
+ * Neighbouring rectangles are merged into their bounding box while that
+ * adds little area. If that leaves more than max_rects rectangles,
+ * consecutive ones are merged regardless of area, and if the union of
+ * the merged boxes still needs too many rectangles the region becomes
+ * its extents.
+ */
+void
+weston_damage_simplify(pixman_region32_t *region, int max_rects,
+		       double max_overhead,
+		       struct weston_damage_simplify_result *result)
+{
+	struct weston_damage_simplify_result res = { 0 };
+	struct damage_cluster *clusters;
+	pixman_box32_t *boxes, *merged;
+	pixman_region32_t simplified;
+	int i, n, nc, group;
+
+	boxes = pixman_region32_rectangles(region, &n);
+	res.rects_in = n;
+	res.rects_out = n;
+	res.area_in = region_area(region);
+
+	if (max_rects <= 0 || n <= 1)
+		goto out;
+
+	clusters = malloc(n * sizeof *clusters);
+	merged = malloc(n * sizeof *merged);
+	if (!clusters || !merged) {
+		free(clusters);
+		free(merged);
+		goto out;
+	}
+
+	nc = cluster_boxes(boxes, n, max_overhead, clusters);
+
+	if (nc > max_rects) {
+		group = (nc + max_rects - 1) / max_rects;
+		for (i = 0; i < nc; i++) {
+			if (i % group == 0)
+				clusters[i / group] = clusters[i];
+			else
+				cluster_merge(&clusters[i / group],
+					      &clusters[i]);
+		}
+		nc = (nc + group - 1) / group;
+	}
+
+	for (i = 0; i < nc; i++)
+		merged[i] = clusters[i].box;
+	pixman_region32_init_rects(&simplified, merged, nc);
+	free(clusters);
+	free(merged);
+
+	pixman_region32_rectangles(&simplified, &n);
+	if (n > max_rects)
+		pixman_region32_reset(&simplified,
+				      pixman_region32_extents(region));
+
+	pixman_region32_copy(region, &simplified);
+	pixman_region32_fini(&simplified);
+
+	pixman_region32_rectangles(region, &res.rects_out);
+	res.area_overdrawn = region_area(region) - res.area_in;
+
+out:
+	if (result)
+		*result = res;
+}
@@ -0,0 +1,47 @@
+/*
+ * Copyright © 2026 The Annland Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef WESTON_DAMAGE_SIMPLIFY_H
+#define WESTON_DAMAGE_SIMPLIFY_H
+
+#include <stdint.h>
+#include <pixman.h>
+
+/** What weston_damage_simplify() did to one region */
+struct weston_damage_simplify_result {
+	int rects_in;
+	int rects_out;
+	/** Damaged pixels before simplification */
+	uint64_t area_in;
+	/** Pixels added by merging rectangles */
+	uint64_t area_overdrawn;
+};
+
+void
+weston_damage_simplify(pixman_region32_t *region, int max_rects,
+		       double max_overhead,
+		       struct weston_damage_simplify_result *result);
+
+#endif /* WESTON_DAMAGE_SIMPLIFY_H */
@@ -0,0 +1,229 @@
+/*
+ * Copyright © 2026 The Annland Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libweston/libweston.h>
+#include "frame-timing.h"
+#include "presentation-time-server-protocol.h"
+#include "shared/helpers.h"
+#include "shared/timespec-util.h"
+
+struct weston_frame_timing *
+weston_frame_timing_create(void)
+{
+	struct weston_frame_timing *ft;
+
+	ft = zalloc(sizeof *ft);
+	if (!ft)
+		return NULL;
+
+	weston_frame_timing_reset(ft);
+
+	return ft;
+}
+
+void
+weston_frame_timing_destroy(struct weston_frame_timing *ft)
+{
+	free(ft);
+}
+
+static void
+histogram_reset(struct weston_frame_timing_histogram *h)
+{
+	memset(h, 0, sizeof *h);
+	h->min_usec = UINT32_MAX;
+}
+
+/** Start a new statistics window
+ *
+ * Only the accumulated samples are dropped; the state of the repaint
+ * loop is kept so the frame in flight is still accounted for.
+ */
+void
+weston_frame_timing_reset(struct weston_frame_timing *ft)
+{
+	histogram_reset(&ft->repaint);
+	histogram_reset(&ft->to_flip);
+	histogram_reset(&ft->jitter);
+	ft->frames = 0;
+	ft->missed = 0;
+}
+
+static void
+histogram_add(struct weston_frame_timing_histogram *h, int64_t nsec)
+{
+	uint32_t usec;
+	int bucket = 0;
+
+	if (nsec < 0)
+		nsec = 0;
+	usec = MIN(nsec / 1000, (int64_t) UINT32_MAX);
+
+	/* Index of the highest set bit, plus one. */
+	if (usec)
+		bucket = 32 - __builtin_clz(usec);
+	if (bucket >= WESTON_FRAME_TIMING_BUCKETS)
+		bucket = WESTON_FRAME_TIMING_BUCKETS - 1;
+
+	h->buckets[bucket]++;
+	h->count++;
+	h->sum_usec += usec;
+	h->min_usec = MIN(h->min_usec, usec);
+	h->max_usec = MAX(h->max_usec, usec);
+}
+
+void
+weston_frame_timing_repaint_begin(struct weston_frame_timing *ft,
+				  const struct timespec *now)
+{
+	ft->repaint_begin = *now;
+}
+
+/**
+ * \param posted True if the backend accepted the frame, in which case
+ * weston_frame_timing_present() is expected to follow.
+ */
+void
+weston_frame_timing_repaint_end(struct weston_frame_timing *ft,
+				const struct timespec *now, bool posted)
+{
+	histogram_add(&ft->repaint,
+		      timespec_sub_to_nsec(now, &ft->repaint_begin));
+	ft->repaint_pending = posted;
+}
+
+/** Account for a completed frame
+ *
+ * \param stamp The presentation timestamp, or NULL if unknown.
+ * \param refresh_nsec The refresh period of the output.
+ * \param presented_flags As passed to weston_output_finish_frame().
+ *
+ * A frame that was presented more than half a refresh period late counts
+ * the refresh cycles it skipped as missed. Frames finishing a restart of
+ * the repaint loop carry no timing of their own and only reset the
+ * interval measurement.
+ */
+void
+weston_frame_timing_present(struct weston_frame_timing *ft,
+			    const struct timespec *stamp,
+			    int32_t refresh_nsec, uint32_t presented_flags)
+{
+	int64_t interval, cycles;
+
+	if (!stamp || (presented_flags & WP_PRESENTATION_FEEDBACK_INVALID) ||
+	    !ft->repaint_pending) {
+		ft->repaint_pending = false;
+		ft->last_present.tv_sec = 0;
+		ft->last_present.tv_nsec = 0;
+		return;
+	}
+
+	ft->repaint_pending = false;
+	ft->frames++;
+	histogram_add(&ft->to_flip,
+		      timespec_sub_to_nsec(stamp, &ft->repaint_begin));
+
+	if (!timespec_is_zero(&ft->last_present) && refresh_nsec > 0) {
+		interval = timespec_sub_to_nsec(stamp, &ft->last_present);
+		cycles = (interval + refresh_nsec / 2) / refresh_nsec;
+		if (cycles < 1)
+			cycles = 1;
+
+		ft->missed += cycles - 1;
+		histogram_add(&ft->jitter,
+			      llabs(interval - cycles * refresh_nsec));
+	}
+
+	ft->last_present = *stamp;
+}
+
+/* Upper bound of the bucket holding the given fraction of the samples. */
+static uint32_t
+histogram_percentile(const struct weston_frame_timing_histogram *h,
+		     double fraction)
+{
+	uint64_t target = h->count * fraction;
+	uint64_t seen = 0;
+	int i;
+
+	for (i = 0; i < WESTON_FRAME_TIMING_BUCKETS; i++) {
+		seen += h->buckets[i];
+		if (seen > target)
+			return MIN(1u << i, h->max_usec);
+	}
+
+	return h->max_usec;
+}
+
+static void
+histogram_print(const struct weston_frame_timing_histogram *h,
+		const char *name, FILE *fp)
+{
+	int i;
+
+	if (h->count == 0) {
+		fprintf(fp, "\t%-8s no samples\n", name);
+		return;
+	}
+
+	fprintf(fp, "\t%-8s n=%" PRIu64 " min=%u avg=%" PRIu64
+		" p50=%u p99=%u max=%u us\n", name, h->count, h->min_usec,
+		h->sum_usec / h->count, histogram_percentile(h, 0.5),
+		histogram_percentile(h, 0.99), h->max_usec);
+
+	fprintf(fp, "\t%-8s", "");
+	for (i = 0; i < WESTON_FRAME_TIMING_BUCKETS; i++) {
+		if (h->buckets[i])
+			fprintf(fp, " <%u:%u", 1u << i, h->buckets[i]);
+	}
+	fprintf(fp, "\n");
+}
+
+/** Print the statistics in the format of the 'frame-timing' debug scope */
+void
+weston_frame_timing_print(struct weston_frame_timing *ft,
+			  struct weston_output *output, FILE *fp)
+{
+	int32_t refresh = 0;
+
+	if (output->current_mode)
+		refresh = output->current_mode->refresh;
+
+	fprintf(fp, "output %u (%s) %d.%03d Hz: %" PRIu64 " frames, %" PRIu64
+		" missed\n", output->id, output->name, refresh / 1000,
+		refresh % 1000, ft->frames, ft->missed);
+	histogram_print(&ft->repaint, "repaint", fp);
+	histogram_print(&ft->to_flip, "to-flip", fp);
+	histogram_print(&ft->jitter, "jitter", fp);
+}
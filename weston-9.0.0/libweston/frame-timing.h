@@ -0,0 +1,98 @@
+/*
+ * Copyright © 2026 The Annland Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef WESTON_FRAME_TIMING_H
+#define WESTON_FRAME_TIMING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <libweston/libweston.h>
+
+/* Bucket i counts samples in [2^(i-1), 2^i) microseconds; bucket 0 counts
+ * samples under 1 us and the last bucket everything from ~4 s up. */
+#define WESTON_FRAME_TIMING_BUCKETS 24
+
+struct weston_frame_timing_histogram {
+	uint64_t count;
+	uint64_t sum_usec;
+	uint32_t min_usec;
+	uint32_t max_usec;
+	uint32_t buckets[WESTON_FRAME_TIMING_BUCKETS];
+};
+
+/** Repaint loop timing statistics of one weston_output
+ *
+ * All timestamps are in the presentation clock domain. The histograms
+ * cover the frames since the last weston_frame_timing_reset().
+ */
+struct weston_frame_timing {
+	/** Time spent in weston_output_repaint() */
+	struct weston_frame_timing_histogram repaint;
+	/** From the start of the repaint to the presentation of its frame */
+	struct weston_frame_timing_histogram to_flip;
+	/** Distance of the presentation interval to a refresh multiple */
+	struct weston_frame_timing_histogram jitter;
+
+	uint64_t frames;
+	/** Refresh cycles skipped between consecutive presented frames */
+	uint64_t missed;
+
+	struct timespec repaint_begin;
+	/** A repaint was posted and its presentation is outstanding */
+	bool repaint_pending;
+	/** Presentation of the previous frame, zero if the loop restarted */
+	struct timespec last_present;
+};
+
+struct weston_frame_timing *
+weston_frame_timing_create(void);
+
+void
+weston_frame_timing_destroy(struct weston_frame_timing *ft);
+
+void
+weston_frame_timing_reset(struct weston_frame_timing *ft);
+
+void
+weston_frame_timing_repaint_begin(struct weston_frame_timing *ft,
+				  const struct timespec *now);
+
+void
+weston_frame_timing_repaint_end(struct weston_frame_timing *ft,
+				const struct timespec *now, bool posted);
+
+void
+weston_frame_timing_present(struct weston_frame_timing *ft,
+			    const struct timespec *stamp,
+			    int32_t refresh_nsec, uint32_t presented_flags);
+
+void
+weston_frame_timing_print(struct weston_frame_timing *ft,
+			  struct weston_output *output, FILE *fp);
+
+#endif /* WESTON_FRAME_TIMING_H */
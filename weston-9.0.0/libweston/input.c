@@ -1670,8 +1670,16 @@ weston_pointer_clamp_for_output(struct weston_pointer *pointer,
 					output->height - 1);
 }
 
+/** Clamp a pointer position moved to from another one than the current
+ *
+ * Like weston_pointer_clamp(), for a position that is not the result of a
+ * single step from pointer->x, pointer->y: out of all outputs, it is kept
+ * on the output containing from_x, from_y.
+ */
 WL_EXPORT void
-weston_pointer_clamp(struct weston_pointer *pointer, wl_fixed_t *fx, wl_fixed_t *fy)
+weston_pointer_clamp_from(struct weston_pointer *pointer,
+			  wl_fixed_t from_x, wl_fixed_t from_y,
+			  wl_fixed_t *fx, wl_fixed_t *fy)
 {
 	struct weston_compositor *ec = pointer->seat->compositor;
 	struct weston_output *output, *prev = NULL;
@@ -1679,8 +1687,8 @@ weston_pointer_clamp(struct weston_pointer *pointer, wl_fixed_t *fx, wl_fixed_t
 
 	x = wl_fixed_to_int(*fx);
 	y = wl_fixed_to_int(*fy);
-	old_x = wl_fixed_to_int(pointer->x);
-	old_y = wl_fixed_to_int(pointer->y);
+	old_x = wl_fixed_to_int(from_x);
+	old_y = wl_fixed_to_int(from_y);
 
 	wl_list_for_each(output, &ec->output_list, link) {
 		if (pointer->seat->output && pointer->seat->output != output)
@@ -1700,6 +1708,12 @@ weston_pointer_clamp(struct weston_pointer *pointer, wl_fixed_t *fx, wl_fixed_t
 		weston_pointer_clamp_for_output(pointer, prev, fx, fy);
 }
 
+WL_EXPORT void
+weston_pointer_clamp(struct weston_pointer *pointer, wl_fixed_t *fx, wl_fixed_t *fy)
+{
+	weston_pointer_clamp_from(pointer, pointer->x, pointer->y, fx, fy);
+}
+
 static void
 weston_pointer_move_to(struct weston_pointer *pointer,
 		       wl_fixed_t x, wl_fixed_t y)
@@ -1791,6 +1805,26 @@ notify_motion(struct weston_seat *seat,
 	pointer->grab->interface->motion(pointer->grab, time, event);
 }
 
+/** Send relative motion to the relative pointers of the focus client only
+ *
+ * For backends coalescing pointer motion: the relative motion of each event
+ * is sent right away, and the pointer is moved later, once for the whole
+ * batch, with an absolute notify_motion().
+ */
+WL_EXPORT void
+notify_relative_motion(struct weston_seat *seat, const struct timespec *time,
+		       struct weston_pointer_motion_event *event)
+{
+	struct weston_pointer *pointer = weston_seat_get_pointer(seat);
+
+	if (!pointer->focus_client ||
+	    wl_list_empty(&pointer->focus_client->relative_pointer_resources))
+		return;
+
+	pointer_send_relative_motion(pointer, time, event);
+	weston_pointer_send_frame(pointer);
+}
+
 static void
 run_modifier_bindings(struct weston_seat *seat, uint32_t old, uint32_t new)
 {
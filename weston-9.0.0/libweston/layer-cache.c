@@ -0,0 +1,191 @@
+/*
+ * Copyright © 2026 The Annland Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <libweston/libweston.h>
+#include "layer-cache.h"
+#include "shared/helpers.h"
+
+/** Get the layer a view is stacked in
+ *
+ * Subsurface views are stacked with their parent.
+ */
+WL_EXPORT struct weston_layer *
+weston_view_get_layer(struct weston_view *view)
+{
+	while (view->parent_view)
+		view = view->parent_view;
+
+	return view->layer_link.layer;
+}
+
+/** Whether the view is drawn as part of a flattened layer */
+WL_EXPORT bool
+weston_view_is_flattened(struct weston_view *view)
+{
+	struct weston_layer *layer = weston_view_get_layer(view);
+
+	return layer && layer->flattened &&
+	       view->plane == &view->surface->compositor->primary_plane;
+}
+
+WL_EXPORT void
+weston_layer_snapshot_init(struct weston_layer_snapshot *snapshot,
+			   struct weston_layer *layer)
+{
+	memset(snapshot, 0, sizeof *snapshot);
+	snapshot->layer = layer;
+	wl_array_init(&snapshot->views);
+	pixman_region32_init(&snapshot->region);
+	pixman_region32_init(&snapshot->opaque);
+}
+
+static void
+snapshot_views_release(struct wl_array *views)
+{
+	struct weston_layer_snapshot_view *sv;
+
+	wl_array_for_each(sv, views)
+		pixman_region32_fini(&sv->clip);
+	wl_array_release(views);
+}
+
+WL_EXPORT void
+weston_layer_snapshot_release(struct weston_layer_snapshot *snapshot)
+{
+	snapshot_views_release(&snapshot->views);
+	pixman_region32_fini(&snapshot->region);
+	pixman_region32_fini(&snapshot->opaque);
+}
+
+static bool
+snapshot_view_equal(const struct weston_layer_snapshot_view *a,
+		    const struct weston_layer_snapshot_view *b)
+{
+	if (a->view != b->view || a->content_serial != b->content_serial ||
+	    a->alpha != b->alpha || a->transformed != b->transformed ||
+	    memcmp(&a->bbox, &b->bbox, sizeof a->bbox) != 0)
+		return false;
+
+	return !a->transformed ||
+	       memcmp(a->matrix.d, b->matrix.d, sizeof a->matrix.d) == 0;
+}
+
+/** Record the current state of the layer on an output
+ *
+ * \param snapshot The snapshot to update.
+ * \param output The output the layer is drawn on.
+ * \return True if the layer may look different than at the previous update,
+ * and any image made from it must be made again.
+ *
+ * Only the layer's views on the primary plane that are shown on the output
+ * are considered.
+ */
+WL_EXPORT bool
+weston_layer_snapshot_update(struct weston_layer_snapshot *snapshot,
+			     struct weston_output *output)
+{
+	struct weston_compositor *compositor = output->compositor;
+	struct weston_layer_snapshot_view *sv, *old;
+	struct weston_view *view;
+	struct wl_array views;
+	pixman_region32_t *opaque = &snapshot->opaque;
+	bool changed = false;
+	size_t n = 0;
+
+	if (snapshot->width != output->current_mode->width ||
+	    snapshot->height != output->current_mode->height ||
+	    memcmp(snapshot->output_matrix.d, output->matrix.d,
+		   sizeof output->matrix.d) != 0)
+		changed = true;
+
+	snapshot->width = output->current_mode->width;
+	snapshot->height = output->current_mode->height;
+	snapshot->output_matrix = output->matrix;
+
+	wl_array_init(&views);
+	pixman_region32_clear(opaque);
+	pixman_region32_clear(&snapshot->region);
+
+	wl_list_for_each(view, &compositor->view_list, link) {
+		if (view->plane != &compositor->primary_plane ||
+		    !(view->output_mask & (1u << output->id)) ||
+		    weston_view_get_layer(view) != snapshot->layer)
+			continue;
+
+		sv = wl_array_add(&views, sizeof *sv);
+		if (!sv) {
+			changed = true;
+			break;
+		}
+
+		memset(sv, 0, sizeof *sv);
+		sv->view = view;
+		sv->content_serial = view->surface->content_serial;
+		sv->alpha = view->alpha;
+		sv->transformed = view->transform.enabled;
+		if (sv->transformed)
+			sv->matrix = view->transform.matrix;
+		sv->bbox = *pixman_region32_extents(&view->transform.boundingbox);
+
+		pixman_region32_init(&sv->clip);
+		pixman_region32_copy(&sv->clip, opaque);
+		pixman_region32_union(opaque, opaque,
+				      &view->transform.opaque);
+		pixman_region32_union(&snapshot->region, &snapshot->region,
+				      &view->transform.boundingbox);
+
+		old = snapshot->views.data;
+		if (n >= snapshot->views.size / sizeof *old ||
+		    !snapshot_view_equal(sv, &old[n]))
+			changed = true;
+		n++;
+	}
+
+	if (n != snapshot->views.size / sizeof *sv)
+		changed = true;
+
+	snapshot_views_release(&snapshot->views);
+	snapshot->views = views;
+
+	return changed;
+}
+
+/** The topmost view of the layer at the last update, or NULL if none */
+WL_EXPORT struct weston_view *
+weston_layer_snapshot_top_view(struct weston_layer_snapshot *snapshot)
+{
+	struct weston_layer_snapshot_view *sv = snapshot->views.data;
+
+	if (snapshot->views.size == 0)
+		return NULL;
+
+	return sv->view;
+}
@@ -0,0 +1,86 @@
+/*
+ * Copyright © 2026 The Annland Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef WESTON_LAYER_CACHE_H
+#define WESTON_LAYER_CACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <libweston/libweston.h>
+#include <libweston/matrix.h>
+
+/*
+ * Renderers may composite the views of a flattened layer (see
+ * weston_layer_set_flattened()) once into an output-sized image and draw
+ * that image instead of the views. A snapshot records what the layer
+ * looked like on an output when that image was made, so that renderers
+ * can tell when it has to be made again.
+ */
+
+struct weston_layer_snapshot_view {
+	struct weston_view *view;
+	uint32_t content_serial;
+	float alpha;
+	bool transformed;
+	struct weston_matrix matrix;
+	pixman_box32_t bbox;
+	/** Opaque region of the layer's views above, in global coordinates */
+	pixman_region32_t clip;
+};
+
+struct weston_layer_snapshot {
+	struct weston_layer *layer;
+	struct weston_matrix output_matrix;
+	int32_t width, height;
+	/** struct weston_layer_snapshot_view, topmost first */
+	struct wl_array views;
+	/** Union of the view bounding boxes, in global coordinates */
+	pixman_region32_t region;
+	/** Union of the view opaque regions, in global coordinates */
+	pixman_region32_t opaque;
+};
+
+struct weston_layer *
+weston_view_get_layer(struct weston_view *view);
+
+bool
+weston_view_is_flattened(struct weston_view *view);
+
+void
+weston_layer_snapshot_init(struct weston_layer_snapshot *snapshot,
+			   struct weston_layer *layer);
+
+void
+weston_layer_snapshot_release(struct weston_layer_snapshot *snapshot);
+
+bool
+weston_layer_snapshot_update(struct weston_layer_snapshot *snapshot,
+			     struct weston_output *output);
+
+struct weston_view *
+weston_layer_snapshot_top_view(struct weston_layer_snapshot *snapshot);
+
+#endif
@@ -42,6 +42,7 @@
 #include "backend.h"
 #include "libweston-internal.h"
 #include "libinput-device.h"
+#include "libinput-seat.h"
 #include "shared/helpers.h"
 #include "shared/timespec-util.h"
 
@@ -93,6 +94,8 @@ handle_pointer_motion(struct libinput_device *libinput_device,
 {
 	struct evdev_device *device =
 		libinput_device_get_user_data(libinput_device);
+	struct udev_input *input =
+		libinput_get_user_data(libinput_device_get_context(libinput_device));
 	struct weston_pointer_motion_event event = { 0 };
 	struct timespec time;
 	double dx_unaccel, dy_unaccel;
@@ -112,6 +115,10 @@ handle_pointer_motion(struct libinput_device *libinput_device,
 		.dy_unaccel = dy_unaccel,
 	};
 
+	/* A coalesced motion gets its frame when the batch is flushed. */
+	if (udev_input_queue_motion(input, device->seat, &event))
+		return false;
+
 	notify_motion(device->seat, &time, &event);
 
 	return true;
@@ -26,6 +26,7 @@
 
 #include "config.h"
 
+#include <inttypes.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
@@ -35,6 +36,7 @@
 #include <libudev.h>
 
 #include <libweston/libweston.h>
+#include <libweston/weston-log.h>
 #include "backend.h"
 #include "libweston-internal.h"
 #include "weston-log-internal.h"
@@ -194,6 +196,109 @@ udev_input_process_event(struct libinput_event *event)
 	return handled;
 }
 
+/** Deliver the pointer motion queued by udev_input_queue_motion()
+ *
+ * Called at the end of each dispatch and before any other event, so that
+ * e.g. a button press is seen at the position reached by the motion that
+ * preceded it.
+ */
+void
+udev_input_flush_motion(struct udev_input *input)
+{
+	struct weston_seat *seat = input->motion_seat;
+	struct weston_pointer_motion_event event;
+
+	if (!seat)
+		return;
+
+	input->motion_seat = NULL;
+
+	if (!weston_seat_get_pointer(seat))
+		return;
+
+	/* The relative pointers already got each step, so only move the
+	 * pointer, without another relative motion. */
+	event = (struct weston_pointer_motion_event) {
+		.mask = WESTON_POINTER_MOTION_ABS,
+		.time = input->motion_time,
+		.x = wl_fixed_to_double(input->motion_x),
+		.y = wl_fixed_to_double(input->motion_y),
+	};
+
+	notify_motion(seat, &event.time, &event);
+	notify_pointer_frame(seat);
+}
+
+/** Queue relative pointer motion until the end of the dispatch
+ *
+ * Each step is clamped to the outputs from where the previous one ended,
+ * as it would be if delivered on its own; pushing against a screen edge
+ * and coming back must not leave the pointer somewhere else.
+ *
+ * Returns false when the event is not coalesced and must be delivered as
+ * usual: coalescing is disabled, or a grab is active, since grabs such as
+ * pointer locking may rely on seeing every event.
+ */
+bool
+udev_input_queue_motion(struct udev_input *input, struct weston_seat *seat,
+			struct weston_pointer_motion_event *event)
+{
+	struct weston_pointer *pointer;
+	wl_fixed_t from_x, from_y, x, y;
+
+	if (!input->coalesce_motion)
+		return false;
+
+	input->motion_events++;
+
+	if (input->motion_seat && input->motion_seat != seat)
+		udev_input_flush_motion(input);
+
+	pointer = weston_seat_get_pointer(seat);
+	if (!pointer || pointer->grab != &pointer->default_grab) {
+		udev_input_flush_motion(input);
+		return false;
+	}
+
+	notify_relative_motion(seat, &event->time, event);
+
+	if (input->motion_seat) {
+		from_x = input->motion_x;
+		from_y = input->motion_y;
+		input->motion_coalesced++;
+	} else {
+		from_x = pointer->x;
+		from_y = pointer->y;
+		input->motion_seat = seat;
+	}
+
+	x = from_x + wl_fixed_from_double(event->dx);
+	y = from_y + wl_fixed_from_double(event->dy);
+	weston_pointer_clamp_from(pointer, from_x, from_y, &x, &y);
+
+	input->motion_time = event->time;
+	input->motion_x = x;
+	input->motion_y = y;
+
+	return true;
+}
+
+static void
+udev_input_motion_subscribe(struct weston_log_subscription *sub, void *data)
+{
+	struct udev_input *input = data;
+
+	if (!input->coalesce_motion) {
+		weston_log_subscription_printf(sub,
+			"pointer motion coalescing is disabled\n");
+		return;
+	}
+
+	weston_log_subscription_printf(sub,
+		"%" PRIu64 " pointer motion events, %" PRIu64 " coalesced\n",
+		input->motion_events, input->motion_coalesced);
+}
+
 static void
 process_event(struct libinput_event *event)
 {
@@ -209,9 +314,16 @@ process_events(struct udev_input *input)
 	struct libinput_event *event;
 
 	while ((event = libinput_get_event(input->libinput))) {
+		/* Queued motion must reach the pointer before anything else
+		 * from the device, e.g. a button press. */
+		if (libinput_event_get_type(event) !=
+		    LIBINPUT_EVENT_POINTER_MOTION)
+			udev_input_flush_motion(input);
 		process_event(event);
 		libinput_event_destroy(event);
 	}
+
+	udev_input_flush_motion(input);
 }
 
 static int
@@ -361,7 +473,16 @@ udev_input_init(struct udev_input *input, struct weston_compositor *c,
 
 	process_events(input);
 
-	return udev_input_enable(input);
+	if (udev_input_enable(input) < 0)
+		return -1;
+
+	input->motion_scope =
+		weston_compositor_add_log_scope(c, "input-coalescing",
+						"Pointer motion coalescing statistics\n",
+						udev_input_motion_subscribe,
+						NULL, input);
+
+	return 0;
 }
 
 void
@@ -369,6 +490,7 @@ udev_input_destroy(struct udev_input *input)
 {
 	struct udev_seat *seat, *next;
 
+	weston_log_scope_destroy(input->motion_scope);
 	if (input->libinput_source)
 		wl_event_source_remove(input->libinput_source);
 	wl_list_for_each_safe(seat, next, &input->compositor->seat_list, base.link)
@@ -51,6 +51,17 @@ struct udev_input {
 	struct weston_compositor *compositor;
 	int suspended;
 	udev_configure_device_t configure_device;
+
+	/* Pointer motion coalescing: the relative motion of a dispatch is
+	 * accumulated into the clamped position motion_x, motion_y and
+	 * delivered to motion_seat at its end. */
+	bool coalesce_motion;
+	struct weston_seat *motion_seat;
+	struct timespec motion_time;
+	wl_fixed_t motion_x, motion_y;
+	uint64_t motion_events;
+	uint64_t motion_coalesced;
+	struct weston_log_scope *motion_scope;
 };
 
 int
@@ -66,6 +77,13 @@ udev_input_init(struct udev_input *input,
 void
 udev_input_destroy(struct udev_input *input);
 
+bool
+udev_input_queue_motion(struct udev_input *input, struct weston_seat *seat,
+			struct weston_pointer_motion_event *event);
+
+void
+udev_input_flush_motion(struct udev_input *input);
+
 struct udev_seat *
 udev_seat_get_named(struct udev_input *u,
 		    const char *seat_name);
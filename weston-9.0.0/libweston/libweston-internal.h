@@ -40,6 +40,12 @@
  * features should either provide their own (internal) header or use this one.
  */
 
+/* Marks the few internal functions the test suite calls directly. They
+ * are exported from the shared library only so the tests can link, are
+ * declared only in this uninstalled header, and are not part of the
+ * libweston ABI.
+ */
+#define WESTON_EXPORT_FOR_TESTS __attribute__ ((visibility("default")))
 
 /* weston_buffer */
 
@@ -159,6 +165,9 @@ weston_output_disable_planes_incr(struct weston_output *output);
 void
 weston_output_disable_planes_decr(struct weston_output *output);
 
+int
+weston_output_repaint(struct weston_output *output, void *repaint_data);
+
 /* weston_plane */
 
 void
@@ -216,6 +225,10 @@ void
 weston_pointer_clamp(struct weston_pointer *pointer,
 		     wl_fixed_t *fx, wl_fixed_t *fy);
 void
+weston_pointer_clamp_from(struct weston_pointer *pointer,
+			  wl_fixed_t from_x, wl_fixed_t from_y,
+			  wl_fixed_t *fx, wl_fixed_t *fy);
+void
 weston_pointer_set_default_grab(struct weston_pointer *pointer,
 			        const struct weston_pointer_grab_interface *interface);
 
@@ -267,6 +280,9 @@ weston_surface_to_buffer_region(struct weston_surface *surface,
 void
 weston_surface_schedule_repaint(struct weston_surface *surface);
 
+void
+weston_surface_update_buffer_matrix(struct weston_surface *surface);
+
 /* weston_spring */
 
 void
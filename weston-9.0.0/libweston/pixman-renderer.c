@@ -30,9 +30,13 @@
 #include <errno.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
+#include <pthread.h>
+#include <signal.h>
 
 #include "pixman-renderer.h"
+#include "layer-cache.h"
 #include "shared/helpers.h"
 
 #include <linux/input.h>
@@ -42,12 +46,34 @@ struct pixman_output_state {
 	pixman_image_t *shadow_image;
 	pixman_image_t *hw_buffer;
 	pixman_region32_t *hw_extra_damage;
+
+	/* Number of horizontal bands composited in parallel, 1 if the
+	 * output is repainted on the compositor thread only */
+	unsigned int n_bands;
+	struct pixman_band *bands;
+
+	/* struct pixman_layer_cache::link */
+	struct wl_list layer_caches;
+};
+
+/** A flattened layer composited into an image the size of an output */
+struct pixman_layer_cache {
+	struct wl_list link;
+	struct weston_layer_snapshot snapshot;
+	pixman_image_t *image;
+	/* the image matches the snapshot */
+	bool valid;
+	/* the layer has views to draw in this repaint */
+	bool used;
 };
 
 struct pixman_surface_state {
 	struct weston_surface *surface;
 
 	pixman_image_t *image;
+	/* Set when image is a solid fill of solid_color */
+	bool solid;
+	pixman_color_t solid_color;
 	struct weston_buffer_reference buffer_ref;
 	struct weston_buffer_release_reference buffer_release_ref;
 
@@ -56,6 +82,39 @@ struct pixman_surface_state {
 	struct wl_listener renderer_destroy_listener;
 };
 
+/** A horizontal slice of an output repaint
+ *
+ * When an output is repainted in bands, every band composites into its own
+ * alias of the output image and uses private aliases of the source images.
+ * Pixman images carry mutable state (clip region, transform, filter, and
+ * lazily validated flags), so sharing them between threads is not safe.
+ */
+struct pixman_band {
+	struct weston_output *output;
+	/* damage to repaint, in global coordinates */
+	pixman_region32_t *damage;
+	/* band extents, in output buffer coordinates */
+	pixman_box32_t box;
+	pixman_image_t *target;
+	pixman_image_t *debug_color;
+	bool private_images;
+};
+
+struct pixman_worker_pool {
+	pthread_t *threads;
+	unsigned int n_threads;
+
+	pthread_mutex_t mutex;
+	pthread_cond_t work_cond;
+	pthread_cond_t done_cond;
+
+	struct pixman_band *bands;
+	unsigned int n_bands;
+	unsigned int next_band;
+	unsigned int pending;
+	bool quit;
+};
+
 struct pixman_renderer {
 	struct weston_renderer base;
 
@@ -63,9 +122,15 @@ struct pixman_renderer {
 	pixman_image_t *debug_color;
 	struct weston_binding *debug_binding;
 
+	struct pixman_worker_pool workers;
+
 	struct wl_signal destroy_signal;
 };
 
+static const pixman_color_t debug_red = {
+	0x3fff, 0x0000, 0x0000, 0x3fff
+};
+
 static inline struct pixman_output_state *
 get_output_state(struct weston_output *output)
 {
@@ -321,36 +386,61 @@ composite_clipped(pixman_image_t *src,
 	}
 }
 
+/** Create a private reference to a surface image for use in one band
+ *
+ * The returned image shares pixel storage with the surface image but has
+ * its own transform, filter and repeat state.
+ */
+static pixman_image_t *
+surface_image_alias(struct pixman_surface_state *ps)
+{
+	if (ps->solid)
+		return pixman_image_create_solid_fill(&ps->solid_color);
+
+	return pixman_image_create_bits_no_clear(pixman_image_get_format(ps->image),
+						 pixman_image_get_width(ps->image),
+						 pixman_image_get_height(ps->image),
+						 pixman_image_get_data(ps->image),
+						 pixman_image_get_stride(ps->image));
+}
+
 /** Paint an intersected region
  *
  * \param ev The view to be painted.
- * \param output The output being painted.
+ * \param band The output band being painted.
  * \param repaint_output The region to be painted in output coordinates.
  * \param source_clip The region of the source image to use, in source image
  *                    coordinates. If NULL, use the whole source image.
  * \param pixman_op Compositing operator, either SRC or OVER.
  */
 static void
-repaint_region(struct weston_view *ev, struct weston_output *output,
+repaint_region(struct weston_view *ev, struct pixman_band *band,
 	       pixman_region32_t *repaint_output,
 	       pixman_region32_t *source_clip,
 	       pixman_op_t pixman_op)
 {
-	struct pixman_renderer *pr =
-		(struct pixman_renderer *) output->compositor->renderer;
+	struct weston_output *output = band->output;
 	struct pixman_surface_state *ps = get_surface_state(ev->surface);
-	struct pixman_output_state *po = get_output_state(output);
 	struct weston_buffer_viewport *vp = &ev->surface->buffer_viewport;
-	pixman_image_t *target_image;
+	pixman_image_t *target_image = band->target;
+	pixman_image_t *src_image;
 	pixman_transform_t transform;
 	pixman_filter_t filter;
 	pixman_image_t *mask_image;
 	pixman_color_t mask = { 0, };
 
-	if (po->shadow_image)
-		target_image = po->shadow_image;
-	else
-		target_image = po->hw_buffer;
+	if (band->private_images) {
+		pixman_region32_intersect_rect(repaint_output, repaint_output,
+					       band->box.x1, band->box.y1,
+					       band->box.x2 - band->box.x1,
+					       band->box.y2 - band->box.y1);
+		if (!pixman_region32_not_empty(repaint_output))
+			return;
+
+		src_image = surface_image_alias(ps);
+	} else {
+		src_image = pixman_image_ref(ps->image);
+	}
 
  	/* Clip rendering to the damaged output region */
 	pixman_image_set_clip_region32(target_image, repaint_output);
@@ -373,10 +463,10 @@ repaint_region(struct weston_view *ev, struct weston_output *output,
 	}
 
 	if (source_clip)
-		composite_clipped(ps->image, mask_image, target_image,
+		composite_clipped(src_image, mask_image, target_image,
 				  &transform, filter, source_clip);
 	else
-		composite_whole(pixman_op, ps->image, mask_image,
+		composite_whole(pixman_op, src_image, mask_image,
 				target_image, &transform, filter);
 
 	if (mask_image)
@@ -385,9 +475,9 @@ repaint_region(struct weston_view *ev, struct weston_output *output,
 	if (ps->buffer_ref.buffer)
 		wl_shm_buffer_end_access(ps->buffer_ref.buffer->shm_buffer);
 
-	if (pr->repaint_debug)
+	if (band->debug_color)
 		pixman_image_composite32(PIXMAN_OP_OVER,
-					 pr->debug_color, /* src */
+					 band->debug_color, /* src */
 					 NULL /* mask */,
 					 target_image, /* dest */
 					 0, 0, /* src_x, src_y */
@@ -397,12 +487,14 @@ repaint_region(struct weston_view *ev, struct weston_output *output,
 					 pixman_image_get_height (target_image) /* height */);
 
 	pixman_image_set_clip_region32(target_image, NULL);
+	pixman_image_unref(src_image);
 }
 
 static void
-draw_view_translated(struct weston_view *view, struct weston_output *output,
+draw_view_translated(struct weston_view *view, struct pixman_band *band,
 		     pixman_region32_t *repaint_global)
 {
+	struct weston_output *output = band->output;
 	struct weston_surface *surface = view->surface;
 	/* non-opaque region in surface coordinates: */
 	pixman_region32_t surface_blend;
@@ -428,7 +520,7 @@ draw_view_translated(struct weston_view *view, struct weston_output *output,
 							  view);
 			region_global_to_output(output, &repaint_output);
 
-			repaint_region(view, output, &repaint_output, NULL,
+			repaint_region(view, band, &repaint_output, NULL,
 				       PIXMAN_OP_SRC);
 		}
 	}
@@ -439,7 +531,7 @@ draw_view_translated(struct weston_view *view, struct weston_output *output,
 						  &surface_blend, view);
 		region_global_to_output(output, &repaint_output);
 
-		repaint_region(view, output, &repaint_output, NULL,
+		repaint_region(view, band, &repaint_output, NULL,
 			       PIXMAN_OP_OVER);
 	}
 
@@ -449,9 +541,10 @@ draw_view_translated(struct weston_view *view, struct weston_output *output,
 
 static void
 draw_view_source_clipped(struct weston_view *view,
-			 struct weston_output *output,
+			 struct pixman_band *band,
 			 pixman_region32_t *repaint_global)
 {
+	struct weston_output *output = band->output;
 	struct weston_surface *surface = view->surface;
 	pixman_region32_t surf_region;
 	pixman_region32_t buffer_region;
@@ -475,7 +568,7 @@ draw_view_source_clipped(struct weston_view *view,
 	pixman_region32_copy(&repaint_output, repaint_global);
 	region_global_to_output(output, &repaint_output);
 
-	repaint_region(view, output, &repaint_output, &buffer_region,
+	repaint_region(view, band, &repaint_output, &buffer_region,
 		       PIXMAN_OP_OVER);
 
 	pixman_region32_fini(&repaint_output);
@@ -483,9 +576,10 @@ draw_view_source_clipped(struct weston_view *view,
 	pixman_region32_fini(&surf_region);
 }
 
+/* 'clip' is the opaque region of the views above, in global coordinates */
 static void
-draw_view(struct weston_view *ev, struct weston_output *output,
-	  pixman_region32_t *damage) /* in global coordinates */
+draw_view(struct weston_view *ev, struct pixman_band *band,
+	  pixman_region32_t *clip)
 {
 	struct pixman_surface_state *ps = get_surface_state(ev->surface);
 	/* repaint bounding region in global coordinates: */
@@ -497,8 +591,8 @@ draw_view(struct weston_view *ev, struct weston_output *output,
 
 	pixman_region32_init(&repaint);
 	pixman_region32_intersect(&repaint,
-				  &ev->transform.boundingbox, damage);
-	pixman_region32_subtract(&repaint, &repaint, &ev->clip);
+				  &ev->transform.boundingbox, band->damage);
+	pixman_region32_subtract(&repaint, &repaint, clip);
 
 	if (!pixman_region32_not_empty(&repaint))
 		goto out;
@@ -511,7 +605,7 @@ draw_view(struct weston_view *ev, struct weston_output *output,
 		 * Also the boundingbox is accurate rather than an
 		 * approximation.
 		 */
-		draw_view_translated(ev, output, &repaint);
+		draw_view_translated(ev, band, &repaint);
 	} else {
 		/* The complex case: the view transformation does not allow
 		 * converting opaque etc. regions into global coordinate space.
@@ -520,21 +614,488 @@ draw_view(struct weston_view *ev, struct weston_output *output,
 		 * to be used whole. Source clipping does not work with
 		 * PIXMAN_OP_SRC.
 		 */
-		draw_view_source_clipped(ev, output, &repaint);
+		draw_view_source_clipped(ev, band, &repaint);
 	}
 
 out:
 	pixman_region32_fini(&repaint);
 }
+
+static struct pixman_layer_cache *
+layer_cache_for_view(struct weston_output *output, struct weston_view *view)
+{
+	struct pixman_output_state *po = get_output_state(output);
+	struct weston_layer *layer;
+	struct pixman_layer_cache *cache;
+
+	if (!weston_view_is_flattened(view))
+		return NULL;
+
+	layer = weston_view_get_layer(view);
+	wl_list_for_each(cache, &po->layer_caches, link)
+		if (cache->snapshot.layer == layer)
+			return cache->used && cache->valid ? cache : NULL;
+
+	return NULL;
+}
+
+static void
+composite_layer_cache(struct pixman_layer_cache *cache,
+		      pixman_format_code_t format, pixman_op_t op,
+		      struct pixman_band *band, pixman_region32_t *region)
+{
+	pixman_image_t *target_image = band->target;
+	pixman_image_t *src_image;
+
+	if (!pixman_region32_not_empty(region))
+		return;
+
+	src_image = pixman_image_create_bits_no_clear(format,
+					pixman_image_get_width(cache->image),
+					pixman_image_get_height(cache->image),
+					pixman_image_get_data(cache->image),
+					pixman_image_get_stride(cache->image));
+
+	pixman_image_set_clip_region32(target_image, region);
+	pixman_image_composite32(op, src_image, NULL, target_image,
+				 0, 0, 0, 0, 0, 0,
+				 pixman_image_get_width(target_image),
+				 pixman_image_get_height(target_image));
+
+	if (band->debug_color)
+		pixman_image_composite32(PIXMAN_OP_OVER, band->debug_color,
+					 NULL, target_image, 0, 0, 0, 0, 0, 0,
+					 pixman_image_get_width(target_image),
+					 pixman_image_get_height(target_image));
+
+	pixman_image_set_clip_region32(target_image, NULL);
+	pixman_image_unref(src_image);
+}
+
+/* The layer is drawn where its views are, minus what the opaque views
+ * above its topmost view cover. Its opaque parts are copied ignoring the
+ * alpha channel, which clients may leave undefined there. */
+static void
+draw_layer_cache(struct pixman_layer_cache *cache, struct pixman_band *band)
+{
+	struct weston_view *top = weston_layer_snapshot_top_view(&cache->snapshot);
+	pixman_region32_t repaint, opaque;
+
+	pixman_region32_init(&repaint);
+	pixman_region32_intersect(&repaint, &cache->snapshot.region,
+				  band->damage);
+	pixman_region32_subtract(&repaint, &repaint, &top->clip);
+
+	pixman_region32_init(&opaque);
+	pixman_region32_intersect(&opaque, &repaint, &cache->snapshot.opaque);
+	pixman_region32_subtract(&repaint, &repaint, &opaque);
+
+	region_global_to_output(band->output, &repaint);
+	region_global_to_output(band->output, &opaque);
+
+	if (band->private_images) {
+		pixman_region32_intersect_rect(&repaint, &repaint,
+					       band->box.x1, band->box.y1,
+					       band->box.x2 - band->box.x1,
+					       band->box.y2 - band->box.y1);
+		pixman_region32_intersect_rect(&opaque, &opaque,
+					       band->box.x1, band->box.y1,
+					       band->box.x2 - band->box.x1,
+					       band->box.y2 - band->box.y1);
+	}
+
+	composite_layer_cache(cache, PIXMAN_x8r8g8b8, PIXMAN_OP_SRC,
+			      band, &opaque);
+	composite_layer_cache(cache, PIXMAN_a8r8g8b8, PIXMAN_OP_OVER,
+			      band, &repaint);
+
+	pixman_region32_fini(&opaque);
+	pixman_region32_fini(&repaint);
+}
+
+static void
+repaint_band(struct pixman_band *band)
+{
+	struct weston_compositor *compositor = band->output->compositor;
+	struct pixman_layer_cache *cache, *last_cache = NULL;
+	struct weston_view *view;
+
+	wl_list_for_each_reverse(view, &compositor->view_list, link) {
+		if (view->plane != &compositor->primary_plane)
+			continue;
+
+		/* A flattened layer is drawn once, at its bottom view. */
+		cache = layer_cache_for_view(band->output, view);
+		if (cache && cache != last_cache)
+			draw_layer_cache(cache, band);
+		last_cache = cache;
+		if (cache)
+			continue;
+
+		draw_view(view, band, &view->clip);
+	}
+}
+
+static void
+pixman_layer_cache_destroy(struct pixman_layer_cache *cache)
+{
+	if (cache->image)
+		pixman_image_unref(cache->image);
+	weston_layer_snapshot_release(&cache->snapshot);
+	wl_list_remove(&cache->link);
+	free(cache);
+}
+
+static struct pixman_layer_cache *
+pixman_layer_cache_get(struct weston_output *output, struct weston_layer *layer)
+{
+	struct pixman_output_state *po = get_output_state(output);
+	struct pixman_layer_cache *cache;
+
+	wl_list_for_each(cache, &po->layer_caches, link)
+		if (cache->snapshot.layer == layer)
+			return cache;
+
+	cache = zalloc(sizeof *cache);
+	if (!cache)
+		return NULL;
+
+	weston_layer_snapshot_init(&cache->snapshot, layer);
+	wl_list_insert(&po->layer_caches, &cache->link);
+
+	return cache;
+}
+
+/* Composite the views of the layer, as recorded in the snapshot, over a
+ * transparent image. Each view is clipped by the opaque views of the
+ * layer above it only, so that the image stays usable whatever is
+ * stacked above the layer. */
+static bool
+pixman_layer_cache_render(struct pixman_layer_cache *cache,
+			  struct weston_output *output)
+{
+	struct weston_layer_snapshot *snapshot = &cache->snapshot;
+	struct weston_layer_snapshot_view *sv;
+	struct pixman_band band = {
+		.output = output,
+		.damage = &output->region,
+		.debug_color = NULL,
+		.private_images = false,
+	};
+	int i;
+
+	if (cache->image &&
+	    (pixman_image_get_width(cache->image) != snapshot->width ||
+	     pixman_image_get_height(cache->image) != snapshot->height)) {
+		pixman_image_unref(cache->image);
+		cache->image = NULL;
+	}
+
+	if (!cache->image) {
+		cache->image = pixman_image_create_bits(PIXMAN_a8r8g8b8,
+							snapshot->width,
+							snapshot->height,
+							NULL, 0);
+		if (!cache->image)
+			return false;
+	} else {
+		memset(pixman_image_get_data(cache->image), 0,
+		       pixman_image_get_stride(cache->image) *
+		       pixman_image_get_height(cache->image));
+	}
+
+	band.target = cache->image;
+	for (i = snapshot->views.size / sizeof *sv - 1; i >= 0; i--) {
+		sv = (struct weston_layer_snapshot_view *)
+			snapshot->views.data + i;
+		draw_view(sv->view, &band, &sv->clip);
+	}
+
+	return true;
+}
+
+/* Bring the caches of all flattened layers with views on the output up to
+ * date, and drop those of layers that are gone. */
+static void
+pixman_layer_caches_update(struct weston_output *output)
+{
+	struct weston_compositor *compositor = output->compositor;
+	struct pixman_output_state *po = get_output_state(output);
+	struct pixman_layer_cache *cache, *next;
+	struct weston_layer *layer, *last = NULL;
+	struct weston_view *view;
+
+	wl_list_for_each(cache, &po->layer_caches, link)
+		cache->used = false;
+
+	wl_list_for_each(view, &compositor->view_list, link) {
+		if (!weston_view_is_flattened(view) ||
+		    !(view->output_mask & (1u << output->id)))
+			continue;
+
+		/* Views of a layer are adjacent in the list. */
+		layer = weston_view_get_layer(view);
+		if (layer == last)
+			continue;
+		last = layer;
+
+		cache = pixman_layer_cache_get(output, layer);
+		if (!cache)
+			continue;
+
+		cache->used = true;
+		if (weston_layer_snapshot_update(&cache->snapshot, output) ||
+		    !cache->valid)
+			cache->valid = pixman_layer_cache_render(cache, output);
+	}
+
+	wl_list_for_each_safe(cache, next, &po->layer_caches, link)
+		if (!cache->used)
+			pixman_layer_cache_destroy(cache);
+}
+
+static void
+pixman_worker_pool_run_bands(struct pixman_worker_pool *pool)
+{
+	struct pixman_band *band;
+
+	while (pool->next_band < pool->n_bands) {
+		band = &pool->bands[pool->next_band++];
+
+		pthread_mutex_unlock(&pool->mutex);
+		repaint_band(band);
+		pthread_mutex_lock(&pool->mutex);
+
+		if (--pool->pending == 0)
+			pthread_cond_signal(&pool->done_cond);
+	}
+}
+
+static void *
+pixman_worker_thread(void *data)
+{
+	struct pixman_worker_pool *pool = data;
+
+	pthread_mutex_lock(&pool->mutex);
+	while (!pool->quit) {
+		if (pool->next_band < pool->n_bands)
+			pixman_worker_pool_run_bands(pool);
+		else
+			pthread_cond_wait(&pool->work_cond, &pool->mutex);
+	}
+	pthread_mutex_unlock(&pool->mutex);
+
+	return NULL;
+}
+
+static void
+pixman_worker_pool_dispatch(struct pixman_worker_pool *pool,
+			    struct pixman_band *bands, unsigned int n_bands)
+{
+	pthread_mutex_lock(&pool->mutex);
+
+	pool->bands = bands;
+	pool->n_bands = n_bands;
+	pool->next_band = 0;
+	pool->pending = n_bands;
+	pthread_cond_broadcast(&pool->work_cond);
+
+	/* The compositor thread takes its share of bands too. */
+	pixman_worker_pool_run_bands(pool);
+
+	while (pool->pending > 0)
+		pthread_cond_wait(&pool->done_cond, &pool->mutex);
+
+	pool->bands = NULL;
+	pool->n_bands = 0;
+	pool->next_band = 0;
+
+	pthread_mutex_unlock(&pool->mutex);
+}
+
+static int
+pixman_worker_pool_grow(struct pixman_worker_pool *pool,
+			unsigned int n_threads)
+{
+	pthread_t *threads;
+	sigset_t blocked, saved;
+	int ret = 0;
+
+	if (pool->n_threads >= n_threads)
+		return 0;
+
+	threads = realloc(pool->threads, n_threads * sizeof *threads);
+	if (!threads)
+		return -1;
+	pool->threads = threads;
+
+	if (pool->n_threads == 0) {
+		pthread_mutex_init(&pool->mutex, NULL);
+		pthread_cond_init(&pool->work_cond, NULL);
+		pthread_cond_init(&pool->done_cond, NULL);
+	}
+
+	/* Workers must not steal the compositor's signals, but faults in
+	 * client SHM pools have to reach the libwayland SIGBUS handler. */
+	sigfillset(&blocked);
+	sigdelset(&blocked, SIGBUS);
+	sigdelset(&blocked, SIGSEGV);
+	sigdelset(&blocked, SIGFPE);
+	sigdelset(&blocked, SIGILL);
+	pthread_sigmask(SIG_BLOCK, &blocked, &saved);
+
+	while (pool->n_threads < n_threads) {
+		if (pthread_create(&pool->threads[pool->n_threads], NULL,
+				   pixman_worker_thread, pool) != 0) {
+			ret = -1;
+			break;
+		}
+		pool->n_threads++;
+	}
+
+	pthread_sigmask(SIG_SETMASK, &saved, NULL);
+
+	return ret;
+}
+
+static void
+pixman_worker_pool_release(struct pixman_worker_pool *pool)
+{
+	unsigned int i;
+
+	if (pool->n_threads == 0)
+		return;
+
+	pthread_mutex_lock(&pool->mutex);
+	pool->quit = true;
+	pthread_cond_broadcast(&pool->work_cond);
+	pthread_mutex_unlock(&pool->mutex);
+
+	for (i = 0; i < pool->n_threads; i++)
+		pthread_join(pool->threads[i], NULL);
+
+	pthread_cond_destroy(&pool->done_cond);
+	pthread_cond_destroy(&pool->work_cond);
+	pthread_mutex_destroy(&pool->mutex);
+	free(pool->threads);
+	pool->threads = NULL;
+	pool->n_threads = 0;
+}
+
+static pixman_image_t *
+output_target_image(struct pixman_output_state *po)
+{
+	if (po->shadow_image)
+		return po->shadow_image;
+	else
+		return po->hw_buffer;
+}
+
 static void
 repaint_surfaces(struct weston_output *output, pixman_region32_t *damage)
+{
+	struct pixman_renderer *pr = get_renderer(output->compositor);
+	struct pixman_output_state *po = get_output_state(output);
+	struct pixman_band band = {
+		.output = output,
+		.damage = damage,
+		.target = output_target_image(po),
+		.debug_color = pr->repaint_debug ? pr->debug_color : NULL,
+		.private_images = false,
+	};
+
+	repaint_band(&band);
+}
+
+/** Repaint the damage split into horizontal bands on the worker pool
+ *
+ * The bands evenly divide the vertical extents of the damage in output
+ * buffer coordinates, so that partial repaints are spread over all
+ * threads as well.
+ */
+static void
+repaint_surfaces_banded(struct weston_output *output,
+			pixman_region32_t *damage)
 {
 	struct weston_compositor *compositor = output->compositor;
+	struct pixman_renderer *pr = get_renderer(compositor);
+	struct pixman_output_state *po = get_output_state(output);
+	pixman_image_t *target = output_target_image(po);
+	struct pixman_band *bands = po->bands;
+	pixman_region32_t output_damage;
+	pixman_box32_t *extents;
 	struct weston_view *view;
+	unsigned int n_bands = 0;
+	int32_t band_height;
+	int32_t y;
+	unsigned int i;
+
+	pixman_region32_init(&output_damage);
+	pixman_region32_copy(&output_damage, damage);
+	region_global_to_output(output, &output_damage);
+	extents = pixman_region32_extents(&output_damage);
+
+	band_height = (extents->y2 - extents->y1 + po->n_bands - 1) /
+		      po->n_bands;
+	if (band_height <= 0)
+		goto out;
 
-	wl_list_for_each_reverse(view, &compositor->view_list, link)
+	/* Surface state is created lazily; do it here rather than racing
+	 * on it from the workers. */
+	wl_list_for_each(view, &compositor->view_list, link)
 		if (view->plane == &compositor->primary_plane)
-			draw_view(view, output, damage);
+			get_surface_state(view->surface);
+
+	for (y = extents->y1; y < extents->y2; y += band_height) {
+		struct pixman_band *band = &bands[n_bands];
+
+		band->output = output;
+		band->damage = damage;
+		band->box.x1 = extents->x1;
+		band->box.x2 = extents->x2;
+		band->box.y1 = y;
+		band->box.y2 = MIN(y + band_height, extents->y2);
+		if (pixman_region32_contains_rectangle(&output_damage,
+						       &band->box) ==
+		    PIXMAN_REGION_OUT)
+			continue;
+
+		band->target =
+			pixman_image_create_bits_no_clear(pixman_image_get_format(target),
+							  pixman_image_get_width(target),
+							  pixman_image_get_height(target),
+							  pixman_image_get_data(target),
+							  pixman_image_get_stride(target));
+		band->debug_color = pr->repaint_debug ?
+			pixman_image_create_solid_fill(&debug_red) : NULL;
+		band->private_images = true;
+		n_bands++;
+	}
+
+	pixman_worker_pool_dispatch(&pr->workers, bands, n_bands);
+
+	for (i = 0; i < n_bands; i++) {
+		pixman_image_unref(bands[i].target);
+		if (bands[i].debug_color)
+			pixman_image_unref(bands[i].debug_color);
+	}
+
+out:
+	pixman_region32_fini(&output_damage);
+}
+
+static void
+pixman_renderer_repaint_surfaces(struct weston_output *output,
+				 pixman_region32_t *damage)
+{
+	struct pixman_output_state *po = get_output_state(output);
+
+	pixman_layer_caches_update(output);
+
+	if (po->n_bands > 1)
+		repaint_surfaces_banded(output, damage);
+	else
+		repaint_surfaces(output, damage);
 }
 
 static void
@@ -586,10 +1147,10 @@ pixman_renderer_repaint_output(struct weston_output *output,
 	}
 
 	if (po->shadow_image) {
-		repaint_surfaces(output, output_damage);
+		pixman_renderer_repaint_surfaces(output, output_damage);
 		copy_to_hw_buffer(output, &hw_damage);
 	} else {
-		repaint_surfaces(output, &hw_damage);
+		pixman_renderer_repaint_surfaces(output, &hw_damage);
 	}
 	pixman_region32_fini(&hw_damage);
 
@@ -640,6 +1201,7 @@ pixman_renderer_attach(struct weston_surface *es, struct weston_buffer *buffer)
 		pixman_image_unref(ps->image);
 		ps->image = NULL;
 	}
+	ps->solid = false;
 
 	if (!buffer)
 		return;
@@ -780,6 +1342,8 @@ pixman_renderer_surface_set_color(struct weston_surface *es,
 	}
 
 	ps->image = pixman_image_create_solid_fill(&color);
+	ps->solid = true;
+	ps->solid_color = color;
 }
 
 static void
@@ -789,6 +1353,7 @@ pixman_renderer_destroy(struct weston_compositor *ec)
 
 	wl_signal_emit(&pr->destroy_signal, pr);
 	weston_binding_destroy(pr->debug_binding);
+	pixman_worker_pool_release(&pr->workers);
 	free(pr);
 
 	ec->renderer = NULL;
@@ -851,11 +1416,7 @@ debug_binding(struct weston_keyboard *keyboard, const struct timespec *time,
 	pr->repaint_debug ^= 1;
 
 	if (pr->repaint_debug) {
-		pixman_color_t red = {
-			0x3fff, 0x0000, 0x0000, 0x3fff
-		};
-
-		pr->debug_color = pixman_image_create_solid_fill(&red);
+		pr->debug_color = pixman_image_create_solid_fill(&debug_red);
 	} else {
 		pixman_image_unref(pr->debug_color);
 		weston_compositor_damage_all(ec);
@@ -957,6 +1518,24 @@ pixman_renderer_output_create(struct weston_output *output,
 		}
 	}
 
+	wl_list_init(&po->layer_caches);
+
+	po->n_bands = 1;
+	if (options->render_threads > 1) {
+		struct pixman_renderer *pr = get_renderer(output->compositor);
+
+		/* The compositor thread renders one of the bands itself. */
+		po->bands = zalloc(options->render_threads * sizeof *po->bands);
+		if (po->bands &&
+		    pixman_worker_pool_grow(&pr->workers,
+					    options->render_threads - 1) == 0)
+			po->n_bands = options->render_threads;
+		else
+			weston_log("Pixman-renderer: failed to start render "
+				   "threads, output %s renders single-threaded\n",
+				   output->name);
+	}
+
 	output->renderer_state = po;
 
 	return 0;
@@ -966,6 +1545,10 @@ WL_EXPORT void
 pixman_renderer_output_destroy(struct weston_output *output)
 {
 	struct pixman_output_state *po = get_output_state(output);
+	struct pixman_layer_cache *cache, *next;
+
+	wl_list_for_each_safe(cache, next, &po->layer_caches, link)
+		pixman_layer_cache_destroy(cache);
 
 	if (po->shadow_image)
 		pixman_image_unref(po->shadow_image);
@@ -974,6 +1557,7 @@ pixman_renderer_output_destroy(struct weston_output *output)
 		pixman_image_unref(po->hw_buffer);
 
 	free(po->shadow_buffer);
+	free(po->bands);
 
 	po->shadow_buffer = NULL;
 	po->shadow_image = NULL;
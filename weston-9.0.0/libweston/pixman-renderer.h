@@ -35,6 +35,9 @@ pixman_renderer_init(struct weston_compositor *ec);
 struct pixman_renderer_output_options {
 	/** Composite into a shadow buffer, copying to the hardware buffer */
 	bool use_shadow;
+	/** Split repaints into this many horizontal bands composited in
+	 * parallel; 0 or 1 repaints on the compositor thread only */
+	unsigned int render_threads;
 };
 
 int
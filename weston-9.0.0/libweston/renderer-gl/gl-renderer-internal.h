@@ -30,6 +30,9 @@
 #include <GLES2/gl2ext.h>
 #include "shared/weston-egl-ext.h"  /* for PFN* stuff */
 
+#define GR_GL_VERSION(major, minor) \
+	(((uint32_t)(major) << 16) | (uint32_t)(minor))
+
 struct gl_shader {
 	GLuint program;
 	GLuint vertex_shader, fragment_shader;
@@ -40,6 +43,160 @@ struct gl_shader {
 	const char *vertex_source, *fragment_source;
 };
 
+/** The GL state a region of a view is drawn with
+ *
+ * Consecutive regions drawn with equal state are merged into one draw call
+ * when batching is enabled.
+ */
+struct gl_draw_state {
+	struct gl_shader *shader;
+	GLenum target;
+	GLuint textures[3];
+	int num_textures;
+	GLint filter;
+	GLfloat color[4];
+	GLfloat alpha;
+	bool blend;
+};
+
+/** A range of the index buffer drawn with a single glDrawElements() */
+struct gl_batch_draw {
+	GLuint first_vertex;
+	GLuint first_index;
+	GLsizei count;
+};
+
+/** A buffer object written front to back, orphaned when full */
+struct gl_stream_buffer {
+	GLuint name;
+	GLsizeiptr size;
+	GLintptr offset;
+};
+
+struct gl_draw_stats {
+	uint32_t draws;
+	uint32_t vertices;
+	uint32_t triangles;
+	uint32_t regions;
+	/* wl_shm texture uploads, accounted to the next output repaint */
+	uint64_t upload_bytes;
+
+	/* Occlusion culling: views on the primary plane touching the
+	 * damage, those entirely covered by opaque views, and the damaged
+	 * area against the area of views drawn on it, without and with the
+	 * covered parts taken away. */
+	uint32_t views;
+	uint32_t culled;
+	uint64_t damage_area;
+	uint64_t covered_area;
+	uint64_t drawn_area;
+
+	/* Flattened layers: views drawn from a layer cache, and caches
+	 * composited again. */
+	uint32_t cached_views;
+	uint32_t layer_cache_renders;
+};
+
+/** A view being drawn by repaint_views() */
+struct gl_view_draw {
+	struct weston_view *view;
+	/* if set, draws the layer cache instead of the view */
+	struct gl_layer_cache *cache;
+	struct gl_draw_state state;
+	struct gl_shader *replaced_shader;
+	/* in global coordinates: */
+	pixman_region32_t repaint;
+	/* in surface coordinates: */
+	pixman_region32_t surface_opaque;
+	pixman_region32_t surface_blend;
+};
+
+/** On-disk cache of linked program binaries, see program-cache.c */
+struct gl_program_cache {
+	char *dir;
+	uint64_t driver_hash;
+	PFNGLGETPROGRAMBINARYOESPROC get_program_binary;
+	PFNGLPROGRAMBINARYOESPROC program_binary;
+
+	uint32_t hits;
+	uint32_t misses;
+	uint32_t stored;
+};
+
+/** What a GPU timer query measured */
+enum gl_gpu_timing_kind {
+	GL_GPU_TIMING_VIEW,
+	GL_GPU_TIMING_LAYER_CACHE,
+	GL_GPU_TIMING_BORDERS,
+};
+
+struct gl_gpu_time {
+	uint64_t frames;
+	uint64_t total_nsec;
+	uint64_t max_nsec;
+};
+
+/** GPU time spent drawing the views of one surface
+ *
+ * Owned by the surface state and by the queries still in flight for it,
+ * so that results arriving after the surface is gone can be dropped.
+ */
+struct gl_gpu_timing_surface {
+	struct wl_list link; /* gl_gpu_timing::surfaces */
+	int refcount;
+	struct weston_surface *surface; /* NULL once destroyed */
+	struct gl_gpu_time time;
+
+	/* while reading the results of a frame */
+	uint32_t frame_serial;
+	uint64_t frame_nsec;
+	bool frame_counted;
+};
+
+struct gl_gpu_timing_sample {
+	GLuint query;
+	enum gl_gpu_timing_kind kind;
+	struct gl_gpu_timing_surface *surface; /* GL_GPU_TIMING_VIEW only */
+};
+
+/* Frames whose results are read back later, so that reading never stalls. */
+#define GL_GPU_TIMING_FRAMES 4
+
+struct gl_gpu_timing_output {
+	/* struct gl_gpu_timing_sample, a ring of frames in flight */
+	struct wl_array frames[GL_GPU_TIMING_FRAMES];
+	int head, count;
+	struct wl_array *recording;
+	bool query_active;
+	/* begin calls made while a query was active, see
+	 * gl_gpu_timing_begin() */
+	int nested;
+
+	struct gl_gpu_time total;
+	struct gl_gpu_time views;
+	struct gl_gpu_time layer_caches;
+	struct gl_gpu_time borders;
+	/* frames not measured: ring full or GPU disjoint */
+	uint64_t skipped, disjoint;
+};
+
+/** GL_EXT_disjoint_timer_query instrumentation, active while its debug
+ * scope has subscribers */
+struct gl_gpu_timing {
+	bool supported;
+	PFNGLGENQUERIESEXTPROC gen_queries;
+	PFNGLDELETEQUERIESEXTPROC delete_queries;
+	PFNGLBEGINQUERYEXTPROC begin_query;
+	PFNGLENDQUERYEXTPROC end_query;
+	PFNGLGETQUERYOBJECTUIVEXTPROC get_query_objectuiv;
+	PFNGLGETQUERYOBJECTUI64VEXTPROC get_query_objectui64v;
+
+	struct wl_array free_queries; /* GLuint */
+	struct wl_list surfaces; /* gl_gpu_timing_surface::link */
+	uint32_t frame_serial;
+	struct weston_log_scope *scope;
+};
+
 struct gl_renderer {
 	struct weston_renderer base;
 	bool fragment_shader_debug;
@@ -58,6 +215,24 @@ struct gl_renderer {
 
 	struct wl_array vertices;
 	struct wl_array vtxcnt;
+	/* texture_region() input and output of the polygon clipper */
+	struct wl_array clip_scratch;
+
+	/* Batched draw submission: the pending batch is made of the
+	 * vertices above, indexed triangles and the draw ranges, all
+	 * sharing batch_state. */
+	bool batching;
+	struct wl_array indices;
+	struct wl_array batch_draws;
+	struct gl_draw_state batch_state;
+	struct gl_stream_buffer vertex_buffer;
+	struct gl_stream_buffer index_buffer;
+
+	struct gl_draw_stats draw_stats;
+	/* struct gl_view_draw, reused across repaints */
+	struct wl_array view_draws;
+	struct weston_log_scope *draw_scope;
+	struct gl_gpu_timing gpu_timing;
 
 	PFNGLEGLIMAGETARGETTEXTURE2DOESPROC image_target_texture_2d;
 	PFNEGLCREATEIMAGEKHRPROC create_image;
@@ -70,6 +245,12 @@ struct gl_renderer {
 
 	bool has_unpack_subimage;
 
+	/* Asynchronous wl_shm uploads through pixel buffer objects */
+	bool has_pbo;
+	PFNGLMAPBUFFERRANGEEXTPROC map_buffer_range;
+	PFNGLUNMAPBUFFEROESPROC unmap_buffer;
+	struct gl_stream_buffer upload_buffer;
+
 	PFNEGLBINDWAYLANDDISPLAYWL bind_display;
 	PFNEGLUNBINDWAYLANDDISPLAYWL unbind_display;
 	PFNEGLQUERYWAYLANDBUFFERWL query_buffer;
@@ -104,6 +285,11 @@ struct gl_renderer {
 	struct gl_shader solid_shader;
 	struct gl_shader *current_shader;
 
+	struct gl_program_cache *program_cache;
+	/* Time spent building programs, reported after the first frame */
+	int64_t program_build_nsec;
+	bool program_build_reported;
+
 	struct wl_signal destroy_signal;
 
 	struct wl_listener output_destroy_listener;
@@ -151,4 +337,68 @@ gl_renderer_setup_egl_client_extensions(struct gl_renderer *gr);
 int
 gl_renderer_setup_egl_extensions(struct weston_compositor *ec);
 
+struct gl_program_cache *
+gl_program_cache_create(const char *extensions, uint32_t gl_version);
+
+void
+gl_program_cache_destroy(struct gl_program_cache *cache);
+
+uint64_t
+gl_program_cache_key(struct gl_program_cache *cache,
+		     const char *vertex_source,
+		     const char **fragment_sources, int count);
+
+bool
+gl_program_cache_load(struct gl_program_cache *cache, uint64_t key,
+		      GLuint program);
+
+void
+gl_program_cache_store(struct gl_program_cache *cache, uint64_t key,
+		       GLuint program);
+
+void
+gl_gpu_timing_init(struct gl_gpu_timing *timing, const char *extensions);
+
+void
+gl_gpu_timing_fini(struct gl_gpu_timing *timing);
+
+void
+gl_gpu_timing_output_init(struct gl_gpu_timing_output *out);
+
+void
+gl_gpu_timing_output_fini(struct gl_gpu_timing *timing,
+			  struct gl_gpu_timing_output *out);
+
+void
+gl_gpu_timing_begin_frame(struct gl_gpu_timing *timing,
+			  struct gl_gpu_timing_output *out,
+			  const char *output_name);
+
+void
+gl_gpu_timing_end_frame(struct gl_gpu_timing *timing,
+			struct gl_gpu_timing_output *out);
+
+void
+gl_gpu_timing_begin(struct gl_gpu_timing *timing,
+		    struct gl_gpu_timing_output *out,
+		    enum gl_gpu_timing_kind kind,
+		    struct gl_gpu_timing_surface **surface_timing,
+		    struct weston_surface *surface);
+
+void
+gl_gpu_timing_end(struct gl_gpu_timing *timing,
+		  struct gl_gpu_timing_output *out);
+
+void
+gl_gpu_timing_surface_release(struct gl_gpu_timing_surface *surface_timing);
+
+void
+gl_gpu_timing_print_output(struct weston_log_subscription *sub,
+			   const char *output_name,
+			   const struct gl_gpu_timing_output *out);
+
+void
+gl_gpu_timing_print_surfaces(struct gl_gpu_timing *timing,
+			     struct weston_log_subscription *sub);
+
 #endif /* GL_RENDERER_INTERNAL_H */
@@ -32,6 +32,7 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <inttypes.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
@@ -41,6 +42,8 @@
 #include <drm_fourcc.h>
 #include <unistd.h>
 
+#include <libweston/weston-log.h>
+#include "layer-cache.h"
 #include "linux-sync-file.h"
 #include "timeline.h"
 
@@ -58,14 +61,14 @@
 #include "shared/timespec-util.h"
 #include "shared/weston-egl-ext.h"
 
-#define GR_GL_VERSION(major, minor) \
-	(((uint32_t)(major) << 16) | (uint32_t)(minor))
-
 #define GR_GL_VERSION_INVALID \
 	GR_GL_VERSION(0, 0)
 
 #define BUFFER_DAMAGE_COUNT 2
 
+/* Initial size of the streaming vertex and index buffers */
+#define STREAM_BUFFER_MIN_SIZE (256 * 1024)
+
 enum gl_border_status {
 	BORDER_STATUS_CLEAN = 0,
 	BORDER_TOP_DIRTY = 1 << GL_RENDERER_BORDER_TOP,
@@ -97,6 +100,27 @@ struct gl_output_state {
 
 	/* struct timeline_render_point::link */
 	struct wl_list timeline_render_point_list;
+
+	/* of the last repaint, for the fragment debug binding */
+	struct gl_draw_stats last_stats;
+
+	/* struct gl_layer_cache::link */
+	struct wl_list layer_caches;
+
+	struct gl_gpu_timing_output gpu_timing;
+};
+
+/** A flattened layer composited into a texture the size of an output */
+struct gl_layer_cache {
+	struct wl_list link;
+	struct weston_layer_snapshot snapshot;
+	GLuint texture;
+	GLuint fbo;
+	int32_t width, height;
+	/* the texture matches the snapshot */
+	bool valid;
+	/* the layer has views to draw in this repaint */
+	bool used;
 };
 
 enum buffer_type {
@@ -200,6 +224,9 @@ struct gl_surface_state {
 	   Used only in the context of a gl_renderer_repaint_output call. */
 	bool used_in_output_repaint;
 
+	/* created when first measured by the gl-gpu-timing scope */
+	struct gl_gpu_timing_surface *gpu_timing;
+
 	struct wl_listener surface_destroy_listener;
 	struct wl_listener renderer_destroy_listener;
 };
@@ -401,81 +428,6 @@ dmabuf_image_destroy(struct dmabuf_image *image)
 	free(image);
 }
 
-#define max(a, b) (((a) > (b)) ? (a) : (b))
-#define min(a, b) (((a) > (b)) ? (b) : (a))
-
-/*
- * Compute the boundary vertices of the intersection of the global coordinate
- * aligned rectangle 'rect', and an arbitrary quadrilateral produced from
- * 'surf_rect' when transformed from surface coordinates into global coordinates.
- * The vertices are written to 'ex' and 'ey', and the return value is the
- * number of vertices. Vertices are produced in clockwise winding order.
- * Guarantees to produce either zero vertices, or 3-8 vertices with non-zero
- * polygon area.
- */
-static int
-calculate_edges(struct weston_view *ev, pixman_box32_t *rect,
-		pixman_box32_t *surf_rect, GLfloat *ex, GLfloat *ey)
-{
-
-	struct clip_context ctx;
-	int i, n;
-	GLfloat min_x, max_x, min_y, max_y;
-	struct polygon8 surf = {
-		{ surf_rect->x1, surf_rect->x2, surf_rect->x2, surf_rect->x1 },
-		{ surf_rect->y1, surf_rect->y1, surf_rect->y2, surf_rect->y2 },
-		4
-	};
-
-	ctx.clip.x1 = rect->x1;
-	ctx.clip.y1 = rect->y1;
-	ctx.clip.x2 = rect->x2;
-	ctx.clip.y2 = rect->y2;
-
-	/* transform surface to screen space: */
-	for (i = 0; i < surf.n; i++)
-		weston_view_to_global_float(ev, surf.x[i], surf.y[i],
-					    &surf.x[i], &surf.y[i]);
-
-	/* find bounding box: */
-	min_x = max_x = surf.x[0];
-	min_y = max_y = surf.y[0];
-
-	for (i = 1; i < surf.n; i++) {
-		min_x = min(min_x, surf.x[i]);
-		max_x = max(max_x, surf.x[i]);
-		min_y = min(min_y, surf.y[i]);
-		max_y = max(max_y, surf.y[i]);
-	}
-
-	/* First, simple bounding box check to discard early transformed
-	 * surface rects that do not intersect with the clip region:
-	 */
-	if ((min_x >= ctx.clip.x2) || (max_x <= ctx.clip.x1) ||
-	    (min_y >= ctx.clip.y2) || (max_y <= ctx.clip.y1))
-		return 0;
-
-	/* Simple case, bounding box edges are parallel to surface edges,
-	 * there will be only four edges.  We just need to clip the surface
-	 * vertices to the clip rect bounds:
-	 */
-	if (!ev->transform.enabled)
-		return clip_simple(&ctx, &surf, ex, ey);
-
-	/* Transformed case: use a general polygon clipping algorithm to
-	 * clip the surface rectangle with each side of 'rect'.
-	 * The algorithm is Sutherland-Hodgman, as explained in
-	 * http://www.codeguru.com/cpp/misc/misc/graphics/article.php/c8965/Polygon-Clipping.htm
-	 * but without looking at any of that code.
-	 */
-	n = clip_transformed(&ctx, &surf, ex, ey);
-
-	if (n < 3)
-		return 0;
-
-	return n;
-}
-
 static bool
 merge_down(pixman_box32_t *a, pixman_box32_t *b, pixman_box32_t *merge)
 {
@@ -525,6 +477,13 @@ compress_bands(pixman_box32_t *inrects, int nrects,
 	return nout;
 }
 
+/*
+ * Compute the boundary vertices of the intersections of the global coordinate
+ * aligned rectangles of 'region', and the arbitrary quadrilaterals produced
+ * from the rectangles of 'surf_region' when transformed from surface
+ * coordinates into global coordinates, and emit them with their texture
+ * coordinates as triangle fans.
+ */
 static int
 texture_region(struct weston_view *ev, pixman_region32_t *region,
 		pixman_region32_t *surf_region)
@@ -536,8 +495,12 @@ texture_region(struct weston_view *ev, pixman_region32_t *region,
 	unsigned int *vtxcnt, nvtx = 0;
 	pixman_box32_t *rects, *surf_rects;
 	pixman_box32_t *raw_rects;
-	int i, j, k, nrects, nsurf, raw_nrects;
-	bool used_band_compression;
+	struct polygon8 *surf;
+	struct clip_box *boxes;
+	GLfloat *ex, *ey;	/* edge points in screen space */
+	int *counts;
+	int i, j, k, nrects, nsurf, raw_nrects, npolygons;
+	bool used_band_compression, transformed;
 	raw_rects = pixman_region32_rectangles(region, &raw_nrects);
 	surf_rects = pixman_region32_rectangles(surf_region, &nsurf);
 
@@ -555,56 +518,98 @@ texture_region(struct weston_view *ev, pixman_region32_t *region,
 	v = wl_array_add(&gr->vertices, nrects * nsurf * 8 * 4 * sizeof *v);
 	vtxcnt = wl_array_add(&gr->vtxcnt, nrects * nsurf * sizeof *vtxcnt);
 
+	gr->clip_scratch.size = 0;
+	surf = wl_array_add(&gr->clip_scratch,
+			    nsurf * sizeof *surf +
+			    nrects * sizeof *boxes +
+			    nrects * nsurf * (16 * sizeof *ex +
+					      sizeof *counts));
+	boxes = (struct clip_box *)(surf + nsurf);
+	ex = (GLfloat *)(boxes + nrects);
+	ey = ex + nrects * nsurf * 8;
+	counts = (int *)(ey + nrects * nsurf * 8);
+
 	inv_width = 1.0 / gs->pitch;
         inv_height = 1.0 / gs->height;
 
+	/* transform the surface rects to screen space once: */
+	for (j = 0; j < nsurf; j++) {
+		pixman_box32_t *surf_rect = &surf_rects[j];
+
+		surf[j] = (struct polygon8) {
+			{ surf_rect->x1, surf_rect->x2,
+			  surf_rect->x2, surf_rect->x1 },
+			{ surf_rect->y1, surf_rect->y1,
+			  surf_rect->y2, surf_rect->y2 },
+			4
+		};
+		for (k = 0; k < surf[j].n; k++)
+			weston_view_to_global_float(ev,
+						    surf[j].x[k], surf[j].y[k],
+						    &surf[j].x[k],
+						    &surf[j].y[k]);
+	}
+
 	for (i = 0; i < nrects; i++) {
-		pixman_box32_t *rect = &rects[i];
-		for (j = 0; j < nsurf; j++) {
-			pixman_box32_t *surf_rect = &surf_rects[j];
+		boxes[i].x1 = rects[i].x1;
+		boxes[i].y1 = rects[i].y1;
+		boxes[i].x2 = rects[i].x2;
+		boxes[i].y2 = rects[i].y2;
+	}
+
+	/* Translated and scaled surface rects stay axis-aligned. */
+	transformed = ev->transform.enabled &&
+		      (ev->transform.matrix.type &
+		       ~(WESTON_MATRIX_TRANSFORM_TRANSLATE |
+			 WESTON_MATRIX_TRANSFORM_SCALE));
+
+	/* The transformed surface, after clipping to the clip region,
+	 * can have as many as eight sides, emitted as a triangle-fan.
+	 * The first vertex in the triangle fan can be chosen arbitrarily,
+	 * since the area is guaranteed to be convex.
+	 *
+	 * If a corner of the transformed surface falls outside of the
+	 * clip region, instead of emitting one vertex for the corner
+	 * of the surface, up to two are emitted for two corresponding
+	 * intersection point(s) between the surface and the clip region.
+	 *
+	 * Simple case, bounding box edges are parallel to surface edges,
+	 * there will be only four edges and the surface vertices only
+	 * need clamping to the clip rect bounds. Otherwise a general
+	 * polygon clipping algorithm clips the surface rectangle with each
+	 * side of the rect. The algorithm is Sutherland-Hodgman, as
+	 * explained in
+	 * http://www.codeguru.com/cpp/misc/misc/graphics/article.php/c8965/Polygon-Clipping.htm
+	 * but without looking at any of that code.
+	 */
+	npolygons = clip_polygons_to_boxes(surf, nsurf, boxes, nrects,
+					   transformed, ex, ey, counts);
+
+	for (i = 0; i < npolygons; i++) {
+		/* emit edge points: */
+		for (k = 0; k < counts[i]; k++) {
 			GLfloat sx, sy, bx, by;
-			GLfloat ex[8], ey[8];          /* edge points in screen space */
-			int n;
-
-			/* The transformed surface, after clipping to the clip region,
-			 * can have as many as eight sides, emitted as a triangle-fan.
-			 * The first vertex in the triangle fan can be chosen arbitrarily,
-			 * since the area is guaranteed to be convex.
-			 *
-			 * If a corner of the transformed surface falls outside of the
-			 * clip region, instead of emitting one vertex for the corner
-			 * of the surface, up to two are emitted for two corresponding
-			 * intersection point(s) between the surface and the clip region.
-			 *
-			 * To do this, we first calculate the (up to eight) points that
-			 * form the intersection of the clip rect and the transformed
-			 * surface.
-			 */
-			n = calculate_edges(ev, rect, surf_rect, ex, ey);
-			if (n < 3)
-				continue;
 
-			/* emit edge points: */
-			for (k = 0; k < n; k++) {
-				weston_view_from_global_float(ev, ex[k], ey[k],
-							      &sx, &sy);
-				/* position: */
-				*(v++) = ex[k];
-				*(v++) = ey[k];
-				/* texcoord: */
-				weston_surface_to_buffer_float(ev->surface,
-							       sx, sy,
-							       &bx, &by);
-				*(v++) = bx * inv_width;
-				if (gs->y_inverted) {
-					*(v++) = by * inv_height;
-				} else {
-					*(v++) = (gs->height - by) * inv_height;
-				}
+			weston_view_from_global_float(ev, ex[k], ey[k],
+						      &sx, &sy);
+			/* position: */
+			*(v++) = ex[k];
+			*(v++) = ey[k];
+			/* texcoord: */
+			weston_surface_to_buffer_float(ev->surface,
+						       sx, sy,
+						       &bx, &by);
+			*(v++) = bx * inv_width;
+			if (gs->y_inverted) {
+				*(v++) = by * inv_height;
+			} else {
+				*(v++) = (gs->height - by) * inv_height;
 			}
-
-			vtxcnt[nvtx++] = n;
 		}
+
+		ex += counts[i];
+		ey += counts[i];
+		vtxcnt[nvtx++] = counts[i];
 	}
 
 	if (used_band_compression)
@@ -652,51 +657,6 @@ triangle_fan_debug(struct weston_view *view, int first, int count)
 	free(buffer);
 }
 
-static void
-repaint_region(struct weston_view *ev, pixman_region32_t *region,
-		pixman_region32_t *surf_region)
-{
-	struct weston_compositor *ec = ev->surface->compositor;
-	struct gl_renderer *gr = get_renderer(ec);
-	GLfloat *v;
-	unsigned int *vtxcnt;
-	int i, first, nfans;
-
-	/* The final region to be painted is the intersection of
-	 * 'region' and 'surf_region'. However, 'region' is in the global
-	 * coordinates, and 'surf_region' is in the surface-local
-	 * coordinates. texture_region() will iterate over all pairs of
-	 * rectangles from both regions, compute the intersection
-	 * polygon for each pair, and store it as a triangle fan if
-	 * it has a non-zero area (at least 3 vertices, actually).
-	 */
-	nfans = texture_region(ev, region, surf_region);
-
-	v = gr->vertices.data;
-	vtxcnt = gr->vtxcnt.data;
-
-	/* position: */
-	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof *v, &v[0]);
-	glEnableVertexAttribArray(0);
-
-	/* texcoord: */
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof *v, &v[2]);
-	glEnableVertexAttribArray(1);
-
-	for (i = 0, first = 0; i < nfans; i++) {
-		glDrawArrays(GL_TRIANGLE_FAN, first, vtxcnt[i]);
-		if (gr->fan_debug)
-			triangle_fan_debug(ev, first, vtxcnt[i]);
-		first += vtxcnt[i];
-	}
-
-	glDisableVertexAttribArray(1);
-	glDisableVertexAttribArray(0);
-
-	gr->vertices.size = 0;
-	gr->vtxcnt.size = 0;
-}
-
 static int
 use_output(struct weston_output *output)
 {
@@ -724,6 +684,25 @@ static int
 shader_init(struct gl_shader *shader, struct gl_renderer *gr,
 		   const char *vertex_source, const char *fragment_source);
 
+/* Shaders are built on first use, so by the end of the first frame
+ * the ones needed at startup are all there. */
+static void
+log_program_build(struct gl_renderer *gr)
+{
+	struct gl_program_cache *cache = gr->program_cache;
+
+	if (cache)
+		weston_log("GL programs built in %.1f ms for the first frame, "
+			   "%u from the program cache, %u compiled, "
+			   "%u stored\n",
+			   gr->program_build_nsec / 1e6,
+			   cache->hits, cache->misses, cache->stored);
+	else
+		weston_log("GL programs built in %.1f ms for the first frame, "
+			   "program cache disabled\n",
+			   gr->program_build_nsec / 1e6);
+}
+
 static void
 use_shader(struct gl_renderer *gr, struct gl_shader *shader)
 {
@@ -746,22 +725,332 @@ use_shader(struct gl_renderer *gr, struct gl_shader *shader)
 
 static void
 shader_uniforms(struct gl_shader *shader,
-		struct weston_view *view,
+		const struct gl_draw_state *state,
 		struct weston_output *output)
 {
 	int i;
-	struct gl_surface_state *gs = get_surface_state(view->surface);
 	struct gl_output_state *go = get_output_state(output);
 
 	glUniformMatrix4fv(shader->proj_uniform,
 			   1, GL_FALSE, go->output_matrix.d);
-	glUniform4fv(shader->color_uniform, 1, gs->color);
-	glUniform1f(shader->alpha_uniform, view->alpha);
+	glUniform4fv(shader->color_uniform, 1, state->color);
+	glUniform1f(shader->alpha_uniform, state->alpha);
 
-	for (i = 0; i < gs->num_textures; i++)
+	for (i = 0; i < state->num_textures; i++)
 		glUniform1i(shader->tex_uniforms[i], i);
 }
 
+static void
+draw_state_apply(struct gl_renderer *gr, struct weston_output *output,
+		 const struct gl_draw_state *state)
+{
+	int i;
+
+	use_shader(gr, state->shader);
+	shader_uniforms(state->shader, state, output);
+
+	for (i = 0; i < state->num_textures; i++) {
+		glActiveTexture(GL_TEXTURE0 + i);
+		glBindTexture(state->target, state->textures[i]);
+		glTexParameteri(state->target, GL_TEXTURE_MIN_FILTER,
+				state->filter);
+		glTexParameteri(state->target, GL_TEXTURE_MAG_FILTER,
+				state->filter);
+	}
+
+	if (state->blend)
+		glEnable(GL_BLEND);
+	else
+		glDisable(GL_BLEND);
+}
+
+static bool
+draw_state_equal(const struct gl_draw_state *a,
+		 const struct gl_draw_state *b)
+{
+	int i;
+
+	if (a->shader != b->shader || a->target != b->target ||
+	    a->num_textures != b->num_textures || a->filter != b->filter ||
+	    a->alpha != b->alpha || a->blend != b->blend)
+		return false;
+
+	for (i = 0; i < a->num_textures; i++)
+		if (a->textures[i] != b->textures[i])
+			return false;
+
+	return memcmp(a->color, b->color, sizeof a->color) == 0;
+}
+
+/* Bind the buffer and reserve 'size' bytes at the end of its used part,
+ * returning their offset. When the buffer is full its storage is orphaned,
+ * so that writing never waits for the GPU to finish the commands reading
+ * from the previous contents. */
+static GLintptr
+stream_buffer_reserve(struct gl_stream_buffer *sb, GLenum target,
+		      GLsizeiptr size)
+{
+	GLintptr offset;
+
+	if (!sb->name)
+		glGenBuffers(1, &sb->name);
+	glBindBuffer(target, sb->name);
+
+	if (sb->offset + size > sb->size) {
+		while (sb->size < size)
+			sb->size = sb->size ? sb->size * 2 :
+					      STREAM_BUFFER_MIN_SIZE;
+		glBufferData(target, sb->size, NULL, GL_STREAM_DRAW);
+		sb->offset = 0;
+	}
+
+	offset = sb->offset;
+	sb->offset += (size + 15) & ~15;
+
+	return offset;
+}
+
+static GLintptr
+stream_buffer_upload(struct gl_stream_buffer *sb, GLenum target,
+		     const void *data, GLsizeiptr size)
+{
+	GLintptr offset;
+
+	offset = stream_buffer_reserve(sb, target, size);
+	glBufferSubData(target, offset, size, data);
+
+	return offset;
+}
+
+/* Draw and empty the pending batch. */
+static void
+gl_batch_flush(struct gl_renderer *gr, struct weston_output *output)
+{
+	const GLsizei stride = 4 * sizeof(GLfloat);
+	struct gl_batch_draw *draw;
+	GLintptr vertex_offset, index_offset;
+	uintptr_t base;
+
+	if (gr->indices.size == 0)
+		goto out;
+
+	draw_state_apply(gr, output, &gr->batch_state);
+
+	vertex_offset = stream_buffer_upload(&gr->vertex_buffer,
+					     GL_ARRAY_BUFFER,
+					     gr->vertices.data,
+					     gr->vertices.size);
+	index_offset = stream_buffer_upload(&gr->index_buffer,
+					    GL_ELEMENT_ARRAY_BUFFER,
+					    gr->indices.data,
+					    gr->indices.size);
+
+	glEnableVertexAttribArray(0);
+	glEnableVertexAttribArray(1);
+
+	wl_array_for_each(draw, &gr->batch_draws) {
+		base = vertex_offset + draw->first_vertex * stride;
+		/* position: */
+		glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, stride,
+				      (void *) base);
+		/* texcoord: */
+		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride,
+				      (void *) (base + 2 * sizeof(GLfloat)));
+		glDrawElements(GL_TRIANGLES, draw->count, GL_UNSIGNED_SHORT,
+			       (void *) (index_offset + draw->first_index *
+							sizeof(GLushort)));
+		gr->draw_stats.draws++;
+	}
+
+	glDisableVertexAttribArray(1);
+	glDisableVertexAttribArray(0);
+
+	/* Everything else draws from client memory. */
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+out:
+	gr->vertices.size = 0;
+	gr->indices.size = 0;
+	gr->batch_draws.size = 0;
+}
+
+/* Append the triangle fans texture_region() left in gr->vtxcnt, whose
+ * vertices start at index 'first' of gr->vertices, to the pending batch
+ * as indexed triangles. */
+static void
+gl_batch_add_fans(struct gl_renderer *gr, GLuint first, int nfans)
+{
+	unsigned int *vtxcnt = gr->vtxcnt.data;
+	struct gl_batch_draw *draw = NULL;
+	GLushort *index;
+	GLuint v = first, base;
+	unsigned int k;
+	int i;
+
+	if (gr->batch_draws.size > 0)
+		draw = (struct gl_batch_draw *)
+			((char *) gr->batch_draws.data +
+			 gr->batch_draws.size) - 1;
+
+	for (i = 0; i < nfans; i++) {
+		/* Indices are 16 bits wide, relative to the first vertex of
+		 * their draw; start a new draw when they would overflow. */
+		if (!draw || v + vtxcnt[i] - draw->first_vertex > 65536) {
+			draw = wl_array_add(&gr->batch_draws, sizeof *draw);
+			if (!draw)
+				return;
+			draw->first_vertex = v;
+			draw->first_index = gr->indices.size / sizeof *index;
+			draw->count = 0;
+		}
+
+		index = wl_array_add(&gr->indices,
+				     (vtxcnt[i] - 2) * 3 * sizeof *index);
+		if (!index)
+			return;
+
+		base = v - draw->first_vertex;
+		for (k = 2; k < vtxcnt[i]; k++) {
+			*index++ = base;
+			*index++ = base + k - 1;
+			*index++ = base + k;
+		}
+
+		draw->count += (vtxcnt[i] - 2) * 3;
+		v += vtxcnt[i];
+
+		gr->draw_stats.vertices += vtxcnt[i];
+		gr->draw_stats.triangles += vtxcnt[i] - 2;
+	}
+}
+
+/* Emit a quad for every rectangle of the region, in global coordinates,
+ * sampling a layer cache texture at the same place of the output. */
+static int
+layer_cache_region(struct weston_output *output, pixman_region32_t *region)
+{
+	struct gl_output_state *go = get_output_state(output);
+	struct gl_renderer *gr = get_renderer(output->compositor);
+	pixman_box32_t *rects;
+	struct weston_vector p;
+	unsigned int *vtxcnt;
+	GLfloat *v;
+	int nrects, i, k;
+
+	rects = pixman_region32_rectangles(region, &nrects);
+	v = wl_array_add(&gr->vertices, nrects * 4 * 4 * sizeof *v);
+	vtxcnt = wl_array_add(&gr->vtxcnt, nrects * sizeof *vtxcnt);
+	if (!v || !vtxcnt)
+		return 0;
+
+	for (i = 0; i < nrects; i++) {
+		for (k = 0; k < 4; k++) {
+			p.f[0] = (k == 0 || k == 3) ? rects[i].x1 : rects[i].x2;
+			p.f[1] = (k < 2) ? rects[i].y1 : rects[i].y2;
+			p.f[2] = 0.0f;
+			p.f[3] = 1.0f;
+
+			/* position: */
+			*(v++) = p.f[0];
+			*(v++) = p.f[1];
+
+			/* texcoord, from normalized device coordinates: */
+			weston_matrix_transform(&go->output_matrix, &p);
+			*(v++) = (p.f[0] / p.f[3] + 1.0f) * 0.5f;
+			*(v++) = (p.f[1] / p.f[3] + 1.0f) * 0.5f;
+		}
+		vtxcnt[i] = 4;
+	}
+
+	return nrects;
+}
+
+/* With a NULL view, the region is drawn from a layer cache texture. */
+static void
+repaint_region(struct weston_view *ev, struct weston_output *output,
+	       pixman_region32_t *region, pixman_region32_t *surf_region,
+	       const struct gl_draw_state *state)
+{
+	struct weston_compositor *ec = output->compositor;
+	struct gl_renderer *gr = get_renderer(ec);
+	GLfloat *v;
+	unsigned int *vtxcnt;
+	int i, first, nfans;
+
+	gr->draw_stats.regions++;
+
+	/* The final region to be painted is the intersection of
+	 * 'region' and 'surf_region'. However, 'region' is in the global
+	 * coordinates, and 'surf_region' is in the surface-local
+	 * coordinates. texture_region() will iterate over all pairs of
+	 * rectangles from both regions, compute the intersection
+	 * polygon for each pair, and store it as a triangle fan if
+	 * it has a non-zero area (at least 3 vertices, actually).
+	 */
+	if (gr->batching && !gr->fan_debug) {
+		if (gr->indices.size > 0 &&
+		    !draw_state_equal(state, &gr->batch_state))
+			gl_batch_flush(gr, output);
+		gr->batch_state = *state;
+
+		first = gr->vertices.size / (4 * sizeof *v);
+		if (ev)
+			nfans = texture_region(ev, region, surf_region);
+		else
+			nfans = layer_cache_region(output, region);
+
+		/* texture_region() reserved room for the worst case. */
+		vtxcnt = gr->vtxcnt.data;
+		gr->vertices.size = first * 4 * sizeof *v;
+		for (i = 0; i < nfans; i++)
+			gr->vertices.size += vtxcnt[i] * 4 * sizeof *v;
+
+		gl_batch_add_fans(gr, first, nfans);
+		gr->vtxcnt.size = 0;
+		return;
+	}
+
+	if (gr->fan_debug) {
+		use_shader(gr, &gr->solid_shader);
+		shader_uniforms(&gr->solid_shader, state, output);
+	}
+	draw_state_apply(gr, output, state);
+
+	if (ev)
+		nfans = texture_region(ev, region, surf_region);
+	else
+		nfans = layer_cache_region(output, region);
+
+	v = gr->vertices.data;
+	vtxcnt = gr->vtxcnt.data;
+
+	/* position: */
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof *v, &v[0]);
+	glEnableVertexAttribArray(0);
+
+	/* texcoord: */
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof *v, &v[2]);
+	glEnableVertexAttribArray(1);
+
+	for (i = 0, first = 0; i < nfans; i++) {
+		glDrawArrays(GL_TRIANGLE_FAN, first, vtxcnt[i]);
+		if (gr->fan_debug)
+			triangle_fan_debug(ev, first, vtxcnt[i]);
+		first += vtxcnt[i];
+
+		gr->draw_stats.draws++;
+		gr->draw_stats.vertices += vtxcnt[i];
+		gr->draw_stats.triangles += vtxcnt[i] - 2;
+	}
+
+	glDisableVertexAttribArray(1);
+	glDisableVertexAttribArray(0);
+
+	gr->vertices.size = 0;
+	gr->vtxcnt.size = 0;
+}
+
 static int
 ensure_surface_buffer_is_ready(struct gl_renderer *gr,
 			       struct gl_surface_state *gs)
@@ -853,156 +1142,561 @@ setup_censor_overrides(struct weston_output *output,
 	bool unprotected_censor =
 		(ev->surface->desired_protection > output->current_protection);
 
-	if (gs->direct_display) {
-		gs->color[0] = 0.40;
-		gs->color[1] = 0.0;
-		gs->color[2] = 0.0;
-		gs->color[3] = 1.0;
-		gs->shader = &gr->solid_shader;
-		return gs->shader;
-	}
+	if (gs->direct_display) {
+		gs->color[0] = 0.40;
+		gs->color[1] = 0.0;
+		gs->color[2] = 0.0;
+		gs->color[3] = 1.0;
+		gs->shader = &gr->solid_shader;
+		return gs->shader;
+	}
+
+	/* When not in enforced mode, the client is notified of the protection */
+	/* change, so content censoring is not required */
+	if (ev->surface->protection_mode !=
+	    WESTON_SURFACE_PROTECTION_MODE_ENFORCED)
+		return NULL;
+
+	if (recording_censor || unprotected_censor) {
+		replaced_shader = gs->shader;
+		gs->color[0] = 0.40;
+		gs->color[1] = 0.0;
+		gs->color[2] = 0.0;
+		gs->color[3] = 1.0;
+		gs->shader = &gr->solid_shader;
+	}
+
+	return replaced_shader;
+}
+
+/* How many times each damaged pixel is drawn on average. */
+static double
+overdraw_ratio(const struct gl_draw_stats *stats, bool culled)
+{
+	if (stats->damage_area == 0)
+		return 0.0;
+
+	return (double) (culled ? stats->drawn_area : stats->covered_area) /
+	       stats->damage_area;
+}
+
+static uint64_t
+region_area(pixman_region32_t *region)
+{
+	pixman_box32_t *rects;
+	uint64_t area = 0;
+	int nrects, i;
+
+	rects = pixman_region32_rectangles(region, &nrects);
+	for (i = 0; i < nrects; i++)
+		area += (uint64_t) (rects[i].x2 - rects[i].x1) *
+			(rects[i].y2 - rects[i].y1);
+
+	return area;
+}
+
+/* Work out what is left to draw of a view once the opaque views above it,
+ * given by 'clip', are taken away. Returns false, with nothing to clean
+ * up, when the view is entirely covered or cannot be drawn. */
+static bool
+view_draw_prepare(struct gl_view_draw *draw, struct weston_view *ev,
+		  struct weston_output *output,
+		  pixman_region32_t *damage, /* in global coordinates */
+		  pixman_region32_t *clip)
+{
+	struct weston_compositor *ec = ev->surface->compositor;
+	struct gl_renderer *gr = get_renderer(ec);
+	struct gl_surface_state *gs = get_surface_state(ev->surface);
+	struct gl_draw_state *state = &draw->state;
+	int i;
+
+	/* In case of a runtime switch of renderers, we may not have received
+	 * an attach for this surface since the switch. In that case we don't
+	 * have a valid buffer or a proper shader set up so skip rendering. */
+	if (!gs->shader && !gs->direct_display)
+		return false;
+
+	/* repaint bounding region in global coordinates: */
+	pixman_region32_init(&draw->repaint);
+	pixman_region32_intersect(&draw->repaint,
+				  &ev->transform.boundingbox, damage);
+	if (!pixman_region32_not_empty(&draw->repaint))
+		goto fail;
+
+	gr->draw_stats.views++;
+	gr->draw_stats.covered_area += region_area(&draw->repaint);
+
+	pixman_region32_subtract(&draw->repaint, &draw->repaint, clip);
+
+	/* Skip covered views before any of the per-vertex work. */
+	if (!pixman_region32_not_empty(&draw->repaint)) {
+		gr->draw_stats.culled++;
+		goto fail;
+	}
+
+	if (ensure_surface_buffer_is_ready(gr, gs) < 0)
+		goto fail;
+
+	gr->draw_stats.drawn_area += region_area(&draw->repaint);
+
+	draw->view = ev;
+	draw->cache = NULL;
+	draw->replaced_shader = setup_censor_overrides(output, ev);
+
+	state->shader = gs->shader;
+	state->target = gs->target;
+	state->num_textures = gs->num_textures;
+	for (i = 0; i < gs->num_textures; i++)
+		state->textures[i] = gs->textures[i];
+	memcpy(state->color, gs->color, sizeof state->color);
+	state->alpha = ev->alpha;
+
+	if (ev->transform.enabled || output->zoom.active ||
+	    output->current_scale != ev->surface->buffer_viewport.buffer.scale)
+		state->filter = GL_LINEAR;
+	else
+		state->filter = GL_NEAREST;
+
+	/* blended region in surface coordinates is whole surface minus
+	 * opaque region: */
+	pixman_region32_init_rect(&draw->surface_blend, 0, 0,
+				  ev->surface->width, ev->surface->height);
+	if (ev->geometry.scissor_enabled)
+		pixman_region32_intersect(&draw->surface_blend,
+					  &draw->surface_blend,
+					  &ev->geometry.scissor);
+	pixman_region32_subtract(&draw->surface_blend, &draw->surface_blend,
+				 &ev->surface->opaque);
+
+	/* XXX: Should we be using ev->transform.opaque here? */
+	pixman_region32_init(&draw->surface_opaque);
+	if (ev->geometry.scissor_enabled)
+		pixman_region32_intersect(&draw->surface_opaque,
+					  &ev->surface->opaque,
+					  &ev->geometry.scissor);
+	else
+		pixman_region32_copy(&draw->surface_opaque,
+				     &ev->surface->opaque);
+
+	return true;
+
+fail:
+	pixman_region32_fini(&draw->repaint);
+	return false;
+}
+
+/* Timer queries measure what is submitted between their begin and end,
+ * so the pending batch is flushed on both sides. */
+static void
+gpu_timing_begin(struct weston_output *output, enum gl_gpu_timing_kind kind,
+		 struct weston_surface *surface)
+{
+	struct gl_renderer *gr = get_renderer(output->compositor);
+	struct gl_output_state *go = get_output_state(output);
+	struct gl_surface_state *gs;
+
+	if (!go->gpu_timing.recording)
+		return;
+
+	gl_batch_flush(gr, output);
+
+	if (surface) {
+		gs = get_surface_state(surface);
+		gl_gpu_timing_begin(&gr->gpu_timing, &go->gpu_timing, kind,
+				    &gs->gpu_timing, surface);
+	} else {
+		gl_gpu_timing_begin(&gr->gpu_timing, &go->gpu_timing, kind,
+				    NULL, NULL);
+	}
+}
+
+static void
+gpu_timing_end(struct weston_output *output)
+{
+	struct gl_renderer *gr = get_renderer(output->compositor);
+	struct gl_output_state *go = get_output_state(output);
+
+	if (!go->gpu_timing.query_active)
+		return;
+
+	gl_batch_flush(gr, output);
+	gl_gpu_timing_end(&gr->gpu_timing, &go->gpu_timing);
+}
+
+static void
+view_draw_opaque(struct gl_view_draw *draw, struct weston_output *output)
+{
+	struct weston_view *ev = draw->view;
+	struct gl_renderer *gr = get_renderer(output->compositor);
+	struct gl_surface_state *gs = get_surface_state(ev->surface);
+	struct gl_draw_state *state = &draw->state;
+
+	if (!pixman_region32_not_empty(&draw->surface_opaque))
+		return;
+
+	if (gs->shader == &gr->texture_shader_rgba) {
+		/* Special case for RGBA textures with possibly
+		 * bad data in alpha channel: use the shader
+		 * that forces texture alpha = 1.0.
+		 * Xwayland surfaces need this.
+		 */
+		state->shader = &gr->texture_shader_rgbx;
+	}
+
+	state->blend = ev->alpha < 1.0;
+	gpu_timing_begin(output, GL_GPU_TIMING_VIEW, ev->surface);
+	repaint_region(ev, output, &draw->repaint, &draw->surface_opaque,
+		       state);
+	gpu_timing_end(output);
+	gs->used_in_output_repaint = true;
+}
+
+/* Only for these is the whole opaque region in ev->transform.opaque, and
+ * so in the clip of every view below: the opaque parts of scaled and
+ * rotated views would be painted over by what is below them. */
+static bool
+view_draw_opaque_first(struct weston_view *ev)
+{
+	return ev->alpha == 1.0 &&
+	       (!ev->transform.enabled ||
+		!(ev->transform.matrix.type &
+		  ~WESTON_MATRIX_TRANSFORM_TRANSLATE));
+}
+
+static void
+view_draw_blend(struct gl_view_draw *draw, struct weston_output *output)
+{
+	struct weston_view *ev = draw->view;
+	struct gl_surface_state *gs = get_surface_state(ev->surface);
+	struct gl_draw_state *state = &draw->state;
+
+	if (!pixman_region32_not_empty(&draw->surface_blend))
+		return;
+
+	state->shader = gs->shader;
+	state->blend = true;
+	gpu_timing_begin(output, GL_GPU_TIMING_VIEW, ev->surface);
+	repaint_region(ev, output, &draw->repaint, &draw->surface_blend,
+		       state);
+	gpu_timing_end(output);
+	gs->used_in_output_repaint = true;
+}
+
+static void
+view_draw_release(struct gl_view_draw *draw)
+{
+	struct gl_surface_state *gs;
+
+	pixman_region32_fini(&draw->surface_blend);
+	pixman_region32_fini(&draw->surface_opaque);
+	pixman_region32_fini(&draw->repaint);
+
+	if (draw->replaced_shader) {
+		gs = get_surface_state(draw->view->surface);
+		gs->shader = draw->replaced_shader;
+	}
+}
+
+static void
+gl_layer_cache_destroy(struct gl_layer_cache *cache)
+{
+	glDeleteFramebuffers(1, &cache->fbo);
+	glDeleteTextures(1, &cache->texture);
+	weston_layer_snapshot_release(&cache->snapshot);
+	wl_list_remove(&cache->link);
+	free(cache);
+}
+
+static struct gl_layer_cache *
+gl_layer_cache_get(struct weston_output *output, struct weston_layer *layer)
+{
+	struct gl_output_state *go = get_output_state(output);
+	struct gl_layer_cache *cache;
+
+	wl_list_for_each(cache, &go->layer_caches, link)
+		if (cache->snapshot.layer == layer)
+			return cache;
+
+	cache = zalloc(sizeof *cache);
+	if (!cache)
+		return NULL;
+
+	weston_layer_snapshot_init(&cache->snapshot, layer);
+	wl_list_insert(&go->layer_caches, &cache->link);
+
+	return cache;
+}
+
+static bool
+gl_layer_cache_ensure_texture(struct gl_layer_cache *cache,
+			      int32_t width, int32_t height)
+{
+	GLenum status;
+
+	if (cache->texture && cache->width == width &&
+	    cache->height == height)
+		return true;
+
+	if (!cache->texture) {
+		glGenTextures(1, &cache->texture);
+		glGenFramebuffers(1, &cache->fbo);
+	}
+
+	glBindTexture(GL_TEXTURE_2D, cache->texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0,
+		     GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, cache->fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+			       GL_TEXTURE_2D, cache->texture, 0);
+	status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	if (status != GL_FRAMEBUFFER_COMPLETE) {
+		weston_log("%s: fbo error: %#x\n", __func__, status);
+		return false;
+	}
+
+	cache->width = width;
+	cache->height = height;
+
+	return true;
+}
+
+/* Composite the views of the layer, as recorded in the snapshot, over a
+ * transparent texture. Each view is clipped by the opaque views of the
+ * layer above it only, so that the texture stays usable whatever is
+ * stacked above the layer. */
+static bool
+gl_layer_cache_render(struct gl_layer_cache *cache,
+		      struct weston_output *output)
+{
+	struct gl_renderer *gr = get_renderer(output->compositor);
+	struct weston_layer_snapshot_view *sv;
+	struct gl_view_draw draw;
+	int i;
+
+	if (!gl_layer_cache_ensure_texture(cache, cache->snapshot.width,
+					   cache->snapshot.height))
+		return false;
+
+	glBindFramebuffer(GL_FRAMEBUFFER, cache->fbo);
+	glViewport(0, 0, cache->width, cache->height);
+	glClearColor(0.0, 0.0, 0.0, 0.0);
+	glClear(GL_COLOR_BUFFER_BIT);
 
-	/* When not in enforced mode, the client is notified of the protection */
-	/* change, so content censoring is not required */
-	if (ev->surface->protection_mode !=
-	    WESTON_SURFACE_PROTECTION_MODE_ENFORCED)
-		return NULL;
+	for (i = cache->snapshot.views.size / sizeof *sv - 1; i >= 0; i--) {
+		sv = (struct weston_layer_snapshot_view *)
+			cache->snapshot.views.data + i;
 
-	if (recording_censor || unprotected_censor) {
-		replaced_shader = gs->shader;
-		gs->color[0] = 0.40;
-		gs->color[1] = 0.0;
-		gs->color[2] = 0.0;
-		gs->color[3] = 1.0;
-		gs->shader = &gr->solid_shader;
+		if (!view_draw_prepare(&draw, sv->view, output,
+				       &output->region, &sv->clip))
+			continue;
+
+		view_draw_opaque(&draw, output);
+		view_draw_blend(&draw, output);
+		view_draw_release(&draw);
 	}
 
-	return replaced_shader;
+	gl_batch_flush(gr, output);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	gr->draw_stats.layer_cache_renders++;
+
+	return true;
 }
 
+/* Bring the caches of all flattened layers with views on the output up to
+ * date, and drop those of layers that are gone. */
 static void
-draw_view(struct weston_view *ev, struct weston_output *output,
-	  pixman_region32_t *damage) /* in global coordinates */
+gl_layer_caches_update(struct weston_output *output)
 {
-	struct weston_compositor *ec = ev->surface->compositor;
-	struct gl_renderer *gr = get_renderer(ec);
-	struct gl_surface_state *gs = get_surface_state(ev->surface);
-	/* repaint bounding region in global coordinates: */
-	pixman_region32_t repaint;
-	/* opaque region in surface coordinates: */
-	pixman_region32_t surface_opaque;
-	/* non-opaque region in surface coordinates: */
-	pixman_region32_t surface_blend;
-	GLint filter;
-	int i;
-	struct gl_shader *replaced_shader = NULL;
+	struct weston_compositor *compositor = output->compositor;
+	struct gl_output_state *go = get_output_state(output);
+	struct gl_renderer *gr = get_renderer(compositor);
+	struct gl_layer_cache *cache, *next;
+	struct weston_layer *layer, *last = NULL;
+	struct weston_view *view;
+	GLint viewport[4];
+	bool rendered = false;
 
-	/* In case of a runtime switch of renderers, we may not have received
-	 * an attach for this surface since the switch. In that case we don't
-	 * have a valid buffer or a proper shader set up so skip rendering. */
-	if (!gs->shader && !gs->direct_display)
-		return;
+	wl_list_for_each(cache, &go->layer_caches, link)
+		cache->used = false;
 
-	pixman_region32_init(&repaint);
-	pixman_region32_intersect(&repaint,
-				  &ev->transform.boundingbox, damage);
-	pixman_region32_subtract(&repaint, &repaint, &ev->clip);
+	/* The debug modes must see every view drawn. */
+	if (gr->fan_debug || gr->fragment_shader_debug)
+		goto prune;
 
-	if (!pixman_region32_not_empty(&repaint))
-		goto out;
+	glGetIntegerv(GL_VIEWPORT, viewport);
 
-	if (ensure_surface_buffer_is_ready(gr, gs) < 0)
-		goto out;
+	wl_list_for_each(view, &compositor->view_list, link) {
+		if (!weston_view_is_flattened(view) ||
+		    !(view->output_mask & (1u << output->id)))
+			continue;
 
-	replaced_shader = setup_censor_overrides(output, ev);
+		/* Views of a layer are adjacent in the list. */
+		layer = weston_view_get_layer(view);
+		if (layer == last)
+			continue;
+		last = layer;
 
-	glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+		cache = gl_layer_cache_get(output, layer);
+		if (!cache)
+			continue;
 
-	if (gr->fan_debug) {
-		use_shader(gr, &gr->solid_shader);
-		shader_uniforms(&gr->solid_shader, ev, output);
+		cache->used = true;
+		if (weston_layer_snapshot_update(&cache->snapshot, output) ||
+		    !cache->valid) {
+			cache->valid = gl_layer_cache_render(cache, output);
+			rendered = true;
+		}
 	}
 
-	use_shader(gr, gs->shader);
-	shader_uniforms(gs->shader, ev, output);
+	if (rendered)
+		glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
 
-	if (ev->transform.enabled || output->zoom.active ||
-	    output->current_scale != ev->surface->buffer_viewport.buffer.scale)
-		filter = GL_LINEAR;
-	else
-		filter = GL_NEAREST;
+prune:
+	wl_list_for_each_safe(cache, next, &go->layer_caches, link)
+		if (!cache->used)
+			gl_layer_cache_destroy(cache);
+}
 
-	for (i = 0; i < gs->num_textures; i++) {
-		glActiveTexture(GL_TEXTURE0 + i);
-		glBindTexture(gs->target, gs->textures[i]);
-		glTexParameteri(gs->target, GL_TEXTURE_MIN_FILTER, filter);
-		glTexParameteri(gs->target, GL_TEXTURE_MAG_FILTER, filter);
-	}
+static struct gl_layer_cache *
+gl_layer_cache_for_view(struct weston_output *output, struct weston_view *view)
+{
+	struct gl_output_state *go = get_output_state(output);
+	struct weston_layer *layer;
+	struct gl_layer_cache *cache;
 
-	/* blended region is whole surface minus opaque region: */
-	pixman_region32_init_rect(&surface_blend, 0, 0,
-				  ev->surface->width, ev->surface->height);
-	if (ev->geometry.scissor_enabled)
-		pixman_region32_intersect(&surface_blend, &surface_blend,
-					  &ev->geometry.scissor);
-	pixman_region32_subtract(&surface_blend, &surface_blend,
-				 &ev->surface->opaque);
+	if (!weston_view_is_flattened(view))
+		return NULL;
 
-	/* XXX: Should we be using ev->transform.opaque here? */
-	pixman_region32_init(&surface_opaque);
-	if (ev->geometry.scissor_enabled)
-		pixman_region32_intersect(&surface_opaque,
-					  &ev->surface->opaque,
-					  &ev->geometry.scissor);
-	else
-		pixman_region32_copy(&surface_opaque, &ev->surface->opaque);
-
-	if (pixman_region32_not_empty(&surface_opaque)) {
-		if (gs->shader == &gr->texture_shader_rgba) {
-			/* Special case for RGBA textures with possibly
-			 * bad data in alpha channel: use the shader
-			 * that forces texture alpha = 1.0.
-			 * Xwayland surfaces need this.
-			 */
-			use_shader(gr, &gr->texture_shader_rgbx);
-			shader_uniforms(&gr->texture_shader_rgbx, ev, output);
-		}
+	layer = weston_view_get_layer(view);
+	wl_list_for_each(cache, &go->layer_caches, link)
+		if (cache->snapshot.layer == layer)
+			return cache->used && cache->valid ? cache : NULL;
 
-		if (ev->alpha < 1.0)
-			glEnable(GL_BLEND);
-		else
-			glDisable(GL_BLEND);
+	return NULL;
+}
 
-		repaint_region(ev, &repaint, &surface_opaque);
-		gs->used_in_output_repaint = true;
+/* The layer is drawn where its views are, minus what the opaque views
+ * above its topmost view cover. */
+static bool
+layer_cache_draw_prepare(struct gl_view_draw *draw,
+			 struct gl_layer_cache *cache,
+			 struct weston_output *output,
+			 pixman_region32_t *damage)
+{
+	struct gl_renderer *gr = get_renderer(output->compositor);
+	struct weston_view *top = weston_layer_snapshot_top_view(&cache->snapshot);
+	struct gl_draw_state *state = &draw->state;
+
+	pixman_region32_init(&draw->repaint);
+	pixman_region32_intersect(&draw->repaint, &cache->snapshot.region,
+				  damage);
+	pixman_region32_subtract(&draw->repaint, &draw->repaint, &top->clip);
+	if (!pixman_region32_not_empty(&draw->repaint)) {
+		pixman_region32_fini(&draw->repaint);
+		return false;
 	}
 
-	if (pixman_region32_not_empty(&surface_blend)) {
-		use_shader(gr, gs->shader);
-		glEnable(GL_BLEND);
-		repaint_region(ev, &repaint, &surface_blend);
-		gs->used_in_output_repaint = true;
-	}
+	gr->draw_stats.drawn_area += region_area(&draw->repaint);
 
-	pixman_region32_fini(&surface_blend);
-	pixman_region32_fini(&surface_opaque);
+	draw->view = top;
+	draw->cache = cache;
+	draw->replaced_shader = NULL;
+	pixman_region32_init(&draw->surface_opaque);
+	pixman_region32_init(&draw->surface_blend);
 
-out:
-	pixman_region32_fini(&repaint);
+	memset(state, 0, sizeof *state);
+	state->shader = &gr->texture_shader_rgba;
+	state->target = GL_TEXTURE_2D;
+	state->textures[0] = cache->texture;
+	state->num_textures = 1;
+	state->filter = GL_NEAREST;
+	state->alpha = 1.0;
+	state->blend = true;
 
-	if (replaced_shader)
-		gs->shader = replaced_shader;
+	return true;
 }
 
+/* Views are walked front to back first: covered ones are dropped and
+ * the opaque parts of untransformed views are drawn right away without
+ * blending. Those never overlap once ev->clip is taken away, so their
+ * order does not matter. Everything else is then drawn back to front.
+ * Flattened layers are drawn in one go from their cache, blended. */
 static void
 repaint_views(struct weston_output *output, pixman_region32_t *damage)
 {
 	struct weston_compositor *compositor = output->compositor;
+	struct gl_renderer *gr = get_renderer(compositor);
+	struct gl_layer_cache *cache, *last_cache = NULL;
+	struct gl_view_draw *draw;
 	struct weston_view *view;
+	int i;
+
+	/* Also for the views blended into the layer caches. */
+	glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+	gpu_timing_begin(output, GL_GPU_TIMING_LAYER_CACHE, NULL);
+	gl_layer_caches_update(output);
+	gpu_timing_end(output);
+
+	gr->draw_stats.damage_area += region_area(damage);
+
+	gr->view_draws.size = 0;
+	wl_list_for_each(view, &compositor->view_list, link) {
+		if (view->plane != &compositor->primary_plane)
+			continue;
+
+		cache = gl_layer_cache_for_view(output, view);
+		if (cache) {
+			gr->draw_stats.cached_views++;
+			if (cache == last_cache)
+				continue;
+		}
+		last_cache = cache;
 
-	wl_list_for_each_reverse(view, &compositor->view_list, link)
-		if (view->plane == &compositor->primary_plane)
-			draw_view(view, output, damage);
+		draw = wl_array_add(&gr->view_draws, sizeof *draw);
+		if (!draw)
+			break;
+
+		if (cache) {
+			if (!layer_cache_draw_prepare(draw, cache, output,
+						      damage))
+				gr->view_draws.size -= sizeof *draw;
+			continue;
+		}
+
+		if (!view_draw_prepare(draw, view, output, damage,
+				       &view->clip)) {
+			gr->view_draws.size -= sizeof *draw;
+			continue;
+		}
+
+		if (view_draw_opaque_first(view))
+			view_draw_opaque(draw, output);
+	}
+
+	for (i = gr->view_draws.size / sizeof *draw - 1; i >= 0; i--) {
+		draw = (struct gl_view_draw *) gr->view_draws.data + i;
+		if (draw->cache) {
+			gpu_timing_begin(output, GL_GPU_TIMING_LAYER_CACHE,
+					 NULL);
+			repaint_region(NULL, output, &draw->repaint, NULL,
+				       &draw->state);
+			gpu_timing_end(output);
+		} else {
+			if (!view_draw_opaque_first(draw->view))
+				view_draw_opaque(draw, output);
+			view_draw_blend(draw, output);
+		}
+		view_draw_release(draw);
+	}
+
+	gl_batch_flush(gr, output);
 }
 
 static int
@@ -1413,6 +2107,9 @@ gl_renderer_repaint_output(struct weston_output *output,
 
 	go->begin_render_sync = create_render_sync(gr);
 
+	gl_gpu_timing_begin_frame(&gr->gpu_timing, &go->gpu_timing,
+				  output->name);
+
 	/* Calculate the viewport */
 	glViewport(go->borders[GL_RENDERER_BORDER_LEFT].width,
 		   go->borders[GL_RENDERER_BORDER_BOTTOM].height,
@@ -1478,7 +2175,52 @@ gl_renderer_repaint_output(struct weston_output *output,
 	pixman_region32_fini(&total_damage);
 	pixman_region32_fini(&previous_damage);
 
-	draw_output_borders(output, border_status);
+	if (border_status != BORDER_STATUS_CLEAN) {
+		gpu_timing_begin(output, GL_GPU_TIMING_BORDERS, NULL);
+		draw_output_borders(output, border_status);
+		gpu_timing_end(output);
+	}
+
+	gl_gpu_timing_end_frame(&gr->gpu_timing, &go->gpu_timing);
+
+	if (weston_log_scope_is_enabled(gr->draw_scope)) {
+		char timestr[128];
+
+		weston_log_scope_timestamp(gr->draw_scope, timestr,
+					   sizeof timestr);
+		weston_log_scope_printf(gr->draw_scope,
+					"%s output %s: %u draw calls, "
+					"%u regions, %u vertices, "
+					"%u triangles%s, %" PRIu64
+					" bytes uploaded%s\n", timestr,
+					output->name, gr->draw_stats.draws,
+					gr->draw_stats.regions,
+					gr->draw_stats.vertices,
+					gr->draw_stats.triangles,
+					gr->batching ? " (batched)" : "",
+					gr->draw_stats.upload_bytes,
+					gr->has_pbo ? " (pbo)" : "");
+		weston_log_scope_printf(gr->draw_scope,
+					"%s output %s: %u of %u views culled, "
+					"%u drawn from layer caches, %u "
+					"caches redrawn, overdraw %.2f "
+					"without culling, %.2f with\n",
+					timestr,
+					output->name,
+					gr->draw_stats.culled,
+					gr->draw_stats.views,
+					gr->draw_stats.cached_views,
+					gr->draw_stats.layer_cache_renders,
+					overdraw_ratio(&gr->draw_stats, false),
+					overdraw_ratio(&gr->draw_stats, true));
+	}
+	go->last_stats = gr->draw_stats;
+	memset(&gr->draw_stats, 0, sizeof gr->draw_stats);
+
+	if (!gr->program_build_reported) {
+		log_program_build(gr);
+		gr->program_build_reported = true;
+	}
 
 	wl_signal_emit(&output->frame_signal, output_damage);
 
@@ -1566,6 +2308,185 @@ static GLenum gl_format_from_internal(GLenum internal_format)
 	}
 }
 
+static int
+gl_format_texel_size(GLenum format, GLenum type)
+{
+	if (type == GL_UNSIGNED_SHORT_5_6_5)
+		return 2;
+
+	switch (format) {
+	case GL_BGRA_EXT:
+		return 4;
+	case GL_RGB:
+		return 3;
+	case GL_RG8_EXT:
+	case GL_LUMINANCE_ALPHA:
+		return 2;
+	default:
+		return 1;
+	}
+}
+
+/* A rectangle of one plane, in texels of that plane */
+struct shm_upload_rect {
+	int plane;
+	int x, y, width, height;
+};
+
+static int
+shm_upload_rects(struct weston_surface *surface, struct gl_surface_state *gs,
+		 struct weston_buffer *buffer, struct wl_array *rects)
+{
+	struct shm_upload_rect *u;
+	pixman_box32_t *rectangles, r;
+	int i, j, n;
+
+	if (gs->needs_full_upload) {
+		for (j = 0; j < gs->num_textures; j++) {
+			u = wl_array_add(rects, sizeof *u);
+			if (!u)
+				return -1;
+			u->plane = j;
+			u->x = 0;
+			u->y = 0;
+			u->width = gs->pitch / gs->hsub[j];
+			u->height = buffer->height / gs->vsub[j];
+		}
+		return 0;
+	}
+
+	rectangles = pixman_region32_rectangles(&gs->texture_damage, &n);
+	for (i = 0; i < n; i++) {
+		r = weston_surface_to_buffer_rect(surface, rectangles[i]);
+
+		for (j = 0; j < gs->num_textures; j++) {
+			u = wl_array_add(rects, sizeof *u);
+			if (!u)
+				return -1;
+			u->plane = j;
+			u->x = r.x1 / gs->hsub[j];
+			u->y = r.y1 / gs->vsub[j];
+			u->width = (r.x2 - r.x1) / gs->hsub[j];
+			u->height = (r.y2 - r.y1) / gs->vsub[j];
+		}
+	}
+
+	return 0;
+}
+
+/* Rows in the pixel buffer are padded to the default GL_UNPACK_ALIGNMENT */
+static size_t
+shm_upload_rect_stride(struct gl_surface_state *gs,
+		       const struct shm_upload_rect *u)
+{
+	int texel = gl_format_texel_size(gs->gl_format[u->plane],
+					 gs->gl_pixel_type);
+
+	return ((size_t) u->width * texel + 3) & ~(size_t) 3;
+}
+
+/* Copy the damage into the streaming pixel buffer and upload the textures
+ * from there. The copy is all the work done on the CPU; the transfer to the
+ * textures is left to the driver, which can do it asynchronously. */
+static int
+gl_renderer_flush_damage_pbo(struct gl_renderer *gr,
+			     struct weston_surface *surface,
+			     struct gl_surface_state *gs,
+			     struct weston_buffer *buffer)
+{
+	struct wl_array rects;
+	struct shm_upload_rect *u;
+	uint8_t *data, *map, *src, *dst;
+	size_t total = 0, stride, src_stride, offset;
+	GLintptr base;
+	GLenum format;
+	int texel, row;
+	int ret = -1;
+
+	wl_array_init(&rects);
+	if (shm_upload_rects(surface, gs, buffer, &rects) < 0)
+		goto out;
+
+	wl_array_for_each(u, &rects)
+		total += (shm_upload_rect_stride(gs, u) * u->height +
+			  15) & ~15;
+	if (total == 0) {
+		ret = 0;
+		goto out;
+	}
+
+	base = stream_buffer_reserve(&gr->upload_buffer,
+				     GL_PIXEL_UNPACK_BUFFER, total);
+	map = gr->map_buffer_range(GL_PIXEL_UNPACK_BUFFER, base, total,
+				   GL_MAP_WRITE_BIT_EXT |
+				   GL_MAP_INVALIDATE_RANGE_BIT_EXT |
+				   GL_MAP_UNSYNCHRONIZED_BIT_EXT);
+	if (!map)
+		goto unbind;
+
+	data = wl_shm_buffer_get_data(buffer->shm_buffer);
+
+	wl_shm_buffer_begin_access(buffer->shm_buffer);
+	offset = 0;
+	wl_array_for_each(u, &rects) {
+		texel = gl_format_texel_size(gs->gl_format[u->plane],
+					     gs->gl_pixel_type);
+		stride = shm_upload_rect_stride(gs, u);
+		src_stride = (size_t) (gs->pitch / gs->hsub[u->plane]) * texel;
+		src = data + gs->offset[u->plane] +
+		      u->y * src_stride + (size_t) u->x * texel;
+		dst = map + offset;
+
+		for (row = 0; row < u->height; row++) {
+			memcpy(dst, src, (size_t) u->width * texel);
+			src += src_stride;
+			dst += stride;
+		}
+
+		offset += (stride * u->height + 15) & ~15;
+	}
+	wl_shm_buffer_end_access(buffer->shm_buffer);
+
+	/* The contents are undefined if this fails, e.g. after a mode
+	 * switch; let the caller upload from the shm buffer again. */
+	if (!gr->unmap_buffer(GL_PIXEL_UNPACK_BUFFER))
+		goto unbind;
+
+	glPixelStorei(GL_UNPACK_ROW_LENGTH_EXT, 0);
+	glPixelStorei(GL_UNPACK_SKIP_PIXELS_EXT, 0);
+	glPixelStorei(GL_UNPACK_SKIP_ROWS_EXT, 0);
+
+	offset = 0;
+	wl_array_for_each(u, &rects) {
+		format = gl_format_from_internal(gs->gl_format[u->plane]);
+		stride = shm_upload_rect_stride(gs, u);
+
+		glBindTexture(GL_TEXTURE_2D, gs->textures[u->plane]);
+		if (gs->needs_full_upload)
+			glTexImage2D(GL_TEXTURE_2D, 0,
+				     gs->gl_format[u->plane],
+				     u->width, u->height, 0,
+				     format, gs->gl_pixel_type,
+				     (void *) (base + offset));
+		else
+			glTexSubImage2D(GL_TEXTURE_2D, 0,
+					u->x, u->y, u->width, u->height,
+					format, gs->gl_pixel_type,
+					(void *) (base + offset));
+
+		offset += (stride * u->height + 15) & ~15;
+	}
+
+	gr->draw_stats.upload_bytes += total;
+	ret = 0;
+
+unbind:
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+out:
+	wl_array_release(&rects);
+	return ret;
+}
+
 static void
 gl_renderer_flush_damage(struct weston_surface *surface)
 {
@@ -1603,6 +2524,10 @@ gl_renderer_flush_damage(struct weston_surface *surface)
 	    !gs->needs_full_upload)
 		goto done;
 
+	if (gr->has_pbo &&
+	    gl_renderer_flush_damage_pbo(gr, surface, gs, buffer) == 0)
+		goto done;
+
 	data = wl_shm_buffer_get_data(buffer->shm_buffer);
 
 	if (!gr->has_unpack_subimage) {
@@ -1617,6 +2542,11 @@ gl_renderer_flush_damage(struct weston_surface *surface)
 				     gl_format_from_internal(gs->gl_format[j]),
 				     gs->gl_pixel_type,
 				     data + gs->offset[j]);
+			gr->draw_stats.upload_bytes +=
+				(uint64_t) gs->pitch / gs->hsub[j] *
+				(buffer->height / gs->vsub[j]) *
+				gl_format_texel_size(gs->gl_format[j],
+						     gs->gl_pixel_type);
 		}
 		wl_shm_buffer_end_access(buffer->shm_buffer);
 
@@ -1639,6 +2569,11 @@ gl_renderer_flush_damage(struct weston_surface *surface)
 				     gl_format_from_internal(gs->gl_format[j]),
 				     gs->gl_pixel_type,
 				     data + gs->offset[j]);
+			gr->draw_stats.upload_bytes +=
+				(uint64_t) gs->pitch / gs->hsub[j] *
+				(buffer->height / gs->vsub[j]) *
+				gl_format_texel_size(gs->gl_format[j],
+						     gs->gl_pixel_type);
 		}
 		wl_shm_buffer_end_access(buffer->shm_buffer);
 		goto done;
@@ -1667,6 +2602,11 @@ gl_renderer_flush_damage(struct weston_surface *surface)
 					gl_format_from_internal(gs->gl_format[j]),
 					gs->gl_pixel_type,
 					data + gs->offset[j]);
+			gr->draw_stats.upload_bytes +=
+				(uint64_t) (r.x2 - r.x1) / gs->hsub[j] *
+				((r.y2 - r.y1) / gs->vsub[j]) *
+				gl_format_texel_size(gs->gl_format[j],
+						     gs->gl_pixel_type);
 		}
 	}
 	wl_shm_buffer_end_access(buffer->shm_buffer);
@@ -2831,6 +3771,9 @@ surface_state_destroy(struct gl_surface_state *gs, struct gl_renderer *gr)
 
 	gs->surface->renderer_state = NULL;
 
+	if (gs->gpu_timing)
+		gl_gpu_timing_surface_release(gs->gpu_timing);
+
 	glDeleteTextures(gs->num_textures, gs->textures);
 
 	for (i = 0; i < gs->num_images; i++)
@@ -3052,32 +3995,19 @@ compile_shader(GLenum type, int count, const char **sources)
 }
 
 static int
-shader_init(struct gl_shader *shader, struct gl_renderer *renderer,
-		   const char *vertex_source, const char *fragment_source)
+shader_link(struct gl_shader *shader, const char *vertex_source,
+	    const char **fragment_sources, int count)
 {
 	char msg[512];
 	GLint status;
-	int count;
-	const char *sources[3];
 
 	shader->vertex_shader =
 		compile_shader(GL_VERTEX_SHADER, 1, &vertex_source);
 	if (shader->vertex_shader == GL_NONE)
 		return -1;
 
-	if (renderer->fragment_shader_debug) {
-		sources[0] = fragment_source;
-		sources[1] = fragment_debug;
-		sources[2] = fragment_brace;
-		count = 3;
-	} else {
-		sources[0] = fragment_source;
-		sources[1] = fragment_brace;
-		count = 2;
-	}
-
 	shader->fragment_shader =
-		compile_shader(GL_FRAGMENT_SHADER, count, sources);
+		compile_shader(GL_FRAGMENT_SHADER, count, fragment_sources);
 	if (shader->fragment_shader == GL_NONE)
 		return -1;
 
@@ -3095,6 +4025,55 @@ shader_init(struct gl_shader *shader, struct gl_renderer *renderer,
 		return -1;
 	}
 
+	return 0;
+}
+
+static int
+shader_init(struct gl_shader *shader, struct gl_renderer *renderer,
+		   const char *vertex_source, const char *fragment_source)
+{
+	struct gl_program_cache *cache = renderer->program_cache;
+	struct timespec begin, end;
+	uint64_t key = 0;
+	int count;
+	const char *sources[3];
+
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+
+	if (renderer->fragment_shader_debug) {
+		sources[0] = fragment_source;
+		sources[1] = fragment_debug;
+		sources[2] = fragment_brace;
+		count = 3;
+	} else {
+		sources[0] = fragment_source;
+		sources[1] = fragment_brace;
+		count = 2;
+	}
+
+	/* A cached binary already has the attribute locations bound. */
+	if (cache) {
+		key = gl_program_cache_key(cache, vertex_source,
+					   sources, count);
+		shader->program = glCreateProgram();
+		if (!gl_program_cache_load(cache, key, shader->program)) {
+			glDeleteProgram(shader->program);
+			shader->program = 0;
+			cache = NULL;
+		}
+	}
+
+	if (!cache) {
+		if (shader_link(shader, vertex_source, sources, count) < 0)
+			return -1;
+		if (renderer->program_cache)
+			gl_program_cache_store(renderer->program_cache, key,
+					       shader->program);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	renderer->program_build_nsec += timespec_sub_to_nsec(&end, &begin);
+
 	shader->proj_uniform = glGetUniformLocation(shader->program, "proj");
 	shader->tex_uniforms[0] = glGetUniformLocation(shader->program, "tex");
 	shader->tex_uniforms[1] = glGetUniformLocation(shader->program, "tex1");
@@ -3255,6 +4234,8 @@ gl_renderer_output_create(struct weston_output *output,
 		pixman_region32_init(&go->buffer_damage[i]);
 
 	wl_list_init(&go->timeline_render_point_list);
+	wl_list_init(&go->layer_caches);
+	gl_gpu_timing_output_init(&go->gpu_timing);
 
 	go->begin_render_sync = EGL_NO_SYNC_KHR;
 	go->end_render_sync = EGL_NO_SYNC_KHR;
@@ -3335,11 +4316,17 @@ gl_renderer_output_destroy(struct weston_output *output)
 	struct gl_renderer *gr = get_renderer(output->compositor);
 	struct gl_output_state *go = get_output_state(output);
 	struct timeline_render_point *trp, *tmp;
+	struct gl_layer_cache *cache, *next;
 	int i;
 
 	for (i = 0; i < 2; i++)
 		pixman_region32_fini(&go->buffer_damage[i]);
 
+	wl_list_for_each_safe(cache, next, &go->layer_caches, link)
+		gl_layer_cache_destroy(cache);
+
+	gl_gpu_timing_output_fini(&gr->gpu_timing, &go->gpu_timing);
+
 	eglMakeCurrent(gr->egl_display,
 		       EGL_NO_SURFACE, EGL_NO_SURFACE,
 		       EGL_NO_CONTEXT);
@@ -3390,6 +4377,8 @@ gl_renderer_destroy(struct weston_compositor *ec)
 	if (gr->has_bind_display)
 		gr->unbind_display(gr->egl_display, ec->wl_display);
 
+	gl_gpu_timing_fini(&gr->gpu_timing);
+
 	/* Work around crash in egl_dri2.c's dri2_make_current() - when does this apply? */
 	eglMakeCurrent(gr->egl_display,
 		       EGL_NO_SURFACE, EGL_NO_SURFACE,
@@ -3413,12 +4402,22 @@ gl_renderer_destroy(struct weston_compositor *ec)
 
 	wl_array_release(&gr->vertices);
 	wl_array_release(&gr->vtxcnt);
+	wl_array_release(&gr->clip_scratch);
+	wl_array_release(&gr->indices);
+	wl_array_release(&gr->batch_draws);
+	wl_array_release(&gr->view_draws);
 
 	if (gr->fragment_binding)
 		weston_binding_destroy(gr->fragment_binding);
 	if (gr->fan_binding)
 		weston_binding_destroy(gr->fan_binding);
 
+	weston_log_scope_destroy(gr->draw_scope);
+	weston_log_scope_destroy(gr->gpu_timing.scope);
+
+	if (gr->program_cache)
+		gl_program_cache_destroy(gr->program_cache);
+
 	free(gr);
 }
 
@@ -3619,6 +4618,21 @@ fragment_debug_binding(struct weston_keyboard *keyboard,
 
 	gr->fragment_shader_debug = !gr->fragment_shader_debug;
 
+	/* The debug shader tints every drawn pixel, which shows overdraw;
+	 * put numbers on it too. */
+	wl_list_for_each(output, &ec->output_list, link) {
+		struct gl_output_state *go = get_output_state(output);
+
+		if (!go)
+			continue;
+
+		weston_log("output %s: %u of %u views culled, overdraw %.2f "
+			   "without culling, %.2f with\n", output->name,
+			   go->last_stats.culled, go->last_stats.views,
+			   overdraw_ratio(&go->last_stats, false),
+			   overdraw_ratio(&go->last_stats, true));
+	}
+
 	shader_release(&gr->texture_shader_rgba);
 	shader_release(&gr->texture_shader_rgbx);
 	shader_release(&gr->texture_shader_egl_external);
@@ -3648,6 +4662,26 @@ fan_debug_repaint_binding(struct weston_keyboard *keyboard,
 	weston_compositor_damage_all(compositor);
 }
 
+/* Print the GPU time gathered so far, per output and per surface. */
+static void
+gpu_timing_subscribe(struct weston_log_subscription *sub, void *data)
+{
+	struct weston_compositor *compositor = data;
+	struct gl_renderer *gr = get_renderer(compositor);
+	struct weston_output *output;
+	struct gl_output_state *go;
+
+	wl_list_for_each(output, &compositor->output_list, link) {
+		go = get_output_state(output);
+		if (go)
+			gl_gpu_timing_print_output(sub, output->name,
+						   &go->gpu_timing);
+	}
+
+	weston_log_subscription_printf(sub, "surfaces:\n");
+	gl_gpu_timing_print_surfaces(&gr->gpu_timing, sub);
+}
+
 static uint32_t
 get_gl_version(void)
 {
@@ -3771,9 +4805,24 @@ gl_renderer_setup(struct weston_compositor *ec, EGLSurface egl_surface)
 	    weston_check_egl_extension(extensions, "GL_EXT_texture_rg"))
 		gr->has_gl_texture_rg = true;
 
+	if (gr->gl_version >= GR_GL_VERSION(3, 0)) {
+		gr->map_buffer_range =
+			(void *) eglGetProcAddress("glMapBufferRange");
+		gr->unmap_buffer = (void *) eglGetProcAddress("glUnmapBuffer");
+		gr->has_pbo = gr->map_buffer_range && gr->unmap_buffer &&
+			      !getenv("WESTON_GL_DISABLE_PBO");
+	}
+
 	if (weston_check_egl_extension(extensions, "GL_OES_EGL_image_external"))
 		gr->has_egl_image_external = true;
 
+	/* Vertex buffer objects are core in GLES 2. */
+	gr->batching = !getenv("WESTON_GL_DISABLE_BATCHING");
+
+	gr->program_cache = gl_program_cache_create(extensions, gr->gl_version);
+
+	gl_gpu_timing_init(&gr->gpu_timing, extensions);
+
 	glActiveTexture(GL_TEXTURE0);
 
 	if (compile_shaders(ec))
@@ -3788,6 +4837,21 @@ gl_renderer_setup(struct weston_compositor *ec, EGLSurface egl_surface)
 						    fan_debug_repaint_binding,
 						    ec);
 
+	gr->draw_scope =
+		weston_compositor_add_log_scope(ec, "gl-draw-stats",
+						"GL renderer draw calls and "
+						"vertices per output repaint\n",
+						NULL, NULL, NULL);
+
+	if (gr->gpu_timing.supported)
+		gr->gpu_timing.scope =
+			weston_compositor_add_log_scope(ec, "gl-gpu-timing",
+							"GPU time of each "
+							"output repaint, per "
+							"surface\n",
+							gpu_timing_subscribe,
+							NULL, ec);
+
 	gr->output_destroy_listener.notify = output_handle_destroy;
 	wl_signal_add(&ec->output_destroyed_signal,
 		      &gr->output_destroy_listener);
@@ -3797,8 +4861,16 @@ gl_renderer_setup(struct weston_compositor *ec, EGLSurface egl_surface)
 		ec->read_format == PIXMAN_a8r8g8b8 ? "BGRA" : "RGBA");
 	weston_log_continue(STAMP_SPACE "wl_shm sub-image to texture: %s\n",
 			    gr->has_unpack_subimage ? "yes" : "no");
+	weston_log_continue(STAMP_SPACE "wl_shm upload through PBOs: %s\n",
+			    gr->has_pbo ? "yes" : "no");
 	weston_log_continue(STAMP_SPACE "EGL Wayland extension: %s\n",
 			    gr->has_bind_display ? "yes" : "no");
+	weston_log_continue(STAMP_SPACE "batched draws: %s\n",
+			    gr->batching ? "yes" : "no");
+	weston_log_continue(STAMP_SPACE "GPU timer queries: %s\n",
+			    gr->gpu_timing.supported ? "yes" : "no");
+	weston_log_continue(STAMP_SPACE "program binary cache: %s\n",
+			    gr->program_cache ? gr->program_cache->dir : "no");
 
 
 	return 0;
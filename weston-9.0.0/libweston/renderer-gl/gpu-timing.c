@@ -0,0 +1,548 @@
+/*
+ * Copyright © 2026 The Annland Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libweston/libweston.h>
+#include <libweston/weston-log.h>
+#include <libweston/zalloc.h>
+
+#include "shared/helpers.h"
+#include "shared/platform.h"
+#include "gl-renderer.h"
+#include "gl-renderer-internal.h"
+
+/*
+ * Each view, layer cache update and border pass drawn during a repaint is
+ * bracketed by a GL_TIME_ELAPSED_EXT query. The queries of a frame are
+ * read back on a later repaint of the same output, once they are all
+ * available, so measuring never waits for the GPU. Frames that overlap a
+ * GPU disjoint event (power state change, context loss...) are dropped.
+ */
+
+/* Query objects are created in batches of this many. */
+#define GPU_TIMING_QUERY_BATCH 32
+
+/* Surfaces named in the report of a frame. */
+#define GPU_TIMING_TOP_SURFACES 3
+
+void
+gl_gpu_timing_init(struct gl_gpu_timing *timing, const char *extensions)
+{
+	memset(timing, 0, sizeof *timing);
+	wl_array_init(&timing->free_queries);
+	wl_list_init(&timing->surfaces);
+
+	if (!weston_check_egl_extension(extensions,
+					"GL_EXT_disjoint_timer_query"))
+		return;
+
+	timing->gen_queries = (void *) eglGetProcAddress("glGenQueriesEXT");
+	timing->delete_queries =
+		(void *) eglGetProcAddress("glDeleteQueriesEXT");
+	timing->begin_query = (void *) eglGetProcAddress("glBeginQueryEXT");
+	timing->end_query = (void *) eglGetProcAddress("glEndQueryEXT");
+	timing->get_query_objectuiv =
+		(void *) eglGetProcAddress("glGetQueryObjectuivEXT");
+	timing->get_query_objectui64v =
+		(void *) eglGetProcAddress("glGetQueryObjectui64vEXT");
+
+	timing->supported = timing->gen_queries && timing->delete_queries &&
+			    timing->begin_query && timing->end_query &&
+			    timing->get_query_objectuiv &&
+			    timing->get_query_objectui64v;
+}
+
+/* The GL context must be current. */
+void
+gl_gpu_timing_fini(struct gl_gpu_timing *timing)
+{
+	if (timing->free_queries.size > 0)
+		timing->delete_queries(timing->free_queries.size /
+				       sizeof(GLuint),
+				       timing->free_queries.data);
+	wl_array_release(&timing->free_queries);
+}
+
+void
+gl_gpu_timing_output_init(struct gl_gpu_timing_output *out)
+{
+	int i;
+
+	memset(out, 0, sizeof *out);
+	for (i = 0; i < GL_GPU_TIMING_FRAMES; i++)
+		wl_array_init(&out->frames[i]);
+}
+
+static struct gl_gpu_timing_surface *
+surface_timing_ref(struct gl_gpu_timing_surface *st)
+{
+	st->refcount++;
+
+	return st;
+}
+
+static void
+surface_timing_unref(struct gl_gpu_timing_surface *st)
+{
+	if (--st->refcount > 0)
+		return;
+
+	free(st);
+}
+
+/** Forget the surface of a surface timing
+ *
+ * Called when the surface state is destroyed. Queries still in flight
+ * keep the structure alive until they are read.
+ */
+void
+gl_gpu_timing_surface_release(struct gl_gpu_timing_surface *st)
+{
+	st->surface = NULL;
+	wl_list_remove(&st->link);
+	wl_list_init(&st->link);
+	surface_timing_unref(st);
+}
+
+static GLuint
+query_get(struct gl_gpu_timing *timing)
+{
+	GLuint *queries, query;
+
+	if (timing->free_queries.size == 0) {
+		queries = wl_array_add(&timing->free_queries,
+				       GPU_TIMING_QUERY_BATCH * sizeof *queries);
+		if (!queries)
+			return 0;
+		timing->gen_queries(GPU_TIMING_QUERY_BATCH, queries);
+	}
+
+	timing->free_queries.size -= sizeof query;
+	memcpy(&query, (char *) timing->free_queries.data +
+			timing->free_queries.size, sizeof query);
+
+	return query;
+}
+
+static void
+query_put(struct gl_gpu_timing *timing, GLuint query)
+{
+	GLuint *slot;
+
+	slot = wl_array_add(&timing->free_queries, sizeof *slot);
+	if (slot)
+		*slot = query;
+	else
+		timing->delete_queries(1, &query);
+}
+
+static void
+frame_release(struct gl_gpu_timing *timing, struct wl_array *frame)
+{
+	struct gl_gpu_timing_sample *sample;
+
+	wl_array_for_each(sample, frame) {
+		query_put(timing, sample->query);
+		if (sample->surface)
+			surface_timing_unref(sample->surface);
+	}
+	frame->size = 0;
+}
+
+/* The GL context must be current. */
+void
+gl_gpu_timing_output_fini(struct gl_gpu_timing *timing,
+			  struct gl_gpu_timing_output *out)
+{
+	int i;
+
+	out->nested = 0;
+	if (out->query_active)
+		gl_gpu_timing_end(timing, out);
+
+	for (i = 0; i < GL_GPU_TIMING_FRAMES; i++) {
+		frame_release(timing, &out->frames[i]);
+		wl_array_release(&out->frames[i]);
+	}
+}
+
+static void
+gpu_time_add(struct gl_gpu_time *time, uint64_t nsec)
+{
+	time->frames++;
+	time->total_nsec += nsec;
+	if (nsec > time->max_nsec)
+		time->max_nsec = nsec;
+}
+
+static bool
+frame_available(struct gl_gpu_timing *timing, struct wl_array *frame)
+{
+	struct gl_gpu_timing_sample *sample;
+	GLuint available;
+
+	wl_array_for_each(sample, frame) {
+		timing->get_query_objectuiv(sample->query,
+					    GL_QUERY_RESULT_AVAILABLE_EXT,
+					    &available);
+		if (!available)
+			return false;
+	}
+
+	return true;
+}
+
+static void
+surface_timing_label(const struct gl_gpu_timing_surface *st,
+		     char *buf, size_t len)
+{
+	struct weston_surface *surface = st->surface;
+	struct wl_client *client;
+	pid_t pid = 0;
+	int n = 0;
+
+	if (!surface) {
+		snprintf(buf, len, "(destroyed surface)");
+		return;
+	}
+
+	if (surface->resource) {
+		client = wl_resource_get_client(surface->resource);
+		wl_client_get_credentials(client, &pid, NULL, NULL);
+		n = snprintf(buf, len, "pid %d surface %u: ", (int) pid,
+			     wl_resource_get_id(surface->resource));
+		if (n < 0 || (size_t) n >= len)
+			return;
+	}
+
+	if (!surface->get_label ||
+	    surface->get_label(surface, buf + n, len - n) < 0)
+		snprintf(buf + n, len - n, "(unlabelled)");
+}
+
+static double
+nsec_to_msec(uint64_t nsec)
+{
+	return nsec / 1000000.0;
+}
+
+static void
+frame_print(struct gl_gpu_timing *timing, const char *output_name,
+	    uint64_t total, uint64_t views, uint64_t layer_caches,
+	    uint64_t borders, struct gl_gpu_timing_surface **top, int n_top)
+{
+	char timestr[128];
+	char label[128];
+	int i;
+
+	weston_log_scope_timestamp(timing->scope, timestr, sizeof timestr);
+	weston_log_scope_printf(timing->scope,
+				"%s output %s: GPU %.3f ms (views %.3f ms, "
+				"layer caches %.3f ms, borders %.3f ms)\n",
+				timestr, output_name, nsec_to_msec(total),
+				nsec_to_msec(views), nsec_to_msec(layer_caches),
+				nsec_to_msec(borders));
+
+	for (i = 0; i < n_top; i++) {
+		surface_timing_label(top[i], label, sizeof label);
+		weston_log_scope_printf(timing->scope,
+					"%s   %.3f ms %s\n", timestr,
+					nsec_to_msec(top[i]->frame_nsec),
+					label);
+	}
+}
+
+static void
+frame_read(struct gl_gpu_timing *timing, struct gl_gpu_timing_output *out,
+	   struct wl_array *frame, const char *output_name)
+{
+	struct gl_gpu_timing_surface *top[GPU_TIMING_TOP_SURFACES];
+	struct gl_gpu_timing_surface *st;
+	struct gl_gpu_timing_sample *sample;
+	uint64_t per_kind[GL_GPU_TIMING_BORDERS + 1] = { 0 };
+	uint64_t total = 0;
+	GLuint64 nsec;
+	int n_top = 0;
+	int i;
+
+	timing->frame_serial++;
+
+	wl_array_for_each(sample, frame) {
+		timing->get_query_objectui64v(sample->query,
+					      GL_QUERY_RESULT_EXT, &nsec);
+		per_kind[sample->kind] += nsec;
+		total += nsec;
+
+		st = sample->surface;
+		if (!st)
+			continue;
+
+		/* A view can be drawn in two passes, and a surface can
+		 * have several views. */
+		if (st->frame_serial != timing->frame_serial) {
+			st->frame_serial = timing->frame_serial;
+			st->frame_nsec = 0;
+			st->frame_counted = false;
+		}
+		st->frame_nsec += nsec;
+	}
+
+	/* Fold the surface times in and keep the most expensive ones. */
+	wl_array_for_each(sample, frame) {
+		st = sample->surface;
+		if (!st || st->frame_counted)
+			continue;
+
+		st->frame_counted = true;
+		gpu_time_add(&st->time, st->frame_nsec);
+
+		for (i = n_top; i > 0; i--) {
+			if (top[i - 1]->frame_nsec >= st->frame_nsec)
+				break;
+			if (i < GPU_TIMING_TOP_SURFACES)
+				top[i] = top[i - 1];
+		}
+		if (i < GPU_TIMING_TOP_SURFACES) {
+			top[i] = st;
+			if (n_top < GPU_TIMING_TOP_SURFACES)
+				n_top++;
+		}
+	}
+
+	gpu_time_add(&out->total, total);
+	gpu_time_add(&out->views, per_kind[GL_GPU_TIMING_VIEW]);
+	gpu_time_add(&out->layer_caches, per_kind[GL_GPU_TIMING_LAYER_CACHE]);
+	gpu_time_add(&out->borders, per_kind[GL_GPU_TIMING_BORDERS]);
+
+	if (weston_log_scope_is_enabled(timing->scope))
+		frame_print(timing, output_name, total,
+			    per_kind[GL_GPU_TIMING_VIEW],
+			    per_kind[GL_GPU_TIMING_LAYER_CACHE],
+			    per_kind[GL_GPU_TIMING_BORDERS], top, n_top);
+}
+
+/* Read back the frames in flight whose results have arrived, oldest
+ * first. */
+static void
+output_collect(struct gl_gpu_timing *timing, struct gl_gpu_timing_output *out,
+	       const char *output_name)
+{
+	struct wl_array *frame;
+	GLint disjoint = 0;
+
+	if (out->count == 0)
+		return;
+
+	/* Reading the flag clears it. Results of any query in flight
+	 * during a disjoint event are meaningless. */
+	glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+	if (disjoint) {
+		while (out->count > 0) {
+			frame_release(timing, &out->frames[out->head]);
+			out->head = (out->head + 1) % GL_GPU_TIMING_FRAMES;
+			out->count--;
+			out->disjoint++;
+		}
+		return;
+	}
+
+	while (out->count > 0) {
+		frame = &out->frames[out->head];
+		if (!frame_available(timing, frame))
+			break;
+
+		frame_read(timing, out, frame, output_name);
+		frame_release(timing, frame);
+		out->head = (out->head + 1) % GL_GPU_TIMING_FRAMES;
+		out->count--;
+	}
+}
+
+/** Start measuring an output repaint
+ *
+ * Reads back the results of earlier frames, then starts recording queries
+ * if the debug scope has subscribers and a frame slot is free.
+ */
+void
+gl_gpu_timing_begin_frame(struct gl_gpu_timing *timing,
+			  struct gl_gpu_timing_output *out,
+			  const char *output_name)
+{
+	if (!timing->supported)
+		return;
+
+	output_collect(timing, out, output_name);
+
+	out->recording = NULL;
+	if (!weston_log_scope_is_enabled(timing->scope))
+		return;
+
+	if (out->count == GL_GPU_TIMING_FRAMES) {
+		out->skipped++;
+		return;
+	}
+
+	out->recording = &out->frames[(out->head + out->count) %
+				      GL_GPU_TIMING_FRAMES];
+	out->recording->size = 0;
+}
+
+void
+gl_gpu_timing_end_frame(struct gl_gpu_timing *timing,
+			struct gl_gpu_timing_output *out)
+{
+	if (!out->recording)
+		return;
+
+	if (out->recording->size > 0)
+		out->count++;
+	out->recording = NULL;
+}
+
+/** Start a timer query for what is drawn next
+ *
+ * Does nothing unless a frame is being recorded. Every call must be
+ * paired with gl_gpu_timing_end(). Queries cannot nest in GL, so a call
+ * made while a query is active, e.g. for a view redrawn into a layer
+ * cache, starts nothing and its time is counted in the outer query.
+ * For views, the surface timing is created in *surface_timing on first
+ * use and belongs to the caller from then on.
+ */
+void
+gl_gpu_timing_begin(struct gl_gpu_timing *timing,
+		    struct gl_gpu_timing_output *out,
+		    enum gl_gpu_timing_kind kind,
+		    struct gl_gpu_timing_surface **surface_timing,
+		    struct weston_surface *surface)
+{
+	struct gl_gpu_timing_sample *sample;
+	struct gl_gpu_timing_surface *st = NULL;
+	GLuint query;
+
+	if (!out->recording)
+		return;
+
+	if (out->query_active) {
+		out->nested++;
+		return;
+	}
+
+	if (surface_timing) {
+		st = *surface_timing;
+		if (!st) {
+			st = zalloc(sizeof *st);
+			if (!st)
+				return;
+			st->refcount = 1;
+			st->surface = surface;
+			wl_list_insert(&timing->surfaces, &st->link);
+			*surface_timing = st;
+		}
+	}
+
+	query = query_get(timing);
+	if (!query)
+		return;
+
+	sample = wl_array_add(out->recording, sizeof *sample);
+	if (!sample) {
+		query_put(timing, query);
+		return;
+	}
+
+	sample->query = query;
+	sample->kind = kind;
+	sample->surface = st ? surface_timing_ref(st) : NULL;
+
+	timing->begin_query(GL_TIME_ELAPSED_EXT, query);
+	out->query_active = true;
+}
+
+void
+gl_gpu_timing_end(struct gl_gpu_timing *timing,
+		  struct gl_gpu_timing_output *out)
+{
+	if (!out->query_active)
+		return;
+
+	if (out->nested > 0) {
+		out->nested--;
+		return;
+	}
+
+	timing->end_query(GL_TIME_ELAPSED_EXT);
+	out->query_active = false;
+}
+
+static void
+gpu_time_print(struct weston_log_subscription *sub, const char *name,
+	       const struct gl_gpu_time *time)
+{
+	weston_log_subscription_printf(sub,
+				       "  %s: %" PRIu64 " frames, "
+				       "average %.3f ms, max %.3f ms\n", name,
+				       time->frames,
+				       time->frames ?
+				       nsec_to_msec(time->total_nsec) /
+				       time->frames : 0.0,
+				       nsec_to_msec(time->max_nsec));
+}
+
+void
+gl_gpu_timing_print_output(struct weston_log_subscription *sub,
+			   const char *output_name,
+			   const struct gl_gpu_timing_output *out)
+{
+	weston_log_subscription_printf(sub, "output %s: %" PRIu64 " frames "
+				       "skipped, %" PRIu64 " dropped on GPU "
+				       "disjoint events\n", output_name,
+				       out->skipped, out->disjoint);
+	gpu_time_print(sub, "total", &out->total);
+	gpu_time_print(sub, "views", &out->views);
+	gpu_time_print(sub, "layer caches", &out->layer_caches);
+	gpu_time_print(sub, "borders", &out->borders);
+}
+
+void
+gl_gpu_timing_print_surfaces(struct gl_gpu_timing *timing,
+			     struct weston_log_subscription *sub)
+{
+	struct gl_gpu_timing_surface *st;
+	char label[128];
+
+	wl_list_for_each(st, &timing->surfaces, link) {
+		if (st->time.frames == 0)
+			continue;
+
+		surface_timing_label(st, label, sizeof label);
+		gpu_time_print(sub, label, &st->time);
+	}
+}
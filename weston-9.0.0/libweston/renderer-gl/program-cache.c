@@ -0,0 +1,330 @@
+/*
+ * Copyright © 2026 The Annland Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <libweston/zalloc.h>
+
+#include "shared/helpers.h"
+#include "shared/platform.h"
+#include "gl-renderer.h"
+#include "gl-renderer-internal.h"
+
+/*
+ * Linked programs are kept as files named after a 64-bit FNV-1a hash of
+ * the GL vendor, renderer and version strings and of all shader sources.
+ * A driver update changes the version string and so invalidates the
+ * entries; an entry the driver rejects anyway is removed and rebuilt.
+ */
+
+#define PROGRAM_CACHE_MAGIC 0x50474c57 /* "WLGP" */
+#define PROGRAM_CACHE_VERSION 1
+
+/* Programs are a few tens of kB; anything much bigger is not ours. */
+#define PROGRAM_CACHE_MAX_BINARY (16 * 1024 * 1024)
+
+struct program_cache_header {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t key;
+	uint32_t format;
+	uint32_t length;
+};
+
+static uint64_t
+fnv1a(uint64_t hash, const char *str)
+{
+	const unsigned char *p;
+
+	for (p = (const unsigned char *) str; p && *p; p++) {
+		hash ^= *p;
+		hash *= 0x100000001b3ull;
+	}
+
+	/* Separate the strings, so that "ab" "c" differs from "a" "bc". */
+	hash ^= 0xff;
+	hash *= 0x100000001b3ull;
+
+	return hash;
+}
+
+static char *
+program_cache_dir(void)
+{
+	const char *env = getenv("WESTON_GL_PROGRAM_CACHE");
+	const char *dir;
+	char *path;
+	int ret;
+
+	if (env)
+		return *env ? strdup(env) : NULL;
+
+	dir = getenv("XDG_CACHE_HOME");
+	if (dir)
+		ret = asprintf(&path, "%s/weston/gl-programs", dir);
+	else if ((dir = getenv("HOME")))
+		ret = asprintf(&path, "%s/.cache/weston/gl-programs", dir);
+	else
+		return NULL;
+
+	return ret < 0 ? NULL : path;
+}
+
+/** Set up the program binary cache
+ *
+ * \return The cache, or NULL if the driver cannot export program binaries
+ * or there is no cache directory, in which case programs are always
+ * compiled from source.
+ */
+struct gl_program_cache *
+gl_program_cache_create(const char *extensions, uint32_t gl_version)
+{
+	struct gl_program_cache *cache;
+	GLint n_formats = 0;
+
+	if (gl_version < GR_GL_VERSION(3, 0) &&
+	    !weston_check_egl_extension(extensions,
+					"GL_OES_get_program_binary"))
+		return NULL;
+
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS_OES, &n_formats);
+	if (n_formats <= 0)
+		return NULL;
+
+	cache = zalloc(sizeof *cache);
+	if (!cache)
+		return NULL;
+
+	if (gl_version >= GR_GL_VERSION(3, 0)) {
+		cache->get_program_binary =
+			(void *) eglGetProcAddress("glGetProgramBinary");
+		cache->program_binary =
+			(void *) eglGetProcAddress("glProgramBinary");
+	} else {
+		cache->get_program_binary =
+			(void *) eglGetProcAddress("glGetProgramBinaryOES");
+		cache->program_binary =
+			(void *) eglGetProcAddress("glProgramBinaryOES");
+	}
+
+	cache->dir = program_cache_dir();
+	if (!cache->get_program_binary || !cache->program_binary ||
+	    !cache->dir) {
+		gl_program_cache_destroy(cache);
+		return NULL;
+	}
+
+	cache->driver_hash = 0xcbf29ce484222325ull;
+	cache->driver_hash = fnv1a(cache->driver_hash,
+				   (const char *) glGetString(GL_VENDOR));
+	cache->driver_hash = fnv1a(cache->driver_hash,
+				   (const char *) glGetString(GL_RENDERER));
+	cache->driver_hash = fnv1a(cache->driver_hash,
+				   (const char *) glGetString(GL_VERSION));
+
+	return cache;
+}
+
+void
+gl_program_cache_destroy(struct gl_program_cache *cache)
+{
+	free(cache->dir);
+	free(cache);
+}
+
+uint64_t
+gl_program_cache_key(struct gl_program_cache *cache,
+		     const char *vertex_source,
+		     const char **fragment_sources, int count)
+{
+	uint64_t key;
+	int i;
+
+	key = fnv1a(cache->driver_hash, vertex_source);
+	for (i = 0; i < count; i++)
+		key = fnv1a(key, fragment_sources[i]);
+
+	return key;
+}
+
+static void
+program_cache_path(struct gl_program_cache *cache, uint64_t key,
+		   char *path, size_t len)
+{
+	snprintf(path, len, "%s/%016" PRIx64 ".bin", cache->dir, key);
+}
+
+/** Link a program from its cached binary
+ *
+ * \param program A program object without shaders attached.
+ * \return True if the program was linked from the cache.
+ */
+bool
+gl_program_cache_load(struct gl_program_cache *cache, uint64_t key,
+		      GLuint program)
+{
+	struct program_cache_header header;
+	char path[PATH_MAX];
+	void *binary = NULL;
+	GLint status = 0;
+	int fd;
+
+	program_cache_path(cache, key, path, sizeof path);
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		goto miss;
+
+	if (read(fd, &header, sizeof header) != sizeof header ||
+	    header.magic != PROGRAM_CACHE_MAGIC ||
+	    header.version != PROGRAM_CACHE_VERSION ||
+	    header.key != key ||
+	    header.length == 0 ||
+	    header.length > PROGRAM_CACHE_MAX_BINARY)
+		goto stale;
+
+	binary = malloc(header.length);
+	if (!binary ||
+	    read(fd, binary, header.length) != (ssize_t) header.length)
+		goto stale;
+
+	cache->program_binary(program, header.format, binary, header.length);
+	glGetProgramiv(program, GL_LINK_STATUS, &status);
+	if (!status)
+		goto stale;
+
+	free(binary);
+	close(fd);
+	cache->hits++;
+
+	return true;
+
+stale:
+	weston_log("GL program cache: discarding %s\n", path);
+	unlink(path);
+	free(binary);
+	close(fd);
+miss:
+	cache->misses++;
+
+	return false;
+}
+
+static int
+mkdir_parents(char *path)
+{
+	char *p;
+
+	for (p = path + 1; *p; p++) {
+		if (*p != '/')
+			continue;
+
+		*p = '\0';
+		if (mkdir(path, 0700) < 0 && errno != EEXIST) {
+			*p = '/';
+			return -1;
+		}
+		*p = '/';
+	}
+
+	if (mkdir(path, 0700) < 0 && errno != EEXIST)
+		return -1;
+
+	return 0;
+}
+
+/** Save the binary of a freshly linked program
+ *
+ * The file is written under a temporary name and renamed, so that a
+ * concurrent or interrupted compositor never sees a partial entry.
+ */
+void
+gl_program_cache_store(struct gl_program_cache *cache, uint64_t key,
+		       GLuint program)
+{
+	struct program_cache_header header = {
+		.magic = PROGRAM_CACHE_MAGIC,
+		.version = PROGRAM_CACHE_VERSION,
+		.key = key,
+	};
+	char path[PATH_MAX], tmp[PATH_MAX];
+	GLint length = 0;
+	GLsizei written = 0;
+	GLenum format;
+	void *binary;
+	bool ok;
+	int fd;
+
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH_OES, &length);
+	if (length <= 0 || length > PROGRAM_CACHE_MAX_BINARY)
+		return;
+
+	binary = malloc(length);
+	if (!binary)
+		return;
+
+	cache->get_program_binary(program, length, &written, &format, binary);
+	if (written <= 0)
+		goto out;
+
+	header.format = format;
+	header.length = written;
+
+	if (mkdir_parents(cache->dir) < 0) {
+		weston_log("GL program cache: cannot create %s: %s\n",
+			   cache->dir, strerror(errno));
+		goto out;
+	}
+
+	program_cache_path(cache, key, path, sizeof path);
+	snprintf(tmp, sizeof tmp, "%s/.tmp-XXXXXX", cache->dir);
+	fd = mkostemp(tmp, O_CLOEXEC);
+	if (fd < 0)
+		goto out;
+
+	ok = write(fd, &header, sizeof header) == sizeof header &&
+	     write(fd, binary, written) == written;
+	close(fd);
+
+	if (!ok || rename(tmp, path) < 0) {
+		weston_log("GL program cache: cannot write %s\n", path);
+		unlink(tmp);
+		goto out;
+	}
+
+	cache->stored++;
+
+out:
+	free(binary);
+}
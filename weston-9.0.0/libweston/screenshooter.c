@@ -33,6 +33,9 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
 #include <sys/uio.h>
 
 #include <libweston/libweston.h>
@@ -42,6 +45,7 @@
 #include "libweston-internal.h"
 
 #include "wcap/wcap-decode.h"
+#include "wcap/wcap-rle.h"
 
 struct screenshooter_frame_listener {
 	struct wl_listener listener;
@@ -214,50 +218,168 @@ weston_screenshooter_shoot(struct weston_output *output,
 	return 0;
 }
 
+/* Frames captured on the compositor thread and waiting to be encoded.
+ * One more than this is never needed: the encoder works on one slot while
+ * the others fill up. */
+#define RECORDER_QUEUE_LENGTH 4
+
+struct recorder_frame {
+	uint32_t msecs;
+	pixman_box32_t *rects;
+	int n_rects;
+	int rects_alloc;
+	uint32_t *pixels;	/* all rects, read_pixels() layout */
+	size_t pixels_alloc;
+};
+
 struct weston_recorder {
 	struct weston_output *output;
-	uint32_t *frame, *rect;
-	uint32_t *tmpbuf;
-	uint32_t total;
 	int fd;
+	int width, height;
+	int do_yflip;
 	struct wl_listener frame_listener;
-	int count, destroying;
+	int destroying;
+
+	/* Damage of frames dropped because the queue was full, in output
+	 * buffer coordinates. Recorded with the next queued frame, so the
+	 * delta encoding never misses a changed pixel. */
+	pixman_region32_t coalesced_damage;
+
+	/* Owned by the encoder thread */
+	uint32_t *frame;	/* last recorded contents of the output */
+	uint32_t *outbuf;	/* RLE output for one rect */
+
+	pthread_t encoder;
+	pthread_mutex_t mutex;
+	pthread_cond_t queued_cond;	/* a frame was queued, or quit */
+	pthread_cond_t free_cond;	/* the encoder freed a slot */
+
+	/* Protected by mutex. Slots head .. head + n_queued - 1 are queued,
+	 * the encoder works on head. */
+	struct recorder_frame queue[RECORDER_QUEUE_LENGTH];
+	unsigned int head;
+	unsigned int n_queued;
+	bool quit;
+	uint32_t total;
+	int count;
+	int dropped;
 };
 
-static uint32_t *
-output_run(uint32_t *p, uint32_t delta, int run)
+/* Runs on the encoder thread. Returns the number of bytes written. */
+static uint32_t
+recorder_encode_frame(struct weston_recorder *recorder,
+		      struct recorder_frame *f)
 {
-	int i;
+	pixman_box32_t *r = f->rects;
+	uint32_t *outbuf = recorder->outbuf;
+	uint32_t *pixels = f->pixels;
+	struct wcap_rle_encoder enc;
+	int i, j, width, height, stride, y_orig;
+	uint32_t *d, *s, *p;
+	uint32_t total = 0;
+	struct {
+		uint32_t msecs;
+		uint32_t nrects;
+	} header;
+	struct iovec v[2];
 
-	while (run > 0) {
-		if (run <= 0xe0) {
-			*p++ = delta | ((run - 1) << 24);
-			break;
+	header.msecs = f->msecs;
+	header.nrects = f->n_rects;
+	v[0].iov_base = &header;
+	v[0].iov_len = sizeof header;
+	v[1].iov_base = r;
+	v[1].iov_len = f->n_rects * sizeof *r;
+	total += writev(recorder->fd, v, 2);
+	stride = recorder->width;
+
+	for (i = 0; i < f->n_rects; i++) {
+		width = r[i].x2 - r[i].x1;
+		height = r[i].y2 - r[i].y1;
+
+		wcap_rle_encode_begin(&enc, outbuf);
+		for (j = 0; j < height; j++) {
+			if (recorder->do_yflip)
+				s = pixels + width * j;
+			else
+				s = pixels + width * (height - j - 1);
+			y_orig = r[i].y2 - j - 1;
+			d = recorder->frame + stride * y_orig + r[i].x1;
+
+			wcap_rle_encode_row(&enc, s, d, width);
 		}
 
-		i = 24 - __builtin_clz(run);
-		*p++ = delta | ((i + 0xe0) << 24);
-		run -= 1 << (7 + i);
+		p = wcap_rle_encode_end(&enc);
+
+		total += write(recorder->fd, outbuf, (p - outbuf) * 4);
+		pixels += width * height;
 	}
 
-	return p;
+	return total;
 }
 
-static uint32_t
-component_delta(uint32_t next, uint32_t prev)
+static void *
+recorder_encoder_thread(void *data)
+{
+	struct weston_recorder *recorder = data;
+	struct recorder_frame *f;
+	uint32_t size;
+
+	pthread_mutex_lock(&recorder->mutex);
+	for (;;) {
+		while (recorder->n_queued == 0 && !recorder->quit)
+			pthread_cond_wait(&recorder->queued_cond,
+					  &recorder->mutex);
+		if (recorder->n_queued == 0)
+			break;
+
+		f = &recorder->queue[recorder->head];
+		pthread_mutex_unlock(&recorder->mutex);
+
+		size = recorder_encode_frame(recorder, f);
+
+		pthread_mutex_lock(&recorder->mutex);
+		recorder->total += size;
+		recorder->count++;
+		recorder->head = (recorder->head + 1) % RECORDER_QUEUE_LENGTH;
+		recorder->n_queued--;
+		pthread_cond_signal(&recorder->free_cond);
+	}
+	pthread_mutex_unlock(&recorder->mutex);
+
+	return NULL;
+}
+
+static int
+recorder_frame_reserve(struct recorder_frame *f, int n_rects, size_t n_pixels)
 {
-	unsigned char dr, dg, db;
+	pixman_box32_t *rects;
+	uint32_t *pixels;
+
+	if (n_rects > f->rects_alloc) {
+		rects = realloc(f->rects, n_rects * sizeof *rects);
+		if (!rects)
+			return -1;
+		f->rects = rects;
+		f->rects_alloc = n_rects;
+	}
 
-	dr = (next >> 16) - (prev >> 16);
-	dg = (next >>  8) - (prev >>  8);
-	db = (next >>  0) - (prev >>  0);
+	if (n_pixels > f->pixels_alloc) {
+		pixels = realloc(f->pixels, n_pixels * sizeof *pixels);
+		if (!pixels)
+			return -1;
+		f->pixels = pixels;
+		f->pixels_alloc = n_pixels;
+	}
 
-	return (dr << 16) | (dg << 8) | (db << 0);
+	return 0;
 }
 
 static void
 weston_recorder_destroy(struct weston_recorder *recorder);
 
+/* Grab the damaged pixels and leave the encoding and file writes to the
+ * encoder thread. If all queue slots are busy, the frame is dropped and its
+ * damage is recorded with the next one instead. */
 static void
 weston_recorder_frame_notify(struct wl_listener *listener, void *data)
 {
@@ -265,25 +387,12 @@ weston_recorder_frame_notify(struct wl_listener *listener, void *data)
 		container_of(listener, struct weston_recorder, frame_listener);
 	struct weston_output *output = recorder->output;
 	struct weston_compositor *compositor = output->compositor;
-	uint32_t msecs = timespec_to_msec(&output->frame_time);
 	pixman_box32_t *r;
 	pixman_region32_t damage, transformed_damage;
-	int i, j, k, n, width, height, run, stride;
-	uint32_t delta, prev, *d, *s, *p, next;
-	struct {
-		uint32_t msecs;
-		uint32_t nrects;
-	} header;
-	struct iovec v[2];
-	int do_yflip;
-	int y_orig;
-	uint32_t *outbuf;
-
-	do_yflip = !!(compositor->capabilities & WESTON_CAP_CAPTURE_YFLIP);
-	if (do_yflip)
-		outbuf = recorder->rect;
-	else
-		outbuf = recorder->tmpbuf;
+	struct recorder_frame *f;
+	size_t n_pixels;
+	uint32_t *pixels;
+	int i, n, width, height, y_orig;
 
 	pixman_region32_init(&damage);
 	pixman_region32_init(&transformed_damage);
@@ -293,76 +402,71 @@ weston_recorder_frame_notify(struct wl_listener *listener, void *data)
 				 output->transform, output->current_scale,
 				 &damage, &transformed_damage);
 	pixman_region32_fini(&damage);
+	pixman_region32_union(&transformed_damage, &transformed_damage,
+			      &recorder->coalesced_damage);
 
 	r = pixman_region32_rectangles(&transformed_damage, &n);
-	if (n == 0) {
-		pixman_region32_fini(&transformed_damage);
-		return;
+	if (n == 0)
+		goto out;
+
+	pthread_mutex_lock(&recorder->mutex);
+	if (recorder->n_queued == RECORDER_QUEUE_LENGTH &&
+	    !recorder->destroying) {
+		recorder->dropped++;
+		pthread_mutex_unlock(&recorder->mutex);
+		pixman_region32_copy(&recorder->coalesced_damage,
+				     &transformed_damage);
+		goto out;
 	}
 
-	header.msecs = msecs;
-	header.nrects = n;
-	v[0].iov_base = &header;
-	v[0].iov_len = sizeof header;
-	v[1].iov_base = r;
-	v[1].iov_len = n * sizeof *r;
-	recorder->total += writev(recorder->fd, v, 2);
-	stride = output->current_mode->width;
+	/* The last frame must not be lost, wait for the encoder. */
+	while (recorder->n_queued == RECORDER_QUEUE_LENGTH)
+		pthread_cond_wait(&recorder->free_cond, &recorder->mutex);
+
+	f = &recorder->queue[(recorder->head + recorder->n_queued) %
+			     RECORDER_QUEUE_LENGTH];
+	pthread_mutex_unlock(&recorder->mutex);
+
+	n_pixels = 0;
+	for (i = 0; i < n; i++)
+		n_pixels += (r[i].x2 - r[i].x1) * (r[i].y2 - r[i].y1);
+
+	if (recorder_frame_reserve(f, n, n_pixels) < 0) {
+		weston_log("%s: out of memory\n", __func__);
+		pixman_region32_copy(&recorder->coalesced_damage,
+				     &transformed_damage);
+		goto out;
+	}
+
+	f->msecs = timespec_to_msec(&output->frame_time);
+	f->n_rects = n;
+	memcpy(f->rects, r, n * sizeof *r);
 
+	pixels = f->pixels;
 	for (i = 0; i < n; i++) {
 		width = r[i].x2 - r[i].x1;
 		height = r[i].y2 - r[i].y1;
 
-		if (do_yflip)
+		if (recorder->do_yflip)
 			y_orig = output->current_mode->height - r[i].y2;
 		else
 			y_orig = r[i].y1;
 
 		compositor->renderer->read_pixels(output,
-				compositor->read_format, recorder->rect,
+				compositor->read_format, pixels,
 				r[i].x1, y_orig, width, height);
+		pixels += width * height;
+	}
 
-		p = outbuf;
-		run = prev = 0; /* quiet gcc */
-		for (j = 0; j < height; j++) {
-			if (do_yflip)
-				s = recorder->rect + width * j;
-			else
-				s = recorder->rect + width * (height - j - 1);
-			y_orig = r[i].y2 - j - 1;
-			d = recorder->frame + stride * y_orig + r[i].x1;
-
-			for (k = 0; k < width; k++) {
-				next = *s++;
-				delta = component_delta(next, *d);
-				*d++ = next;
-				if (run == 0 || delta == prev) {
-					run++;
-				} else {
-					p = output_run(p, prev, run);
-					run = 1;
-				}
-				prev = delta;
-			}
-		}
-
-		p = output_run(p, prev, run);
+	pixman_region32_clear(&recorder->coalesced_damage);
 
-		recorder->total += write(recorder->fd,
-					 outbuf, (p - outbuf) * 4);
-
-#if 0
-		fprintf(stderr,
-			"%dx%d at %d,%d rle from %d to %d bytes (%f) total %dM\n",
-			width, height, r[i].x1, r[i].y1,
-			width * height * 4, (int) (p - outbuf) * 4,
-			(float) (p - outbuf) / (width * height),
-			recorder->total / 1024 / 1024);
-#endif
-	}
+	pthread_mutex_lock(&recorder->mutex);
+	recorder->n_queued++;
+	pthread_cond_signal(&recorder->queued_cond);
+	pthread_mutex_unlock(&recorder->mutex);
 
+out:
 	pixman_region32_fini(&transformed_damage);
-	recorder->count++;
 
 	if (recorder->destroying)
 		weston_recorder_destroy(recorder);
@@ -371,15 +475,48 @@ weston_recorder_frame_notify(struct wl_listener *listener, void *data)
 static void
 weston_recorder_free(struct weston_recorder *recorder)
 {
+	int i;
+
 	if (recorder == NULL)
 		return;
 
-	free(recorder->tmpbuf);
-	free(recorder->rect);
+	for (i = 0; i < RECORDER_QUEUE_LENGTH; i++) {
+		free(recorder->queue[i].rects);
+		free(recorder->queue[i].pixels);
+	}
+	pixman_region32_fini(&recorder->coalesced_damage);
+	free(recorder->outbuf);
 	free(recorder->frame);
 	free(recorder);
 }
 
+static int
+weston_recorder_start_encoder(struct weston_recorder *recorder)
+{
+	sigset_t blocked, saved;
+	int ret;
+
+	pthread_mutex_init(&recorder->mutex, NULL);
+	pthread_cond_init(&recorder->queued_cond, NULL);
+	pthread_cond_init(&recorder->free_cond, NULL);
+
+	/* Keep the compositor's signals off the encoder thread. */
+	sigfillset(&blocked);
+	pthread_sigmask(SIG_BLOCK, &blocked, &saved);
+	ret = pthread_create(&recorder->encoder, NULL,
+			     recorder_encoder_thread, recorder);
+	pthread_sigmask(SIG_SETMASK, &saved, NULL);
+
+	if (ret != 0) {
+		pthread_cond_destroy(&recorder->free_cond);
+		pthread_cond_destroy(&recorder->queued_cond);
+		pthread_mutex_destroy(&recorder->mutex);
+		return -1;
+	}
+
+	return 0;
+}
+
 static struct weston_recorder *
 weston_recorder_create(struct weston_output *output, const char *filename)
 {
@@ -387,9 +524,6 @@ weston_recorder_create(struct weston_output *output, const char *filename)
 	struct weston_recorder *recorder;
 	int stride, size;
 	struct { uint32_t magic, format, width, height; } header;
-	int do_yflip;
-
-	do_yflip = !!(compositor->capabilities & WESTON_CAP_CAPTURE_YFLIP);
 
 	recorder = zalloc(sizeof *recorder);
 	if (recorder == NULL) {
@@ -397,25 +531,23 @@ weston_recorder_create(struct weston_output *output, const char *filename)
 		return NULL;
 	}
 
-	stride = output->current_mode->width;
-	size = stride * 4 * output->current_mode->height;
+	pixman_region32_init(&recorder->coalesced_damage);
+	recorder->do_yflip =
+		!!(compositor->capabilities & WESTON_CAP_CAPTURE_YFLIP);
+	recorder->width = output->current_mode->width;
+	recorder->height = output->current_mode->height;
+
+	stride = recorder->width;
+	size = stride * 4 * recorder->height;
 	recorder->frame = zalloc(size);
-	recorder->rect = malloc(size);
+	recorder->outbuf = malloc(size);
 	recorder->output = output;
 
-	if ((recorder->frame == NULL) || (recorder->rect == NULL)) {
+	if ((recorder->frame == NULL) || (recorder->outbuf == NULL)) {
 		weston_log("%s: out of memory\n", __func__);
 		goto err_recorder;
 	}
 
-	if (!do_yflip) {
-		recorder->tmpbuf = malloc(size);
-		if (recorder->tmpbuf == NULL) {
-			weston_log("%s: out of memory\n", __func__);
-			goto err_recorder;
-		}
-	}
-
 	header.magic = WCAP_HEADER_MAGIC;
 
 	switch (compositor->read_format) {
@@ -440,10 +572,16 @@ weston_recorder_create(struct weston_output *output, const char *filename)
 		goto err_recorder;
 	}
 
-	header.width = output->current_mode->width;
-	header.height = output->current_mode->height;
+	header.width = recorder->width;
+	header.height = recorder->height;
 	recorder->total += write(recorder->fd, &header, sizeof header);
 
+	if (weston_recorder_start_encoder(recorder) < 0) {
+		weston_log("failed to start the recorder encoder thread\n");
+		close(recorder->fd);
+		goto err_recorder;
+	}
+
 	recorder->frame_listener.notify = weston_recorder_frame_notify;
 	wl_signal_add(&output->frame_signal, &recorder->frame_listener);
 	weston_output_disable_planes_incr(output);
@@ -460,6 +598,23 @@ static void
 weston_recorder_destroy(struct weston_recorder *recorder)
 {
 	wl_list_remove(&recorder->frame_listener.link);
+
+	/* Let the encoder drain the queue. */
+	pthread_mutex_lock(&recorder->mutex);
+	recorder->quit = true;
+	pthread_cond_signal(&recorder->queued_cond);
+	pthread_mutex_unlock(&recorder->mutex);
+	pthread_join(recorder->encoder, NULL);
+
+	pthread_cond_destroy(&recorder->free_cond);
+	pthread_cond_destroy(&recorder->queued_cond);
+	pthread_mutex_destroy(&recorder->mutex);
+
+	weston_log("recorder stopped, total file size %dM, %d frames, "
+		   "%d dropped and merged into later frames\n",
+		   recorder->total / (1024 * 1024), recorder->count,
+		   recorder->dropped);
+
 	close(recorder->fd);
 	weston_output_disable_planes_decr(recorder->output);
 	weston_recorder_free(recorder);
@@ -486,8 +641,10 @@ weston_recorder_start(struct weston_output *output, const char *filename)
 WL_EXPORT void
 weston_recorder_stop(struct weston_recorder *recorder)
 {
-	weston_log("stopping recorder, total file size %dM, %d frames\n",
-		   recorder->total / (1024 * 1024), recorder->count);
+	pthread_mutex_lock(&recorder->mutex);
+	weston_log("stopping recorder, %d frames queued\n",
+		   recorder->n_queued);
+	pthread_mutex_unlock(&recorder->mutex);
 
 	recorder->destroying = 1;
 	weston_output_schedule_repaint(recorder->output);
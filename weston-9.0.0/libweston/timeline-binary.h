@@ -0,0 +1,84 @@
+/*
+ * Copyright © 2026 The Annland Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef WESTON_TIMELINE_BINARY_H
+#define WESTON_TIMELINE_BINARY_H
+
+#include <stdint.h>
+
+/*
+ * Record format of the 'timeline-binary' log scope, read back by
+ * weston-timeline-convert.
+ *
+ * A stream is a sequence of 32-byte records in host byte order, starting
+ * with a WESTON_TIMELINE_RECORD_HEADER. Point names and object
+ * descriptions are sent once, the first time they are used, as records
+ * followed by 'n_blocks' 32-byte blocks holding a NUL-terminated string.
+ * Timeline points then only refer to them by id.
+ *
+ * Times are CLOCK_MONOTONIC nanoseconds.
+ */
+
+#define WESTON_TIMELINE_BINARY_MAGIC	0x42544c57	/* "WLTB" */
+#define WESTON_TIMELINE_BINARY_VERSION	1
+
+enum weston_timeline_record_kind {
+	/** 'id' is WESTON_TIMELINE_BINARY_MAGIC, 'aux' the version */
+	WESTON_TIMELINE_RECORD_HEADER = 1,
+	/** Interned point name 'id', string follows */
+	WESTON_TIMELINE_RECORD_NAME,
+	/** weston_output 'id', its name follows */
+	WESTON_TIMELINE_RECORD_OUTPUT,
+	/** weston_surface 'id' with main surface 'aux' (0 if itself), its
+	 * label follows; no blocks means it has none */
+	WESTON_TIMELINE_RECORD_SURFACE,
+	/** A timeline point named 'id' */
+	WESTON_TIMELINE_RECORD_POINT,
+};
+
+enum weston_timeline_point_flags {
+	/** 'extra' is a vblank timestamp */
+	WESTON_TIMELINE_POINT_VBLANK = 1 << 0,
+	/** 'extra' is a GPU timestamp */
+	WESTON_TIMELINE_POINT_GPU = 1 << 1,
+};
+
+struct weston_timeline_record {
+	uint8_t kind;		/**< enum weston_timeline_record_kind */
+	uint8_t n_blocks;	/**< string blocks following this record */
+	uint16_t flags;		/**< enum weston_timeline_point_flags */
+	uint32_t id;
+	uint32_t output;	/**< output id of a point, or 0 */
+	uint32_t surface;	/**< surface id of a point, or 0 */
+	uint64_t time;
+	union {
+		uint64_t extra;
+		uint32_t aux;
+	};
+};
+
+#define WESTON_TIMELINE_BLOCK_SIZE sizeof(struct weston_timeline_record)
+
+#endif /* WESTON_TIMELINE_BINARY_H */
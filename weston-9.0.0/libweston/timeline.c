@@ -34,7 +34,9 @@
 
 #include <libweston/libweston.h>
 #include <libweston/weston-log.h>
+#include "shared/helpers.h"
 #include "timeline.h"
+#include "timeline-binary.h"
 #include "weston-log-internal.h"
 
 /**
@@ -147,9 +149,16 @@ weston_timeline_subscription_search(struct weston_timeline_subscription *tl_sub,
 {
 	struct weston_timeline_subscription_object *sub_obj;
 
-	wl_list_for_each(sub_obj, &tl_sub->objects, subscription_link)
-		if (sub_obj->object == object)
-			return sub_obj;
+	wl_list_for_each(sub_obj, &tl_sub->objects, subscription_link) {
+		if (sub_obj->object != object)
+			continue;
+
+		/* Keep recently used objects in front; points mostly
+		 * refer to the same few outputs and surfaces. */
+		wl_list_remove(&sub_obj->subscription_link);
+		wl_list_insert(&tl_sub->objects, &sub_obj->subscription_link);
+		return sub_obj;
+	}
 
 	return NULL;
 }
@@ -370,14 +379,19 @@ WL_EXPORT void
 weston_timeline_refresh_subscription_objects(struct weston_compositor *wc,
 					     void *object)
 {
-	struct weston_log_subscription *sub = NULL;
-
-	while ((sub = weston_log_subscription_iterate(wc->timeline, sub))) {
-		struct weston_timeline_subscription_object *sub_obj;
-
-		sub_obj = weston_timeline_get_subscription_object(sub, object);
-		if (sub_obj)
-			sub_obj->force_refresh = true;
+	struct weston_log_scope *scopes[] = { wc->timeline, wc->timeline_binary };
+	struct weston_log_subscription *sub;
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_LENGTH(scopes); i++) {
+		sub = NULL;
+		while ((sub = weston_log_subscription_iterate(scopes[i], sub))) {
+			struct weston_timeline_subscription_object *sub_obj;
+
+			sub_obj = weston_timeline_get_subscription_object(sub, object);
+			if (sub_obj)
+				sub_obj->force_refresh = true;
+		}
 	}
 }
 
@@ -459,3 +473,323 @@ weston_timeline_point(struct weston_log_scope *timeline_scope,
 
 	}
 }
+
+/*
+ * The 'timeline-binary' scope carries the same points as 'timeline', as
+ * fixed-size records (see timeline-binary.h) that are collected per
+ * subscription and written out in batches: when the buffer fills up, or
+ * at the latest TIMELINE_BINARY_FLUSH_MS after the first record of a
+ * batch. A point costs a clock read and a few stores per subscription.
+ */
+
+/* 8 KiB per subscription */
+#define TIMELINE_BINARY_RECORDS 256
+#define TIMELINE_BINARY_FLUSH_MS 100
+
+/* Long strings are truncated so that a record with its string always
+ * fits into an empty buffer. */
+#define TIMELINE_BINARY_MAX_BLOCKS \
+	MIN(TIMELINE_BINARY_RECORDS - 1, UINT8_MAX)
+
+struct timeline_point_args {
+	struct weston_output *output;
+	struct weston_surface *surface;
+	const struct timespec *vblank;
+	const struct timespec *gpu;
+};
+
+static uint64_t
+timespec_to_ns(const struct timespec *ts)
+{
+	return (uint64_t)ts->tv_sec * 1000000000 + ts->tv_nsec;
+}
+
+static void
+timeline_binary_flush(struct weston_timeline_subscription *tl_sub)
+{
+	if (tl_sub->n_records == 0)
+		return;
+
+	weston_log_subscription_write(tl_sub->sub,
+				      (const char *)tl_sub->records,
+				      tl_sub->n_records *
+				      sizeof(*tl_sub->records));
+	tl_sub->n_records = 0;
+}
+
+static int
+timeline_binary_flush_handler(void *data)
+{
+	timeline_binary_flush(data);
+
+	return 0;
+}
+
+/* Returns n zeroed, consecutive records; n must not exceed
+ * TIMELINE_BINARY_RECORDS. */
+static struct weston_timeline_record *
+timeline_binary_reserve(struct weston_timeline_subscription *tl_sub,
+			unsigned int n)
+{
+	struct weston_timeline_record *r;
+
+	if (tl_sub->n_records + n > TIMELINE_BINARY_RECORDS)
+		timeline_binary_flush(tl_sub);
+
+	if (tl_sub->n_records == 0 && tl_sub->flush_timer)
+		wl_event_source_timer_update(tl_sub->flush_timer,
+					     TIMELINE_BINARY_FLUSH_MS);
+
+	r = &tl_sub->records[tl_sub->n_records];
+	tl_sub->n_records += n;
+	memset(r, 0, n * sizeof(*r));
+
+	return r;
+}
+
+static void
+timeline_binary_emit_string(struct weston_timeline_subscription *tl_sub,
+			    enum weston_timeline_record_kind kind,
+			    uint32_t id, uint32_t aux, const char *str)
+{
+	struct weston_timeline_record *r;
+	size_t len = str ? strlen(str) : 0;
+	unsigned int n_blocks = 0;
+
+	if (str) {
+		n_blocks = len / WESTON_TIMELINE_BLOCK_SIZE + 1;
+		if (n_blocks > TIMELINE_BINARY_MAX_BLOCKS) {
+			n_blocks = TIMELINE_BINARY_MAX_BLOCKS;
+			len = n_blocks * WESTON_TIMELINE_BLOCK_SIZE - 1;
+		}
+	}
+
+	r = timeline_binary_reserve(tl_sub, 1 + n_blocks);
+	r->kind = kind;
+	r->n_blocks = n_blocks;
+	r->id = id;
+	r->aux = aux;
+
+	/* The terminating NUL comes from the zeroed blocks. */
+	memcpy(r + 1, str, len);
+}
+
+static uint16_t
+timeline_binary_intern_name(struct weston_timeline_subscription *tl_sub,
+			    const char *name)
+{
+	const char **names = tl_sub->names.data;
+	size_t n = tl_sub->names.size / sizeof(*names);
+	const char **slot;
+	size_t i;
+
+	for (i = 0; i < n; i++)
+		if (names[i] == name)
+			return i + 1;
+
+	if (n >= UINT16_MAX)
+		return 0;
+
+	slot = wl_array_add(&tl_sub->names, sizeof(*slot));
+	if (!slot)
+		return 0;
+	*slot = name;
+
+	timeline_binary_emit_string(tl_sub, WESTON_TIMELINE_RECORD_NAME,
+				    n + 1, 0, name);
+
+	return n + 1;
+}
+
+static uint32_t
+timeline_binary_output_id(struct weston_timeline_subscription *tl_sub,
+			  struct weston_output *output)
+{
+	struct weston_timeline_subscription_object *sub_obj;
+
+	sub_obj = weston_timeline_subscription_output_ensure(tl_sub, output);
+	if (weston_timeline_check_object_refresh(sub_obj))
+		timeline_binary_emit_string(tl_sub,
+					    WESTON_TIMELINE_RECORD_OUTPUT,
+					    sub_obj->id, 0, output->name);
+
+	return sub_obj->id;
+}
+
+static uint32_t
+timeline_binary_surface_id(struct weston_timeline_subscription *tl_sub,
+			   struct weston_surface *surface)
+{
+	struct weston_timeline_subscription_object *sub_obj;
+	struct weston_surface *mains;
+	uint32_t main_id = 0;
+	char desc[512];
+
+	sub_obj = weston_timeline_subscription_surface_ensure(tl_sub, surface);
+	if (!weston_timeline_check_object_refresh(sub_obj))
+		return sub_obj->id;
+
+	mains = weston_surface_get_main_surface(surface);
+	if (mains != surface)
+		main_id = timeline_binary_surface_id(tl_sub, mains);
+
+	if (!surface->get_label ||
+	    surface->get_label(surface, desc, sizeof(desc)) < 0)
+		desc[0] = '\0';
+
+	timeline_binary_emit_string(tl_sub, WESTON_TIMELINE_RECORD_SURFACE,
+				    sub_obj->id, main_id,
+				    desc[0] ? desc : NULL);
+
+	return sub_obj->id;
+}
+
+/** Create a binary timeline subscription
+ *
+ * Like weston_timeline_create_subscription(), with a record buffer and
+ * a timer to flush it. The stream header is the first record.
+ *
+ * @ingroup internal-log
+ */
+void
+weston_timeline_binary_create_subscription(struct weston_log_subscription *sub,
+					   void *user_data)
+{
+	struct weston_compositor *compositor = user_data;
+	struct weston_timeline_subscription *tl_sub;
+	struct weston_timeline_record *r;
+	struct wl_event_loop *loop;
+
+	tl_sub = zalloc(sizeof(*tl_sub));
+	if (!tl_sub)
+		return;
+
+	tl_sub->records = calloc(TIMELINE_BINARY_RECORDS,
+				 sizeof(*tl_sub->records));
+	if (!tl_sub->records) {
+		free(tl_sub);
+		return;
+	}
+
+	wl_list_init(&tl_sub->objects);
+	wl_array_init(&tl_sub->names);
+	tl_sub->sub = sub;
+
+	loop = wl_display_get_event_loop(compositor->wl_display);
+	tl_sub->flush_timer =
+		wl_event_loop_add_timer(loop, timeline_binary_flush_handler,
+					tl_sub);
+
+	r = timeline_binary_reserve(tl_sub, 1);
+	r->kind = WESTON_TIMELINE_RECORD_HEADER;
+	r->id = WESTON_TIMELINE_BINARY_MAGIC;
+	r->aux = WESTON_TIMELINE_BINARY_VERSION;
+
+	weston_log_subscription_set_data(sub, tl_sub);
+}
+
+/** Flush and destroy a binary timeline subscription
+ *
+ * @ingroup internal-log
+ */
+void
+weston_timeline_binary_destroy_subscription(struct weston_log_subscription *sub,
+					    void *user_data)
+{
+	struct weston_timeline_subscription *tl_sub =
+		weston_log_subscription_get_data(sub);
+
+	if (!tl_sub)
+		return;
+
+	timeline_binary_flush(tl_sub);
+	if (tl_sub->flush_timer)
+		wl_event_source_remove(tl_sub->flush_timer);
+	free(tl_sub->records);
+	wl_array_release(&tl_sub->names);
+
+	weston_timeline_destroy_subscription(sub, user_data);
+}
+
+/** Binary counterpart of weston_timeline_point()
+ *
+ * Called by TL_POINT() with the 'timeline-binary' scope.
+ *
+ * @param timeline_scope the binary timeline scope
+ * @param name the name of the timeline point, which must stay valid for
+ * the lifetime of the compositor
+ *
+ * @ingroup log
+ */
+WL_EXPORT void
+weston_timeline_binary_point(struct weston_log_scope *timeline_scope,
+			     const char *name, ...)
+{
+	struct timeline_point_args args = {};
+	struct weston_log_subscription *sub = NULL;
+	struct weston_timeline_subscription *tl_sub;
+	struct weston_timeline_record *r;
+	enum timeline_type otype;
+	struct timespec ts;
+	uint32_t output_id, surface_id;
+	uint16_t name_id;
+	va_list argp;
+	void *obj;
+
+	if (!weston_log_scope_is_enabled(timeline_scope))
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	va_start(argp, name);
+	while ((otype = va_arg(argp, enum timeline_type)) != TLT_END) {
+		obj = va_arg(argp, void *);
+		switch (otype) {
+		case TLT_OUTPUT:
+			args.output = obj;
+			break;
+		case TLT_SURFACE:
+			args.surface = obj;
+			break;
+		case TLT_VBLANK:
+			args.vblank = obj;
+			break;
+		case TLT_GPU:
+			args.gpu = obj;
+			break;
+		default:
+			break;
+		}
+	}
+	va_end(argp);
+
+	while ((sub = weston_log_subscription_iterate(timeline_scope, sub))) {
+		tl_sub = weston_log_subscription_get_data(sub);
+		if (!tl_sub)
+			continue;
+
+		/* These may emit name and object records, which must come
+		 * before the point. */
+		name_id = timeline_binary_intern_name(tl_sub, name);
+		output_id = args.output ?
+			timeline_binary_output_id(tl_sub, args.output) : 0;
+		surface_id = args.surface ?
+			timeline_binary_surface_id(tl_sub, args.surface) : 0;
+
+		r = timeline_binary_reserve(tl_sub, 1);
+		r->kind = WESTON_TIMELINE_RECORD_POINT;
+		r->id = name_id;
+		r->output = output_id;
+		r->surface = surface_id;
+		r->time = timespec_to_ns(&ts);
+
+		/* No point carries both. */
+		if (args.vblank) {
+			r->flags |= WESTON_TIMELINE_POINT_VBLANK;
+			r->extra = timespec_to_ns(args.vblank);
+		} else if (args.gpu) {
+			r->flags |= WESTON_TIMELINE_POINT_GPU;
+			r->extra = timespec_to_ns(args.gpu);
+		}
+	}
+}
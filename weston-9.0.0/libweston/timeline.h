@@ -33,6 +33,8 @@
 #include <libweston/weston-log.h>
 #include <wayland-server-core.h>
 
+struct weston_timeline_record;
+
 enum timeline_type {
 	TLT_END = 0,
 	TLT_OUTPUT,
@@ -51,6 +53,13 @@ enum timeline_type {
 struct weston_timeline_subscription {
 	unsigned int next_id;
 	struct wl_list objects; /**< weston_timeline_subscription_object::subscription_link */
+
+	/* Only used by the 'timeline-binary' scope */
+	struct weston_log_subscription *sub;
+	struct wl_array names;	/**< const char *, interned name id is index + 1 */
+	struct weston_timeline_record *records;
+	unsigned int n_records;	/**< records waiting to be written */
+	struct wl_event_source *flush_timer;
 };
 
 /**
@@ -86,7 +95,9 @@ struct weston_timeline_subscription_object {
 
 /** This macro is used to add timeline points.
  *
- * Use TLP_END when done for the vargs.
+ * Use TLP_END when done for the vargs. The point name must be a string
+ * literal, or otherwise outlive the compositor: the binary timeline
+ * interns names by address.
  *
  * @param ec weston_compositor instance
  *
@@ -94,10 +105,15 @@ struct weston_timeline_subscription_object {
  */
 #define TL_POINT(ec, ...) do { \
 	weston_timeline_point(ec->timeline, __VA_ARGS__); \
+	weston_timeline_binary_point(ec->timeline_binary, __VA_ARGS__); \
 } while (0)
 
 void
 weston_timeline_point(struct weston_log_scope *timeline_scope,
 		      const char *name, ...);
 
+void
+weston_timeline_binary_point(struct weston_log_scope *timeline_scope,
+			     const char *name, ...);
+
 #endif /* WESTON_TIMELINE_H */
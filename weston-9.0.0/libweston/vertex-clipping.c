@@ -25,6 +25,11 @@
 #include <assert.h>
 #include <float.h>
 #include <math.h>
+#include <string.h>
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
 
 #include "vertex-clipping.h"
 
@@ -296,21 +301,12 @@ clip_simple(struct clip_context *ctx,
 	return surf->n;
 }
 
-int
-clip_transformed(struct clip_context *ctx,
-		 struct polygon8 *surf,
-		 float *ex,
-		 float *ey)
+/* Copy the polygon to ex, ey without duplicate vertices. */
+static int
+clip_remove_duplicates(const struct polygon8 *surf, float *ex, float *ey)
 {
-	struct polygon8 polygon;
 	int i, n;
 
-	polygon.n = clip_polygon_left(ctx, surf, polygon.x, polygon.y);
-	surf->n = clip_polygon_right(ctx, &polygon, surf->x, surf->y);
-	polygon.n = clip_polygon_top(ctx, surf, polygon.x, polygon.y);
-	surf->n = clip_polygon_bottom(ctx, &polygon, surf->x, surf->y);
-
-	/* Get rid of duplicate vertices */
 	ex[0] = surf->x[0];
 	ey[0] = surf->y[0];
 	n = 1;
@@ -328,3 +324,214 @@ clip_transformed(struct clip_context *ctx,
 
 	return n;
 }
+
+int
+clip_transformed(struct clip_context *ctx,
+		 struct polygon8 *surf,
+		 float *ex,
+		 float *ey)
+{
+	struct polygon8 polygon;
+
+	polygon.n = clip_polygon_left(ctx, surf, polygon.x, polygon.y);
+	surf->n = clip_polygon_right(ctx, &polygon, surf->x, surf->y);
+	polygon.n = clip_polygon_top(ctx, surf, polygon.x, polygon.y);
+	surf->n = clip_polygon_bottom(ctx, &polygon, surf->x, surf->y);
+
+	/* Get rid of duplicate vertices */
+	return clip_remove_duplicates(surf, ex, ey);
+}
+
+enum clip_class {
+	CLIP_OUTSIDE,
+	CLIP_INSIDE,
+	CLIP_PARTIAL,
+};
+
+struct clip_bounds {
+	float min_x, min_y;
+	float max_x, max_y;
+};
+
+static void
+polygon_bounds(const struct polygon8 *p, struct clip_bounds *b)
+{
+	int i;
+
+	b->min_x = b->max_x = p->x[0];
+	b->min_y = b->max_y = p->y[0];
+	for (i = 1; i < p->n; i++) {
+		b->min_x = min(b->min_x, p->x[i]);
+		b->max_x = max(b->max_x, p->x[i]);
+		b->min_y = min(b->min_y, p->y[i]);
+		b->max_y = max(b->max_y, p->y[i]);
+	}
+}
+
+/* A polygon is inside only if every vertex is on the inner side of all
+ * four edges, as the path_transition_*_edge() tests define it; then the
+ * Sutherland-Hodgman passes would copy it unchanged. */
+static enum clip_class
+clip_classify(const struct clip_bounds *b, const struct clip_box *box)
+{
+	if (b->min_x >= box->x2 || b->max_x <= box->x1 ||
+	    b->min_y >= box->y2 || b->max_y <= box->y1)
+		return CLIP_OUTSIDE;
+
+	if (b->min_x >= box->x1 && b->max_x < box->x2 &&
+	    b->min_y >= box->y1 && b->max_y < box->y2)
+		return CLIP_INSIDE;
+
+	return CLIP_PARTIAL;
+}
+
+#ifdef __SSE__
+/* Classify one polygon against four boxes at once. Lane i of the result
+ * holds the class for boxes[i]. */
+static void
+clip_classify4(const struct clip_bounds *b, const struct clip_box *boxes,
+	       enum clip_class *classes)
+{
+	__m128 x1 = _mm_loadu_ps(&boxes[0].x1);
+	__m128 y1 = _mm_loadu_ps(&boxes[1].x1);
+	__m128 x2 = _mm_loadu_ps(&boxes[2].x1);
+	__m128 y2 = _mm_loadu_ps(&boxes[3].x1);
+	__m128 min_x = _mm_set1_ps(b->min_x);
+	__m128 min_y = _mm_set1_ps(b->min_y);
+	__m128 max_x = _mm_set1_ps(b->max_x);
+	__m128 max_y = _mm_set1_ps(b->max_y);
+	__m128 outside, inside;
+	int out_mask, in_mask, i;
+
+	/* struct clip_box is four floats: transpose rows into x1, y1, x2,
+	 * y2 vectors. */
+	_MM_TRANSPOSE4_PS(x1, y1, x2, y2);
+
+	outside = _mm_or_ps(_mm_or_ps(_mm_cmpge_ps(min_x, x2),
+				      _mm_cmple_ps(max_x, x1)),
+			    _mm_or_ps(_mm_cmpge_ps(min_y, y2),
+				      _mm_cmple_ps(max_y, y1)));
+	inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(min_x, x1),
+				       _mm_cmplt_ps(max_x, x2)),
+			    _mm_and_ps(_mm_cmpge_ps(min_y, y1),
+				       _mm_cmplt_ps(max_y, y2)));
+	out_mask = _mm_movemask_ps(outside);
+	in_mask = _mm_movemask_ps(inside);
+
+	for (i = 0; i < 4; i++) {
+		if (out_mask & (1 << i))
+			classes[i] = CLIP_OUTSIDE;
+		else if (in_mask & (1 << i))
+			classes[i] = CLIP_INSIDE;
+		else
+			classes[i] = CLIP_PARTIAL;
+	}
+}
+#else
+static void
+clip_classify4(const struct clip_bounds *b, const struct clip_box *boxes,
+	       enum clip_class *classes)
+{
+	int i;
+
+	for (i = 0; i < 4; i++)
+		classes[i] = clip_classify(b, &boxes[i]);
+}
+#endif
+
+static int
+clip_emit(const struct polygon8 *polygon, const struct clip_box *box,
+	  enum clip_class class, bool transformed, float *ex, float *ey)
+{
+	struct clip_context ctx;
+	struct polygon8 surf;
+	int n;
+
+	if (class == CLIP_OUTSIDE)
+		return 0;
+
+	ctx.clip.x1 = box->x1;
+	ctx.clip.y1 = box->y1;
+	ctx.clip.x2 = box->x2;
+	ctx.clip.y2 = box->y2;
+
+	if (!transformed) {
+		surf = *polygon;
+		return clip_simple(&ctx, &surf, ex, ey);
+	}
+
+	if (class == CLIP_INSIDE)
+		n = clip_remove_duplicates(polygon, ex, ey);
+	else {
+		surf = *polygon;
+		n = clip_transformed(&ctx, &surf, ex, ey);
+	}
+
+	return n < 3 ? 0 : n;
+}
+
+/** Clip many convex polygons against many axis-aligned boxes
+ *
+ * \param polygons Convex polygons with at least three vertices each.
+ * \param n_polygons The number of polygons.
+ * \param boxes The clip boxes.
+ * \param n_boxes The number of boxes.
+ * \param transformed False if the polygons are axis-aligned rectangles,
+ * which only need clamping to the boxes.
+ * \param ex Receives the x coordinates of all resulting vertices.
+ * \param ey Receives the y coordinates of all resulting vertices.
+ * \param counts Receives the number of vertices of each resulting polygon.
+ * \return The number of resulting polygons.
+ *
+ * For every polygon in order, and every box in order, this produces the
+ * same vertices as clip_simple() or clip_transformed() would, dropping
+ * results with less than three vertices. A polygon's bounding box is
+ * tested against four boxes at a time: boxes it misses are skipped and
+ * boxes that contain it need no clipping, so only polygons crossing a box
+ * edge go through the Sutherland-Hodgman passes.
+ *
+ * ex and ey need room for 8 * n_polygons * n_boxes floats and counts
+ * for n_polygons * n_boxes ints.
+ */
+int
+clip_polygons_to_boxes(const struct polygon8 *polygons, int n_polygons,
+		       const struct clip_box *boxes, int n_boxes,
+		       bool transformed,
+		       float *ex, float *ey, int *counts)
+{
+	struct clip_bounds bounds;
+	enum clip_class classes[4];
+	int i, j, k, n, n_out = 0;
+
+	for (i = 0; i < n_polygons; i++) {
+		const struct polygon8 *polygon = &polygons[i];
+
+		if (polygon->n < 3)
+			continue;
+
+		polygon_bounds(polygon, &bounds);
+
+		for (j = 0; j < n_boxes; j += 4) {
+			if (n_boxes - j >= 4) {
+				clip_classify4(&bounds, &boxes[j], classes);
+			} else {
+				for (k = 0; j + k < n_boxes; k++)
+					classes[k] = clip_classify(&bounds,
+								   &boxes[j + k]);
+			}
+
+			for (k = 0; k < 4 && j + k < n_boxes; k++) {
+				n = clip_emit(polygon, &boxes[j + k],
+					      classes[k], transformed, ex, ey);
+				if (n == 0)
+					continue;
+
+				ex += n;
+				ey += n;
+				counts[n_out++] = n;
+			}
+		}
+	}
+
+	return n_out;
+}
@@ -25,6 +25,8 @@
 #ifndef _WESTON_VERTEX_CLIPPING_H
 #define _WESTON_VERTEX_CLIPPING_H
 
+#include <stdbool.h>
+
 struct polygon8 {
 	float x[8];
 	float y[8];
@@ -61,6 +63,17 @@ int
 clip_transformed(struct clip_context *ctx,
 		 struct polygon8 *surf,
 		 float *ex,
-		 float *ey);\
+		 float *ey);
+
+struct clip_box {
+	float x1, y1;
+	float x2, y2;
+};
+
+int
+clip_polygons_to_boxes(const struct polygon8 *polygons, int n_polygons,
+		       const struct clip_box *boxes, int n_boxes,
+		       bool transformed,
+		       float *ex, float *ey, int *counts);
 
 #endif
@@ -0,0 +1,510 @@
+/*
+ * Copyright © 2026 The Annland Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libweston/libweston.h>
+#include "view-index.h"
+
+/* 128x128 pixel cells */
+#define CELL_SHIFT 7
+
+/* Views touching more cells than this go to the large view list. */
+#define MAX_VIEW_CELLS 256
+
+#define INITIAL_TABLE_SIZE 64
+
+struct index_cell {
+	int32_t cx, cy;
+	bool used;
+	struct wl_array views;	/* struct weston_view *, in view list order */
+};
+
+struct weston_view_index {
+	/* open addressing hash table of cells, size is a power of two */
+	struct index_cell *cells;
+	uint32_t size;
+	uint32_t used;
+
+	struct wl_array large;	/* struct weston_view *, in view list order */
+};
+
+static uint32_t
+cell_hash(int32_t cx, int32_t cy)
+{
+	uint32_t h = ((uint32_t)cx * 0x9e3779b1u) ^ ((uint32_t)cy * 0x85ebca6bu);
+
+	return h ^ (h >> 16);
+}
+
+static int32_t
+cell_coord(int32_t v)
+{
+	/* Rounds towards negative infinity, unlike division. */
+	return v >> CELL_SHIFT;
+}
+
+static struct index_cell *
+index_lookup_cell(struct weston_view_index *index, int32_t cx, int32_t cy)
+{
+	uint32_t mask = index->size - 1;
+	uint32_t i;
+
+	for (i = cell_hash(cx, cy) & mask; index->cells[i].used;
+	     i = (i + 1) & mask) {
+		if (index->cells[i].cx == cx && index->cells[i].cy == cy)
+			return &index->cells[i];
+	}
+
+	return NULL;
+}
+
+static int
+index_grow(struct weston_view_index *index)
+{
+	struct index_cell *old = index->cells;
+	uint32_t old_size = index->size;
+	uint32_t mask;
+	uint32_t i, j;
+
+	index->cells = calloc(old_size * 2, sizeof *index->cells);
+	if (!index->cells) {
+		index->cells = old;
+		return -1;
+	}
+	index->size = old_size * 2;
+	mask = index->size - 1;
+
+	for (i = 0; i < old_size; i++) {
+		if (!old[i].used)
+			continue;
+
+		for (j = cell_hash(old[i].cx, old[i].cy) & mask;
+		     index->cells[j].used; j = (j + 1) & mask)
+			;
+		index->cells[j] = old[i];
+	}
+
+	free(old);
+
+	return 0;
+}
+
+static struct index_cell *
+index_get_cell(struct weston_view_index *index, int32_t cx, int32_t cy)
+{
+	struct index_cell *cell;
+	uint32_t mask;
+	uint32_t i;
+
+	cell = index_lookup_cell(index, cx, cy);
+	if (cell)
+		return cell;
+
+	if ((index->used + 1) * 2 > index->size && index_grow(index) < 0)
+		return NULL;
+
+	mask = index->size - 1;
+	for (i = cell_hash(cx, cy) & mask; index->cells[i].used;
+	     i = (i + 1) & mask)
+		;
+
+	cell = &index->cells[i];
+	cell->used = true;
+	cell->cx = cx;
+	cell->cy = cy;
+	wl_array_init(&cell->views);
+	index->used++;
+
+	return cell;
+}
+
+static size_t
+view_array_count(struct wl_array *array)
+{
+	return array->size / sizeof(struct weston_view *);
+}
+
+static size_t
+view_array_lower_bound(struct wl_array *array, uint32_t order)
+{
+	struct weston_view **views = array->data;
+	size_t lo = 0;
+	size_t hi = view_array_count(array);
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (views[mid]->index.order < order)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+static bool
+view_array_insert(struct wl_array *array, struct weston_view *view)
+{
+	size_t pos = view_array_lower_bound(array, view->index.order);
+	size_t n = view_array_count(array);
+	struct weston_view **views;
+
+	if (!wl_array_add(array, sizeof *views))
+		return false;
+
+	views = array->data;
+	memmove(&views[pos + 1], &views[pos], (n - pos) * sizeof *views);
+	views[pos] = view;
+
+	return true;
+}
+
+static void
+view_array_remove(struct wl_array *array, struct weston_view *view)
+{
+	size_t pos = view_array_lower_bound(array, view->index.order);
+	size_t n = view_array_count(array);
+	struct weston_view **views = array->data;
+
+	assert(pos < n && views[pos] == view);
+
+	memmove(&views[pos], &views[pos + 1], (n - pos - 1) * sizeof *views);
+	array->size -= sizeof *views;
+}
+
+/* Cell range [x1, x2) x [y1, y2) touched by the view's bounding box */
+static void
+view_cell_range(struct weston_view *view, pixman_box32_t *range)
+{
+	pixman_box32_t *ext = pixman_region32_extents(&view->transform.boundingbox);
+
+	if (ext->x1 >= ext->x2 || ext->y1 >= ext->y2) {
+		range->x1 = range->x2 = 0;
+		range->y1 = range->y2 = 0;
+		return;
+	}
+
+	range->x1 = cell_coord(ext->x1);
+	range->y1 = cell_coord(ext->y1);
+	range->x2 = cell_coord(ext->x2 - 1) + 1;
+	range->y2 = cell_coord(ext->y2 - 1) + 1;
+}
+
+static int64_t
+cell_range_count(const pixman_box32_t *range)
+{
+	return (int64_t)(range->x2 - range->x1) *
+	       (int64_t)(range->y2 - range->y1);
+}
+
+static void
+index_unregister_cells(struct weston_view_index *index,
+		       struct weston_view *view,
+		       const pixman_box32_t *range)
+{
+	struct index_cell *cell;
+	int32_t cx, cy;
+
+	for (cy = range->y1; cy < range->y2; cy++) {
+		for (cx = range->x1; cx < range->x2; cx++) {
+			cell = index_lookup_cell(index, cx, cy);
+			assert(cell);
+			view_array_remove(&cell->views, view);
+		}
+	}
+}
+
+static void
+index_unregister(struct weston_view_index *index, struct weston_view *view)
+{
+	if (view->index.large)
+		view_array_remove(&index->large, view);
+	else
+		index_unregister_cells(index, view, &view->index.cells);
+}
+
+static void
+index_register_large(struct weston_view_index *index,
+		     struct weston_view *view)
+{
+	view->index.large = true;
+	view->index.cells.x1 = view->index.cells.x2 = 0;
+	view->index.cells.y1 = view->index.cells.y2 = 0;
+
+	/* If even this fails, the view cannot be picked through the index
+	 * until its next update. */
+	if (!view_array_insert(&index->large, view))
+		view->index.large = false;
+}
+
+static void
+index_register(struct weston_view_index *index, struct weston_view *view,
+	       const pixman_box32_t *range)
+{
+	struct index_cell *cell;
+	pixman_box32_t done;
+	int32_t cx, cy;
+
+	if (cell_range_count(range) > MAX_VIEW_CELLS) {
+		index_register_large(index, view);
+		return;
+	}
+
+	view->index.large = false;
+	view->index.cells = *range;
+
+	for (cy = range->y1; cy < range->y2; cy++) {
+		for (cx = range->x1; cx < range->x2; cx++) {
+			cell = index_get_cell(index, cx, cy);
+			if (cell && view_array_insert(&cell->views, view))
+				continue;
+
+			/* Out of memory: undo the full rows and the
+			 * partial row registered so far. */
+			done = *range;
+			done.y2 = cy;
+			index_unregister_cells(index, view, &done);
+			done.y1 = cy;
+			done.y2 = cy + 1;
+			done.x2 = cx;
+			index_unregister_cells(index, view, &done);
+			index_register_large(index, view);
+			return;
+		}
+	}
+}
+
+static void
+index_clear(struct weston_view_index *index)
+{
+	uint32_t i;
+
+	for (i = 0; i < index->size; i++) {
+		if (index->cells[i].used)
+			wl_array_release(&index->cells[i].views);
+	}
+	memset(index->cells, 0, index->size * sizeof *index->cells);
+	index->used = 0;
+
+	index->large.size = 0;
+}
+
+struct weston_view_index *
+weston_view_index_create(void)
+{
+	struct weston_view_index *index;
+
+	index = zalloc(sizeof *index);
+	if (!index)
+		return NULL;
+
+	index->cells = calloc(INITIAL_TABLE_SIZE, sizeof *index->cells);
+	if (!index->cells) {
+		free(index);
+		return NULL;
+	}
+	index->size = INITIAL_TABLE_SIZE;
+	wl_array_init(&index->large);
+
+	return index;
+}
+
+void
+weston_view_index_destroy(struct weston_view_index *index)
+{
+	index_clear(index);
+	wl_array_release(&index->large);
+	free(index->cells);
+	free(index);
+}
+
+/** Re-create the index from a freshly built view list
+ *
+ * \param index The index.
+ * \param view_list The compositor's view list.
+ *
+ * The caller must have cleared view->index.indexed on every view that was
+ * dropped from the list.
+ */
+void
+weston_view_index_rebuild(struct weston_view_index *index,
+			  struct wl_list *view_list)
+{
+	struct weston_view *view;
+	pixman_box32_t range;
+	uint32_t order = 0;
+
+	index_clear(index);
+
+	wl_list_for_each(view, view_list, link) {
+		view->index.order = order++;
+		view->index.indexed = true;
+		view_cell_range(view, &range);
+		index_register(index, view, &range);
+	}
+}
+
+/** Move a view to the cells matching its current bounding box
+ *
+ * \param index The index.
+ * \param view A view whose transform.boundingbox may have changed.
+ *
+ * Views that are not in the index are ignored.
+ */
+void
+weston_view_index_update(struct weston_view_index *index,
+			 struct weston_view *view)
+{
+	pixman_box32_t range;
+	bool large;
+
+	if (!view->index.indexed)
+		return;
+
+	view_cell_range(view, &range);
+	large = cell_range_count(&range) > MAX_VIEW_CELLS;
+
+	if (large && view->index.large)
+		return;
+
+	if (!large && !view->index.large &&
+	    range.x1 == view->index.cells.x1 &&
+	    range.y1 == view->index.cells.y1 &&
+	    range.x2 == view->index.cells.x2 &&
+	    range.y2 == view->index.cells.y2)
+		return;
+
+	index_unregister(index, view);
+	index_register(index, view, &range);
+}
+
+/** Remove a view that is being taken off the view list
+ *
+ * \param index The index.
+ * \param view The view.
+ */
+void
+weston_view_index_remove(struct weston_view_index *index,
+			 struct weston_view *view)
+{
+	if (!view->index.indexed)
+		return;
+
+	index_unregister(index, view);
+	view->index.indexed = false;
+}
+
+/** Start iterating the views that may contain a point
+ *
+ * \param iter The iterator to initialize.
+ * \param index The index.
+ * \param x X coordinate in the global space.
+ * \param y Y coordinate in the global space.
+ *
+ * The iterator is invalidated by any change to the index.
+ */
+void
+weston_view_index_iter_init(struct weston_view_index_iter *iter,
+			    struct weston_view_index *index,
+			    int32_t x, int32_t y)
+{
+	struct index_cell *cell;
+
+	cell = index_lookup_cell(index, cell_coord(x), cell_coord(y));
+	if (cell) {
+		iter->cell = cell->views.data;
+		iter->n_cell = view_array_count(&cell->views);
+	} else {
+		iter->cell = NULL;
+		iter->n_cell = 0;
+	}
+
+	iter->large = index->large.data;
+	iter->n_large = view_array_count(&index->large);
+}
+
+/** Return the next candidate view, or NULL when done
+ *
+ * \param iter The iterator.
+ *
+ * Merges the cell and the large view lists, so views come out top-most
+ * first just like when walking the compositor's view list.
+ */
+struct weston_view *
+weston_view_index_iter_next(struct weston_view_index_iter *iter)
+{
+	struct weston_view *view;
+
+	if (iter->n_cell > 0 &&
+	    (iter->n_large == 0 ||
+	     iter->cell[0]->index.order < iter->large[0]->index.order)) {
+		view = iter->cell[0];
+		iter->cell++;
+		iter->n_cell--;
+	} else if (iter->n_large > 0) {
+		view = iter->large[0];
+		iter->large++;
+		iter->n_large--;
+	} else {
+		view = NULL;
+	}
+
+	return view;
+}
+
+/** Keep a spatial index of the view list
+ *
+ * \param compositor The compositor.
+ * \return 0 on success, -1 on failure.
+ *
+ * Once enabled, weston_compositor_pick_view() only tests the views near the
+ * picked point. This pays off with many small views; the index is kept up
+ * to date on every view transform change.
+ *
+ * There is no way to disable this once enabled.
+ */
+WL_EXPORT int
+weston_compositor_enable_view_index(struct weston_compositor *compositor)
+{
+	if (compositor->view_index)
+		return 0;
+
+	compositor->view_index = weston_view_index_create();
+	if (!compositor->view_index)
+		return -1;
+
+	weston_view_index_rebuild(compositor->view_index,
+				  &compositor->view_list);
+
+	return 0;
+}
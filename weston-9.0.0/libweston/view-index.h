@@ -0,0 +1,83 @@
+/*
+ * Copyright © 2026 The Annland Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef WESTON_VIEW_INDEX_H
+#define WESTON_VIEW_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <libweston/libweston.h>
+
+/** Spatial index of the views in weston_compositor::view_list
+ *
+ * Global coordinate space is divided into a grid of square cells. Each
+ * view is registered in every cell its transform.boundingbox extents
+ * touch, in view list order. Views covering too many cells are kept in a
+ * separate list that every lookup visits.
+ *
+ * A view is in the index if and only if it is in the compositor's view
+ * list; its position in that list is recorded in view->index.order.
+ */
+struct weston_view_index;
+
+/** Iterator over the views whose bounding box may contain a point
+ *
+ * Views are returned in view list order, i.e. top-most first.
+ */
+struct weston_view_index_iter {
+	struct weston_view **cell;
+	size_t n_cell;
+	struct weston_view **large;
+	size_t n_large;
+};
+
+struct weston_view_index *
+weston_view_index_create(void);
+
+void
+weston_view_index_destroy(struct weston_view_index *index);
+
+void
+weston_view_index_rebuild(struct weston_view_index *index,
+			  struct wl_list *view_list);
+
+void
+weston_view_index_update(struct weston_view_index *index,
+			 struct weston_view *view);
+
+void
+weston_view_index_remove(struct weston_view_index *index,
+			 struct weston_view *view);
+
+void
+weston_view_index_iter_init(struct weston_view_index_iter *iter,
+			    struct weston_view_index *index,
+			    int32_t x, int32_t y);
+
+struct weston_view *
+weston_view_index_iter_next(struct weston_view_index_iter *iter);
+
+#endif /* WESTON_VIEW_INDEX_H */
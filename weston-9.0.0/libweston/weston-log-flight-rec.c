@@ -30,12 +30,17 @@
 #include <libweston/libweston.h>
 
 #include "weston-log-internal.h"
+#include "weston-log-flight-rec.h"
 
 #include <assert.h>
+#include <fcntl.h>
 #include <unistd.h>
 #include <stdarg.h>
+#include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/time.h>
 
 struct weston_ring_buffer {
@@ -44,6 +49,11 @@ struct weston_ring_buffer {
 	char *buf;		/**< the buffer itself */
 	FILE *file;		/**< where to write in case we need to dump the buf */
 	bool overlap;		/**< in case buff overlaps, hint from where to print buf contents */
+
+	/** For a file-backed ring, the mapped file header; append_pos and
+	 * overlap are then unused, see weston-log-flight-rec.h */
+	struct weston_flight_rec_header *header;
+	size_t map_size;
 };
 
 /** allows easy access to the ring buffer in case of a core dump
@@ -149,6 +159,34 @@ weston_log_flight_recorder_write_data(struct weston_ring_buffer *rb,
 		weston_log_flight_recorder_write_chunks_overlap(rb, data, len);
 }
 
+/* Appends to a file-backed ring without locks: the space is reserved
+ * with an atomic add, so concurrent writers copy to disjoint ranges, unless
+ * a single write wraps over the whole ring. */
+static void
+weston_log_flight_recorder_write_shared(struct weston_ring_buffer *rb,
+					const char *data, size_t len)
+{
+	struct weston_flight_rec_header *header = rb->header;
+	uint64_t start;
+	size_t pos, to_end;
+
+	start = __atomic_fetch_add(&header->written, len, __ATOMIC_RELAXED);
+
+	/* only the tail of an oversized write survives anyway */
+	if (len > rb->size) {
+		start += len - rb->size;
+		data += len - rb->size;
+		len = rb->size;
+	}
+
+	pos = start % rb->size;
+	to_end = MIN(len, rb->size - pos);
+	memcpy(&rb->buf[pos], data, to_end);
+	memcpy(rb->buf, data + to_end, len - to_end);
+
+	__atomic_fetch_add(&header->committed, len, __ATOMIC_RELEASE);
+}
+
 static void
 weston_log_flight_recorder_write(struct weston_log_subscriber *sub,
 				 const char *data, size_t len)
@@ -157,6 +195,11 @@ weston_log_flight_recorder_write(struct weston_log_subscriber *sub,
 		to_flight_recorder(sub);
 	struct weston_ring_buffer *rb = &flight_rec->rb;
 
+	if (rb->header) {
+		weston_log_flight_recorder_write_shared(rb, data, len);
+		return;
+	}
+
 	/* in case the data is bigger than the size of the buf */
 	if (rb->size < len) {
 		weston_log_flight_recorder_write_data(rb, data, len);
@@ -191,9 +234,25 @@ weston_log_subscriber_display_flight_rec_data(struct weston_ring_buffer *rb,
 					      FILE *file)
 {
 	FILE *file_d = stderr;
+	uint64_t written;
+	size_t pos;
+
 	if (file)
 		file_d = file;
 
+	if (rb->header) {
+		written = __atomic_load_n(&rb->header->written,
+					  __ATOMIC_ACQUIRE);
+		pos = written % rb->size;
+		if (written > rb->size)
+			fwrite(&rb->buf[pos], sizeof(char),
+			       rb->size - pos, file_d);
+		else if (written == rb->size)
+			pos = rb->size;
+		fwrite(rb->buf, sizeof(char), pos, file_d);
+		return;
+	}
+
 	if (!rb->overlap) {
 		if (rb->append_pos)
 			fwrite(rb->buf, sizeof(char), rb->append_pos, file_d);
@@ -229,10 +288,34 @@ weston_log_subscriber_destroy_flight_rec(struct weston_log_subscriber *sub)
 		weston_primary_flight_recorder_ring_buffer = NULL;
 
 	weston_log_subscriber_release(sub);
-	free(flight_rec->rb.buf);
+	if (flight_rec->rb.header)
+		munmap(flight_rec->rb.header, flight_rec->rb.map_size);
+	else
+		free(flight_rec->rb.buf);
 	free(flight_rec);
 }
 
+static struct weston_debug_log_flight_recorder *
+weston_log_flight_recorder_alloc(void)
+{
+	struct weston_debug_log_flight_recorder *flight_rec;
+
+	assert("Can't create more than one flight recorder." &&
+			!weston_primary_flight_recorder_ring_buffer);
+
+	flight_rec = zalloc(sizeof(*flight_rec));
+	if (!flight_rec)
+		return NULL;
+
+	flight_rec->base.write = weston_log_flight_recorder_write;
+	flight_rec->base.destroy = weston_log_subscriber_destroy_flight_rec;
+	flight_rec->base.destroy_subscription = NULL;
+	flight_rec->base.complete = NULL;
+	wl_list_init(&flight_rec->base.subscription_list);
+
+	return flight_rec;
+}
+
 /** Create a flight recorder type of subscriber
  *
  * Allocates both the flight recorder and the underlying ring buffer. Use
@@ -248,19 +331,10 @@ weston_log_subscriber_create_flight_rec(size_t size)
 	struct weston_debug_log_flight_recorder *flight_rec;
 	char *weston_rb;
 
-	assert("Can't create more than one flight recorder." &&
-			!weston_primary_flight_recorder_ring_buffer);
-
-	flight_rec = zalloc(sizeof(*flight_rec));
+	flight_rec = weston_log_flight_recorder_alloc();
 	if (!flight_rec)
 		return NULL;
 
-	flight_rec->base.write = weston_log_flight_recorder_write;
-	flight_rec->base.destroy = weston_log_subscriber_destroy_flight_rec;
-	flight_rec->base.destroy_subscription = NULL;
-	flight_rec->base.complete = NULL;
-	wl_list_init(&flight_rec->base.subscription_list);
-
 	weston_rb = zalloc(sizeof(char) * size);
 	if (!weston_rb) {
 		free(flight_rec);
@@ -276,6 +350,101 @@ weston_log_subscriber_create_flight_rec(size_t size)
 	return &flight_rec->base;
 }
 
+/** Create a flight recorder whose ring buffer is a shared mapping of a
+ * file
+ *
+ * Unlike weston_log_subscriber_create_flight_rec(), the contents outlive
+ * the process: after a crash or a kill, they can be read from the file with
+ * weston-flight-rec. Writes do not need locks, so they may come from
+ * any thread. The file layout is described in weston-log-flight-rec.h.
+ *
+ * An existing file at \c path is first renamed to \c path with ".old"
+ * appended, so that restarting does not destroy the previous record.
+ *
+ * @param path the file to create
+ * @param size the size (in bytes) of the ring buffer, excluding the header
+ * @returns a weston_log_subscriber object or NULL in case of failure
+ *
+ * @sa weston_log_subscriber_create_flight_rec
+ */
+WL_EXPORT struct weston_log_subscriber *
+weston_log_subscriber_create_flight_rec_file(const char *path, size_t size)
+{
+	struct weston_debug_log_flight_recorder *flight_rec;
+	struct weston_flight_rec_header *header;
+	size_t header_size = sysconf(_SC_PAGESIZE);
+	size_t map_size;
+	char *old_path;
+	int fd, ret;
+
+	/* weston_ring_buffer::size is 32 bits wide; the file offsets
+	 * in the header are 64 bits */
+	if (size == 0 || size >= UINT32_MAX)
+		return NULL;
+
+	if (asprintf(&old_path, "%s.old", path) < 0)
+		return NULL;
+	if (rename(path, old_path) < 0 && errno != ENOENT)
+		weston_log("flight recorder: could not keep %s: %s\n",
+			   path, strerror(errno));
+	free(old_path);
+
+	fd = open(path, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+	if (fd < 0)
+		return NULL;
+
+	/* Allocate the blocks up front: running out of space while
+	 * writing to a mapping would raise SIGBUS. */
+	map_size = header_size + size;
+#ifdef HAVE_POSIX_FALLOCATE
+	do {
+		ret = posix_fallocate(fd, 0, map_size);
+	} while (ret == EINTR);
+	/* not supported by the file system */
+	if (ret == EINVAL || ret == EOPNOTSUPP)
+		ret = ftruncate(fd, map_size);
+#else
+	ret = ftruncate(fd, map_size);
+#endif
+	if (ret != 0) {
+		close(fd);
+		unlink(path);
+		return NULL;
+	}
+
+	header = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+		      fd, 0);
+	close(fd);
+	if (header == MAP_FAILED) {
+		unlink(path);
+		return NULL;
+	}
+
+	flight_rec = weston_log_flight_recorder_alloc();
+	if (!flight_rec) {
+		munmap(header, map_size);
+		return NULL;
+	}
+
+	header->version = WESTON_FLIGHT_REC_VERSION;
+	header->header_size = header_size;
+	header->pid = getpid();
+	header->size = size;
+	header->written = 0;
+	header->committed = 0;
+	/* the magic last, so that a valid header is complete */
+	__atomic_store_n(&header->magic, WESTON_FLIGHT_REC_MAGIC,
+			 __ATOMIC_RELEASE);
+
+	weston_ring_buffer_init(&flight_rec->rb, size + 1,
+				(char *)header + header_size);
+	flight_rec->rb.header = header;
+	flight_rec->rb.map_size = map_size;
+	weston_primary_flight_recorder_ring_buffer = &flight_rec->rb;
+
+	return &flight_rec->base;
+}
+
 /** Retrieve flight recorder ring buffer contents, could be useful when
  * implementing an assert()-like wrapper.
  *
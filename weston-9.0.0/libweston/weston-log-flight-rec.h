@@ -0,0 +1,60 @@
+/*
+ * Copyright © 2026 The Annland Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef WESTON_LOG_FLIGHT_REC_H
+#define WESTON_LOG_FLIGHT_REC_H
+
+#include <stdint.h>
+
+/*
+ * Layout of a file-backed flight recorder, see
+ * weston_log_subscriber_create_flight_rec_file(). Read back offline by
+ * weston-flight-rec.
+ *
+ * The file holds this header, then 'size' bytes of ring buffer starting at
+ * 'header_size'. Host byte order.
+ *
+ * Writers reserve space by atomically adding to 'written', the number of
+ * bytes ever appended, copy their data to the ring and then atomically add
+ * to 'committed'. So the next append position is written % size, and the
+ * ring has wrapped over once written >= size. If 'committed' is behind
+ * 'written', the writer of the newest bytes did not finish, e.g. because
+ * it crashed while copying.
+ */
+
+#define WESTON_FLIGHT_REC_MAGIC		0x43524657	/* "WFRC" */
+#define WESTON_FLIGHT_REC_VERSION	1
+
+struct weston_flight_rec_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t header_size;	/**< offset of the ring in the file */
+	uint32_t pid;		/**< of the writer */
+	uint64_t size;		/**< ring size in bytes */
+	uint64_t written;	/**< bytes reserved by writers */
+	uint64_t committed;	/**< bytes completely copied */
+};
+
+#endif /* WESTON_LOG_FLIGHT_REC_H */
@@ -177,6 +177,9 @@ frame_get_shadow_margin(struct frame *frame);
 uint32_t
 frame_status(struct frame *frame);
 
+uint32_t
+frame_flags(struct frame *frame);
+
 void
 frame_status_clear(struct frame *frame, enum frame_status status);
 
@@ -230,4 +233,12 @@ frame_double_touch_up(struct frame *frame, void *data, int32_t id);
 void
 frame_repaint(struct frame *frame, cairo_t *cr);
 
+/* frame_repaint() in two steps. The background only depends on the size,
+ * title, flags and buttons of the frame, so it can be cached. */
+void
+frame_repaint_background(struct frame *frame, cairo_t *cr);
+
+void
+frame_repaint_buttons(struct frame *frame, cairo_t *cr);
+
 #endif
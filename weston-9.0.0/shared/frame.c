@@ -669,6 +669,12 @@ frame_status(struct frame *frame)
 	return frame->status;
 }
 
+uint32_t
+frame_flags(struct frame *frame)
+{
+	return frame->flags;
+}
+
 void
 frame_status_clear(struct frame *frame, enum frame_status status)
 {
@@ -995,9 +1001,8 @@ frame_double_touch_up(struct frame *frame, void *data, int32_t id)
 }
 
 void
-frame_repaint(struct frame *frame, cairo_t *cr)
+frame_repaint_background(struct frame *frame, cairo_t *cr)
 {
-	struct frame_button *button;
 	uint32_t flags = 0;
 
 	frame_refresh_geometry(frame);
@@ -1013,9 +1018,24 @@ frame_repaint(struct frame *frame, cairo_t *cr)
 			   frame->title, &frame->title_rect,
 			   &frame->buttons, flags);
 	cairo_restore(cr);
+}
+
+void
+frame_repaint_buttons(struct frame *frame, cairo_t *cr)
+{
+	struct frame_button *button;
+
+	frame_refresh_geometry(frame);
 
 	wl_list_for_each(button, &frame->buttons, link)
 		frame_button_repaint(button, cr);
 
 	frame_status_clear(frame, FRAME_STATUS_REPAINT);
 }
+
+void
+frame_repaint(struct frame *frame, cairo_t *cr)
+{
+	frame_repaint_background(frame, cr);
+	frame_repaint_buttons(frame, cr);
+}
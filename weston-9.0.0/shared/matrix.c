@@ -31,6 +31,10 @@
 #include <stdlib.h>
 #include <math.h>
 
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
 #ifdef UNIT_TEST
 #define WL_EXPORT
 #else
@@ -46,8 +50,43 @@
  *  1  5  9 13
  *  2  6 10 14
  *  3  7 11 15
+ *
+ * Unless the type has WESTON_MATRIX_TRANSFORM_OTHER set, the matrix was
+ * built only from translations, scales and rotations in the xy-plane, so
+ * it has the form
+ *  a  c  0 tx
+ *  b  d  0 ty
+ *  0  0 sz tz
+ *  0  0  0  1
+ * and the operations below take shortcuts based on that.
  */
 
+enum matrix_class {
+	MATRIX_IDENTITY,
+	MATRIX_TRANSLATE,
+	MATRIX_SCALE_TRANSLATE,
+	MATRIX_AFFINE_2D,
+	MATRIX_GENERAL,
+};
+
+static inline enum matrix_class
+matrix_classify(const struct weston_matrix *matrix)
+{
+	unsigned int type = matrix->type;
+
+	if (type == 0)
+		return MATRIX_IDENTITY;
+	if (type & WESTON_MATRIX_TRANSFORM_OTHER)
+		return MATRIX_GENERAL;
+	if (!(type & ~WESTON_MATRIX_TRANSFORM_TRANSLATE))
+		return MATRIX_TRANSLATE;
+	if (!(type & ~(WESTON_MATRIX_TRANSFORM_TRANSLATE |
+		       WESTON_MATRIX_TRANSFORM_SCALE)))
+		return MATRIX_SCALE_TRANSLATE;
+
+	return MATRIX_AFFINE_2D;
+}
+
 WL_EXPORT void
 weston_matrix_init(struct weston_matrix *matrix)
 {
@@ -59,23 +98,85 @@ weston_matrix_init(struct weston_matrix *matrix)
 	memcpy(matrix, &identity, sizeof identity);
 }
 
+/* m <- n * m for matrices of the 2D affine form. Writes m in place:
+ * going through a temporary and memcpy() makes the copy stall on
+ * store forwarding, which costs more than the arithmetic. */
+static inline void
+multiply_affine_2d(float *m, const float *n)
+{
+	float m0 = m[0], m1 = m[1], m4 = m[4], m5 = m[5];
+	float m12 = m[12], m13 = m[13];
+
+	m[0] = n[0] * m0 + n[4] * m1;
+	m[1] = n[1] * m0 + n[5] * m1;
+	m[4] = n[0] * m4 + n[4] * m5;
+	m[5] = n[1] * m4 + n[5] * m5;
+	m[10] = n[10] * m[10];
+	m[12] = n[0] * m12 + n[4] * m13 + n[12];
+	m[13] = n[1] * m12 + n[5] * m13 + n[13];
+	m[14] = n[10] * m[14] + n[14];
+}
+
+/* r <- n * m, each column of r is a linear combination of n's columns. */
+static inline void
+multiply_general(float *r, const float *n, const float *m)
+{
+#ifdef __SSE__
+	__m128 n0 = _mm_loadu_ps(&n[0]);
+	__m128 n1 = _mm_loadu_ps(&n[4]);
+	__m128 n2 = _mm_loadu_ps(&n[8]);
+	__m128 n3 = _mm_loadu_ps(&n[12]);
+	__m128 c;
+	int i;
+
+	for (i = 0; i < 16; i += 4) {
+		c = _mm_mul_ps(n0, _mm_set1_ps(m[i + 0]));
+		c = _mm_add_ps(c, _mm_mul_ps(n1, _mm_set1_ps(m[i + 1])));
+		c = _mm_add_ps(c, _mm_mul_ps(n2, _mm_set1_ps(m[i + 2])));
+		c = _mm_add_ps(c, _mm_mul_ps(n3, _mm_set1_ps(m[i + 3])));
+		_mm_storeu_ps(&r[i], c);
+	}
+#else
+	int i, j;
+
+	for (i = 0; i < 16; i += 4)
+		for (j = 0; j < 4; j++)
+			r[i + j] = n[j] * m[i + 0] + n[j + 4] * m[i + 1] +
+				   n[j + 8] * m[i + 2] + n[j + 12] * m[i + 3];
+#endif
+}
+
 /* m <- n * m, that is, m is multiplied on the LEFT. */
 WL_EXPORT void
 weston_matrix_multiply(struct weston_matrix *m, const struct weston_matrix *n)
 {
 	struct weston_matrix tmp;
-	const float *row, *column;
-	div_t d;
-	int i, j;
 
-	for (i = 0; i < 16; i++) {
-		tmp.d[i] = 0;
-		d = div(i, 4);
-		row = m->d + d.quot * 4;
-		column = n->d + d.rem;
-		for (j = 0; j < 4; j++)
-			tmp.d[i] += row[j] * column[j * 4];
+	switch (matrix_classify(n)) {
+	case MATRIX_IDENTITY:
+		return;
+	case MATRIX_TRANSLATE:
+		if (m->type & WESTON_MATRIX_TRANSFORM_OTHER)
+			break;
+		m->d[12] += n->d[12];
+		m->d[13] += n->d[13];
+		m->d[14] += n->d[14];
+		m->type |= n->type;
+		return;
+	case MATRIX_SCALE_TRANSLATE:
+	case MATRIX_AFFINE_2D:
+		if (m->type & WESTON_MATRIX_TRANSFORM_OTHER)
+			break;
+		if (m == n)
+			break;
+		multiply_affine_2d(m->d, n->d);
+		m->type |= n->type;
+		return;
+	case MATRIX_GENERAL:
+		break;
 	}
+
+	multiply_general(tmp.d, n->d, m->d);
 	tmp.type = m->type | n->type;
 	memcpy(m, &tmp, sizeof tmp);
 }
@@ -117,16 +218,53 @@ weston_matrix_rotate_xy(struct weston_matrix *matrix, float cos, float sin)
 WL_EXPORT void
 weston_matrix_transform(struct weston_matrix *matrix, struct weston_vector *v)
 {
-	int i, j;
-	struct weston_vector t;
+	const float *d = matrix->d;
+	float x = v->f[0], y = v->f[1], z = v->f[2], w = v->f[3];
+
+	switch (matrix_classify(matrix)) {
+	case MATRIX_IDENTITY:
+		return;
+	case MATRIX_TRANSLATE:
+		v->f[0] = x + d[12] * w;
+		v->f[1] = y + d[13] * w;
+		v->f[2] = z + d[14] * w;
+		return;
+	case MATRIX_SCALE_TRANSLATE:
+		v->f[0] = d[0] * x + d[12] * w;
+		v->f[1] = d[5] * y + d[13] * w;
+		v->f[2] = d[10] * z + d[14] * w;
+		return;
+	case MATRIX_AFFINE_2D:
+		v->f[0] = d[0] * x + d[4] * y + d[12] * w;
+		v->f[1] = d[1] * x + d[5] * y + d[13] * w;
+		v->f[2] = d[10] * z + d[14] * w;
+		return;
+	case MATRIX_GENERAL:
+		break;
+	}
 
-	for (i = 0; i < 4; i++) {
-		t.f[i] = 0;
-		for (j = 0; j < 4; j++)
-			t.f[i] += v->f[j] * matrix->d[i + j * 4];
+#ifdef __SSE__
+	{
+		__m128 t;
+
+		t = _mm_mul_ps(_mm_loadu_ps(&d[0]), _mm_set1_ps(x));
+		t = _mm_add_ps(t, _mm_mul_ps(_mm_loadu_ps(&d[4]),
+					     _mm_set1_ps(y)));
+		t = _mm_add_ps(t, _mm_mul_ps(_mm_loadu_ps(&d[8]),
+					     _mm_set1_ps(z)));
+		t = _mm_add_ps(t, _mm_mul_ps(_mm_loadu_ps(&d[12]),
+					     _mm_set1_ps(w)));
+		_mm_storeu_ps(v->f, t);
 	}
+#else
+	{
+		int i;
 
-	*v = t;
+		for (i = 0; i < 4; i++)
+			v->f[i] = x * d[i] + y * d[i + 4] +
+				  z * d[i + 8] + w * d[i + 12];
+	}
+#endif
 }
 
 static inline void
@@ -256,6 +394,42 @@ inverse_transform(const double *LU, const unsigned *p, float *v)
 		v[j] = b[j];
 }
 
+/* Inverts a matrix of the 2D affine form, in double precision like the
+ * general case. Rejects the same near-zero pivots as matrix_invert().
+ * All of the input is read before inverse is written, so they may be the
+ * same matrix. */
+static int
+invert_affine_2d(struct weston_matrix *inverse,
+		 const struct weston_matrix *matrix)
+{
+	const float *d = matrix->d;
+	double a = d[0], b = d[1], c = d[4], e = d[5];
+	double tx = d[12], ty = d[13], sz = d[10], tz = d[14];
+	unsigned int type = matrix->type;
+	double det, pivot;
+
+	pivot = fabs(a) > fabs(b) ? fabs(a) : fabs(b);
+	if (pivot < 1e-9)
+		return -1;
+
+	det = a * e - b * c;
+	if (fabs(det) / pivot < 1e-9 || fabs(sz) < 1e-9)
+		return -1;
+
+	weston_matrix_init(inverse);
+	inverse->d[0] = e / det;
+	inverse->d[1] = -b / det;
+	inverse->d[4] = -c / det;
+	inverse->d[5] = a / det;
+	inverse->d[10] = 1.0 / sz;
+	inverse->d[12] = (c * ty - e * tx) / det;
+	inverse->d[13] = (b * tx - a * ty) / det;
+	inverse->d[14] = -tz / sz;
+	inverse->type = type;
+
+	return 0;
+}
+
 WL_EXPORT int
 weston_matrix_invert(struct weston_matrix *inverse,
 		     const struct weston_matrix *matrix)
@@ -263,6 +437,31 @@ weston_matrix_invert(struct weston_matrix *inverse,
 	double LU[16];		/* column-major */
 	unsigned perm[4];	/* permutation */
 	unsigned c;
+	float tx, ty, tz;
+	unsigned int type;
+
+	switch (matrix_classify(matrix)) {
+	case MATRIX_IDENTITY:
+		weston_matrix_init(inverse);
+		return 0;
+	case MATRIX_TRANSLATE:
+		tx = matrix->d[12];
+		ty = matrix->d[13];
+		tz = matrix->d[14];
+		type = matrix->type;
+
+		weston_matrix_init(inverse);
+		inverse->d[12] = -tx;
+		inverse->d[13] = -ty;
+		inverse->d[14] = -tz;
+		inverse->type = type;
+		return 0;
+	case MATRIX_SCALE_TRANSLATE:
+	case MATRIX_AFFINE_2D:
+		return invert_affine_2d(inverse, matrix);
+	case MATRIX_GENERAL:
+		break;
+	}
 
 	if (matrix_invert(LU, perm, matrix) < 0)
 		return -1;
@@ -202,6 +202,10 @@ os_create_anonymous_file(off_t size)
 			return -1;
 	}
 
+	/* posix_fallocate() rejects a zero length. */
+	if (size == 0)
+		return fd;
+
 #ifdef HAVE_POSIX_FALLOCATE
 	do {
 		ret = posix_fallocate(fd, 0, size);
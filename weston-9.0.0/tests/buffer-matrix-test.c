@@ -0,0 +1,162 @@
+/*
+ * Copyright © 2026 The Annland Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+
+#include <libweston/libweston.h>
+#include "libweston-internal.h"
+#include "shared/helpers.h"
+#include "weston-test-runner.h"
+#include "weston-test-fixture-compositor.h"
+
+static enum test_result_code
+fixture_setup(struct weston_test_harness *harness)
+{
+	struct compositor_setup setup;
+
+	compositor_setup_defaults(&setup);
+
+	return weston_test_harness_execute_as_plugin(harness, &setup);
+}
+DECLARE_FIXTURE_SETUP(fixture_setup);
+
+/* Something weston_surface_update_buffer_matrix() never builds */
+static void
+poison_matrices(struct weston_surface *surface)
+{
+	surface->surface_to_buffer_matrix.d[0] = 42.0f;
+	surface->buffer_to_surface_matrix.d[0] = 42.0f;
+}
+
+static bool
+matrices_poisoned(struct weston_surface *surface)
+{
+	return surface->surface_to_buffer_matrix.d[0] == 42.0f &&
+	       surface->buffer_to_surface_matrix.d[0] == 42.0f;
+}
+
+/* The matrices against weston_surface_to_buffer_float(), which does not
+ * use them, and back. */
+static bool
+matrices_match(struct weston_surface *surface)
+{
+	static const float points[][2] = {
+		{ 0.0f, 0.0f }, { 7.0f, 3.0f }, { 20.0f, 10.0f },
+	};
+	struct weston_vector v;
+	float bx, by;
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_LENGTH(points); i++) {
+		weston_surface_to_buffer_float(surface, points[i][0],
+					       points[i][1], &bx, &by);
+
+		v.f[0] = points[i][0];
+		v.f[1] = points[i][1];
+		v.f[2] = 0.0f;
+		v.f[3] = 1.0f;
+		weston_matrix_transform(&surface->surface_to_buffer_matrix,
+					&v);
+		if (fabsf(v.f[0] / v.f[3] - bx) > 1e-3f ||
+		    fabsf(v.f[1] / v.f[3] - by) > 1e-3f)
+			return false;
+
+		weston_matrix_transform(&surface->buffer_to_surface_matrix,
+					&v);
+		if (fabsf(v.f[0] / v.f[3] - points[i][0]) > 1e-3f ||
+		    fabsf(v.f[1] / v.f[3] - points[i][1]) > 1e-3f)
+			return false;
+	}
+
+	return true;
+}
+
+/* A commit that changes nothing the matrices depend on keeps them. */
+static void
+assert_reused(struct weston_surface *surface)
+{
+	poison_matrices(surface);
+	weston_surface_update_buffer_matrix(surface);
+	assert(matrices_poisoned(surface));
+}
+
+static void
+assert_rebuilt(struct weston_surface *surface)
+{
+	poison_matrices(surface);
+	weston_surface_update_buffer_matrix(surface);
+	assert(!matrices_poisoned(surface));
+	assert(matrices_match(surface));
+}
+
+PLUGIN_TEST(buffer_matrix_rebuilt_on_change)
+{
+	/* struct weston_compositor *compositor; */
+	struct weston_buffer_viewport *vp;
+	struct weston_surface *surface;
+
+	surface = weston_surface_create(compositor);
+	assert(surface);
+	vp = &surface->buffer_viewport;
+
+	surface->width_from_buffer = 100;
+	surface->height_from_buffer = 60;
+	assert_rebuilt(surface);
+	assert_reused(surface);
+
+	vp->buffer.scale = 2;
+	assert_rebuilt(surface);
+	assert_reused(surface);
+
+	vp->buffer.transform = WL_OUTPUT_TRANSFORM_90;
+	assert_rebuilt(surface);
+	assert_reused(surface);
+
+	/* wp_viewport source rectangle, then destination size */
+	vp->buffer.src_x = wl_fixed_from_int(4);
+	vp->buffer.src_y = wl_fixed_from_int(2);
+	vp->buffer.src_width = wl_fixed_from_int(20);
+	vp->buffer.src_height = wl_fixed_from_int(40);
+	assert_rebuilt(surface);
+	assert_reused(surface);
+
+	vp->surface.width = 80;
+	vp->surface.height = 40;
+	assert_rebuilt(surface);
+	assert_reused(surface);
+
+	/* a buffer of another size */
+	vp->buffer.src_width = wl_fixed_from_int(-1);
+	assert_rebuilt(surface);
+	surface->width_from_buffer = 120;
+	assert_rebuilt(surface);
+	assert_reused(surface);
+
+	weston_surface_destroy(surface);
+}
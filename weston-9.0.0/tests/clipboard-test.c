@@ -0,0 +1,279 @@
+/*
+ * Copyright © 2026 The Annland Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <libweston/libweston.h>
+#include "libweston-internal.h"
+#include "shared/helpers.h"
+#include "shared/timespec-util.h"
+#include "weston-test-runner.h"
+#include "weston-test-fixture-compositor.h"
+
+#define PAYLOAD_SIZE (100 * 1000 * 1000)
+#define PAYLOAD_MIME_TYPE "application/octet-stream"
+#define TEXT_MIME_TYPE "text/plain;charset=utf-8"
+
+static enum test_result_code
+fixture_setup(struct weston_test_harness *harness)
+{
+	struct compositor_setup setup;
+
+	compositor_setup_defaults(&setup);
+
+	return weston_test_harness_execute_as_plugin(harness, &setup);
+}
+DECLARE_FIXTURE_SETUP(fixture_setup);
+
+/* One end of a copy or a paste, run in its own thread since the
+ * compositor side is driven by the event loop of this one. */
+struct transfer {
+	pthread_t thread;
+	int fd;
+	size_t size;
+	uint32_t seed;
+	/* reader only */
+	size_t received;
+	bool match;
+	bool done;
+};
+
+static uint8_t
+pattern_byte(uint32_t seed, size_t i)
+{
+	return (uint8_t) (((uint32_t) i * 2654435761u + seed) >> 24);
+}
+
+static void *
+writer_thread(void *data)
+{
+	struct transfer *t = data;
+	uint8_t buf[64 * 1024];
+	size_t offset = 0;
+	size_t len, i;
+	ssize_t n;
+
+	while (offset < t->size) {
+		len = MIN(sizeof buf, t->size - offset);
+		for (i = 0; i < len; i++)
+			buf[i] = pattern_byte(t->seed, offset + i);
+
+		for (i = 0; i < len; i += n) {
+			n = write(t->fd, buf + i, len - i);
+			assert(n > 0);
+		}
+		offset += len;
+	}
+
+	close(t->fd);
+	__atomic_store_n(&t->done, true, __ATOMIC_RELEASE);
+
+	return NULL;
+}
+
+static void *
+reader_thread(void *data)
+{
+	struct transfer *t = data;
+	uint8_t buf[64 * 1024];
+	ssize_t n, i;
+
+	t->match = true;
+	while ((n = read(t->fd, buf, sizeof buf)) != 0) {
+		if (n < 0 && errno == EINTR)
+			continue;
+		assert(n > 0);
+
+		for (i = 0; i < n && t->match; i++)
+			t->match = buf[i] == pattern_byte(t->seed,
+							  t->received + i);
+		t->received += n;
+	}
+
+	close(t->fd);
+	__atomic_store_n(&t->done, true, __ATOMIC_RELEASE);
+
+	return NULL;
+}
+
+static void
+dispatch_until_done(struct weston_compositor *compositor, struct transfer *t)
+{
+	struct wl_event_loop *loop =
+		wl_display_get_event_loop(compositor->wl_display);
+
+	while (!__atomic_load_n(&t->done, __ATOMIC_ACQUIRE))
+		wl_event_loop_dispatch(loop, 10);
+
+	pthread_join(t->thread, NULL);
+}
+
+struct test_source {
+	struct weston_data_source base;
+	struct transfer payload;
+	struct transfer text;
+};
+
+static void
+test_source_accept(struct weston_data_source *source,
+		   uint32_t time, const char *mime_type)
+{
+}
+
+static void
+test_source_send(struct weston_data_source *base,
+		 const char *mime_type, int32_t fd)
+{
+	struct test_source *source = container_of(base, struct test_source,
+						  base);
+	struct transfer *t;
+
+	if (strcmp(mime_type, PAYLOAD_MIME_TYPE) == 0)
+		t = &source->payload;
+	else if (strcmp(mime_type, TEXT_MIME_TYPE) == 0)
+		t = &source->text;
+	else
+		assert(!"unexpected MIME type");
+
+	t->fd = fd;
+	assert(pthread_create(&t->thread, NULL, writer_thread, t) == 0);
+}
+
+static void
+test_source_cancel(struct weston_data_source *source)
+{
+}
+
+static void
+test_source_init(struct test_source *source)
+{
+	const char **s;
+
+	memset(source, 0, sizeof *source);
+	wl_array_init(&source->base.mime_types);
+	source->base.accept = test_source_accept;
+	source->base.send = test_source_send;
+	source->base.cancel = test_source_cancel;
+	wl_signal_init(&source->base.destroy_signal);
+
+	s = wl_array_add(&source->base.mime_types, 2 * sizeof *s);
+	assert(s);
+	s[0] = PAYLOAD_MIME_TYPE;
+	s[1] = TEXT_MIME_TYPE;
+
+	source->payload.size = PAYLOAD_SIZE;
+	source->payload.seed = 0x1234;
+	source->text.size = 4096;
+	source->text.seed = 0x5678;
+}
+
+static void
+paste(struct weston_compositor *compositor, struct weston_seat *seat,
+      const char *mime_type, struct transfer *t)
+{
+	struct weston_data_source *selection = seat->selection_data_source;
+	int p[2];
+
+	assert(pipe2(p, O_CLOEXEC) == 0);
+
+	t->fd = p[0];
+	assert(pthread_create(&t->thread, NULL, reader_thread, t) == 0);
+
+	selection->send(selection, mime_type, p[1]);
+	dispatch_until_done(compositor, t);
+}
+
+static bool
+offers(struct weston_data_source *source, const char *mime_type)
+{
+	char **s;
+
+	wl_array_for_each(s, &source->mime_types)
+		if (strcmp(*s, mime_type) == 0)
+			return true;
+
+	return false;
+}
+
+PLUGIN_TEST(clipboard_large_paste)
+{
+	/* struct weston_compositor *compositor; */
+	struct weston_seat seat;
+	struct test_source source;
+	struct transfer payload = { .size = PAYLOAD_SIZE, .seed = 0x1234 };
+	struct transfer text = { .size = 4096, .seed = 0x5678 };
+	struct transfer unknown = { 0 };
+	struct timespec begin, copied, pasted;
+
+	weston_seat_init(&seat, compositor, "clipboard-test");
+	test_source_init(&source);
+
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+
+	/* Every MIME type is fetched in turn while the source is alive. */
+	weston_seat_set_selection(&seat, &source.base, 1);
+	dispatch_until_done(compositor, &source.payload);
+	dispatch_until_done(compositor, &source.text);
+
+	clock_gettime(CLOCK_MONOTONIC, &copied);
+
+	/* The clipboard takes over once the source is gone. */
+	wl_signal_emit(&source.base.destroy_signal, &source.base);
+	assert(seat.selection_data_source);
+	assert(seat.selection_data_source != &source.base);
+	assert(offers(seat.selection_data_source, PAYLOAD_MIME_TYPE));
+	assert(offers(seat.selection_data_source, TEXT_MIME_TYPE));
+
+	paste(compositor, &seat, PAYLOAD_MIME_TYPE, &payload);
+	clock_gettime(CLOCK_MONOTONIC, &pasted);
+	assert(payload.received == PAYLOAD_SIZE);
+	assert(payload.match);
+
+	paste(compositor, &seat, TEXT_MIME_TYPE, &text);
+	assert(text.received == text.size);
+	assert(text.match);
+
+	paste(compositor, &seat, "text/x-not-offered", &unknown);
+	assert(unknown.received == 0);
+
+	testlog("%d MB copied in %.1f ms, pasted in %.1f ms\n",
+		PAYLOAD_SIZE / (1000 * 1000),
+		timespec_sub_to_nsec(&copied, &begin) / 1e6,
+		timespec_sub_to_nsec(&pasted, &copied) / 1e6);
+
+	wl_array_release(&source.base.mime_types);
+	weston_seat_release(&seat);
+}
@@ -0,0 +1,101 @@
+/*
+ * Copyright © 2026 The Annland Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <time.h>
+
+#include "shared/helpers.h"
+#include "shared/timespec-util.h"
+#include "weston-test-client-helper.h"
+#include "weston-test-fixture-compositor.h"
+
+#define SURFACE_SIZE 64
+#define COMMITS 10000
+#define COMMITS_PER_ROUNDTRIP 100
+
+static enum test_result_code
+fixture_setup(struct weston_test_harness *harness)
+{
+	struct compositor_setup setup;
+
+	compositor_setup_defaults(&setup);
+
+	return weston_test_harness_execute_as_client(harness, &setup);
+}
+DECLARE_FIXTURE_SETUP(fixture_setup);
+
+static void
+run_commit_bench(const char *label, bool toggle_scale)
+{
+	struct client *client;
+	struct wl_surface *surface;
+	struct timespec begin, end;
+	int64_t nsec;
+	int i;
+
+	client = create_client_and_test_surface(10, 10,
+						SURFACE_SIZE, SURFACE_SIZE);
+	surface = client->surface->wl_surface;
+
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (i = 0; i < COMMITS; i++) {
+		/* Changing the buffer scale invalidates the buffer matrices
+		 * on every commit, damage alone should not. */
+		if (toggle_scale)
+			wl_surface_set_buffer_scale(surface, 1 + i % 2);
+
+		wl_surface_attach(surface, client->surface->buffer->proxy,
+				  0, 0);
+		wl_surface_damage(surface, i % SURFACE_SIZE, 0, 1, 1);
+		wl_surface_commit(surface);
+
+		if (i % COMMITS_PER_ROUNDTRIP == COMMITS_PER_ROUNDTRIP - 1)
+			client_roundtrip(client);
+	}
+	client_roundtrip(client);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	nsec = timespec_sub_to_nsec(&end, &begin);
+	testlog("%s: %d commits in %.1f ms, %.0f commits/s\n",
+		label, COMMITS, nsec / 1e6, COMMITS * 1e9 / nsec);
+
+	client_destroy(client);
+}
+
+/* Not a correctness test: reports how many wl_surface.commit requests
+ * per second the compositor sustains for a single client. */
+TEST(commit_throughput_damage_only)
+{
+	run_commit_bench("damage only", false);
+}
+
+TEST(commit_throughput_scale_change)
+{
+	run_commit_bench("buffer scale change", true);
+}
@@ -0,0 +1,155 @@
+/*
+ * Copyright © 2026 The Annland Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include "weston-test-runner.h"
+
+#include "shared/helpers.h"
+#include "damage-simplify.h"
+
+static int
+region_n_rects(pixman_region32_t *region)
+{
+	int n;
+
+	pixman_region32_rectangles(region, &n);
+	return n;
+}
+
+/* The simplified region must still cover all of the damage. */
+static void
+assert_contains(pixman_region32_t *region, pixman_region32_t *damage)
+{
+	pixman_region32_t rest;
+
+	pixman_region32_init(&rest);
+	pixman_region32_subtract(&rest, damage, region);
+	assert(!pixman_region32_not_empty(&rest));
+	pixman_region32_fini(&rest);
+}
+
+/* A grid of cols x rows squares of the given size, gap pixels apart. */
+static void
+make_grid(pixman_region32_t *region, int cols, int rows, int size, int gap)
+{
+	int i, j;
+
+	pixman_region32_init(region);
+	for (j = 0; j < rows; j++)
+		for (i = 0; i < cols; i++)
+			pixman_region32_union_rect(region, region,
+						   i * (size + gap),
+						   j * (size + gap),
+						   size, size);
+}
+
+TEST(damage_simplify_disabled)
+{
+	struct weston_damage_simplify_result res;
+	pixman_region32_t region;
+
+	make_grid(&region, 10, 10, 8, 2);
+	weston_damage_simplify(&region, 0, 0.25, &res);
+
+	assert(res.rects_in == 100);
+	assert(res.rects_out == 100);
+	assert(res.area_in == 100 * 8 * 8);
+	assert(res.area_overdrawn == 0);
+	assert(region_n_rects(&region) == 100);
+
+	pixman_region32_fini(&region);
+}
+
+TEST(damage_simplify_merges_fragments)
+{
+	struct weston_damage_simplify_result res;
+	pixman_region32_t region, damage;
+
+	/* Like text drawn glyph by glyph: small boxes with 1 px gaps. */
+	make_grid(&damage, 40, 4, 7, 1);
+	pixman_region32_init(&region);
+	pixman_region32_copy(&region, &damage);
+
+	weston_damage_simplify(&region, 32, 0.25, &res);
+
+	assert(res.rects_in == 160);
+	assert(res.rects_out == region_n_rects(&region));
+	assert(res.rects_out <= 32);
+	assert_contains(&region, &damage);
+	/* The gaps are 1/8 of each row and column. */
+	assert(res.area_overdrawn * 2 < res.area_in);
+
+	pixman_region32_fini(&region);
+	pixman_region32_fini(&damage);
+}
+
+TEST(damage_simplify_keeps_distant_rects)
+{
+	struct weston_damage_simplify_result res;
+	pixman_region32_t region;
+
+	pixman_region32_init_rect(&region, 0, 0, 10, 10);
+	pixman_region32_union_rect(&region, &region, 1000, 1000, 10, 10);
+
+	weston_damage_simplify(&region, 32, 0.25, &res);
+	assert(res.rects_out == 2);
+	assert(res.area_overdrawn == 0);
+
+	/* Merged regardless of the overhead to meet the bound. */
+	weston_damage_simplify(&region, 1, 0.25, &res);
+	assert(res.rects_out == 1);
+	assert(res.area_overdrawn == 1010 * 1010 - 200);
+
+	pixman_region32_fini(&region);
+}
+
+TEST(damage_simplify_bounds_scattered_rects)
+{
+	struct weston_damage_simplify_result res;
+	pixman_region32_t region, damage;
+	int i;
+
+	srandom(7);
+	pixman_region32_init(&damage);
+	for (i = 0; i < 500; i++)
+		pixman_region32_union_rect(&damage, &damage,
+					   random() % 1920, random() % 1080,
+					   1 + random() % 4, 1 + random() % 4);
+
+	pixman_region32_init(&region);
+	pixman_region32_copy(&region, &damage);
+	weston_damage_simplify(&region, 16, 0.25, &res);
+
+	assert(res.rects_in == region_n_rects(&damage));
+	assert(res.rects_out <= 16);
+	assert_contains(&region, &damage);
+
+	pixman_region32_fini(&region);
+	pixman_region32_fini(&damage);
+}
@@ -0,0 +1,177 @@
+/*
+ * Copyright © 2026 The Annland Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <libweston/libweston.h>
+#include <libweston/weston-log.h>
+#include "libweston/weston-log-flight-rec.h"
+#include "weston-test-runner.h"
+
+#define RING_SIZE 64
+
+struct flight_rec_file {
+	struct weston_flight_rec_header header;
+	char *ring;
+};
+
+static void
+make_path(char *path, size_t size)
+{
+	const char *dir = getenv("XDG_RUNTIME_DIR");
+
+	assert(dir);
+	snprintf(path, size, "%s/flight-rec-%d", dir, getpid());
+}
+
+static void
+read_flight_rec_file(const char *path, struct flight_rec_file *file)
+{
+	FILE *fp;
+
+	fp = fopen(path, "r");
+	assert(fp);
+	assert(fread(&file->header, sizeof file->header, 1, fp) == 1);
+	assert(file->header.magic == WESTON_FLIGHT_REC_MAGIC);
+	assert(file->header.version == WESTON_FLIGHT_REC_VERSION);
+	assert(file->header.header_size >= sizeof file->header);
+
+	file->ring = malloc(file->header.size);
+	assert(file->ring);
+	assert(fseek(fp, file->header.header_size, SEEK_SET) == 0);
+	assert(fread(file->ring, 1, file->header.size, fp) ==
+	       file->header.size);
+	fclose(fp);
+}
+
+/* The ring contents oldest first, as weston-flight-rec prints them. */
+static char *
+decode_ring(struct flight_rec_file *file, size_t *len)
+{
+	uint64_t size = file->header.size;
+	uint64_t written = file->header.written;
+	uint64_t pos = written % size;
+	char *out;
+
+	out = malloc(size);
+	assert(out);
+
+	if (written < size) {
+		memcpy(out, file->ring, written);
+		*len = written;
+	} else {
+		memcpy(out, file->ring + pos, size - pos);
+		memcpy(out + size - pos, file->ring, pos);
+		*len = size;
+	}
+
+	return out;
+}
+
+/* Writes through a log scope, then reads the file back after the
+ * subscriber, and with it the mapping, is gone. */
+static void
+write_and_check(const char *path, int n_lines)
+{
+	struct weston_log_context *log_ctx;
+	struct weston_log_subscriber *sub;
+	struct weston_log_scope *scope;
+	struct flight_rec_file file;
+	char stream[4096];
+	size_t stream_len = 0;
+	size_t len;
+	char *data;
+	int i;
+
+	log_ctx = weston_log_ctx_create();
+	assert(log_ctx);
+	scope = weston_log_ctx_add_log_scope(log_ctx, "test", "test scope",
+					     NULL, NULL, NULL);
+	assert(scope);
+
+	sub = weston_log_subscriber_create_flight_rec_file(path, RING_SIZE);
+	assert(sub);
+	weston_log_subscribe(log_ctx, sub, "test");
+
+	for (i = 0; i < n_lines; i++) {
+		weston_log_scope_printf(scope, "line %d\n", i);
+		stream_len += snprintf(stream + stream_len,
+				       sizeof stream - stream_len,
+				       "line %d\n", i);
+		assert(stream_len < sizeof stream);
+	}
+
+	weston_log_subscriber_destroy(sub);
+	weston_log_scope_destroy(scope);
+	weston_log_ctx_destroy(log_ctx);
+
+	read_flight_rec_file(path, &file);
+	assert(file.header.size == RING_SIZE);
+	assert(file.header.pid == (uint32_t)getpid());
+	assert(file.header.written == stream_len);
+	assert(file.header.committed == file.header.written);
+
+	/* Only the newest RING_SIZE bytes survive. */
+	data = decode_ring(&file, &len);
+	assert(len == (stream_len < RING_SIZE ? stream_len : RING_SIZE));
+	assert(memcmp(data, stream + stream_len - len, len) == 0);
+
+	free(data);
+	free(file.ring);
+}
+
+TEST(flight_rec_file_round_trip)
+{
+	char path[256], old_path[300];
+
+	make_path(path, sizeof path);
+	snprintf(old_path, sizeof old_path, "%s.old", path);
+	unlink(path);
+	unlink(old_path);
+
+	/* fits in the ring */
+	write_and_check(path, 3);
+
+	/* wraps around several times; the previous file is kept */
+	write_and_check(path, 100);
+	assert(access(old_path, F_OK) == 0);
+
+	unlink(path);
+	unlink(old_path);
+}
+
+TEST(flight_rec_file_rejects_bad_size)
+{
+	char path[256];
+
+	make_path(path, sizeof path);
+	assert(!weston_log_subscriber_create_flight_rec_file(path, 0));
+}
@@ -0,0 +1,158 @@
+/*
+ * Copyright © 2026 The Annland Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <libweston/libweston.h>
+#include "libweston-internal.h"
+#include "frame-timing.h"
+#include "presentation-time-server-protocol.h"
+#include "shared/timespec-util.h"
+#include "weston-test-runner.h"
+#include "weston-test-fixture-compositor.h"
+
+#define REFRESH_NSEC 16666667
+
+static enum test_result_code
+fixture_setup(struct weston_test_harness *harness)
+{
+	struct compositor_setup setup;
+
+	compositor_setup_defaults(&setup);
+
+	return weston_test_harness_execute_as_plugin(harness, &setup);
+}
+DECLARE_FIXTURE_SETUP(fixture_setup);
+
+/* Repaint 'repaint_nsec' long, starting 'lead_nsec' before the vblank at
+ * 'vblank', and present the frame on that vblank. */
+static void
+run_frame(struct weston_frame_timing *ft, const struct timespec *vblank,
+	  int64_t lead_nsec, int64_t repaint_nsec)
+{
+	struct timespec begin, end;
+
+	timespec_add_nsec(&begin, vblank, -lead_nsec);
+	timespec_add_nsec(&end, &begin, repaint_nsec);
+	weston_frame_timing_repaint_begin(ft, &begin);
+	weston_frame_timing_repaint_end(ft, &end, true);
+	weston_frame_timing_present(ft, vblank, REFRESH_NSEC,
+				    WP_PRESENTATION_FEEDBACK_KIND_VSYNC);
+}
+
+TEST(frame_timing_missed_frames)
+{
+	struct weston_frame_timing *ft;
+	struct timespec vblank = { 1000, 0 };
+	int i;
+
+	ft = weston_frame_timing_create();
+	assert(ft);
+
+	/* Restarting the repaint loop gives no interval. */
+	weston_frame_timing_present(ft, &vblank, REFRESH_NSEC,
+				    WP_PRESENTATION_FEEDBACK_INVALID);
+
+	for (i = 0; i < 10; i++) {
+		timespec_add_nsec(&vblank, &vblank, REFRESH_NSEC);
+		run_frame(ft, &vblank, 7000000, 2000000);
+	}
+	assert(ft->frames == 10);
+	assert(ft->missed == 0);
+	assert(ft->repaint.count == 10);
+	assert(ft->repaint.min_usec == 2000 && ft->repaint.max_usec == 2000);
+	assert(ft->to_flip.min_usec == 7000);
+	assert(ft->jitter.count == 9);
+	assert(ft->jitter.max_usec == 0);
+
+	/* A repaint past the deadline skips two vblanks, and a late
+	 * presentation shows up as jitter. */
+	timespec_add_nsec(&vblank, &vblank, 3 * REFRESH_NSEC);
+	run_frame(ft, &vblank, 20000000, 19000000);
+	timespec_add_nsec(&vblank, &vblank, REFRESH_NSEC + 500000);
+	run_frame(ft, &vblank, 7000000, 2000000);
+	assert(ft->frames == 12);
+	assert(ft->missed == 2);
+	assert(ft->repaint.max_usec == 19000);
+	assert(ft->to_flip.max_usec == 20000);
+	assert(ft->jitter.max_usec == 500);
+
+	/* A repaint loop going idle must not count as missed frames. */
+	timespec_add_nsec(&vblank, &vblank, 100 * REFRESH_NSEC);
+	weston_frame_timing_present(ft, &vblank, REFRESH_NSEC,
+				    WP_PRESENTATION_FEEDBACK_INVALID);
+	timespec_add_nsec(&vblank, &vblank, REFRESH_NSEC);
+	run_frame(ft, &vblank, 7000000, 2000000);
+	assert(ft->frames == 13);
+	assert(ft->missed == 2);
+
+	/* A new window drops the samples but not the frame in flight. */
+	weston_frame_timing_repaint_begin(ft, &vblank);
+	weston_frame_timing_reset(ft);
+	assert(ft->frames == 0 && ft->missed == 0);
+	assert(ft->repaint.count == 0);
+	weston_frame_timing_repaint_end(ft, &vblank, true);
+	timespec_add_nsec(&vblank, &vblank, REFRESH_NSEC);
+	weston_frame_timing_present(ft, &vblank, REFRESH_NSEC,
+				    WP_PRESENTATION_FEEDBACK_KIND_VSYNC);
+	assert(ft->frames == 1 && ft->missed == 0);
+	assert(ft->to_flip.min_usec == 16666);
+
+	weston_frame_timing_destroy(ft);
+}
+
+PLUGIN_TEST(frame_timing_scope)
+{
+	/* struct weston_compositor *compositor; */
+	struct weston_output *output;
+	char *str;
+	size_t len;
+	FILE *fp;
+
+	assert(compositor->frame_timing);
+	assert(!wl_list_empty(&compositor->output_list));
+
+	output = container_of(compositor->output_list.next,
+			      struct weston_output, link);
+	assert(output->frame_timing);
+
+	fp = open_memstream(&str, &len);
+	assert(fp);
+	weston_frame_timing_print(output->frame_timing, output, fp);
+	assert(fclose(fp) == 0);
+
+	testlog("%s", str);
+	assert(strstr(str, output->name));
+	assert(strstr(str, "repaint"));
+	assert(strstr(str, "to-flip"));
+	assert(strstr(str, "jitter"));
+	free(str);
+}
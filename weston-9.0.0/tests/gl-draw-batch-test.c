@@ -0,0 +1,301 @@
+/*
+ * Copyright © 2026 The Annland Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <libweston/libweston.h>
+#include <libweston/weston-log.h>
+#include "libweston-internal.h"
+#include "shared/helpers.h"
+#include "shared/timespec-util.h"
+#include "weston-test-runner.h"
+#include "weston-test-fixture-compositor.h"
+
+#define VIEW_SIZE 64
+#define DAMAGE_TILE 16
+
+struct setup_args {
+	bool batching;
+};
+
+/* Batched first: the immediate run compares against what it left in
+ * batched_frame. */
+static const struct setup_args my_setup_args[] = {
+	{ true },
+	{ false },
+};
+
+/* What gl_draw_batch_matches_immediate saw in the batched run; the
+ * fixtures run one after the other in the same process. */
+static struct {
+	uint32_t *pixels;
+	unsigned int draws;
+} batched_frame;
+
+static enum test_result_code
+fixture_setup(struct weston_test_harness *harness, const struct setup_args *arg)
+{
+	struct compositor_setup setup;
+
+	if (arg->batching)
+		unsetenv("WESTON_GL_DISABLE_BATCHING");
+	else
+		setenv("WESTON_GL_DISABLE_BATCHING", "1", 1);
+
+	compositor_setup_defaults(&setup);
+	setup.renderer = RENDERER_GL;
+	setup.width = 1024;
+	setup.height = 768;
+	setup.logging_scopes = "log,gl-draw-stats";
+
+	return weston_test_harness_execute_as_plugin(harness, &setup);
+}
+DECLARE_FIXTURE_SETUP_WITH_ARG(fixture_setup, my_setup_args);
+
+/* Damage every other tile of the output, like many small client updates
+ * spread over the screen. */
+static void
+damage_checkerboard(struct weston_compositor *compositor,
+		    struct weston_output *output)
+{
+	pixman_region32_t *damage = &compositor->primary_plane.damage;
+	int x, y;
+
+	for (y = 0; y < output->height; y += DAMAGE_TILE)
+		for (x = (y / DAMAGE_TILE) % 2 * DAMAGE_TILE;
+		     x < output->width; x += 2 * DAMAGE_TILE)
+			pixman_region32_union_rect(damage, damage,
+						   output->x + x,
+						   output->y + y,
+						   DAMAGE_TILE, DAMAGE_TILE);
+}
+
+/* The numbers of the last 'gl-draw-stats' line in the log text. */
+static bool
+parse_draw_stats(const char *text, unsigned int *draws,
+		 unsigned int *regions)
+{
+	const char *p, *last = NULL;
+
+	for (p = text; (p = strstr(p, " draw calls, ")); p++)
+		last = p;
+	if (!last)
+		return false;
+
+	while (last > text && isdigit(last[-1]))
+		last--;
+
+	return sscanf(last, "%u draw calls, %u regions", draws, regions) == 2;
+}
+
+/* Many overlapping opaque views, in runs of the same color: batching
+ * must not change a single pixel, and must merge each run into few draw
+ * calls. */
+PLUGIN_TEST(gl_draw_batch_matches_immediate)
+{
+	/* struct weston_compositor *compositor; */
+	static const float colors[][3] = {
+		{ 1.0, 0.0, 0.0 },
+		{ 0.0, 1.0, 0.0 },
+		{ 0.0, 0.0, 1.0 },
+		{ 1.0, 1.0, 0.0 },
+	};
+	const int n_views = 200;
+	const int per_color = n_views / ARRAY_LENGTH(colors);
+	bool batching = !getenv("WESTON_GL_DISABLE_BATCHING");
+	struct weston_log_subscriber *sub;
+	struct weston_output *output;
+	struct weston_surface **surfaces;
+	struct weston_view *view;
+	struct weston_layer layer;
+	unsigned int draws, regions;
+	uint32_t *pixels;
+	char *log_text = NULL;
+	size_t log_size = 0;
+	FILE *log_file;
+	int width, height;
+	int i;
+
+	assert(!wl_list_empty(&compositor->output_list));
+	output = container_of(compositor->output_list.next,
+			      struct weston_output, link);
+	width = output->current_mode->width;
+	height = output->current_mode->height;
+
+	log_file = open_memstream(&log_text, &log_size);
+	assert(log_file);
+	sub = weston_log_subscriber_create_log(log_file);
+	assert(sub);
+	weston_log_subscribe(compositor->weston_log_ctx, sub, "gl-draw-stats");
+
+	weston_layer_init(&layer, compositor);
+	weston_layer_set_position(&layer, WESTON_LAYER_POSITION_NORMAL);
+
+	surfaces = calloc(n_views, sizeof *surfaces);
+	assert(surfaces);
+
+	for (i = 0; i < n_views; i++) {
+		const float *c = colors[i / per_color];
+
+		surfaces[i] = weston_surface_create(compositor);
+		assert(surfaces[i]);
+		weston_surface_set_color(surfaces[i], c[0], c[1], c[2], 1.0);
+		pixman_region32_fini(&surfaces[i]->opaque);
+		pixman_region32_init_rect(&surfaces[i]->opaque, 0, 0,
+					  VIEW_SIZE, VIEW_SIZE);
+		surfaces[i]->width = VIEW_SIZE;
+		surfaces[i]->height = VIEW_SIZE;
+		surfaces[i]->is_mapped = true;
+
+		view = weston_view_create(surfaces[i]);
+		assert(view);
+		view->is_mapped = true;
+		weston_view_set_position(view,
+					 output->x + (i * 37) %
+					 (output->width - VIEW_SIZE),
+					 output->y + (i * 23) %
+					 (output->height - VIEW_SIZE));
+		weston_layer_entry_insert(&layer.view_list, &view->layer_link);
+	}
+
+	weston_output_damage(output);
+	assert(weston_output_repaint(output, NULL) == 0);
+
+	fflush(log_file);
+	assert(parse_draw_stats(log_text, &draws, &regions));
+	testlog("%s: %u draw calls for %u regions\n",
+		batching ? "batched" : "immediate", draws, regions);
+
+	pixels = calloc(width * height, sizeof *pixels);
+	assert(pixels);
+	assert(compositor->renderer->read_pixels(output,
+						 compositor->read_format,
+						 pixels, 0, 0,
+						 width, height) == 0);
+
+	if (batching) {
+		assert(draws < regions);
+		free(batched_frame.pixels);
+		batched_frame.pixels = pixels;
+		batched_frame.draws = draws;
+	} else if (batched_frame.pixels) {
+		assert(batched_frame.draws < draws);
+		assert(memcmp(batched_frame.pixels, pixels,
+			      width * height * sizeof *pixels) == 0);
+		free(batched_frame.pixels);
+		batched_frame.pixels = NULL;
+		free(pixels);
+	} else {
+		testlog("batched run skipped, nothing to compare with\n");
+		free(pixels);
+	}
+
+	weston_log_subscriber_destroy(sub);
+	fclose(log_file);
+	free(log_text);
+
+	for (i = 0; i < n_views; i++)
+		weston_surface_destroy(surfaces[i]);
+	free(surfaces);
+	weston_layer_unset_position(&layer);
+}
+
+/* Not a correctness test, see gl_draw_batch_matches_immediate: reports
+ * the GL repaint cost with and without batching, for many views of the
+ * same solid color under fragmented damage. The draw call counts are in
+ * the 'gl-draw-stats' lines of the compositor log. */
+PLUGIN_TEST(gl_draw_batch_bench)
+{
+	/* struct weston_compositor *compositor; */
+	const int iterations = 20;
+	const int n_views = 400;
+	struct weston_output *output;
+	struct weston_surface **surfaces;
+	struct weston_view *view;
+	struct weston_layer layer;
+	struct timespec begin, end;
+	int per_row;
+	int i, k;
+
+	assert(!wl_list_empty(&compositor->output_list));
+	output = container_of(compositor->output_list.next,
+			      struct weston_output, link);
+
+	weston_layer_init(&layer, compositor);
+	weston_layer_set_position(&layer, WESTON_LAYER_POSITION_NORMAL);
+
+	surfaces = calloc(n_views, sizeof *surfaces);
+	assert(surfaces);
+
+	per_row = output->width / (VIEW_SIZE / 2);
+	for (i = 0; i < n_views; i++) {
+		surfaces[i] = weston_surface_create(compositor);
+		assert(surfaces[i]);
+		weston_surface_set_color(surfaces[i], 0.2, 0.4, 0.6, 1.0);
+		pixman_region32_fini(&surfaces[i]->opaque);
+		pixman_region32_init_rect(&surfaces[i]->opaque, 0, 0,
+					  VIEW_SIZE, VIEW_SIZE);
+		surfaces[i]->width = VIEW_SIZE;
+		surfaces[i]->height = VIEW_SIZE;
+		surfaces[i]->is_mapped = true;
+
+		view = weston_view_create(surfaces[i]);
+		assert(view);
+		view->is_mapped = true;
+		weston_view_set_position(view,
+					 output->x +
+					 (i % per_row) * VIEW_SIZE / 2,
+					 output->y + ((i / per_row) *
+					 VIEW_SIZE / 2) %
+					 (output->height - VIEW_SIZE));
+		weston_layer_entry_insert(&layer.view_list, &view->layer_link);
+	}
+
+	damage_checkerboard(compositor, output);
+	assert(weston_output_repaint(output, NULL) == 0);
+
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (k = 0; k < iterations; k++) {
+		damage_checkerboard(compositor, output);
+		assert(weston_output_repaint(output, NULL) == 0);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	testlog("%d views, %s: %.1f us per output repaint\n", n_views,
+		getenv("WESTON_GL_DISABLE_BATCHING") ? "immediate" : "batched",
+		timespec_sub_to_nsec(&end, &begin) / 1000.0 / iterations);
+
+	for (i = 0; i < n_views; i++)
+		weston_surface_destroy(surfaces[i]);
+	free(surfaces);
+	weston_layer_unset_position(&layer);
+}
@@ -0,0 +1,130 @@
+/*
+ * Copyright © 2026 The Annland Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libweston/libweston.h>
+#include <libweston/weston-log.h>
+#include "libweston-internal.h"
+#include "shared/helpers.h"
+#include "weston-test-runner.h"
+#include "weston-test-fixture-compositor.h"
+#include "weston-test-plugin-helper.h"
+
+static enum test_result_code
+fixture_setup(struct weston_test_harness *harness)
+{
+	struct compositor_setup setup;
+
+	compositor_setup_defaults(&setup);
+	setup.renderer = RENDERER_GL;
+	setup.logging_scopes = "log,gl-gpu-timing";
+
+	return weston_test_harness_execute_as_plugin(harness, &setup);
+}
+DECLARE_FIXTURE_SETUP(fixture_setup);
+
+/* Redrawing a layer cache draws its views inside the query timing the
+ * whole cache: this used to start a second query while the first one
+ * was active. */
+PLUGIN_TEST(gpu_timing_with_flattened_layer)
+{
+	/* struct weston_compositor *compositor; */
+	struct weston_log_subscriber *sub;
+	struct weston_output *output;
+	struct weston_view *views[2], *top;
+	struct weston_layer flat, layer;
+	double views_ms, caches_ms;
+	bool cache_timed = false;
+	char *log_text = NULL;
+	size_t log_size = 0;
+	FILE *log_file;
+	const char *p;
+	int frames = 0;
+	int i;
+
+	log_file = open_memstream(&log_text, &log_size);
+	assert(log_file);
+	sub = weston_log_subscriber_create_log(log_file);
+	assert(sub);
+	weston_log_subscribe(compositor->weston_log_ctx, sub, "gl-gpu-timing");
+
+	output = create_test_output(compositor, 320, 240);
+
+	weston_layer_init(&flat, compositor);
+	weston_layer_set_position(&flat, WESTON_LAYER_POSITION_BACKGROUND);
+	weston_layer_set_flattened(&flat, true);
+	weston_layer_init(&layer, compositor);
+	weston_layer_set_position(&layer, WESTON_LAYER_POSITION_NORMAL);
+
+	views[0] = create_test_view(compositor, &flat, output->x, output->y,
+				    200, 200);
+	views[1] = create_test_view(compositor, &flat, output->x + 50,
+				    output->y + 50, 50, 50);
+	top = create_test_view(compositor, &layer, output->x + 100,
+			       output->y + 100, 100, 100);
+	weston_surface_set_color(top->surface, 0.0, 0.0, 1.0, 1.0);
+
+	/* New content in the flattened layer every frame, so that its
+	 * cache is drawn again each time. */
+	for (i = 0; i < 20; i++) {
+		weston_surface_set_color(views[0]->surface, 1.0,
+					 (i % 2) * 1.0, 0.0, 1.0);
+		weston_surface_set_color(views[1]->surface, 0.0,
+					 1.0, (i % 2) * 1.0, 1.0);
+		weston_output_damage(output);
+		assert(weston_output_repaint(output, NULL) == 0);
+	}
+
+	fflush(log_file);
+	for (p = log_text; (p = strstr(p, "(views ")); p++) {
+		assert(sscanf(p, "(views %lf ms, layer caches %lf ms",
+			      &views_ms, &caches_ms) == 2);
+		if (caches_ms > 0.0)
+			cache_timed = true;
+		frames++;
+	}
+
+	testlog("%d frames timed\n", frames);
+	/* without timer queries, the scope does not even exist */
+	if (frames > 0)
+		assert(cache_timed);
+
+	weston_log_subscriber_destroy(sub);
+	fclose(log_file);
+	free(log_text);
+
+	weston_surface_destroy(top->surface);
+	weston_surface_destroy(views[1]->surface);
+	weston_surface_destroy(views[0]->surface);
+	weston_layer_unset_position(&layer);
+	weston_layer_unset_position(&flat);
+	weston_output_destroy(output);
+}
@@ -0,0 +1,171 @@
+/*
+ * Copyright © 2026 The Annland Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+
+#include <libweston/libweston.h>
+#include "libweston-internal.h"
+#include "shared/helpers.h"
+#include "weston-test-runner.h"
+#include "weston-test-fixture-compositor.h"
+#include "weston-test-plugin-helper.h"
+
+/* The same in both formats read_pixels may use. */
+#define GREEN 0x00ff00
+#define MAGENTA 0xff00ff
+
+static enum test_result_code
+fixture_setup(struct weston_test_harness *harness)
+{
+	struct compositor_setup setup;
+
+	compositor_setup_defaults(&setup);
+	setup.renderer = RENDERER_GL;
+
+	return weston_test_harness_execute_as_plugin(harness, &setup);
+}
+DECLARE_FIXTURE_SETUP(fixture_setup);
+
+static struct weston_view *
+create_color_view(struct weston_compositor *compositor,
+		  struct weston_layer *layer, int x, int y, int size,
+		  float r, float g, float b)
+{
+	struct weston_view *view;
+
+	view = create_test_view(compositor, layer, x, y, size, size);
+	weston_surface_set_color(view->surface, r, g, b, 1.0);
+	test_view_set_opaque(view);
+
+	return view;
+}
+
+/* x and y relative to the output, top-down */
+static uint32_t
+read_pixel(struct weston_output *output, int x, int y)
+{
+	struct weston_compositor *compositor = output->compositor;
+	uint32_t pixel;
+
+	if (compositor->capabilities & WESTON_CAP_CAPTURE_YFLIP)
+		y = output->current_mode->height - 1 - y;
+
+	assert(compositor->renderer->read_pixels(output,
+						 compositor->read_format,
+						 &pixel, x, y, 1, 1) == 0);
+
+	return pixel & 0xffffff;
+}
+
+/* An opaque view rotated above another one does not occlude it, and must
+ * not be painted over by it either. */
+PLUGIN_TEST(rotated_opaque_view_stays_on_top)
+{
+	/* struct weston_compositor *compositor; */
+	struct weston_transform rotate;
+	struct weston_output *output;
+	struct weston_view *top, *bottom;
+	struct weston_layer layer;
+
+	weston_layer_init(&layer, compositor);
+	weston_layer_set_position(&layer, WESTON_LAYER_POSITION_NORMAL);
+	output = create_test_output(compositor, 320, 240);
+
+	bottom = create_color_view(compositor, &layer, output->x, output->y,
+				   200, 1.0, 0.0, 1.0);
+	top = create_color_view(compositor, &layer, output->x + 60,
+				output->y + 60, 80, 0.0, 1.0, 0.0);
+
+	/* 30 degrees about the center of the view */
+	weston_matrix_init(&rotate.matrix);
+	weston_matrix_translate(&rotate.matrix, -40.0, -40.0, 0.0);
+	weston_matrix_rotate_xy(&rotate.matrix, cosf(M_PI / 6),
+				sinf(M_PI / 6));
+	weston_matrix_translate(&rotate.matrix, 40.0, 40.0, 0.0);
+	wl_list_insert(&top->geometry.transformation_list, &rotate.link);
+	weston_view_geometry_dirty(top);
+
+	weston_output_damage(output);
+	assert(weston_output_repaint(output, NULL) == 0);
+
+	assert(read_pixel(output, 100, 100) == GREEN);
+	assert(read_pixel(output, 62, 62) == MAGENTA);
+	assert(read_pixel(output, 190, 190) == MAGENTA);
+
+	weston_surface_destroy(top->surface);
+	weston_surface_destroy(bottom->surface);
+	weston_layer_unset_position(&layer);
+	weston_output_destroy(output);
+}
+
+/* A scaled opaque view only occludes the pixels it covers entirely and
+ * that filtering cannot touch; the ones along its edges must still end
+ * up in its color. */
+PLUGIN_TEST(scaled_opaque_view_keeps_its_edges)
+{
+	/* struct weston_compositor *compositor; */
+	struct weston_transform scale;
+	struct weston_output *output;
+	struct weston_view *top, *bottom;
+	struct weston_layer layer;
+
+	weston_layer_init(&layer, compositor);
+	weston_layer_set_position(&layer, WESTON_LAYER_POSITION_NORMAL);
+	output = create_test_output(compositor, 320, 240);
+
+	bottom = create_color_view(compositor, &layer, output->x, output->y,
+				   200, 1.0, 0.0, 1.0);
+	top = create_color_view(compositor, &layer, output->x + 20,
+				output->y + 20, 45, 0.0, 1.0, 0.0);
+
+	/* covers [20, 76.25) on both axes */
+	weston_matrix_init(&scale.matrix);
+	weston_matrix_scale(&scale.matrix, 1.25, 1.25, 1.0);
+	wl_list_insert(&top->geometry.transformation_list, &scale.link);
+	weston_view_geometry_dirty(top);
+
+	weston_output_damage(output);
+	assert(weston_output_repaint(output, NULL) == 0);
+
+	/* occluded */
+	assert(read_pixel(output, 40, 40) == GREEN);
+	/* not in top->transform.opaque */
+	assert(!pixman_region32_contains_point(&top->transform.opaque,
+					       output->x + 75,
+					       output->y + 40, NULL));
+	assert(read_pixel(output, 20, 40) == GREEN);
+	assert(read_pixel(output, 75, 40) == GREEN);
+	assert(read_pixel(output, 40, 75) == GREEN);
+	assert(read_pixel(output, 77, 40) == MAGENTA);
+
+	weston_surface_destroy(top->surface);
+	weston_surface_destroy(bottom->surface);
+	weston_layer_unset_position(&layer);
+	weston_output_destroy(output);
+}
@@ -0,0 +1,197 @@
+/*
+ * Copyright © 2026 The Annland Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <libweston/libweston.h>
+#include "libweston-internal.h"
+#include "shared/helpers.h"
+#include "weston-test-runner.h"
+#include "weston-test-fixture-compositor.h"
+#include "weston-test-plugin-helper.h"
+
+#define MAX_ENTRIES 64
+
+struct setup_args {
+	bool fresh;
+};
+
+/* The second compositor starts with what the first one stored; the
+ * fixtures run one after the other in the same process. */
+static const struct setup_args my_setup_args[] = {
+	{ true },
+	{ false },
+};
+
+struct cache_entry {
+	char name[64];
+	ino_t ino;
+};
+
+static char cache_dir[256];
+
+/* The cache files the first compositor left */
+static struct cache_entry stored[MAX_ENTRIES];
+static int n_stored = -1;
+
+static int
+list_cache(struct cache_entry *entries)
+{
+	struct dirent *de;
+	struct stat st;
+	char path[512];
+	DIR *dir;
+	int n = 0;
+
+	dir = opendir(cache_dir);
+	if (!dir)
+		return 0;
+
+	while ((de = readdir(dir))) {
+		size_t len = strlen(de->d_name);
+
+		if (len < 4 || strcmp(de->d_name + len - 4, ".bin") != 0)
+			continue;
+		if (!entries) {
+			snprintf(path, sizeof path, "%s/%s", cache_dir,
+				 de->d_name);
+			unlink(path);
+			continue;
+		}
+
+		assert(n < MAX_ENTRIES);
+		snprintf(path, sizeof path, "%s/%s", cache_dir, de->d_name);
+		assert(stat(path, &st) == 0);
+		snprintf(entries[n].name, sizeof entries[n].name, "%s",
+			 de->d_name);
+		entries[n].ino = st.st_ino;
+		n++;
+	}
+	closedir(dir);
+
+	return n;
+}
+
+static enum test_result_code
+fixture_setup(struct weston_test_harness *harness, const struct setup_args *arg)
+{
+	struct compositor_setup setup;
+	const char *runtime_dir = getenv("XDG_RUNTIME_DIR");
+
+	assert(runtime_dir);
+	snprintf(cache_dir, sizeof cache_dir, "%s/gl-programs-%d",
+		 runtime_dir, getpid());
+	if (arg->fresh)
+		list_cache(NULL);
+	setenv("WESTON_GL_PROGRAM_CACHE", cache_dir, 1);
+
+	compositor_setup_defaults(&setup);
+	setup.renderer = RENDERER_GL;
+	setup.width = 320;
+	setup.height = 240;
+
+	return weston_test_harness_execute_as_plugin(harness, &setup);
+}
+DECLARE_FIXTURE_SETUP_WITH_ARG(fixture_setup, my_setup_args);
+
+static bool
+find_entry(const struct cache_entry *entries, int n,
+	   const struct cache_entry *e)
+{
+	int i;
+
+	for (i = 0; i < n; i++)
+		if (strcmp(entries[i].name, e->name) == 0)
+			return entries[i].ino == e->ino;
+
+	return false;
+}
+
+/* The first compositor stores every program it links. The second one
+ * must load all of them, so it neither rewrites nor discards a file,
+ * and must still draw the right colors with them. */
+PLUGIN_TEST(gl_program_cache_reused)
+{
+	/* struct weston_compositor *compositor; */
+	struct cache_entry entries[MAX_ENTRIES];
+	struct weston_output *output;
+	struct weston_layer layer;
+	struct weston_view *view;
+	uint32_t pixel;
+	int n, i;
+
+	assert(!wl_list_empty(&compositor->output_list));
+	output = container_of(compositor->output_list.next,
+			      struct weston_output, link);
+
+	weston_layer_init(&layer, compositor);
+	weston_layer_set_position(&layer, WESTON_LAYER_POSITION_NORMAL);
+
+	/* the same in both formats read_pixels may use */
+	view = create_test_view(compositor, &layer, output->x, output->y,
+				output->width, output->height);
+	weston_surface_set_color(view->surface, 1.0, 0.0, 1.0, 1.0);
+	test_view_set_opaque(view);
+
+	weston_output_damage(output);
+	assert(weston_output_repaint(output, NULL) == 0);
+
+	assert(compositor->renderer->read_pixels(output,
+						 compositor->read_format,
+						 &pixel,
+						 output->width / 2,
+						 output->height / 2,
+						 1, 1) == 0);
+	assert((pixel & 0xffffff) == 0xff00ff);
+
+	n = list_cache(entries);
+	testlog("%d programs in the cache\n", n);
+
+	if (n_stored < 0) {
+		/* not every driver can give program binaries */
+		if (n == 0)
+			testlog("nothing stored, program cache unsupported\n");
+		memcpy(stored, entries, n * sizeof *entries);
+		n_stored = n;
+	} else {
+		assert(n == n_stored);
+		for (i = 0; i < n; i++)
+			assert(find_entry(stored, n_stored, &entries[i]));
+
+		list_cache(NULL);
+		rmdir(cache_dir);
+	}
+
+	weston_surface_destroy(view->surface);
+	weston_layer_unset_position(&layer);
+}
@@ -507,3 +507,26 @@ TEST(ivi_layout_surface_remove_notification)
 
 	runner_destroy(runner);
 }
+
+TEST(ivi_layout_bench)
+{
+	struct client *client;
+	struct runner *runner;
+	struct ivi_application *iviapp;
+	struct ivi_window *winds[IVI_TEST_BENCH_SURFACE_COUNT];
+	int i;
+
+	client = create_client();
+	runner = client_create_runner(client);
+	iviapp = get_ivi_application(client);
+
+	for (i = 0; i < IVI_TEST_BENCH_SURFACE_COUNT; i++)
+		winds[i] = client_create_ivi_window(client, iviapp,
+						    IVI_TEST_SURFACE_ID(i));
+
+	runner_run(runner, "layout_bench");
+
+	for (i = 0; i < IVI_TEST_BENCH_SURFACE_COUNT; i++)
+		ivi_window_destroy(winds[i]);
+	runner_destroy(runner);
+}
@@ -34,6 +34,7 @@
 #include <assert.h>
 #include <limits.h>
 #include <errno.h>
+#include <time.h>
 
 #include <libweston/libweston.h>
 #include "compositor/weston.h"
@@ -41,6 +42,7 @@
 #include "ivi-test.h"
 #include "ivi-shell/ivi-layout-export.h"
 #include "shared/helpers.h"
+#include "shared/timespec-util.h"
 
 struct test_context;
 
@@ -78,6 +80,7 @@ find_runner_test(const char *name)
 }
 
 struct test_context {
+	struct weston_compositor *compositor;
 	const struct ivi_layout_interface *layout_interface;
 	struct wl_resource *runner_resource;
 	uint32_t user_flags;
@@ -127,6 +130,7 @@ runner_run_handler(struct wl_client *client, struct wl_resource *resource,
 	assert(ctx->runner_resource == NULL ||
 	       ctx->runner_resource == resource);
 
+	ctx->compositor = launcher->compositor;
 	ctx->layout_interface = launcher->layout_interface;
 	ctx->runner_resource = resource;
 
@@ -1016,3 +1020,121 @@ RUNNER_TEST(surface_bad_properties_changed_notification)
 	runner_assert(lyt->surface_add_listener(
 		      ivisurf, NULL) == IVI_FAILED);
 }
+
+static double
+bench_usec_since(const struct timespec *begin, int count)
+{
+	struct timespec end;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	return timespec_sub_to_nsec(&end, begin) / 1000.0 / count;
+}
+
+/*
+ * Not a correctness test: reports the cost of ID lookups and of commits
+ * changing one or all of IVI_TEST_BENCH_SURFACE_COUNT mapped surfaces.
+ */
+RUNNER_TEST(layout_bench)
+{
+	const struct ivi_layout_interface *lyt = ctx->layout_interface;
+	const int iterations = 100;
+	const int n = IVI_TEST_BENCH_SURFACE_COUNT;
+	struct ivi_layout_surface *ivisurfs[IVI_TEST_BENCH_SURFACE_COUNT];
+	const struct ivi_layout_surface_properties *prop;
+	struct ivi_layout_layer *ivilayer;
+	struct weston_output *output;
+	struct timespec begin;
+	int i, k;
+
+	runner_assert_or_return(!wl_list_empty(&ctx->compositor->output_list));
+	output = wl_container_of(ctx->compositor->output_list.next,
+				 output, link);
+
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (k = 0; k < iterations; k++)
+		for (i = 0; i < n; i++)
+			ivisurfs[i] = lyt->get_surface_from_id(
+					IVI_TEST_SURFACE_ID(i));
+	weston_log("layout_bench: %d surfaces: %.3f us per ID lookup\n",
+		   n, bench_usec_since(&begin, iterations * n));
+
+	for (i = 0; i < n; i++)
+		runner_assert_or_return(ivisurfs[i]);
+
+	ivilayer = lyt->layer_create_with_dimension(IVI_TEST_LAYER_ID(0),
+						    output->width,
+						    output->height);
+	runner_assert_or_return(ivilayer);
+	runner_assert(lyt->layer_set_render_order(ivilayer, ivisurfs, n) ==
+		      IVI_SUCCEEDED);
+	runner_assert(lyt->layer_set_visibility(ivilayer, true) ==
+		      IVI_SUCCEEDED);
+	runner_assert(lyt->screen_add_layer(output, ivilayer) ==
+		      IVI_SUCCEEDED);
+
+	for (i = 0; i < n; i++) {
+		lyt->surface_set_source_rectangle(ivisurfs[i], 0, 0, 64, 64);
+		lyt->surface_set_destination_rectangle(ivisurfs[i],
+						       (i % 16) * 32,
+						       (i / 16) * 32, 64, 64);
+		lyt->surface_set_visibility(ivisurfs[i], true);
+	}
+	lyt->commit_changes();
+
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (k = 0; k < iterations; k++)
+		lyt->commit_changes();
+	weston_log("layout_bench: %d surfaces: %.3f us per commit, "
+		   "nothing changed\n", n, bench_usec_since(&begin, iterations));
+
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (k = 0; k < iterations; k++) {
+		lyt->surface_set_opacity(ivisurfs[k % n],
+					 wl_fixed_from_double(k & 1 ? 1.0 : 0.5));
+		lyt->commit_changes();
+	}
+	weston_log("layout_bench: %d surfaces: %.3f us per commit, "
+		   "one surface changed\n",
+		   n, bench_usec_since(&begin, iterations));
+
+	for (i = 0; i < n; i++) {
+		prop = lyt->get_properties_of_surface(ivisurfs[i]);
+		runner_assert(prop->opacity ==
+			      wl_fixed_from_double(i < iterations && !(i & 1) ?
+						   0.5 : 1.0));
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (k = 0; k < iterations; k++) {
+		for (i = 0; i < n; i++)
+			lyt->surface_set_destination_rectangle(ivisurfs[i],
+							       (i % 16) * 32 + k,
+							       (i / 16) * 32,
+							       64, 64);
+		lyt->commit_changes();
+	}
+	weston_log("layout_bench: %d surfaces: %.3f us per commit, "
+		   "all surfaces changed\n",
+		   n, bench_usec_since(&begin, iterations));
+
+	for (i = 0; i < n; i++) {
+		prop = lyt->get_properties_of_surface(ivisurfs[i]);
+		runner_assert(prop->dest_x == (i % 16) * 32 + iterations - 1);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (k = 0; k < iterations; k++) {
+		lyt->layer_set_destination_rectangle(ivilayer, k, 0,
+						     output->width,
+						     output->height);
+		lyt->commit_changes();
+	}
+	weston_log("layout_bench: %d surfaces: %.3f us per commit, "
+		   "layer changed\n", n, bench_usec_since(&begin, iterations));
+
+	runner_assert(lyt->screen_remove_layer(output, ivilayer) ==
+		      IVI_SUCCEEDED);
+	lyt->commit_changes();
+	lyt->layer_destroy(ivilayer);
+}
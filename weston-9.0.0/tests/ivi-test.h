@@ -39,4 +39,7 @@
 #define IVI_TEST_SURFACE_COUNT (3)
 #define IVI_TEST_LAYER_COUNT (3)
 
+/* Number of surfaces created for the layout_bench runner test. */
+#define IVI_TEST_BENCH_SURFACE_COUNT (256)
+
 #endif /* IVI_TEST_H */
@@ -0,0 +1,178 @@
+/*
+ * Copyright © 2026 The Annland Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include <libweston/libweston.h>
+#include "libweston-internal.h"
+#include "shared/helpers.h"
+#include "weston-test-runner.h"
+#include "weston-test-fixture-compositor.h"
+#include "weston-test-plugin-helper.h"
+
+struct setup_args {
+	enum renderer_type renderer;
+};
+
+static const struct setup_args my_setup_args[] = {
+	{ RENDERER_PIXMAN },
+	{ RENDERER_GL },
+};
+
+static enum test_result_code
+fixture_setup(struct weston_test_harness *harness, const struct setup_args *arg)
+{
+	struct compositor_setup setup;
+
+	compositor_setup_defaults(&setup);
+	setup.renderer = arg->renderer;
+
+	return weston_test_harness_execute_as_plugin(harness, &setup);
+}
+DECLARE_FIXTURE_SETUP_WITH_ARG(fixture_setup, my_setup_args);
+
+static struct weston_view *
+create_color_view(struct weston_compositor *compositor,
+		  struct weston_layer *layer, int x, int y, int size,
+		  float r, float g, float b, float alpha)
+{
+	struct weston_view *view;
+
+	view = create_test_view(compositor, layer, x, y, size, size);
+	weston_surface_set_color(view->surface, r, g, b, 1.0);
+	view->alpha = alpha;
+	if (alpha == 1.0)
+		test_view_set_opaque(view);
+
+	return view;
+}
+
+static uint32_t *
+read_output(struct weston_output *output)
+{
+	struct weston_compositor *compositor = output->compositor;
+	int width = output->current_mode->width;
+	int height = output->current_mode->height;
+	uint32_t *pixels;
+
+	pixels = calloc(width * height, sizeof *pixels);
+	assert(pixels);
+
+	weston_output_damage(output);
+	assert(weston_output_repaint(output, NULL) == 0);
+	assert(compositor->renderer->read_pixels(output,
+						 compositor->read_format,
+						 pixels, 0, 0,
+						 width, height) == 0);
+
+	return pixels;
+}
+
+/* The layer is composited into its cache first and only then over what
+ * is below it, so the 8-bit rounding may differ a little. */
+static bool
+pixel_close(uint32_t a, uint32_t b)
+{
+	int shift, d;
+
+	for (shift = 0; shift < 24; shift += 8) {
+		d = (int) ((a >> shift) & 0xff) - (int) ((b >> shift) & 0xff);
+		if (abs(d) > 2)
+			return false;
+	}
+
+	return true;
+}
+
+static int
+channel(uint32_t pixel, int shift)
+{
+	return (pixel >> shift) & 0xff;
+}
+
+/* Translucent views overlapping inside a flattened layer blend with each
+ * other in the cache as they do when drawn one by one. */
+PLUGIN_TEST(flattened_layer_matches_unflattened)
+{
+	/* struct weston_compositor *compositor; */
+	struct weston_layer background, layer;
+	struct weston_output *output;
+	struct weston_view *views[3];
+	uint32_t *flat, *plain, overlap;
+	int width, height, i;
+
+	weston_layer_init(&background, compositor);
+	weston_layer_set_position(&background,
+				  WESTON_LAYER_POSITION_NORMAL - 1);
+	weston_layer_init(&layer, compositor);
+	weston_layer_set_position(&layer, WESTON_LAYER_POSITION_NORMAL);
+	weston_layer_set_flattened(&layer, true);
+	output = create_test_output(compositor, 320, 240);
+	width = output->current_mode->width;
+	height = output->current_mode->height;
+
+	views[0] = create_color_view(compositor, &background,
+				     output->x, output->y, 240,
+				     0.25, 0.25, 0.25, 1.0);
+	views[1] = create_color_view(compositor, &layer,
+				     output->x + 20, output->y + 20, 120,
+				     0.0, 1.0, 0.0, 0.5);
+	views[2] = create_color_view(compositor, &layer,
+				     output->x + 80, output->y + 80, 120,
+				     1.0, 0.0, 1.0, 0.5);
+
+	/* Cached first: the first repaint is where the GL blend state was
+	 * not set up yet. */
+	flat = read_output(output);
+
+	weston_layer_set_flattened(&layer, false);
+	plain = read_output(output);
+
+	for (i = 0; i < width * height; i++) {
+		if (!pixel_close(flat[i], plain[i]))
+			testlog("pixel %d, %d: %06x cached, %06x drawn\n",
+				i % width, i / width,
+				flat[i] & 0xffffff, plain[i] & 0xffffff);
+		assert(pixel_close(flat[i], plain[i]));
+	}
+
+	/* Both views show through where they overlap. Row 110 is in the
+	 * overlap whichever way up the pixels were read. */
+	overlap = plain[110 * width + 110];
+	assert(channel(overlap, 8) > 0x40);
+	assert(channel(overlap, 0) > 0x40);
+	assert(channel(overlap, 16) > 0x40);
+
+	free(flat);
+	free(plain);
+	for (i = 0; i < (int) ARRAY_LENGTH(views); i++)
+		weston_surface_destroy(views[i]->surface);
+	weston_layer_unset_position(&layer);
+	weston_layer_unset_position(&background);
+	weston_output_destroy(output);
+}
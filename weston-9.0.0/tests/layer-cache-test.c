@@ -0,0 +1,121 @@
+/*
+ * Copyright © 2026 The Annland Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+
+#include <libweston/libweston.h>
+#include "libweston-internal.h"
+#include "layer-cache.h"
+#include "shared/helpers.h"
+#include "weston-test-runner.h"
+#include "weston-test-fixture-compositor.h"
+#include "weston-test-plugin-helper.h"
+
+static enum test_result_code
+fixture_setup(struct weston_test_harness *harness)
+{
+	struct compositor_setup setup;
+
+	compositor_setup_defaults(&setup);
+
+	return weston_test_harness_execute_as_plugin(harness, &setup);
+}
+DECLARE_FIXTURE_SETUP(fixture_setup);
+
+static struct weston_view *
+create_layer_view(struct weston_compositor *compositor,
+		  struct weston_layer *layer,
+		  int x, int y, int width, int height)
+{
+	struct weston_view *view;
+
+	view = create_test_view(compositor, layer, x, y, width, height);
+	weston_surface_set_color(view->surface, 0.0, 0.0, 0.0, 1.0);
+	test_view_set_opaque(view);
+
+	return view;
+}
+
+PLUGIN_TEST(layer_snapshot_tracks_changes)
+{
+	/* struct weston_compositor *compositor; */
+	struct weston_layer_snapshot snapshot;
+	struct weston_layer_snapshot_view *sv;
+	struct weston_output *output;
+	struct weston_view *top, *bottom;
+	struct weston_layer layer;
+
+	weston_layer_init(&layer, compositor);
+	weston_layer_set_position(&layer, WESTON_LAYER_POSITION_BACKGROUND);
+	weston_layer_set_flattened(&layer, true);
+	output = create_test_output(compositor, 640, 480);
+
+	bottom = create_layer_view(compositor, &layer, 0, 0, 200, 200);
+	top = create_layer_view(compositor, &layer, 50, 50, 50, 50);
+	assert(weston_output_repaint(output, NULL) == 0);
+
+	assert(weston_view_is_flattened(top));
+	assert(weston_view_get_layer(top) == &layer);
+
+	weston_layer_snapshot_init(&snapshot, &layer);
+	assert(weston_layer_snapshot_update(&snapshot, output));
+	assert(!weston_layer_snapshot_update(&snapshot, output));
+
+	/* Topmost first, each clipped by the layer's views above only. */
+	assert(snapshot.views.size == 2 * sizeof *sv);
+	sv = snapshot.views.data;
+	assert(sv[0].view == top && sv[1].view == bottom);
+	assert(!pixman_region32_not_empty(&sv[0].clip));
+	assert(pixman_region32_equal(&sv[1].clip, &top->transform.opaque));
+	assert(weston_layer_snapshot_top_view(&snapshot) == top);
+	assert(pixman_region32_extents(&snapshot.region)->x2 == 200);
+
+	/* New content. */
+	weston_surface_set_color(bottom->surface, 1.0, 0.0, 0.0, 1.0);
+	assert(weston_layer_snapshot_update(&snapshot, output));
+	assert(!weston_layer_snapshot_update(&snapshot, output));
+
+	/* Moved view. */
+	weston_view_set_position(top, 60, 50);
+	assert(weston_output_repaint(output, NULL) == 0);
+	assert(weston_layer_snapshot_update(&snapshot, output));
+
+	/* Changed alpha. */
+	top->alpha = 0.5;
+	assert(weston_layer_snapshot_update(&snapshot, output));
+
+	/* Removed view. */
+	weston_surface_destroy(top->surface);
+	assert(weston_output_repaint(output, NULL) == 0);
+	assert(weston_layer_snapshot_update(&snapshot, output));
+	assert(snapshot.views.size == sizeof *sv);
+
+	weston_layer_snapshot_release(&snapshot);
+	weston_surface_destroy(bottom->surface);
+	weston_layer_unset_position(&layer);
+	weston_output_destroy(output);
+}
@@ -0,0 +1,179 @@
+/*
+ * Copyright © 2026 The Annland Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+
+#include <libweston/matrix.h>
+#include "weston-test-runner.h"
+
+/*
+ * weston_matrix_multiply() picks its shortcut from the type of the matrix
+ * multiplied on the left, and weston_matrix_transform() and
+ * weston_matrix_invert() from the type of the product. Check every pair of
+ * classes against the general 4x4 code, which is what a matrix gets when
+ * its type claims nothing about it. matrix-test has the timings.
+ */
+
+enum matrix_class {
+	CLASS_IDENTITY,
+	CLASS_TRANSLATE,
+	CLASS_SCALE,
+	CLASS_SCALE_TRANSLATE,
+	CLASS_AFFINE_2D,
+	CLASS_GENERAL,
+	CLASS_COUNT
+};
+
+static double
+frand(void)
+{
+	return random() / (double) (RAND_MAX / 2) - 1.0;
+}
+
+static void
+make_class_matrix(struct weston_matrix *m, enum matrix_class class)
+{
+	double angle;
+	int i;
+
+	weston_matrix_init(m);
+
+	switch (class) {
+	case CLASS_IDENTITY:
+	case CLASS_COUNT:
+		break;
+	case CLASS_TRANSLATE:
+		weston_matrix_translate(m, 1000.0 * frand(),
+					1000.0 * frand(), frand());
+		break;
+	case CLASS_SCALE:
+		weston_matrix_scale(m, 0.25 + 2.0 * fabs(frand()),
+				    -0.25 - 2.0 * fabs(frand()), 1);
+		break;
+	case CLASS_AFFINE_2D:
+		angle = M_PI * frand();
+		weston_matrix_rotate_xy(m, cos(angle), sin(angle));
+		/* fall through */
+	case CLASS_SCALE_TRANSLATE:
+		weston_matrix_scale(m, 0.25 + 2.0 * fabs(frand()),
+				    0.25 + 2.0 * fabs(frand()), 1);
+		weston_matrix_translate(m, 1000.0 * frand(),
+					1000.0 * frand(), 0);
+		break;
+	case CLASS_GENERAL:
+		/* diagonally dominant, so that it inverts accurately */
+		for (i = 0; i < 16; i++)
+			m->d[i] = frand() + (i % 5 == 0 ? 4.0 : 0.0);
+		m->type = WESTON_MATRIX_TRANSFORM_OTHER;
+		break;
+	}
+}
+
+static double
+max_relative_error(const float *a, const float *b, unsigned n)
+{
+	double err, errsup = 0.0;
+	unsigned i;
+
+	for (i = 0; i < n; ++i) {
+		err = fabs((double) a[i] - b[i]) / (1.0 + fabs(b[i]));
+		if (err > errsup)
+			errsup = err;
+	}
+
+	return errsup;
+}
+
+static void
+check_pair(enum matrix_class cm, enum matrix_class cn)
+{
+	struct weston_matrix m, n, ref_m, ref_n, inv, ref_inv;
+	struct weston_vector v, ref_v;
+	unsigned int type;
+	double err = 0.0;
+	int i;
+
+	for (i = 0; i < 1000; i++) {
+		make_class_matrix(&m, cm);
+		make_class_matrix(&n, cn);
+		ref_m = m;
+		ref_m.type = WESTON_MATRIX_TRANSFORM_OTHER;
+		ref_n = n;
+		ref_n.type = WESTON_MATRIX_TRANSFORM_OTHER;
+		type = m.type | n.type;
+
+		weston_matrix_multiply(&m, &n);
+		weston_matrix_multiply(&ref_m, &ref_n);
+		assert(m.type == type);
+		err = fmax(err, max_relative_error(m.d, ref_m.d, 16));
+
+		v.f[0] = 100.0 * frand();
+		v.f[1] = 100.0 * frand();
+		v.f[2] = frand();
+		v.f[3] = 1.0;
+		ref_v = v;
+		weston_matrix_transform(&m, &v);
+		weston_matrix_transform(&ref_m, &ref_v);
+		err = fmax(err, max_relative_error(v.f, ref_v.f, 4));
+
+		assert(weston_matrix_invert(&inv, &m) == 0);
+		assert(weston_matrix_invert(&ref_inv, &ref_m) == 0);
+		err = fmax(err, max_relative_error(inv.d, ref_inv.d, 16));
+	}
+
+	testlog("%d x %d: max relative error %g\n", cn, cm, err);
+	assert(err < 1e-4);
+}
+
+TEST(matrix_mixed_classes)
+{
+	int cm, cn;
+
+	srandom(13);
+
+	for (cm = 0; cm < CLASS_COUNT; cm++)
+		for (cn = 0; cn < CLASS_COUNT; cn++)
+			check_pair(cm, cn);
+}
+
+/* The pairs a view transform is usually built from, one by one, so that
+ * a failure names them. */
+TEST(matrix_translate_times_scale)
+{
+	srandom(17);
+	check_pair(CLASS_SCALE, CLASS_TRANSLATE);
+	check_pair(CLASS_TRANSLATE, CLASS_SCALE);
+}
+
+TEST(matrix_scale_times_general)
+{
+	srandom(19);
+	check_pair(CLASS_GENERAL, CLASS_SCALE);
+	check_pair(CLASS_SCALE, CLASS_GENERAL);
+}
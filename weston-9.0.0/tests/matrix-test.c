@@ -371,6 +371,189 @@ test_loop_speed_invert_explicit(void)
 	       count, t, 1e9 * t / count);
 }
 
+enum matrix_class {
+	CLASS_IDENTITY,
+	CLASS_TRANSLATE,
+	CLASS_SCALE_TRANSLATE,
+	CLASS_AFFINE_2D,
+	CLASS_GENERAL,
+	CLASS_COUNT
+};
+
+static const char * const class_names[CLASS_COUNT] = {
+	"identity",
+	"translate",
+	"scale+translate",
+	"2D affine",
+	"general",
+};
+
+/* Build a matrix the way the compositor would, so that its type field
+ * selects the given class. */
+static void
+make_class_matrix(struct weston_matrix *m, enum matrix_class class)
+{
+	double angle;
+
+	weston_matrix_init(m);
+
+	switch (class) {
+	case CLASS_IDENTITY:
+	case CLASS_COUNT:
+		break;
+	case CLASS_AFFINE_2D:
+		angle = M_PI * frand();
+		weston_matrix_rotate_xy(m, cos(angle), sin(angle));
+		/* fall through */
+	case CLASS_SCALE_TRANSLATE:
+		weston_matrix_scale(m, 0.25 + 2.0 * fabs(frand()),
+				    -0.25 - 2.0 * fabs(frand()), 1);
+		/* fall through */
+	case CLASS_TRANSLATE:
+		weston_matrix_translate(m, 1000.0 * frand(),
+					1000.0 * frand(), 0);
+		break;
+	case CLASS_GENERAL:
+		randomize_matrix(m);
+		m->type = WESTON_MATRIX_TRANSFORM_OTHER;
+		break;
+	}
+}
+
+static double
+max_relative_error(const float *a, const float *b, unsigned n)
+{
+	double err, errsup = 0.0;
+	unsigned i;
+
+	for (i = 0; i < n; ++i) {
+		err = fabs((double)a[i] - b[i]) / (1.0 + fabs(b[i]));
+		if (err > errsup)
+			errsup = err;
+	}
+
+	return errsup;
+}
+
+/* Compare each class's fast paths against the general 4x4 code, which is
+ * what a matrix gets when its type claims nothing about it. */
+static int
+test_fast_paths(void)
+{
+	struct weston_matrix m, n, ref_m, ref_n, inv, ref_inv;
+	struct weston_vector v, ref_v;
+	double err, errsup[CLASS_COUNT] = { 0 };
+	int i, c, failed = 0;
+
+	printf("\nComparing fast paths against the general case...\n");
+
+	for (c = 0; c < CLASS_COUNT; c++) {
+		for (i = 0; i < 10000; i++) {
+			make_class_matrix(&m, c);
+			make_class_matrix(&n, c);
+			ref_m = m;
+			ref_m.type = WESTON_MATRIX_TRANSFORM_OTHER;
+			ref_n = n;
+			ref_n.type = WESTON_MATRIX_TRANSFORM_OTHER;
+
+			weston_matrix_multiply(&m, &n);
+			weston_matrix_multiply(&ref_m, &ref_n);
+			err = max_relative_error(m.d, ref_m.d, 16);
+			if (err > errsup[c])
+				errsup[c] = err;
+
+			v.f[0] = 100.0 * frand();
+			v.f[1] = 100.0 * frand();
+			v.f[2] = frand();
+			v.f[3] = 1.0;
+			ref_v = v;
+			weston_matrix_transform(&m, &v);
+			weston_matrix_transform(&ref_m, &ref_v);
+			err = max_relative_error(v.f, ref_v.f, 4);
+			if (err > errsup[c])
+				errsup[c] = err;
+
+			if (weston_matrix_invert(&inv, &m) < 0 ||
+			    weston_matrix_invert(&ref_inv, &ref_m) < 0)
+				continue;
+			err = max_relative_error(inv.d, ref_inv.d, 16);
+			if (err > errsup[c])
+				errsup[c] = err;
+		}
+
+		/* the general class is compared against itself */
+		if (errsup[c] > 1e-4)
+			failed = 1;
+
+		printf("%16s: max relative error %g%s\n", class_names[c],
+		       errsup[c], errsup[c] > 1e-4 ? " FAIL" : "");
+	}
+
+	return failed;
+}
+
+static void __attribute__((noinline))
+test_loop_speed_class(enum matrix_class class)
+{
+	struct weston_matrix m, n, inv;
+	struct weston_vector v = { { 0.5, 0.5, 0.5, 1.0 } };
+	unsigned long count;
+	double t_mul, t_xform, t_inv;
+	unsigned long n_mul, n_xform, n_inv;
+
+	make_class_matrix(&n, class);
+
+	running = 1;
+	alarm(1);
+	count = 0;
+	reset_timer();
+	while (running) {
+		m = n;
+		weston_matrix_multiply(&m, &n);
+		count++;
+	}
+	t_mul = read_timer();
+	n_mul = count;
+
+	running = 1;
+	alarm(1);
+	count = 0;
+	reset_timer();
+	while (running) {
+		weston_matrix_transform(&n, &v);
+		count++;
+	}
+	t_xform = read_timer();
+	n_xform = count;
+
+	running = 1;
+	alarm(1);
+	count = 0;
+	reset_timer();
+	while (running) {
+		weston_matrix_invert(&inv, &n);
+		count++;
+	}
+	t_inv = read_timer();
+	n_inv = count;
+
+	printf("%16s: multiply %6.1f ns, transform %6.1f ns, "
+	       "invert %6.1f ns\n", class_names[class],
+	       1e9 * t_mul / n_mul, 1e9 * t_xform / n_xform,
+	       1e9 * t_inv / n_inv);
+}
+
+static void
+test_loop_speed_classes(void)
+{
+	int c;
+
+	printf("\nRunning 1 s tests per matrix class and operation...\n");
+
+	for (c = 0; c < CLASS_COUNT; c++)
+		test_loop_speed_class(c);
+}
+
 int main(void)
 {
 	struct sigaction ding;
@@ -414,11 +597,15 @@ int main(void)
 	print_matrix(&M);
 	printf("max abs error: %g, original determinant %g\n", errsup, det);
 
+	if (test_fast_paths() != 0)
+		return 1;
+
 	test_loop_precision();
 	test_loop_speed_matrixvector();
 	test_loop_speed_inversetransform();
 	test_loop_speed_invert();
 	test_loop_speed_invert_explicit();
+	test_loop_speed_classes();
 
 	return 0;
 }
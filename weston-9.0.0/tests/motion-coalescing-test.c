@@ -0,0 +1,251 @@
+/*
+ * Copyright © 2026 The Annland Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <linux/input.h>
+#include <string.h>
+
+#include <libweston/libweston.h>
+#include "backend.h"
+#include "libweston-internal.h"
+#include "libinput-seat.h"
+#include "shared/helpers.h"
+#include "weston-test-runner.h"
+#include "weston-test-fixture-compositor.h"
+#include "weston-test-plugin-helper.h"
+
+static enum test_result_code
+fixture_setup(struct weston_test_harness *harness)
+{
+	struct compositor_setup setup;
+
+	compositor_setup_defaults(&setup);
+
+	return weston_test_harness_execute_as_plugin(harness, &setup);
+}
+DECLARE_FIXTURE_SETUP(fixture_setup);
+
+/* A seat of its own, fed directly instead of by libinput. */
+struct motion_test {
+	struct weston_seat seat;
+	struct weston_pointer *pointer;
+	struct udev_input input;
+	struct timespec time;
+
+	struct wl_listener motion_listener;
+	int motions;
+
+	struct weston_binding *button_binding;
+	int motions_at_button;
+	wl_fixed_t button_x, button_y;
+};
+
+static void
+handle_motion(struct wl_listener *listener, void *data)
+{
+	struct motion_test *t =
+		container_of(listener, struct motion_test, motion_listener);
+
+	t->motions++;
+}
+
+static void
+handle_button(struct weston_pointer *pointer, const struct timespec *time,
+	      uint32_t button, void *data)
+{
+	struct motion_test *t = data;
+
+	if (pointer != t->pointer)
+		return;
+
+	t->motions_at_button = t->motions;
+	t->button_x = pointer->x;
+	t->button_y = pointer->y;
+}
+
+static void
+motion_test_init(struct motion_test *t, struct weston_compositor *compositor,
+		 bool coalesce)
+{
+	memset(t, 0, sizeof *t);
+
+	weston_seat_init(&t->seat, compositor, "motion-test-seat");
+	weston_seat_init_pointer(&t->seat);
+	t->pointer = weston_seat_get_pointer(&t->seat);
+	assert(t->pointer);
+
+	t->input.compositor = compositor;
+	t->input.coalesce_motion = coalesce;
+
+	t->motion_listener.notify = handle_motion;
+	wl_signal_add(&t->pointer->motion_signal, &t->motion_listener);
+
+	t->button_binding =
+		weston_compositor_add_button_binding(compositor, BTN_LEFT, 0,
+						     handle_button, t);
+	assert(t->button_binding);
+}
+
+static void
+motion_test_fini(struct motion_test *t)
+{
+	weston_binding_destroy(t->button_binding);
+	wl_list_remove(&t->motion_listener.link);
+	weston_seat_release(&t->seat);
+}
+
+static bool
+motion_test_queue(struct motion_test *t, double dx, double dy)
+{
+	struct weston_pointer_motion_event event = {
+		.mask = WESTON_POINTER_MOTION_REL |
+			WESTON_POINTER_MOTION_REL_UNACCEL,
+		.dx = dx,
+		.dy = dy,
+		.dx_unaccel = dx,
+		.dy_unaccel = dy,
+	};
+
+	t->time.tv_nsec += 125000;
+	event.time = t->time;
+
+	return udev_input_queue_motion(&t->input, &t->seat, &event);
+}
+
+static void
+assert_pointer_at(struct motion_test *t, double x, double y)
+{
+	assert(t->pointer->x == wl_fixed_from_double(x));
+	assert(t->pointer->y == wl_fixed_from_double(y));
+}
+
+static void
+motion_test_warp(struct motion_test *t, double x, double y)
+{
+	notify_motion_absolute(&t->seat, &t->time, x, y);
+	notify_pointer_frame(&t->seat);
+
+	assert_pointer_at(t, x, y);
+}
+
+/* Pushing against the screen edge and back: each step is clamped on its
+ * own, so the pointer comes back off the edge. */
+PLUGIN_TEST(coalesced_motion_is_clamped_per_event)
+{
+	/* struct weston_compositor *compositor; */
+	struct weston_output *output;
+	struct motion_test t;
+	int motions;
+
+	/* Right of the 320x240 output of the fixture, and taller. */
+	output = create_test_output(compositor, 320, 480);
+	motion_test_init(&t, compositor, true);
+
+	motion_test_warp(&t, 100, 100);
+	motions = t.motions;
+
+	assert(motion_test_queue(&t, 0, -300));
+	assert(motion_test_queue(&t, 0, 50));
+
+	/* Nothing moves until the end of the dispatch. */
+	assert_pointer_at(&t, 100, 100);
+	assert(t.motions == motions);
+
+	udev_input_flush_motion(&t.input);
+	assert_pointer_at(&t, 100, 50);
+	assert(t.motions == motions + 1);
+	assert(t.input.motion_events == 2);
+	assert(t.input.motion_coalesced == 1);
+
+	/* Onto the second output, then past its bottom edge: clamped to the
+	 * output reached by the previous steps, not to the first one. */
+	motion_test_warp(&t, 300, 100);
+	motions = t.motions;
+
+	assert(motion_test_queue(&t, 100, 0));
+	assert(motion_test_queue(&t, 0, 300));
+	assert(motion_test_queue(&t, 0, 200));
+
+	udev_input_flush_motion(&t.input);
+	assert_pointer_at(&t, 400, 479);
+	assert(t.motions == motions + 1);
+
+	motion_test_fini(&t);
+	weston_output_destroy(output);
+}
+
+/* A button press follows the motion read before it. */
+PLUGIN_TEST(coalesced_motion_precedes_button)
+{
+	/* struct weston_compositor *compositor; */
+	struct motion_test t;
+	int motions;
+
+	motion_test_init(&t, compositor, true);
+
+	motion_test_warp(&t, 100, 100);
+	motions = t.motions;
+
+	assert(motion_test_queue(&t, 20, 10));
+	assert(motion_test_queue(&t, 20, 10));
+
+	/* What the dispatch does before any other event. */
+	udev_input_flush_motion(&t.input);
+	notify_button(&t.seat, &t.time, BTN_LEFT,
+		      WL_POINTER_BUTTON_STATE_PRESSED);
+	notify_pointer_frame(&t.seat);
+
+	assert(t.motions_at_button == motions + 1);
+	assert(t.button_x == wl_fixed_from_int(140));
+	assert(t.button_y == wl_fixed_from_int(120));
+
+	/* Nothing left to deliver after the button. */
+	udev_input_flush_motion(&t.input);
+	assert(t.motions == motions + 1);
+
+	notify_button(&t.seat, &t.time, BTN_LEFT,
+		      WL_POINTER_BUTTON_STATE_RELEASED);
+	notify_pointer_frame(&t.seat);
+
+	motion_test_fini(&t);
+}
+
+/* Without coalescing every event is delivered as it comes. */
+PLUGIN_TEST(motion_not_coalesced_when_disabled)
+{
+	/* struct weston_compositor *compositor; */
+	struct motion_test t;
+
+	motion_test_init(&t, compositor, false);
+
+	motion_test_warp(&t, 100, 100);
+	assert(!motion_test_queue(&t, 20, 10));
+	assert(t.input.motion_seat == NULL);
+	assert(t.input.motion_events == 0);
+
+	motion_test_fini(&t);
+}
@@ -0,0 +1,197 @@
+/*
+ * Copyright © 2026 The Annland Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <libweston/libweston.h>
+#include "libweston-internal.h"
+#include "compositor/weston.h"
+#include "shared/helpers.h"
+#include "shared/timespec-util.h"
+#include "weston-test-runner.h"
+#include "weston-test-fixture-compositor.h"
+#include "weston-test-plugin-helper.h"
+
+#define OUTPUT_WIDTH 1920
+#define OUTPUT_HEIGHT 1080
+#define VIEW_SIZE 64
+
+static enum test_result_code
+fixture_setup(struct weston_test_harness *harness)
+{
+	struct compositor_setup setup;
+
+	compositor_setup_defaults(&setup);
+
+	return weston_test_harness_execute_as_plugin(harness, &setup);
+}
+DECLARE_FIXTURE_SETUP(fixture_setup);
+
+static bool
+output_lists_view(struct weston_output *output, struct weston_view *view)
+{
+	struct weston_view **ev;
+
+	wl_array_for_each(ev, &output->view_list)
+		if (*ev == view)
+			return true;
+
+	return false;
+}
+
+PLUGIN_TEST(output_view_list_membership)
+{
+	/* struct weston_compositor *compositor; */
+	struct weston_output *a, *b;
+	struct weston_view *on_a, *on_ab, *on_b;
+	struct weston_layer layer;
+
+	weston_layer_init(&layer, compositor);
+	weston_layer_set_position(&layer, WESTON_LAYER_POSITION_NORMAL);
+
+	a = create_test_output(compositor, OUTPUT_WIDTH, OUTPUT_HEIGHT);
+	b = create_test_output(compositor, OUTPUT_WIDTH, OUTPUT_HEIGHT);
+	assert(b->x == a->x + a->width);
+
+	on_a = create_test_view(compositor, &layer, a->x + 10, 10,
+				VIEW_SIZE, VIEW_SIZE);
+	on_ab = create_test_view(compositor, &layer, b->x - VIEW_SIZE / 2, 10,
+				 VIEW_SIZE, VIEW_SIZE);
+	on_b = create_test_view(compositor, &layer, b->x + 10, 10,
+				VIEW_SIZE, VIEW_SIZE);
+
+	assert(weston_output_repaint(a, NULL) == 0);
+	assert(weston_output_repaint(b, NULL) == 0);
+
+	assert(output_lists_view(a, on_a));
+	assert(output_lists_view(a, on_ab));
+	assert(!output_lists_view(a, on_b));
+	assert(!output_lists_view(b, on_a));
+	assert(output_lists_view(b, on_ab));
+	assert(output_lists_view(b, on_b));
+
+	/* Moving a view across outputs must update both lists. */
+	weston_view_set_position(on_a, b->x + 100, 100);
+	assert(weston_output_repaint(a, NULL) == 0);
+	assert(weston_output_repaint(b, NULL) == 0);
+	assert(!output_lists_view(a, on_a));
+	assert(output_lists_view(b, on_a));
+
+	/* A destroyed view must not linger in any list. */
+	weston_surface_destroy(on_b->surface);
+	assert(weston_output_repaint(b, NULL) == 0);
+	assert(!output_lists_view(b, on_b));
+
+	weston_surface_destroy(on_a->surface);
+	weston_surface_destroy(on_ab->surface);
+	weston_layer_unset_position(&layer);
+	weston_output_destroy(a);
+	weston_output_destroy(b);
+}
+
+static void
+run_repaint_bench(struct weston_compositor *compositor,
+		  int n_views, int n_outputs)
+{
+	const int iterations = 20;
+	struct weston_output **outputs;
+	struct weston_view **views;
+	struct weston_layer layer;
+	struct timespec begin, end;
+	int64_t nsec;
+	int per_row;
+	int i, j, k;
+
+	weston_layer_init(&layer, compositor);
+	weston_layer_set_position(&layer, WESTON_LAYER_POSITION_NORMAL);
+
+	outputs = calloc(n_outputs, sizeof *outputs);
+	views = calloc(n_views, sizeof *views);
+	assert(outputs && views);
+
+	for (i = 0; i < n_outputs; i++)
+		outputs[i] = create_test_output(compositor, OUTPUT_WIDTH,
+						OUTPUT_HEIGHT);
+
+	/* Spread the views evenly over all outputs, row by row. */
+	per_row = n_outputs * OUTPUT_WIDTH / VIEW_SIZE;
+	for (i = 0; i < n_views; i++) {
+		views[i] = create_test_view(compositor, &layer,
+					    outputs[0]->x +
+					    (i % per_row) * VIEW_SIZE,
+					    ((i / per_row) * VIEW_SIZE / 4) %
+					    (OUTPUT_HEIGHT - VIEW_SIZE),
+					    VIEW_SIZE, VIEW_SIZE);
+	}
+
+	/* Warm up: build the view lists. */
+	for (j = 0; j < n_outputs; j++)
+		assert(weston_output_repaint(outputs[j], NULL) == 0);
+
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (k = 0; k < iterations; k++) {
+		for (i = 0; i < n_views; i++)
+			pixman_region32_union_rect(&views[i]->surface->damage,
+						   &views[i]->surface->damage,
+						   0, 0, VIEW_SIZE, VIEW_SIZE);
+
+		for (j = 0; j < n_outputs; j++)
+			assert(weston_output_repaint(outputs[j], NULL) == 0);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	nsec = timespec_sub_to_nsec(&end, &begin);
+	testlog("%6d views, %d outputs: %9.1f us per output repaint\n",
+		n_views, n_outputs,
+		nsec / 1000.0 / (iterations * n_outputs));
+
+	for (i = 0; i < n_views; i++)
+		weston_surface_destroy(views[i]->surface);
+	weston_layer_unset_position(&layer);
+	for (i = 0; i < n_outputs; i++)
+		weston_output_destroy(outputs[i]);
+
+	free(outputs);
+	free(views);
+}
+
+/* Not a correctness test: reports the core repaint cost, with the noop
+ * renderer, for N views spread over M outputs. */
+PLUGIN_TEST(output_view_list_bench)
+{
+	/* struct weston_compositor *compositor; */
+	static const int n_views[] = { 100, 1000, 4000 };
+	static const int n_outputs[] = { 1, 2, 4 };
+	unsigned i, j;
+
+	for (i = 0; i < ARRAY_LENGTH(n_views); i++)
+		for (j = 0; j < ARRAY_LENGTH(n_outputs); j++)
+			run_repaint_bench(compositor, n_views[i],
+					  n_outputs[j]);
+}
@@ -0,0 +1,180 @@
+/*
+ * Copyright © 2026 The Annland Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "weston-test-client-helper.h"
+#include "weston-test-fixture-compositor.h"
+
+#define SURFACE_X 40
+#define SURFACE_Y 40
+#define SURFACE_WIDTH 160
+#define SURFACE_HEIGHT 120
+
+struct setup_args {
+	bool pbo;
+};
+
+static const struct setup_args my_setup_args[] = {
+	{ true },
+	{ false },
+};
+
+static enum test_result_code
+fixture_setup(struct weston_test_harness *harness, const struct setup_args *arg)
+{
+	struct compositor_setup setup;
+
+	if (arg->pbo)
+		unsetenv("WESTON_GL_DISABLE_PBO");
+	else
+		setenv("WESTON_GL_DISABLE_PBO", "1", 1);
+
+	compositor_setup_defaults(&setup);
+	setup.renderer = RENDERER_GL;
+	setup.width = 320;
+	setup.height = 240;
+	setup.shell = SHELL_TEST_DESKTOP;
+	setup.logging_scopes = "log,gl-draw-stats";
+
+	return weston_test_harness_execute_as_client(harness, &setup);
+}
+DECLARE_FIXTURE_SETUP_WITH_ARG(fixture_setup, my_setup_args);
+
+/* Opaque, and different at every pixel of the surface, so that a
+ * rectangle uploaded at the wrong offset or stride shows. */
+static uint32_t
+pattern_pixel(int x, int y, int seed)
+{
+	return 0xff000000 |
+	       ((x * 7 + seed) & 0xff) << 16 |
+	       ((y * 5 + seed) & 0xff) << 8 |
+	       ((x + y * 3) & 0xff);
+}
+
+static void
+fill_pattern(struct buffer *buf, int x, int y, int width, int height,
+	     int seed)
+{
+	uint32_t *data = (uint32_t *) pixman_image_get_data(buf->image);
+	int stride = pixman_image_get_stride(buf->image) / 4;
+	int i, j;
+
+	for (j = y; j < y + height; j++)
+		for (i = x; i < x + width; i++)
+			data[j * stride + i] = pattern_pixel(i, j, seed);
+}
+
+static bool
+screen_shows_buffer(struct client *client, struct buffer *buf)
+{
+	struct buffer *shot;
+	uint32_t *src = (uint32_t *) pixman_image_get_data(buf->image);
+	uint32_t *dst;
+	int src_stride = pixman_image_get_stride(buf->image) / 4;
+	int dst_stride;
+	int mismatches = 0;
+	int x, y;
+
+	shot = capture_screenshot_of_output(client);
+	assert(shot);
+	dst = (uint32_t *) pixman_image_get_data(shot->image);
+	dst_stride = pixman_image_get_stride(shot->image) / 4;
+
+	for (y = 0; y < SURFACE_HEIGHT; y++) {
+		for (x = 0; x < SURFACE_WIDTH; x++) {
+			uint32_t want = src[y * src_stride + x] & 0xffffff;
+			uint32_t got = dst[(SURFACE_Y + y) * dst_stride +
+					   SURFACE_X + x] & 0xffffff;
+
+			if (want == got)
+				continue;
+			if (mismatches++ == 0)
+				testlog("first mismatch at %d,%d: "
+					"0x%06x instead of 0x%06x\n",
+					x, y, got, want);
+		}
+	}
+
+	buffer_destroy(shot);
+
+	return mismatches == 0;
+}
+
+/* The whole buffer first, then rectangles of odd sizes, so that the
+ * rows copied for each one are not aligned in the upload buffer. */
+TEST(shm_upload_damage_rects)
+{
+	static const struct rectangle rects[] = {
+		{ 0, 0, 13, 7 },
+		{ 30, 11, 1, 1 },
+		{ 61, 40, 37, 29 },
+		{ 100, 90, 60, 30 },
+		{ 147, 0, 13, 120 },
+	};
+	struct client *client;
+	struct wl_surface *surface;
+	struct buffer *buf;
+	unsigned int i;
+	int seed;
+
+	client = create_client_and_test_surface(SURFACE_X, SURFACE_Y,
+						SURFACE_WIDTH, SURFACE_HEIGHT);
+	assert(client);
+	surface = client->surface->wl_surface;
+
+	/* move the pointer clearly away from the surface */
+	weston_test_move_pointer(client->test->weston_test, 0, 1, 0, 2, 30);
+
+	buf = create_shm_buffer_a8r8g8b8(client, SURFACE_WIDTH,
+					 SURFACE_HEIGHT);
+	fill_pattern(buf, 0, 0, SURFACE_WIDTH, SURFACE_HEIGHT, 0);
+	wl_surface_attach(surface, buf->proxy, 0, 0);
+	wl_surface_damage(surface, 0, 0, SURFACE_WIDTH, SURFACE_HEIGHT);
+	wl_surface_commit(surface);
+
+	assert(screen_shows_buffer(client, buf));
+
+	for (seed = 1; seed <= 3; seed++) {
+		for (i = 0; i < ARRAY_LENGTH(rects); i++) {
+			fill_pattern(buf, rects[i].x, rects[i].y,
+				     rects[i].width, rects[i].height,
+				     seed * 40 + i);
+			wl_surface_damage(surface, rects[i].x, rects[i].y,
+					  rects[i].width, rects[i].height);
+		}
+		wl_surface_attach(surface, buf->proxy, 0, 0);
+		wl_surface_commit(surface);
+
+		assert(screen_shows_buffer(client, buf));
+	}
+
+	buffer_destroy(buf);
+	client_destroy(client);
+}
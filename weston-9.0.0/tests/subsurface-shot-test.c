@@ -32,19 +32,29 @@
 
 #include "weston-test-client-helper.h"
 #include "weston-test-fixture-compositor.h"
+#include "test-config.h"
 
-static const enum renderer_type renderers[] = {
-	RENDERER_PIXMAN,
-	RENDERER_GL,
+struct setup_args {
+	enum renderer_type renderer;
+	const char *config_file;
+};
+
+static const struct setup_args my_setup_args[] = {
+	{ RENDERER_PIXMAN, NULL },
+	{ RENDERER_GL, NULL },
+	/* pixman-threads=4, the bands must match the single threaded
+	 * references */
+	{ RENDERER_PIXMAN, TESTSUITE_PIXMAN_THREADS_CONFIG_PATH },
 };
 
 static enum test_result_code
-fixture_setup(struct weston_test_harness *harness, const enum renderer_type *arg)
+fixture_setup(struct weston_test_harness *harness, const struct setup_args *arg)
 {
 	struct compositor_setup setup;
 
 	compositor_setup_defaults(&setup);
-	setup.renderer = *arg;
+	setup.renderer = arg->renderer;
+	setup.config_file = arg->config_file;
 	setup.width = 320;
 	setup.height = 240;
 	setup.shell = SHELL_TEST_DESKTOP;
@@ -52,7 +62,7 @@ fixture_setup(struct weston_test_harness *harness, const enum renderer_type *arg
 
 	return weston_test_harness_execute_as_client(harness, &setup);
 }
-DECLARE_FIXTURE_SETUP_WITH_ARG(fixture_setup, renderers);
+DECLARE_FIXTURE_SETUP_WITH_ARG(fixture_setup, my_setup_args);
 
 static struct wl_subcompositor *
 get_subcompositor(struct client *client)
@@ -0,0 +1,204 @@
+/*
+ * Copyright © 2026 The Annland Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <libweston/libweston.h>
+#include "libweston-internal.h"
+#include "timeline.h"
+#include "timeline-binary.h"
+#include "shared/helpers.h"
+#include "shared/timespec-util.h"
+#include "weston-test-runner.h"
+#include "weston-test-fixture-compositor.h"
+
+static enum test_result_code
+fixture_setup(struct weston_test_harness *harness)
+{
+	struct compositor_setup setup;
+
+	compositor_setup_defaults(&setup);
+
+	return weston_test_harness_execute_as_plugin(harness, &setup);
+}
+DECLARE_FIXTURE_SETUP(fixture_setup);
+
+struct recording {
+	char *data;
+	size_t size;
+	FILE *file;
+	struct weston_log_subscriber *subscriber;
+};
+
+static void
+recording_start(struct recording *rec, struct weston_compositor *compositor)
+{
+	rec->file = open_memstream(&rec->data, &rec->size);
+	assert(rec->file);
+	rec->subscriber = weston_log_subscriber_create_log(rec->file);
+	assert(rec->subscriber);
+	weston_log_subscribe(compositor->weston_log_ctx, rec->subscriber,
+			     "timeline-binary");
+	assert(weston_log_scope_is_enabled(compositor->timeline_binary));
+}
+
+/* Destroying the subscription flushes the pending records. */
+static void
+recording_stop(struct recording *rec)
+{
+	weston_log_subscriber_destroy(rec->subscriber);
+	fclose(rec->file);
+	assert(rec->size % sizeof(struct weston_timeline_record) == 0);
+}
+
+static struct weston_timeline_record *
+next_record(struct recording *rec, size_t *pos)
+{
+	struct weston_timeline_record *r;
+
+	if (*pos >= rec->size)
+		return NULL;
+
+	r = (struct weston_timeline_record *)(rec->data + *pos);
+	*pos += (1 + r->n_blocks) * sizeof(*r);
+	assert(*pos <= rec->size);
+
+	return r;
+}
+
+PLUGIN_TEST(timeline_binary_records)
+{
+	/* struct weston_compositor *compositor; */
+	struct weston_timeline_record *r, *header;
+	struct weston_output *output;
+	struct recording rec;
+	uint32_t output_id = 0, begin_id = 0, posted_id = 0;
+	uint64_t last_time = 0;
+	int n_begin = 0, n_posted = 0;
+	size_t pos = 0;
+	int i;
+
+	assert(!wl_list_empty(&compositor->output_list));
+	output = container_of(compositor->output_list.next,
+			      struct weston_output, link);
+
+	recording_start(&rec, compositor);
+	for (i = 0; i < 3; i++)
+		assert(weston_output_repaint(output, NULL) == 0);
+	recording_stop(&rec);
+
+	header = next_record(&rec, &pos);
+	assert(header);
+	assert(header->kind == WESTON_TIMELINE_RECORD_HEADER);
+	assert(header->id == WESTON_TIMELINE_BINARY_MAGIC);
+	assert(header->aux == WESTON_TIMELINE_BINARY_VERSION);
+
+	while ((r = next_record(&rec, &pos))) {
+		switch (r->kind) {
+		case WESTON_TIMELINE_RECORD_NAME:
+			/* Each name is sent once. */
+			if (strcmp((char *)(r + 1), "core_repaint_begin") == 0) {
+				assert(begin_id == 0);
+				begin_id = r->id;
+			} else if (strcmp((char *)(r + 1),
+					  "core_repaint_posted") == 0) {
+				assert(posted_id == 0);
+				posted_id = r->id;
+			}
+			break;
+		case WESTON_TIMELINE_RECORD_OUTPUT:
+			assert(output_id == 0);
+			assert(strcmp((char *)(r + 1), output->name) == 0);
+			output_id = r->id;
+			break;
+		case WESTON_TIMELINE_RECORD_POINT:
+			/* Names and objects come before their first use. */
+			assert(r->id != 0);
+			assert(r->time >= last_time);
+			last_time = r->time;
+			if (r->id == begin_id) {
+				assert(r->output == output_id);
+				n_begin++;
+			} else if (r->id == posted_id) {
+				assert(r->output == output_id);
+				n_posted++;
+			}
+			break;
+		default:
+			assert(!"unexpected record");
+		}
+	}
+
+	assert(output_id != 0);
+	assert(n_begin == 3);
+	assert(n_posted == 3);
+
+	free(rec.data);
+}
+
+/* Not a correctness test: reports the cost of a timeline point with a
+ * binary subscription, and with none. */
+PLUGIN_TEST(timeline_binary_point_cost)
+{
+	/* struct weston_compositor *compositor; */
+	const int n_points = 200000;
+	struct weston_output *output;
+	struct recording rec;
+	struct timespec begin, end;
+	int64_t idle_ns, binary_ns;
+	int i;
+
+	output = container_of(compositor->output_list.next,
+			      struct weston_output, link);
+
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (i = 0; i < n_points; i++)
+		TL_POINT(compositor, "bench_point", TLP_OUTPUT(output),
+			 TLP_END);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	idle_ns = timespec_sub_to_nsec(&end, &begin);
+
+	recording_start(&rec, compositor);
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (i = 0; i < n_points; i++)
+		TL_POINT(compositor, "bench_point", TLP_OUTPUT(output),
+			 TLP_END);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	binary_ns = timespec_sub_to_nsec(&end, &begin);
+	recording_stop(&rec);
+
+	assert(rec.size >= n_points * sizeof(struct weston_timeline_record));
+	free(rec.data);
+
+	testlog("timeline point: %.1f ns without subscribers, "
+		"%.1f ns with a binary subscription\n",
+		(double)idle_ns / n_points, (double)binary_ns / n_points);
+}
@@ -26,11 +26,15 @@
 #include "config.h"
 
 #include <assert.h>
+#include <math.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include "weston-test-runner.h"
 
 #include "shared/helpers.h"
+#include "shared/timespec-util.h"
 #include "vertex-clipping.h"
 
 #define BOUNDING_BOX_TOP_Y 100.0f
@@ -221,3 +225,259 @@ TEST(float_difference_same)
 	assert(float_difference(1.0f, 1.0f) == 0.0f);
 }
 
+
+static const struct clip_box test_box = {
+	BOUNDING_BOX_LEFT_X, BOUNDING_BOX_BOTTOM_Y,
+	BOUNDING_BOX_RIGHT_X, BOUNDING_BOX_TOP_Y
+};
+
+TEST_P(clip_polygons_to_boxes_expected_vertices, test_data)
+{
+	struct vertex_clip_test_data *tdata = data;
+	float vertices_x[8];
+	float vertices_y[8];
+	int counts[1];
+	int n, i;
+
+	n = clip_polygons_to_boxes(&tdata->surface, 1, &test_box, 1, true,
+				   vertices_x, vertices_y, counts);
+
+	assert(n == 1);
+	assert(counts[0] == tdata->expected.n);
+	for (i = 0; i < counts[0]; ++i) {
+		assert(vertices_x[i] == tdata->expected.x[i]);
+		assert(vertices_y[i] == tdata->expected.y[i]);
+	}
+}
+
+/* A 100x100 rectangle rotated by angle around (cx, cy), scaled by scale. */
+static void
+make_quad(struct polygon8 *quad, float cx, float cy, float scale,
+	  float angle)
+{
+	static const float rx[4] = { -50, 50, 50, -50 };
+	static const float ry[4] = { -50, -50, 50, 50 };
+	float c = cosf(angle) * scale;
+	float s = sinf(angle) * scale;
+	int i;
+
+	for (i = 0; i < 4; i++) {
+		quad->x[i] = cx + c * rx[i] - s * ry[i];
+		quad->y[i] = cy + s * rx[i] + c * ry[i];
+	}
+	quad->n = 4;
+}
+
+/* What gl-renderer did before the batched clipper: one clip per pair. */
+static int
+clip_pairs(const struct polygon8 *polygons, int n_polygons,
+	   const struct clip_box *boxes, int n_boxes, bool transformed,
+	   float *ex, float *ey, int *counts)
+{
+	struct clip_context ctx;
+	struct polygon8 surf;
+	float min_x, max_x, min_y, max_y;
+	int i, j, k, n, n_out = 0;
+
+	for (i = 0; i < n_polygons; i++) {
+		for (j = 0; j < n_boxes; j++) {
+			surf = polygons[i];
+			ctx.clip.x1 = boxes[j].x1;
+			ctx.clip.y1 = boxes[j].y1;
+			ctx.clip.x2 = boxes[j].x2;
+			ctx.clip.y2 = boxes[j].y2;
+
+			min_x = max_x = surf.x[0];
+			min_y = max_y = surf.y[0];
+			for (k = 1; k < surf.n; k++) {
+				min_x = fminf(min_x, surf.x[k]);
+				max_x = fmaxf(max_x, surf.x[k]);
+				min_y = fminf(min_y, surf.y[k]);
+				max_y = fmaxf(max_y, surf.y[k]);
+			}
+			if (min_x >= ctx.clip.x2 || max_x <= ctx.clip.x1 ||
+			    min_y >= ctx.clip.y2 || max_y <= ctx.clip.y1)
+				continue;
+
+			if (transformed)
+				n = clip_transformed(&ctx, &surf, ex, ey);
+			else
+				n = clip_simple(&ctx, &surf, ex, ey);
+			if (n < 3)
+				continue;
+
+			ex += n;
+			ey += n;
+			counts[n_out++] = n;
+		}
+	}
+
+	return n_out;
+}
+
+struct clip_workload {
+	struct polygon8 *polygons;
+	int n_polygons;
+	struct clip_box *boxes;
+	int n_boxes;
+	float *ex, *ey;
+	int *counts;
+};
+
+static void
+clip_workload_init(struct clip_workload *w, int n_polygons, int n_boxes)
+{
+	w->polygons = calloc(n_polygons, sizeof *w->polygons);
+	w->n_polygons = n_polygons;
+	w->boxes = calloc(n_boxes, sizeof *w->boxes);
+	w->n_boxes = n_boxes;
+	w->ex = calloc(n_polygons * n_boxes * 8, sizeof *w->ex);
+	w->ey = calloc(n_polygons * n_boxes * 8, sizeof *w->ey);
+	w->counts = calloc(n_polygons * n_boxes, sizeof *w->counts);
+	assert(w->polygons && w->boxes && w->ex && w->ey && w->counts);
+}
+
+static void
+clip_workload_release(struct clip_workload *w)
+{
+	free(w->polygons);
+	free(w->boxes);
+	free(w->ex);
+	free(w->ey);
+	free(w->counts);
+}
+
+/* Damage as a grid of cols x rows boxes of the given size. */
+static void
+clip_workload_grid(struct clip_workload *w, int cols, float size)
+{
+	int i;
+
+	for (i = 0; i < w->n_boxes; i++) {
+		w->boxes[i].x1 = (i % cols) * size;
+		w->boxes[i].y1 = (i / cols) * size;
+		w->boxes[i].x2 = w->boxes[i].x1 + size;
+		w->boxes[i].y2 = w->boxes[i].y1 + size;
+	}
+}
+
+static void
+assert_batch_matches_pairs(struct clip_workload *w, bool transformed)
+{
+	struct clip_workload ref;
+	int n, ref_n, i, total = 0;
+
+	clip_workload_init(&ref, w->n_polygons, w->n_boxes);
+
+	n = clip_polygons_to_boxes(w->polygons, w->n_polygons,
+				   w->boxes, w->n_boxes, transformed,
+				   w->ex, w->ey, w->counts);
+	ref_n = clip_pairs(w->polygons, w->n_polygons,
+			   w->boxes, w->n_boxes, transformed,
+			   ref.ex, ref.ey, ref.counts);
+
+	assert(n == ref_n);
+	for (i = 0; i < n; i++) {
+		assert(w->counts[i] == ref.counts[i]);
+		total += w->counts[i];
+	}
+	for (i = 0; i < total; i++) {
+		assert(w->ex[i] == ref.ex[i]);
+		assert(w->ey[i] == ref.ey[i]);
+	}
+
+	clip_workload_release(&ref);
+}
+
+TEST(clip_polygons_to_boxes_matches_pairwise)
+{
+	struct clip_workload w;
+	int i, round;
+
+	srandom(42);
+
+	for (round = 0; round < 200; round++) {
+		clip_workload_init(&w, 1 + round % 5, 1 + round % 23);
+		clip_workload_grid(&w, 1 + round % 7, 40.0f);
+
+		for (i = 0; i < w.n_polygons; i++)
+			make_quad(&w.polygons[i],
+				  random() % 300, random() % 300,
+				  0.1f + (random() % 300) / 100.0f,
+				  (round % 3) ? (random() % 628) / 100.0f : 0);
+
+		assert_batch_matches_pairs(&w, round % 3 != 0);
+		clip_workload_release(&w);
+	}
+}
+
+static int64_t
+clip_bench_run(struct clip_workload *w, bool batched, bool transformed)
+{
+	const int iterations = 2000;
+	struct timespec begin, end;
+	int i;
+
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (i = 0; i < iterations; i++) {
+		if (batched)
+			clip_polygons_to_boxes(w->polygons, w->n_polygons,
+					       w->boxes, w->n_boxes,
+					       transformed,
+					       w->ex, w->ey, w->counts);
+		else
+			clip_pairs(w->polygons, w->n_polygons,
+				   w->boxes, w->n_boxes, transformed,
+				   w->ex, w->ey, w->counts);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	return timespec_sub_to_nsec(&end, &begin) / iterations;
+}
+
+static void
+clip_bench(const char *name, struct clip_workload *w)
+{
+	assert_batch_matches_pairs(w, true);
+	assert_batch_matches_pairs(w, false);
+
+	testlog("%s: %d polygons x %d boxes\n",
+		name, w->n_polygons, w->n_boxes);
+	testlog("  general clip: per pair %.1f us, batched %.1f us\n",
+		clip_bench_run(w, false, true) / 1000.0,
+		clip_bench_run(w, true, true) / 1000.0);
+	testlog("  axis-aligned: per pair %.1f us, batched %.1f us\n",
+		clip_bench_run(w, false, false) / 1000.0,
+		clip_bench_run(w, true, false) / 1000.0);
+}
+
+/* Not a correctness test: compares the batched clipper to clipping pair
+ * by pair, for the zoom and exposay animations. Both only scale, so
+ * gl-renderer clips their surfaces as axis-aligned rectangles; the
+ * general polygon clipper is timed for reference. */
+TEST(clip_polygons_to_boxes_bench)
+{
+	struct clip_workload w;
+	int i;
+
+	/* Zoom: a 1920x1080 surface scaled up 1.5 times around the
+	 * pointer, against damage split in 64 px tiles. */
+	clip_workload_init(&w, 1, 30 * 17);
+	clip_workload_grid(&w, 30, 64.0f);
+	make_quad(&w.polygons[0], 700, 400, 1.5f * 19.2f, 0);
+	w.polygons[0].y[0] = w.polygons[0].y[1] = 400 - 1.5f * 540;
+	w.polygons[0].y[2] = w.polygons[0].y[3] = 400 + 1.5f * 540;
+	clip_bench("zoom", &w);
+	clip_workload_release(&w);
+
+	/* Exposay: 16 windows scaled down into a 4x4 grid over the whole
+	 * output, which is damaged every frame of the animation, in
+	 * 128 px tiles. */
+	clip_workload_init(&w, 16, 15 * 9);
+	clip_workload_grid(&w, 15, 128.0f);
+	for (i = 0; i < w.n_polygons; i++)
+		make_quad(&w.polygons[i], 240 + (i % 4) * 480,
+			  135 + (i / 4) * 270, 3.8f, 0);
+	clip_bench("exposay", &w);
+	clip_workload_release(&w);
+}
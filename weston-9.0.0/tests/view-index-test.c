@@ -0,0 +1,256 @@
+/*
+ * Copyright © 2026 The Annland Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include "weston-test-runner.h"
+
+#include <libweston/libweston.h>
+#include <libweston/zalloc.h>
+#include "shared/helpers.h"
+#include "view-index.h"
+
+#define N_VIEWS 200
+#define SPACE 4096
+
+/* A view list of bare views, only bounding boxes and links are set. */
+struct view_set {
+	struct wl_list list;
+	struct weston_view *views[N_VIEWS];
+};
+
+static void
+view_set_box(struct weston_view *view, int x, int y, int w, int h)
+{
+	pixman_region32_fini(&view->transform.boundingbox);
+	pixman_region32_init_rect(&view->transform.boundingbox, x, y, w, h);
+}
+
+static void
+view_set_random_box(struct weston_view *view)
+{
+	int w, h;
+
+	/* Mostly small views, some covering more than 256 cells. */
+	if (random() % 10 == 0) {
+		w = 2048 + random() % 2048;
+		h = 2048 + random() % 2048;
+	} else {
+		w = 1 + random() % 300;
+		h = 1 + random() % 300;
+	}
+
+	view_set_box(view, random() % SPACE - SPACE / 4,
+		     random() % SPACE - SPACE / 4, w, h);
+}
+
+static void
+view_set_init(struct view_set *set)
+{
+	int i;
+
+	wl_list_init(&set->list);
+	for (i = 0; i < N_VIEWS; i++) {
+		set->views[i] = zalloc(sizeof *set->views[i]);
+		assert(set->views[i]);
+		pixman_region32_init(&set->views[i]->transform.boundingbox);
+		view_set_random_box(set->views[i]);
+		wl_list_insert(set->list.prev, &set->views[i]->link);
+	}
+}
+
+static void
+view_set_release(struct view_set *set)
+{
+	int i;
+
+	for (i = 0; i < N_VIEWS; i++) {
+		pixman_region32_fini(&set->views[i]->transform.boundingbox);
+		free(set->views[i]);
+	}
+}
+
+static bool
+view_contains(struct weston_view *view, int32_t x, int32_t y)
+{
+	return pixman_region32_contains_point(&view->transform.boundingbox,
+					      x, y, NULL);
+}
+
+/* The views the index yields for a point, filtered by containment, must
+ * be exactly the listed views containing it, in list order. */
+static void
+check_point(struct weston_view_index *index, struct wl_list *list,
+	    int32_t x, int32_t y)
+{
+	struct weston_view_index_iter iter;
+	struct weston_view *view, *expected;
+	struct wl_list *pos = list;
+	bool first = true;
+	uint32_t last = 0;
+
+	weston_view_index_iter_init(&iter, index, x, y);
+	while ((view = weston_view_index_iter_next(&iter))) {
+		assert(view->index.indexed);
+		assert(first || view->index.order > last);
+		first = false;
+		last = view->index.order;
+
+		if (!view_contains(view, x, y))
+			continue;
+
+		do {
+			pos = pos->next;
+			assert(pos != list);
+			expected = container_of(pos, struct weston_view, link);
+		} while (!view_contains(expected, x, y));
+		assert(view == expected);
+	}
+
+	/* No view containing the point was missed. */
+	for (pos = pos->next; pos != list; pos = pos->next) {
+		expected = container_of(pos, struct weston_view, link);
+		assert(!view_contains(expected, x, y));
+	}
+}
+
+static void
+check_points(struct weston_view_index *index, struct wl_list *list)
+{
+	int i;
+
+	for (i = 0; i < 2000; i++)
+		check_point(index, list, random() % SPACE - SPACE / 4,
+			    random() % SPACE - SPACE / 4);
+}
+
+TEST(view_index_matches_list)
+{
+	struct weston_view_index *index;
+	struct view_set set;
+
+	srandom(1);
+	view_set_init(&set);
+	index = weston_view_index_create();
+	assert(index);
+
+	weston_view_index_rebuild(index, &set.list);
+	check_points(index, &set.list);
+
+	/* Rebuilding after a restack uses the new order. */
+	wl_list_remove(&set.views[0]->link);
+	wl_list_insert(set.list.prev, &set.views[0]->link);
+	wl_list_remove(&set.views[N_VIEWS - 1]->link);
+	wl_list_insert(&set.list, &set.views[N_VIEWS - 1]->link);
+	weston_view_index_rebuild(index, &set.list);
+	check_points(index, &set.list);
+
+	weston_view_index_destroy(index);
+	view_set_release(&set);
+}
+
+TEST(view_index_update_moves_views)
+{
+	struct weston_view_index *index;
+	struct view_set set;
+	int i;
+
+	srandom(2);
+	view_set_init(&set);
+	index = weston_view_index_create();
+	assert(index);
+	weston_view_index_rebuild(index, &set.list);
+
+	/* Moves between cells, into and out of the large list, and to an
+	 * empty bounding box. */
+	for (i = 0; i < N_VIEWS; i += 3) {
+		if (i % 7 == 0)
+			view_set_box(set.views[i], 0, 0, 0, 0);
+		else
+			view_set_random_box(set.views[i]);
+		weston_view_index_update(index, set.views[i]);
+	}
+	check_points(index, &set.list);
+
+	/* Updating a view that did not move is a no-op. */
+	weston_view_index_update(index, set.views[1]);
+	check_points(index, &set.list);
+
+	weston_view_index_destroy(index);
+	view_set_release(&set);
+}
+
+TEST(view_index_remove)
+{
+	struct weston_view_index *index;
+	struct view_set set;
+	int i;
+
+	srandom(3);
+	view_set_init(&set);
+	index = weston_view_index_create();
+	assert(index);
+	weston_view_index_rebuild(index, &set.list);
+
+	for (i = 0; i < N_VIEWS; i += 2) {
+		weston_view_index_remove(index, set.views[i]);
+		assert(!set.views[i]->index.indexed);
+		wl_list_remove(&set.views[i]->link);
+	}
+	check_points(index, &set.list);
+
+	/* Views no longer in the index are ignored. */
+	view_set_random_box(set.views[0]);
+	weston_view_index_update(index, set.views[0]);
+	weston_view_index_remove(index, set.views[0]);
+	check_points(index, &set.list);
+
+	/* Put them back so view_set_release() frees everything. */
+	for (i = 0; i < N_VIEWS; i += 2)
+		wl_list_insert(&set.list, &set.views[i]->link);
+
+	weston_view_index_destroy(index);
+	view_set_release(&set);
+}
+
+TEST(view_index_empty_cell)
+{
+	struct weston_view_index *index;
+	struct weston_view_index_iter iter;
+	struct wl_list list;
+
+	wl_list_init(&list);
+	index = weston_view_index_create();
+	assert(index);
+	weston_view_index_rebuild(index, &list);
+
+	weston_view_index_iter_init(&iter, index, 12345, -6789);
+	assert(weston_view_index_iter_next(&iter) == NULL);
+
+	weston_view_index_destroy(index);
+}
@@ -0,0 +1,127 @@
+/*
+ * Copyright © 2026 The Annland Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+
+#include <libweston/libweston.h>
+#include "libweston-internal.h"
+#include "shared/helpers.h"
+#include "weston-test-runner.h"
+#include "weston-test-fixture-compositor.h"
+#include "weston-test-plugin-helper.h"
+
+#define VIEW_SIZE 64
+
+static enum test_result_code
+fixture_setup(struct weston_test_harness *harness)
+{
+	struct compositor_setup setup;
+
+	compositor_setup_defaults(&setup);
+
+	return weston_test_harness_execute_as_plugin(harness, &setup);
+}
+DECLARE_FIXTURE_SETUP(fixture_setup);
+
+/* Return the position of the view in the compositor view list, or -1. */
+static int
+view_list_index(struct weston_compositor *compositor, struct weston_view *view)
+{
+	struct weston_view *ev;
+	int i = 0;
+
+	wl_list_for_each(ev, &compositor->view_list, link) {
+		if (ev == view)
+			return i;
+		i++;
+	}
+
+	return -1;
+}
+
+PLUGIN_TEST(view_list_rebuilt_on_topology_change)
+{
+	/* struct weston_compositor *compositor; */
+	struct weston_output *output;
+	struct weston_view *a, *b;
+	struct weston_layer layer, bottom_layer;
+
+	weston_layer_init(&layer, compositor);
+	weston_layer_set_position(&layer, WESTON_LAYER_POSITION_NORMAL);
+	weston_layer_init(&bottom_layer, compositor);
+	output = create_test_output(compositor, 640, 480);
+
+	a = create_test_view(compositor, &layer, 0, 0, VIEW_SIZE, VIEW_SIZE);
+	b = create_test_view(compositor, &layer, 100, 0, VIEW_SIZE, VIEW_SIZE);
+	assert(compositor->view_list_needs_rebuild);
+
+	assert(weston_output_repaint(output, NULL) == 0);
+	assert(!compositor->view_list_needs_rebuild);
+	assert(view_list_index(compositor, a) >= 0);
+	assert(view_list_index(compositor, b) < view_list_index(compositor, a));
+
+	/* Moving a view is not a topology change, but the repaint must
+	 * still bring its transform up to date. */
+	weston_view_set_position(a, 200, 100);
+	assert(!compositor->view_list_needs_rebuild);
+	assert(weston_output_repaint(output, NULL) == 0);
+	assert(view_list_index(compositor, a) >= 0);
+	assert(!a->transform.dirty);
+	assert(a->transform.boundingbox.extents.x1 == 200);
+	assert(a->transform.boundingbox.extents.y1 == 100);
+
+	/* Removing a layer entry drops the view from the list. */
+	weston_layer_entry_remove(&b->layer_link);
+	assert(compositor->view_list_needs_rebuild);
+	assert(weston_output_repaint(output, NULL) == 0);
+	assert(view_list_index(compositor, b) == -1);
+	assert(view_list_index(compositor, a) >= 0);
+
+	/* Putting it back on a layer below restacks the list. */
+	weston_layer_set_position(&bottom_layer,
+				  WESTON_LAYER_POSITION_BACKGROUND);
+	assert(compositor->view_list_needs_rebuild);
+	assert(weston_output_repaint(output, NULL) == 0);
+	weston_layer_entry_insert(&bottom_layer.view_list, &b->layer_link);
+	assert(compositor->view_list_needs_rebuild);
+	assert(weston_output_repaint(output, NULL) == 0);
+	assert(view_list_index(compositor, a) >= 0);
+	assert(view_list_index(compositor, a) < view_list_index(compositor, b));
+
+	/* Unmapping a view drops it as well. */
+	weston_view_unmap(a);
+	assert(compositor->view_list_needs_rebuild);
+	assert(weston_output_repaint(output, NULL) == 0);
+	assert(view_list_index(compositor, a) == -1);
+	assert(view_list_index(compositor, b) >= 0);
+
+	weston_surface_destroy(a->surface);
+	weston_surface_destroy(b->surface);
+	weston_layer_unset_position(&bottom_layer);
+	weston_layer_unset_position(&layer);
+	weston_output_destroy(output);
+}
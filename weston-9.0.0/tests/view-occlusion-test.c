@@ -0,0 +1,140 @@
+/*
+ * Copyright © 2026 The Annland Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <stdio.h>
+
+#include <libweston/libweston.h>
+#include "libweston-internal.h"
+#include "shared/helpers.h"
+#include "weston-test-runner.h"
+#include "weston-test-fixture-compositor.h"
+#include "weston-test-plugin-helper.h"
+
+static enum test_result_code
+fixture_setup(struct weston_test_harness *harness)
+{
+	struct compositor_setup setup;
+
+	compositor_setup_defaults(&setup);
+
+	return weston_test_harness_execute_as_plugin(harness, &setup);
+}
+DECLARE_FIXTURE_SETUP(fixture_setup);
+
+static struct weston_view *
+create_opaque_view(struct weston_compositor *compositor,
+		   struct weston_layer *layer, int x, int y, int size)
+{
+	struct weston_view *view;
+
+	view = create_test_view(compositor, layer, x, y, size, size);
+	test_view_set_opaque(view);
+
+	return view;
+}
+
+static void
+view_add_transform(struct weston_view *view, struct weston_transform *tform)
+{
+	wl_list_insert(&view->geometry.transformation_list, &tform->link);
+	weston_view_geometry_dirty(view);
+}
+
+static bool
+region_covers(pixman_region32_t *region, pixman_region32_t *rect)
+{
+	return pixman_region32_contains_rectangle(region,
+			pixman_region32_extents(rect)) == PIXMAN_REGION_IN;
+}
+
+/* An opaque view scaled up on top of another one must still hide it. */
+PLUGIN_TEST(scaled_opaque_view_occludes)
+{
+	/* struct weston_compositor *compositor; */
+	struct weston_transform scale;
+	struct weston_output *output;
+	struct weston_view *top, *bottom;
+	struct weston_layer layer;
+	const pixman_box32_t *box;
+
+	weston_layer_init(&layer, compositor);
+	weston_layer_set_position(&layer, WESTON_LAYER_POSITION_NORMAL);
+	output = create_test_output(compositor, 640, 480);
+
+	bottom = create_opaque_view(compositor, &layer, 110, 110, 64);
+	top = create_opaque_view(compositor, &layer, 100, 100, 32);
+
+	weston_matrix_init(&scale.matrix);
+	weston_matrix_scale(&scale.matrix, 4.0, 4.0, 1.0);
+	view_add_transform(top, &scale);
+
+	assert(weston_output_repaint(output, NULL) == 0);
+
+	/* Edge pixels are not trusted when the view is scaled. */
+	box = pixman_region32_extents(&top->transform.opaque);
+	assert(box->x1 == 101 && box->y1 == 101);
+	assert(box->x2 == 227 && box->y2 == 227);
+
+	assert(region_covers(&bottom->clip, &bottom->transform.boundingbox));
+
+	weston_surface_destroy(top->surface);
+	weston_surface_destroy(bottom->surface);
+	weston_layer_unset_position(&layer);
+	weston_output_destroy(output);
+}
+
+/* Rotated views keep drawing what is below them. */
+PLUGIN_TEST(rotated_opaque_view_does_not_occlude)
+{
+	/* struct weston_compositor *compositor; */
+	struct weston_transform rotate;
+	struct weston_output *output;
+	struct weston_view *top, *bottom;
+	struct weston_layer layer;
+
+	weston_layer_init(&layer, compositor);
+	weston_layer_set_position(&layer, WESTON_LAYER_POSITION_NORMAL);
+	output = create_test_output(compositor, 640, 480);
+
+	bottom = create_opaque_view(compositor, &layer, 132, 132, 64);
+	top = create_opaque_view(compositor, &layer, 100, 100, 128);
+
+	weston_matrix_init(&rotate.matrix);
+	weston_matrix_rotate_xy(&rotate.matrix, 0.8f, 0.6f);
+	view_add_transform(top, &rotate);
+
+	assert(weston_output_repaint(output, NULL) == 0);
+
+	assert(!pixman_region32_not_empty(&top->transform.opaque));
+	assert(!pixman_region32_not_empty(&bottom->clip));
+
+	weston_surface_destroy(top->surface);
+	weston_surface_destroy(bottom->surface);
+	weston_layer_unset_position(&layer);
+	weston_output_destroy(output);
+}
@@ -0,0 +1,208 @@
+/*
+ * Copyright © 2026 The Annland Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <libweston/libweston.h>
+#include "libweston-internal.h"
+#include "shared/helpers.h"
+#include "weston-test-runner.h"
+#include "weston-test-fixture-compositor.h"
+#include "weston-test-plugin-helper.h"
+#include "wcap-decode.h"
+#include "wcap-rle.h"
+
+static enum test_result_code
+fixture_setup(struct weston_test_harness *harness)
+{
+	struct compositor_setup setup;
+
+	compositor_setup_defaults(&setup);
+	setup.renderer = RENDERER_PIXMAN;
+	setup.width = 320;
+	setup.height = 240;
+
+	return weston_test_harness_execute_as_plugin(harness, &setup);
+}
+DECLARE_FIXTURE_SETUP(fixture_setup);
+
+#define N_VIEWS 8
+
+static void *
+read_file(const char *path, size_t *size)
+{
+	FILE *fp;
+	void *data;
+	long len;
+
+	fp = fopen(path, "r");
+	assert(fp);
+	assert(fseek(fp, 0, SEEK_END) == 0);
+	len = ftell(fp);
+	assert(len >= 0);
+	rewind(fp);
+
+	data = malloc(len);
+	assert(data);
+	assert(fread(data, 1, len, fp) == (size_t)len);
+	fclose(fp);
+
+	*size = len;
+	return data;
+}
+
+/* Decode every frame of a wcap file like wcap-decode does and return
+ * the last one. */
+static uint32_t *
+decode_wcap(const char *path, int width, int height, int *n_frames)
+{
+	const struct wcap_header *header;
+	const struct wcap_frame_header *fh;
+	const struct wcap_rectangle *rects;
+	const uint32_t *p, *end;
+	uint32_t *frame;
+	size_t size;
+	void *data;
+	uint32_t i;
+	int n;
+
+	data = read_file(path, &size);
+	assert(size >= sizeof *header);
+	header = data;
+	assert(header->magic == WCAP_HEADER_MAGIC);
+	assert(header->width == (uint32_t)width);
+	assert(header->height == (uint32_t)height);
+
+	frame = calloc(width * height, sizeof *frame);
+	assert(frame);
+
+	*n_frames = 0;
+	p = (const uint32_t *)(header + 1);
+	end = (const uint32_t *)((const char *)data + size);
+	while (p < end) {
+		fh = (const struct wcap_frame_header *)p;
+		rects = (const struct wcap_rectangle *)(fh + 1);
+		p = (const uint32_t *)(rects + fh->nrects);
+		for (i = 0; i < fh->nrects; i++) {
+			p = wcap_rle_decode_rect(p, frame, width, &rects[i], &n);
+			assert(n == (rects[i].x2 - rects[i].x1) *
+				    (rects[i].y2 - rects[i].y1));
+		}
+		assert(p <= end);
+		(*n_frames)++;
+	}
+
+	free(data);
+	return frame;
+}
+
+/* Repaints faster than the encoder thread keeps up with drop frames and
+ * merge their damage into later ones; the decoded recording must still
+ * end up with exactly what is on screen. */
+PLUGIN_TEST(wcap_recorder_matches_output)
+{
+	/* struct weston_compositor *compositor; */
+	struct weston_view *views[N_VIEWS];
+	struct weston_recorder *recorder;
+	struct weston_output *output;
+	struct weston_layer layer;
+	uint32_t *screen, *decoded;
+	char path[256];
+	int n_frames, n_pixels;
+	int i, k, fd;
+
+	assert(!wl_list_empty(&compositor->output_list));
+	output = container_of(compositor->output_list.next,
+			      struct weston_output, link);
+
+	weston_layer_init(&layer, compositor);
+	weston_layer_set_position(&layer, WESTON_LAYER_POSITION_NORMAL);
+	for (i = 0; i < N_VIEWS; i++) {
+		views[i] = create_test_view(compositor, &layer,
+					    output->x + i * 30,
+					    output->y + i * 20, 60, 60);
+		weston_surface_set_color(views[i]->surface,
+					 0.1 * i, 0.5, 1.0 - 0.1 * i, 1.0);
+	}
+	assert(weston_output_repaint(output, NULL) == 0);
+
+	snprintf(path, sizeof path, "%s/wcap-recorder-XXXXXX",
+		 getenv("XDG_RUNTIME_DIR"));
+	fd = mkstemp(path);
+	assert(fd >= 0);
+	close(fd);
+
+	recorder = weston_recorder_start(output, path);
+	assert(recorder);
+
+	for (k = 0; k < 100; k++) {
+		for (i = 0; i < N_VIEWS; i++) {
+			weston_view_set_position(views[i],
+						 output->x + (i * 30 + k * 3) %
+						 (output->width - 60),
+						 output->y + i * 20);
+			weston_surface_set_color(views[i]->surface,
+						 (k % 10) * 0.1, 0.1 * i,
+						 0.5, 1.0);
+			weston_surface_damage(views[i]->surface);
+		}
+		assert(weston_output_repaint(output, NULL) == 0);
+	}
+
+	/* The recorder goes away on the next frame, after its encoder has
+	 * written everything queued. */
+	weston_recorder_stop(recorder);
+	assert(weston_output_repaint(output, NULL) == 0);
+
+	n_pixels = output->current_mode->width * output->current_mode->height;
+	screen = calloc(n_pixels, sizeof *screen);
+	assert(screen);
+	assert(compositor->renderer->read_pixels(output,
+						 compositor->read_format,
+						 screen, 0, 0,
+						 output->current_mode->width,
+						 output->current_mode->height) == 0);
+
+	decoded = decode_wcap(path, output->current_mode->width,
+			      output->current_mode->height, &n_frames);
+	testlog("%d frames recorded\n", n_frames);
+	assert(n_frames > 0);
+
+	/* wcap does not record alpha. */
+	for (i = 0; i < n_pixels; i++)
+		assert((decoded[i] & 0xffffff) == (screen[i] & 0xffffff));
+
+	free(decoded);
+	free(screen);
+	unlink(path);
+	for (i = 0; i < N_VIEWS; i++)
+		weston_surface_destroy(views[i]->surface);
+	weston_layer_unset_position(&layer);
+}
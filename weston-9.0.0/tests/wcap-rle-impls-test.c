@@ -0,0 +1,226 @@
+/*
+ * Copyright © 2026 The Annland Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Checks that every RLE delta coder implementation the CPU supports
+ * encodes exactly the same stream as the scalar one and decodes it back
+ * to the same frames. Rectangles are placed inside a larger frame with
+ * widths that leave tails for the scalar code and runs that continue from
+ * one row to the next. See wcap-rle-test for the throughput benchmark.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "wcap-decode.h"
+#include "wcap-rle.h"
+
+#define WIDTH 300
+#define HEIGHT 40
+#define N_FRAMES 6
+
+static const struct {
+	enum wcap_rle_impl impl;
+	const char *name;
+} impls[] = {
+	{ WCAP_RLE_IMPL_SCALAR, "scalar" },
+	{ WCAP_RLE_IMPL_SSE2, "sse2" },
+	{ WCAP_RLE_IMPL_AVX2, "avx2" },
+};
+
+static const struct wcap_rectangle rects[] = {
+	{ 0, 0, WIDTH, HEIGHT },
+	{ 0, 0, 1, 1 },
+	{ 5, 3, 12, 4 },
+	{ 17, 2, 50, 19 },
+	{ 31, 7, 96, 8 },
+	{ 100, 10, 299, 39 },
+	{ WIDTH - 3, 0, WIDTH, HEIGHT },
+};
+
+static uint32_t rand_state = 1;
+
+static uint32_t
+next_rand(void)
+{
+	rand_state = rand_state * 1103515245 + 12345;
+	return rand_state >> 8;
+}
+
+/* Runs of every length up to a few hundred pixels, long enough for the
+ * vectorized paths and the long run codes, mixed with noise. */
+static void
+fill_frame(uint32_t *frame, int n)
+{
+	uint32_t color = 0;
+	int i, run = 0;
+
+	for (i = 0; i < WIDTH * HEIGHT; i++) {
+		if (run == 0) {
+			color = 0xff000000 | next_rand();
+			run = (n % 3 == 2) ? 1 : 1 + next_rand() % 400;
+		}
+		frame[i] = color;
+		run--;
+	}
+}
+
+/* Encode one rectangle of each frame against the previous frame, the way
+ * the recorder does, bottom row first. Returns the stream length in
+ * words. */
+static size_t
+encode(uint32_t **frames, const struct wcap_rectangle *rect,
+       uint32_t *stream)
+{
+	struct wcap_rle_encoder enc;
+	uint32_t *ref, *p = stream;
+	int n, y;
+
+	ref = calloc(WIDTH * HEIGHT, sizeof *ref);
+	if (!ref) {
+		fprintf(stderr, "out of memory\n");
+		exit(EXIT_FAILURE);
+	}
+
+	for (n = 0; n < N_FRAMES; n++) {
+		wcap_rle_encode_begin(&enc, p);
+		for (y = rect->y2 - 1; y >= rect->y1; y--)
+			wcap_rle_encode_row(&enc,
+					    frames[n] + y * WIDTH + rect->x1,
+					    ref + y * WIDTH + rect->x1,
+					    rect->x2 - rect->x1);
+		p = wcap_rle_encode_end(&enc);
+	}
+
+	free(ref);
+
+	return p - stream;
+}
+
+/* Returns the number of frames that do not decode to the original. */
+static int
+decode(uint32_t **frames, const struct wcap_rectangle *rect,
+       const uint32_t *stream)
+{
+	int w = rect->x2 - rect->x1, h = rect->y2 - rect->y1;
+	uint32_t *frame;
+	int n, x, y, count, bad = 0;
+
+	frame = calloc(WIDTH * HEIGHT, sizeof *frame);
+	if (!frame) {
+		fprintf(stderr, "out of memory\n");
+		exit(EXIT_FAILURE);
+	}
+
+	for (n = 0; n < N_FRAMES; n++) {
+		stream = wcap_rle_decode_rect(stream, frame, WIDTH,
+					      rect, &count);
+		if (count != w * h) {
+			bad++;
+			continue;
+		}
+
+		/* wcap does not carry alpha. */
+		for (y = rect->y1; y < rect->y2; y++) {
+			for (x = rect->x1; x < rect->x2; x++) {
+				if ((frame[y * WIDTH + x] ^
+				     frames[n][y * WIDTH + x]) & 0xffffff) {
+					bad++;
+					y = rect->y2;
+					break;
+				}
+			}
+		}
+	}
+
+	free(frame);
+
+	return bad;
+}
+
+int main(int argc, char *argv[])
+{
+	uint32_t *frames[N_FRAMES];
+	uint32_t *reference, *stream;
+	size_t ref_len, len;
+	unsigned r, i;
+	int n, failed = 0;
+
+	for (n = 0; n < N_FRAMES; n++) {
+		frames[n] = malloc(WIDTH * HEIGHT * 4);
+		if (!frames[n]) {
+			fprintf(stderr, "out of memory\n");
+			return EXIT_FAILURE;
+		}
+		fill_frame(frames[n], n);
+	}
+	/* Worst case is one word per pixel. */
+	reference = malloc((size_t) N_FRAMES * WIDTH * HEIGHT * 4);
+	stream = malloc((size_t) N_FRAMES * WIDTH * HEIGHT * 4);
+	if (!reference || !stream) {
+		fprintf(stderr, "out of memory\n");
+		return EXIT_FAILURE;
+	}
+
+	for (r = 0; r < sizeof rects / sizeof rects[0]; r++) {
+		wcap_rle_select_impl(WCAP_RLE_IMPL_SCALAR);
+		ref_len = encode(frames, &rects[r], reference);
+
+		printf("rect %d,%d-%d,%d\n", rects[r].x1, rects[r].y1,
+		       rects[r].x2, rects[r].y2);
+		for (i = 0; i < sizeof impls / sizeof impls[0]; i++) {
+			if (!wcap_rle_select_impl(impls[i].impl)) {
+				printf("  %-8s not supported\n",
+				       impls[i].name);
+				continue;
+			}
+
+			len = encode(frames, &rects[r], stream);
+			if (len != ref_len ||
+			    memcmp(stream, reference, len * 4) != 0) {
+				printf("  %-8s encode MISMATCH\n",
+				       impls[i].name);
+				failed = 1;
+			}
+
+			if (decode(frames, &rects[r], reference) != 0) {
+				printf("  %-8s decode MISMATCH\n",
+				       impls[i].name);
+				failed = 1;
+			}
+		}
+	}
+
+	for (n = 0; n < N_FRAMES; n++)
+		free(frames[n]);
+	free(reference);
+	free(stream);
+
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
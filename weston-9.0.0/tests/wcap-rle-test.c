@@ -0,0 +1,406 @@
+/*
+ * Copyright © 2026 The Annland Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Throughput of the wcap RLE delta coder, for every implementation the CPU
+ * supports, in MB/s of uncompressed pixels. Mismatches are reported too,
+ * but wcap-rle-impls-test is the automated equivalence check.
+ *
+ * Usage: test-wcap-rle [capture.wcap]
+ *
+ * Without arguments only synthetic frames are used. With a capture, it is
+ * additionally decoded in full, and every frame re-encoded, which must give
+ * back the original stream.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "wcap-decode.h"
+#include "wcap-rle.h"
+
+#define WIDTH 1920
+#define HEIGHT 1080
+#define N_FRAMES 16
+
+static const struct {
+	enum wcap_rle_impl impl;
+	const char *name;
+} impls[] = {
+	{ WCAP_RLE_IMPL_SCALAR, "scalar" },
+	{ WCAP_RLE_IMPL_SSE2, "sse2" },
+	{ WCAP_RLE_IMPL_AVX2, "avx2" },
+};
+
+static struct timespec begin_time;
+
+static void
+reset_timer(void)
+{
+	clock_gettime(CLOCK_MONOTONIC, &begin_time);
+}
+
+static double
+read_timer(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (double)(t.tv_sec - begin_time.tv_sec) +
+	       1e-9 * (t.tv_nsec - begin_time.tv_nsec);
+}
+
+static void *
+xmalloc(size_t size)
+{
+	void *p = malloc(size);
+
+	if (!p) {
+		fprintf(stderr, "out of memory\n");
+		exit(1);
+	}
+
+	return p;
+}
+
+static uint32_t
+next_random(uint32_t *state)
+{
+	*state = *state * 1103515245 + 12345;
+	return *state >> 8;
+}
+
+/* Desktop-like: flat background and a few moving solid boxes. */
+static void
+fill_desktop(uint32_t *frame, int n)
+{
+	int x, y, b, x0, y0;
+
+	for (y = 0; y < HEIGHT; y++)
+		for (x = 0; x < WIDTH; x++)
+			frame[y * WIDTH + x] = 0xff336699;
+
+	for (b = 0; b < 8; b++) {
+		x0 = (b * 211 + n * 13) % (WIDTH - 300);
+		y0 = (b * 97 + n * 7) % (HEIGHT - 200);
+		for (y = y0; y < y0 + 200; y++)
+			for (x = x0; x < x0 + 300; x++)
+				frame[y * WIDTH + x] = 0xff000000 | (b * 0x1f2f3f);
+	}
+}
+
+/* A gradient scrolling by one pixel per frame. */
+static void
+fill_gradient(uint32_t *frame, int n)
+{
+	int x, y;
+
+	for (y = 0; y < HEIGHT; y++)
+		for (x = 0; x < WIDTH; x++)
+			frame[y * WIDTH + x] = 0xff000000 |
+				(((x + n) & 0xff) << 16) | ((y & 0xff) << 8);
+}
+
+/* Worst case, nothing compresses. */
+static void
+fill_noise(uint32_t *frame, int n)
+{
+	uint32_t state = n + 1;
+	int i;
+
+	for (i = 0; i < WIDTH * HEIGHT; i++)
+		frame[i] = 0xff000000 | next_random(&state);
+}
+
+static const struct {
+	const char *name;
+	void (*fill)(uint32_t *frame, int n);
+} scenes[] = {
+	{ "desktop", fill_desktop },
+	{ "gradient", fill_gradient },
+	{ "noise", fill_noise },
+};
+
+/* Encode whole frames the way the recorder does, returning the stream
+ * length in words. */
+static size_t
+encode_frames(uint32_t **frames, uint32_t *stream, double *seconds)
+{
+	struct wcap_rle_encoder enc;
+	uint32_t *ref, *p = stream;
+	int n, y;
+
+	ref = xmalloc(WIDTH * HEIGHT * 4);
+	memset(ref, 0, WIDTH * HEIGHT * 4);
+
+	reset_timer();
+	for (n = 0; n < N_FRAMES; n++) {
+		wcap_rle_encode_begin(&enc, p);
+		for (y = HEIGHT - 1; y >= 0; y--)
+			wcap_rle_encode_row(&enc, frames[n] + y * WIDTH,
+					    ref + y * WIDTH, WIDTH);
+		p = wcap_rle_encode_end(&enc);
+	}
+	*seconds = read_timer();
+
+	free(ref);
+
+	return p - stream;
+}
+
+static int
+decode_frames(uint32_t **frames, const uint32_t *stream, double *seconds)
+{
+	const struct wcap_rectangle rect = { 0, 0, WIDTH, HEIGHT };
+	uint32_t *frame;
+	int n, count, bad = 0;
+	double t = 0;
+
+	frame = xmalloc(WIDTH * HEIGHT * 4);
+	memset(frame, 0, WIDTH * HEIGHT * 4);
+
+	for (n = 0; n < N_FRAMES; n++) {
+		reset_timer();
+		stream = wcap_rle_decode_rect(stream, frame, WIDTH,
+					      &rect, &count);
+		t += read_timer();
+
+		if (count != WIDTH * HEIGHT ||
+		    memcmp(frame, frames[n], WIDTH * HEIGHT * 4) != 0)
+			bad++;
+	}
+	*seconds = t;
+
+	free(frame);
+
+	return bad;
+}
+
+static int
+run_synthetic(void)
+{
+	const double mbytes = N_FRAMES * WIDTH * HEIGHT * 4 / 1e6;
+	uint32_t *frames[N_FRAMES];
+	uint32_t *reference, *stream;
+	size_t ref_len, len;
+	double t;
+	unsigned s, i;
+	int n, failed = 0;
+
+	for (n = 0; n < N_FRAMES; n++)
+		frames[n] = xmalloc(WIDTH * HEIGHT * 4);
+	/* Worst case is one word per pixel. */
+	reference = xmalloc((size_t) N_FRAMES * WIDTH * HEIGHT * 4);
+	stream = xmalloc((size_t) N_FRAMES * WIDTH * HEIGHT * 4);
+
+	for (s = 0; s < sizeof scenes / sizeof scenes[0]; s++) {
+		for (n = 0; n < N_FRAMES; n++)
+			scenes[s].fill(frames[n], n);
+
+		wcap_rle_select_impl(WCAP_RLE_IMPL_SCALAR);
+		ref_len = encode_frames(frames, reference, &t);
+
+		printf("\n%s, %d frames of %dx%d, ratio %.3f\n",
+		       scenes[s].name, N_FRAMES, WIDTH, HEIGHT,
+		       (double) ref_len / (N_FRAMES * WIDTH * HEIGHT));
+
+		for (i = 0; i < sizeof impls / sizeof impls[0]; i++) {
+			if (!wcap_rle_select_impl(impls[i].impl)) {
+				printf("  %-8s not supported\n", impls[i].name);
+				continue;
+			}
+
+			len = encode_frames(frames, stream, &t);
+			printf("  %-8s encode %8.1f MB/s", impls[i].name,
+			       mbytes / t);
+			if (len != ref_len ||
+			    memcmp(stream, reference, len * 4) != 0) {
+				printf(" MISMATCH");
+				failed = 1;
+			}
+
+			if (decode_frames(frames, reference, &t) != 0) {
+				printf(", decode MISMATCH\n");
+				failed = 1;
+				continue;
+			}
+			printf(", decode %8.1f MB/s\n", mbytes / t);
+		}
+	}
+
+	for (n = 0; n < N_FRAMES; n++)
+		free(frames[n]);
+	free(reference);
+	free(stream);
+
+	return failed;
+}
+
+struct capture {
+	const struct wcap_header *header;
+	const void *begin, *end;
+};
+
+/* Decode every frame of the capture. With reencode, also encode each
+ * decoded frame's rects against the previous frame and compare with the
+ * original stream. Returns the number of mismatches. */
+static int
+process_capture(const struct capture *cap, int reencode,
+		double *decode_time, double *encode_time, double *mbytes)
+{
+	const struct wcap_frame_header *fh;
+	const struct wcap_rectangle *rects;
+	struct wcap_rle_encoder enc;
+	const uint32_t *p, *rect_begin;
+	uint32_t *frame, *ref = NULL, *out = NULL, *end;
+	int width = cap->header->width, height = cap->header->height;
+	int count, i, y, w, bad = 0;
+	size_t frame_size = (size_t) width * height * 4;
+
+	frame = xmalloc(frame_size);
+	memset(frame, 0, frame_size);
+	if (reencode) {
+		ref = xmalloc(frame_size);
+		memset(ref, 0, frame_size);
+		out = xmalloc(frame_size);
+	}
+
+	*decode_time = *encode_time = *mbytes = 0;
+
+	p = cap->begin;
+	while ((const void *) p < cap->end) {
+		fh = (const void *) p;
+		rects = (const void *) (fh + 1);
+		p = (const uint32_t *) (rects + fh->nrects);
+
+		for (i = 0; i < (int) fh->nrects; i++) {
+			rect_begin = p;
+
+			reset_timer();
+			p = wcap_rle_decode_rect(p, frame, width,
+						 &rects[i], &count);
+			*decode_time += read_timer();
+			*mbytes += count * 4 / 1e6;
+
+			if (!reencode)
+				continue;
+
+			w = rects[i].x2 - rects[i].x1;
+			reset_timer();
+			wcap_rle_encode_begin(&enc, out);
+			for (y = rects[i].y2 - 1; y >= rects[i].y1; y--)
+				wcap_rle_encode_row(&enc,
+					frame + y * width + rects[i].x1,
+					ref + y * width + rects[i].x1, w);
+			end = wcap_rle_encode_end(&enc);
+			*encode_time += read_timer();
+
+			if (end - out != p - rect_begin ||
+			    memcmp(out, rect_begin, (p - rect_begin) * 4) != 0)
+				bad++;
+		}
+	}
+
+	free(frame);
+	free(ref);
+	free(out);
+
+	return bad;
+}
+
+static int
+run_capture(const char *filename)
+{
+	struct capture cap;
+	struct stat st;
+	void *map;
+	double dt, et, mbytes;
+	unsigned i;
+	int fd, bad, failed = 0;
+
+	fd = open(filename, O_RDONLY | O_CLOEXEC);
+	if (fd < 0 || fstat(fd, &st) < 0) {
+		fprintf(stderr, "cannot open %s\n", filename);
+		return 1;
+	}
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		fprintf(stderr, "mmap failed\n");
+		return 1;
+	}
+
+	cap.header = map;
+	cap.begin = cap.header + 1;
+	cap.end = (const char *) map + st.st_size;
+	if (cap.header->magic != WCAP_HEADER_MAGIC) {
+		fprintf(stderr, "%s is not a wcap file\n", filename);
+		munmap(map, st.st_size);
+		return 1;
+	}
+
+	printf("\n%s, %ux%u\n", filename,
+	       cap.header->width, cap.header->height);
+
+	for (i = 0; i < sizeof impls / sizeof impls[0]; i++) {
+		if (!wcap_rle_select_impl(impls[i].impl)) {
+			printf("  %-8s not supported\n", impls[i].name);
+			continue;
+		}
+
+		bad = process_capture(&cap, 1, &dt, &et, &mbytes);
+		printf("  %-8s decode %8.1f MB/s, encode %8.1f MB/s%s\n",
+		       impls[i].name, mbytes / dt, mbytes / et,
+		       bad ? " MISMATCH" : "");
+		if (bad)
+			failed = 1;
+	}
+
+	munmap(map, st.st_size);
+
+	return failed;
+}
+
+int main(int argc, char *argv[])
+{
+	int failed;
+
+	failed = run_synthetic();
+
+	if (argc > 1)
+		failed |= run_capture(argv[1]);
+
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,184 @@
+/*
+ * Copyright © 2026 The Annland Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Checks that every RGB to YUV implementation the CPU supports gives the
+ * same output as the scalar one, for both output layouts and pixel
+ * formats, including widths that leave a tail for the scalar code. Also
+ * reports their throughput in megapixels per second.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "wcap-decode.h"
+#include "wcap-yuv.h"
+
+#define N_ITERATIONS 10
+
+static const struct {
+	enum wcap_yuv_impl impl;
+	const char *name;
+} impls[] = {
+	{ WCAP_YUV_IMPL_SCALAR, "scalar" },
+	{ WCAP_YUV_IMPL_SSE2, "sse2" },
+	{ WCAP_YUV_IMPL_AVX2, "avx2" },
+};
+
+static const uint32_t formats[] = {
+	WCAP_FORMAT_XRGB8888,
+	WCAP_FORMAT_XBGR8888,
+};
+
+static const struct {
+	int width, height;
+} sizes[] = {
+	{ 1920, 1080 },
+	{ 38, 6 },
+	{ 2, 2 },
+};
+
+static uint32_t rand_state = 1;
+
+static uint32_t
+next_rand(void)
+{
+	rand_state = rand_state * 1103515245 + 12345;
+	return rand_state;
+}
+
+/* Noise in the top half, where every chroma clamp gets exercised, and
+ * smooth gradients below. */
+static void
+fill_frame(uint32_t *frame, int width, int height)
+{
+	int x, y;
+
+	for (y = 0; y < height; y++) {
+		for (x = 0; x < width; x++) {
+			if (y < height / 2)
+				frame[y * width + x] = next_rand() >> 4;
+			else
+				frame[y * width + x] = 0xff000000 |
+					((x & 0xff) << 16) |
+					((y & 0xff) << 8) |
+					((x + y) & 0xff);
+		}
+	}
+}
+
+static double
+convert(int depth, uint32_t format, const uint32_t *frame,
+	int width, int height, unsigned char *out, int iterations)
+{
+	struct timespec begin, end;
+	int i;
+
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (i = 0; i < iterations; i++) {
+		if (depth == 444)
+			wcap_yuv_convert_yuv444(format, frame,
+						width, height, out);
+		else
+			wcap_yuv_convert_yv12(format, frame,
+					      width, height, out);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	return (end.tv_sec - begin.tv_sec) +
+	       (end.tv_nsec - begin.tv_nsec) / 1e9;
+}
+
+static int
+run_size(int width, int height)
+{
+	static const int depths[] = { 420, 444 };
+	unsigned char *ref, *out;
+	uint32_t *frame;
+	size_t size = (size_t) width * height * 3;
+	unsigned i, d, f;
+	int iterations, failed = 0;
+	double mpixels, t;
+
+	frame = malloc((size_t) width * height * 4);
+	ref = malloc(size);
+	out = malloc(size);
+	if (!frame || !ref || !out) {
+		fprintf(stderr, "out of memory\n");
+		exit(EXIT_FAILURE);
+	}
+
+	fill_frame(frame, width, height);
+	iterations = width * height > 100000 ? N_ITERATIONS : 1;
+	mpixels = (double) width * height * iterations / 1e6;
+
+	printf("%dx%d\n", width, height);
+	for (d = 0; d < sizeof depths / sizeof depths[0]; d++) {
+		for (f = 0; f < sizeof formats / sizeof formats[0]; f++) {
+			wcap_yuv_select_impl(WCAP_YUV_IMPL_SCALAR);
+			memset(ref, 0, size);
+			convert(depths[d], formats[f], frame,
+				width, height, ref, 1);
+
+			for (i = 0; i < sizeof impls / sizeof impls[0]; i++) {
+				if (!wcap_yuv_select_impl(impls[i].impl))
+					continue;
+
+				memset(out, 0, size);
+				t = convert(depths[d], formats[f], frame,
+					    width, height, out, iterations);
+				printf("  %d %08x %-8s %8.1f Mpixels/s%s\n",
+				       depths[d], formats[f], impls[i].name,
+				       mpixels / t,
+				       memcmp(ref, out, size) ?
+				       " MISMATCH" : "");
+				if (memcmp(ref, out, size) != 0)
+					failed = 1;
+			}
+		}
+	}
+
+	free(frame);
+	free(ref);
+	free(out);
+
+	return failed;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned i;
+	int failed = 0;
+
+	for (i = 0; i < sizeof sizes / sizeof sizes[0]; i++)
+		failed |= run_size(sizes[i].width, sizes[i].height);
+
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
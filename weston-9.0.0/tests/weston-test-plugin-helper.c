@@ -0,0 +1,121 @@
+/*
+ * Copyright © 2026 The Annland Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <libweston/libweston.h>
+#include <libweston/windowed-output-api.h>
+#include "weston-test-plugin-helper.h"
+
+/** Create and enable an output on the headless backend
+ *
+ * \param compositor The compositor of the plugin test.
+ * \param width The output width in pixels.
+ * \param height The output height in pixels.
+ * \return The new output, placed right of the existing ones.
+ *
+ * Every call creates a new head with a unique name.
+ */
+struct weston_output *
+create_test_output(struct weston_compositor *compositor,
+		   int width, int height)
+{
+	static int head_count;
+	const struct weston_windowed_output_api *api;
+	struct weston_output *output;
+	struct weston_head *head = NULL;
+	char name[32];
+
+	api = weston_windowed_output_get_api(compositor);
+	assert(api);
+
+	snprintf(name, sizeof name, "test-output-%d", head_count++);
+	assert(api->create_head(compositor, name) == 0);
+
+	while ((head = weston_compositor_iterate_heads(compositor, head)))
+		if (strcmp(weston_head_get_name(head), name) == 0)
+			break;
+	assert(head);
+
+	output = weston_compositor_create_output_with_head(compositor, head);
+	assert(output);
+	weston_output_set_scale(output, 1);
+	weston_output_set_transform(output, WL_OUTPUT_TRANSFORM_NORMAL);
+	assert(api->output_set_size(output, width, height) == 0);
+	assert(weston_output_enable(output) == 0);
+
+	return output;
+}
+
+/** Create a mapped view without a client
+ *
+ * \param compositor The compositor of the plugin test.
+ * \param layer The layer to put the view on top of.
+ * \param x The view position in global coordinates.
+ * \param y The view position in global coordinates.
+ * \param width The surface width.
+ * \param height The surface height.
+ * \return The new view. Destroy it with weston_surface_destroy() on
+ * its surface.
+ *
+ * The surface has no buffer and an empty opaque region.
+ */
+struct weston_view *
+create_test_view(struct weston_compositor *compositor,
+		 struct weston_layer *layer,
+		 int x, int y, int width, int height)
+{
+	struct weston_surface *surface;
+	struct weston_view *view;
+
+	surface = weston_surface_create(compositor);
+	assert(surface);
+	view = weston_view_create(surface);
+	assert(view);
+
+	weston_surface_set_size(surface, width, height);
+	surface->is_mapped = true;
+	view->is_mapped = true;
+	weston_view_set_position(view, x, y);
+	weston_layer_entry_insert(&layer->view_list, &view->layer_link);
+
+	return view;
+}
+
+/** Make the whole surface of a test view opaque */
+void
+test_view_set_opaque(struct weston_view *view)
+{
+	struct weston_surface *surface = view->surface;
+
+	pixman_region32_fini(&surface->opaque);
+	pixman_region32_init_rect(&surface->opaque, 0, 0,
+				  surface->width, surface->height);
+	weston_view_geometry_dirty(view);
+}
@@ -0,0 +1,48 @@
+/*
+ * Copyright © 2026 The Annland Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef WESTON_TEST_PLUGIN_HELPER_H
+#define WESTON_TEST_PLUGIN_HELPER_H
+
+#include "config.h"
+
+struct weston_compositor;
+struct weston_layer;
+struct weston_output;
+struct weston_view;
+
+struct weston_output *
+create_test_output(struct weston_compositor *compositor,
+		   int width, int height);
+
+struct weston_view *
+create_test_view(struct weston_compositor *compositor,
+		 struct weston_layer *layer,
+		 int x, int y, int width, int height);
+
+void
+test_view_set_opaque(struct weston_view *view);
+
+#endif /* WESTON_TEST_PLUGIN_HELPER_H */
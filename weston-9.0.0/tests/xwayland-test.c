@@ -29,18 +29,36 @@
  *		  1) Confirm that the WL_SURFACE_ID atom exists
  *		  2) Confirm that the window manager's name is "Weston WM"
  *		  3) Make sure we can map a window
+ *
+ *		  xwayland_clipboard_bench copies a large CLIPBOARD selection
+ *		  from one X client to another, through the Weston clipboard,
+ *		  and reports the throughput.
+ *
+ *		  xwayland_decoration_repaint checks that the frame drawn
+ *		  by the window manager follows title and activation
+ *		  changes, and that a cached decoration comes back intact.
+ *
+ *		  xwayland_map_bench creates and maps bursts of decorated
+ *		  windows and reports how long the window manager takes.
  */
 
 #include "config.h"
 
 #include <unistd.h>
 #include <assert.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <time.h>
 #include <X11/Xlib.h>
 #include <X11/Xatom.h>
+#include <X11/Xutil.h>
 #include <string.h>
 
+#include "shared/helpers.h"
+#include "shared/timespec-util.h"
 #include "weston-test-runner.h"
 #include "weston-test-fixture-compositor.h"
 
@@ -117,3 +135,554 @@ TEST(xwayland_client_test)
 
 	XCloseDisplay(display);
 }
+
+#define CLIPBOARD_BENCH_SIZE (32 * 1024 * 1024)
+
+struct clipboard_bench {
+	Display *owner;
+	Window owner_window;
+	Display *requestor;
+	Window requestor_window;
+
+	Atom clipboard, targets, utf8_string, incr, property;
+
+	/* Owner side: the INCR transfer to the Xwayland WM. */
+	Window incr_window;
+	Atom incr_property;
+	size_t chunk_size;
+	size_t sent;
+	bool end_sent;
+	bool owner_done;
+	bool released;
+	struct timespec owner_end;
+
+	/* Requestor side: the INCR transfer from the Xwayland WM. */
+	bool requested;
+	bool receiving_incr;
+	size_t received;
+	bool done;
+	struct timespec end;
+};
+
+static uint8_t
+bench_byte(size_t i)
+{
+	return (i * 7 + (i >> 12)) & 0xff;
+}
+
+static void
+bench_send_chunk(struct clipboard_bench *b)
+{
+	size_t len = MIN(b->chunk_size, CLIPBOARD_BENCH_SIZE - b->sent);
+	unsigned char *data;
+	size_t i;
+
+	data = malloc(len + 1);
+	assert(data);
+	for (i = 0; i < len; i++)
+		data[i] = bench_byte(b->sent + i);
+
+	XChangeProperty(b->owner, b->incr_window, b->incr_property,
+			b->utf8_string, 8, PropModeReplace, data, len);
+	free(data);
+
+	b->sent += len;
+	if (len == 0)
+		b->end_sent = true;
+}
+
+static void
+bench_handle_owner_event(struct clipboard_bench *b, XEvent *event)
+{
+	XSelectionRequestEvent *req = &event->xselectionrequest;
+	XSelectionEvent notify = { 0 };
+	Atom targets[2] = { b->targets, b->utf8_string };
+	long size = CLIPBOARD_BENCH_SIZE;
+
+	switch (event->type) {
+	case SelectionRequest:
+		notify.type = SelectionNotify;
+		notify.requestor = req->requestor;
+		notify.selection = req->selection;
+		notify.target = req->target;
+		notify.property = req->property;
+		notify.time = req->time;
+
+		if (req->target == b->targets) {
+			XChangeProperty(b->owner, req->requestor,
+					req->property, XA_ATOM, 32,
+					PropModeReplace,
+					(unsigned char *) targets, 2);
+		} else if (req->target == b->utf8_string) {
+			/* Announce INCR, wait for the property delete. */
+			b->incr_window = req->requestor;
+			b->incr_property = req->property;
+			XSelectInput(b->owner, req->requestor,
+				     PropertyChangeMask);
+			XChangeProperty(b->owner, req->requestor,
+					req->property, b->incr, 32,
+					PropModeReplace,
+					(unsigned char *) &size, 1);
+		} else {
+			notify.property = None;
+		}
+
+		XSendEvent(b->owner, req->requestor, False, 0,
+			   (XEvent *) &notify);
+		XFlush(b->owner);
+		break;
+	case PropertyNotify:
+		if (event->xproperty.window != b->incr_window ||
+		    event->xproperty.atom != b->incr_property ||
+		    event->xproperty.state != PropertyDelete)
+			break;
+
+		if (b->end_sent) {
+			clock_gettime(CLOCK_MONOTONIC, &b->owner_end);
+			b->owner_done = true;
+			b->incr_window = None;
+		} else {
+			bench_send_chunk(b);
+		}
+		XFlush(b->owner);
+		break;
+	case SelectionClear:
+		/* The WM took over; keep serving the transfer. */
+		break;
+	}
+}
+
+static void
+bench_read_property(struct clipboard_bench *b)
+{
+	unsigned char *data;
+	unsigned long nitems, bytes, i;
+	Atom type;
+	int format, status;
+
+	status = XGetWindowProperty(b->requestor, b->requestor_window,
+				    b->property, 0L, ~0L, True,
+				    AnyPropertyType, &type, &format,
+				    &nitems, &bytes, &data);
+	assert(status == Success);
+	assert(bytes == 0);
+
+	if (type == b->incr) {
+		b->receiving_incr = true;
+	} else if (nitems == 0) {
+		clock_gettime(CLOCK_MONOTONIC, &b->end);
+		b->done = true;
+	} else {
+		assert(type == b->utf8_string);
+		assert(format == 8);
+		assert(b->received + nitems <= CLIPBOARD_BENCH_SIZE);
+		for (i = 0; i < nitems; i++)
+			assert(data[i] == bench_byte(b->received + i));
+		b->received += nitems;
+
+		if (!b->receiving_incr) {
+			clock_gettime(CLOCK_MONOTONIC, &b->end);
+			b->done = true;
+		}
+	}
+
+	XFree(data);
+}
+
+static void
+bench_handle_requestor_event(struct clipboard_bench *b, XEvent *event)
+{
+	switch (event->type) {
+	case SelectionNotify:
+		assert(event->xselection.property == b->property);
+		bench_read_property(b);
+		break;
+	case PropertyNotify:
+		if (b->receiving_incr &&
+		    event->xproperty.atom == b->property &&
+		    event->xproperty.state == PropertyNewValue)
+			bench_read_property(b);
+		break;
+	}
+}
+
+static Window
+bench_create_window(Display *display)
+{
+	int screen = DefaultScreen(display);
+
+	return XCreateSimpleWindow(display, RootWindow(display, screen),
+				   0, 0, 1, 1, 0,
+				   BlackPixel(display, screen),
+				   WhitePixel(display, screen));
+}
+
+/* Not only a correctness test: reports how fast a selection crosses the
+ * Xwayland WM in both directions. */
+TEST(xwayland_clipboard_bench)
+{
+	struct clipboard_bench b = { 0 };
+	struct pollfd fds[2];
+	struct timespec begin;
+	XEvent event;
+	Window owner;
+	long max_request;
+	int64_t usec;
+
+	if (access(XSERVER_PATH, X_OK) != 0)
+		exit(77);
+
+	b.owner = XOpenDisplay(NULL);
+	b.requestor = XOpenDisplay(NULL);
+	if (!b.owner || !b.requestor)
+		exit(EXIT_FAILURE);
+
+	b.clipboard = XInternAtom(b.owner, "CLIPBOARD", False);
+	b.targets = XInternAtom(b.owner, "TARGETS", False);
+	b.utf8_string = XInternAtom(b.owner, "UTF8_STRING", False);
+	b.incr = XInternAtom(b.owner, "INCR", False);
+	b.property = XInternAtom(b.owner, "BENCH_SELECTION", False);
+
+	/* Chunks the size a toolkit would use. */
+	max_request = XExtendedMaxRequestSize(b.owner);
+	if (max_request == 0)
+		max_request = XMaxRequestSize(b.owner);
+	b.chunk_size = MIN((size_t) max_request * 4 - 64, 1024 * 1024);
+
+	b.owner_window = bench_create_window(b.owner);
+	b.requestor_window = bench_create_window(b.requestor);
+	XSelectInput(b.requestor, b.requestor_window, PropertyChangeMask);
+	XSync(b.requestor, False);
+
+	alarm(60);
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	XSetSelectionOwner(b.owner, b.clipboard, b.owner_window, CurrentTime);
+	XFlush(b.owner);
+
+	fds[0].fd = ConnectionNumber(b.owner);
+	fds[0].events = POLLIN;
+	fds[1].fd = ConnectionNumber(b.requestor);
+	fds[1].events = POLLIN;
+
+	while (!b.done) {
+		while (XPending(b.owner)) {
+			XNextEvent(b.owner, &event);
+			bench_handle_owner_event(&b, &event);
+		}
+		while (XPending(b.requestor)) {
+			XNextEvent(b.requestor, &event);
+			bench_handle_requestor_event(&b, &event);
+		}
+
+		/* The Weston clipboard keeps its copy when the X11
+		 * selection goes away, and offers it back to X11. */
+		if (b.owner_done && !b.released) {
+			XSetSelectionOwner(b.owner, b.clipboard, None,
+					   CurrentTime);
+			XFlush(b.owner);
+			b.released = true;
+		}
+
+		/* Paste once the WM owns the selection on behalf of the
+		 * Weston clipboard; its copy may still be in progress. */
+		if (b.released && !b.requested) {
+			owner = XGetSelectionOwner(b.requestor, b.clipboard);
+			if (owner != None && owner != b.owner_window) {
+				XConvertSelection(b.requestor, b.clipboard,
+						  b.utf8_string, b.property,
+						  b.requestor_window,
+						  CurrentTime);
+				XFlush(b.requestor);
+				b.requested = true;
+			}
+		}
+
+		poll(fds, ARRAY_LENGTH(fds), b.released && !b.requested ? 10 : -1);
+	}
+	alarm(0);
+
+	assert(b.owner_done);
+	assert(b.sent == CLIPBOARD_BENCH_SIZE);
+	assert(b.received == CLIPBOARD_BENCH_SIZE);
+
+	usec = timespec_sub_to_nsec(&b.owner_end, &begin) / 1000;
+	testlog("X11 to Wayland: %d bytes in %.1f ms, %.1f MB/s\n",
+		CLIPBOARD_BENCH_SIZE, usec / 1000.0,
+		(double) CLIPBOARD_BENCH_SIZE / usec);
+	usec = timespec_sub_to_nsec(&b.end, &begin) / 1000;
+	testlog("X11 to X11 via Wayland: %d bytes in %.1f ms, %.1f MB/s\n",
+		CLIPBOARD_BENCH_SIZE, usec / 1000.0,
+		(double) CLIPBOARD_BENCH_SIZE / usec);
+
+	XCloseDisplay(b.requestor);
+	XCloseDisplay(b.owner);
+}
+
+static Window
+window_parent(Display *display, Window window)
+{
+	Window root, parent, *children;
+	unsigned int n_children;
+
+	assert(XQueryTree(display, window, &root, &parent,
+			  &children, &n_children));
+	if (children)
+		XFree(children);
+
+	return parent;
+}
+
+/* The window manager maps the client and then its frame. */
+static void
+wait_for_map(Display *display, Window window)
+{
+	XWindowAttributes attr;
+	XEvent event;
+
+	do
+		XWindowEvent(display, window, StructureNotifyMask, &event);
+	while (event.type != MapNotify);
+
+	while (1) {
+		assert(XGetWindowAttributes(display, window, &attr));
+		if (attr.map_state == IsViewable)
+			break;
+		usleep(10000);
+	}
+}
+
+/* The part of the frame above the client: shadow and title bar. */
+static XImage *
+read_decoration(Display *display, Window window)
+{
+	XWindowAttributes frame_attr, attr;
+	Window frame;
+	XImage *image;
+
+	frame = window_parent(display, window);
+	assert(frame != DefaultRootWindow(display));
+
+	assert(XGetWindowAttributes(display, frame, &frame_attr));
+	assert(XGetWindowAttributes(display, window, &attr));
+	assert(attr.y > 0);
+
+	image = XGetImage(display, frame, 0, 0, frame_attr.width, attr.y,
+			  AllPlanes, ZPixmap);
+	assert(image);
+
+	return image;
+}
+
+static bool
+image_equal(XImage *a, XImage *b)
+{
+	return a->width == b->width && a->height == b->height &&
+	       a->bytes_per_line == b->bytes_per_line &&
+	       memcmp(a->data, b->data, a->bytes_per_line * a->height) == 0;
+}
+
+static bool
+image_uniform(XImage *image)
+{
+	unsigned long pixel = XGetPixel(image, 0, 0);
+	int x, y;
+
+	for (y = 0; y < image->height; y++)
+		for (x = 0; x < image->width; x++)
+			if (XGetPixel(image, x, y) != pixel)
+				return false;
+
+	return true;
+}
+
+/* Waits for the window manager to have drawn the frame and then left it
+ * alone for a while. */
+static XImage *
+wait_for_stable_decoration(Display *display, Window window)
+{
+	XImage *prev, *image;
+
+	prev = read_decoration(display, window);
+	while (1) {
+		usleep(100000);
+		image = read_decoration(display, window);
+		if (image_equal(prev, image) && !image_uniform(image))
+			break;
+		XDestroyImage(prev);
+		prev = image;
+	}
+	XDestroyImage(prev);
+
+	return image;
+}
+
+static XImage *
+wait_for_decoration_change(Display *display, Window window, XImage *old)
+{
+	XImage *image;
+
+	while (1) {
+		image = read_decoration(display, window);
+		if (!image_equal(old, image))
+			break;
+		XDestroyImage(image);
+		usleep(20000);
+	}
+	XDestroyImage(old);
+
+	return wait_for_stable_decoration(display, window);
+}
+
+TEST(xwayland_decoration_repaint)
+{
+	Display *display;
+	Window root, window, other;
+	XImage *first, *image;
+	int screen;
+
+	if (access(XSERVER_PATH, X_OK) != 0)
+		exit(77);
+
+	display = XOpenDisplay(NULL);
+	if (!display)
+		exit(EXIT_FAILURE);
+
+	screen = DefaultScreen(display);
+	root = RootWindow(display, screen);
+
+	/* A stale decoration never changes, so this would hang instead. */
+	alarm(20);
+
+	window = XCreateSimpleWindow(display, root, 100, 100, 200, 150, 0,
+				     BlackPixel(display, screen),
+				     WhitePixel(display, screen));
+	XStoreName(display, window, "decoration one");
+	XSelectInput(display, window, StructureNotifyMask);
+	XMapWindow(display, window);
+	wait_for_map(display, window);
+	first = wait_for_stable_decoration(display, window);
+
+	/* Title change. */
+	XStoreName(display, window, "decoration two");
+	XFlush(display);
+	image = XSubImage(first, 0, 0, first->width, first->height);
+	image = wait_for_decoration_change(display, window, image);
+	testlog("repainted after a title change\n");
+
+	/* Back to the first title: the same frame as before. */
+	XStoreName(display, window, "decoration one");
+	XFlush(display);
+	image = wait_for_decoration_change(display, window, image);
+	assert(image_equal(first, image));
+	testlog("repainted after restoring the title\n");
+
+	/* Activation change: a new window takes the focus. */
+	other = XCreateSimpleWindow(display, root, 150, 150, 200, 150, 0,
+				    BlackPixel(display, screen),
+				    WhitePixel(display, screen));
+	XStoreName(display, other, "decoration other");
+	XSelectInput(display, other, StructureNotifyMask);
+	XMapWindow(display, other);
+	wait_for_map(display, other);
+	image = wait_for_decoration_change(display, window, image);
+	assert(!image_equal(first, image));
+	testlog("repainted after an activation change\n");
+
+	alarm(0);
+
+	XDestroyImage(image);
+	XDestroyImage(first);
+	XDestroyWindow(display, other);
+	XDestroyWindow(display, window);
+	XCloseDisplay(display);
+}
+
+static void
+run_map_bench(Display *display, int n_windows, bool same_title)
+{
+	Window root, *windows;
+	XEvent event;
+	struct timespec begin, end;
+	char title[64];
+	int64_t usec;
+	int screen, mapped, i;
+
+	screen = DefaultScreen(display);
+	root = RootWindow(display, screen);
+
+	windows = calloc(n_windows, sizeof *windows);
+	assert(windows);
+
+	/* Alike windows, as a session restore would bring up, or all
+	 * with their own title, so that no decoration is shared. Each is
+	 * mapped right after its creation: the window manager sees both in
+	 * the same burst of events. */
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (i = 0; i < n_windows; i++) {
+		windows[i] = XCreateSimpleWindow(display, root,
+						 (i % 16) * 40, (i / 16) * 30,
+						 320, 240, 0,
+						 BlackPixel(display, screen),
+						 WhitePixel(display, screen));
+		if (same_title)
+			snprintf(title, sizeof title, "xwayland-map-bench");
+		else
+			snprintf(title, sizeof title,
+				 "xwayland-map-bench %d", i);
+		XStoreName(display, windows[i], title);
+		XSelectInput(display, windows[i], StructureNotifyMask);
+		XMapWindow(display, windows[i]);
+	}
+	XFlush(display);
+
+	/* The window manager maps each window in response. */
+	mapped = 0;
+	while (mapped < n_windows) {
+		XNextEvent(display, &event);
+		if (event.type == MapNotify &&
+		    event.xmap.event == event.xmap.window)
+			mapped++;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	/* Every window got a frame. */
+	for (i = 0; i < n_windows; i++)
+		assert(window_parent(display, windows[i]) != root);
+
+	usec = timespec_sub_to_nsec(&end, &begin) / 1000;
+	testlog("%4d windows, %s titles, created and mapped in %8.1f ms, "
+		"%7.1f us per window\n", n_windows,
+		same_title ? "same" : "distinct", usec / 1000.0,
+		(double) usec / n_windows);
+
+	for (i = 0; i < n_windows; i++)
+		XDestroyWindow(display, windows[i]);
+	XSync(display, False);
+
+	free(windows);
+}
+
+/* Not only a correctness test: reports the window manager cost of
+ * mapping many X11 windows at once. */
+TEST(xwayland_map_bench)
+{
+	static const int n_windows[] = { 16, 64, 256 };
+	Display *display;
+	unsigned i;
+
+	if (access(XSERVER_PATH, X_OK) != 0)
+		exit(77);
+
+	display = XOpenDisplay(NULL);
+	if (!display)
+		exit(EXIT_FAILURE);
+
+	alarm(60);
+	for (i = 0; i < ARRAY_LENGTH(n_windows); i++) {
+		run_map_bench(display, n_windows[i], true);
+		run_map_bench(display, n_windows[i], false);
+	}
+	alarm(0);
+
+	XCloseDisplay(display);
+}
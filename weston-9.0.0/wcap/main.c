@@ -28,6 +28,9 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <time.h>
 #include <sys/mman.h>
 #include <sys/mman.h>
 #include <sys/types.h>
@@ -40,6 +43,7 @@
 #include <cairo.h>
 
 #include "wcap-decode.h"
+#include "wcap-yuv.h"
 
 static void
 write_png(struct wcap_decoder *decoder, const char *filename)
@@ -55,142 +59,261 @@ write_png(struct wcap_decoder *decoder, const char *filename)
 	cairo_surface_destroy(surface);
 }
 
-static inline int
-rgb_to_yuv(uint32_t format, uint32_t p, int *u, int *v)
+/* Frames are decoded in order on the main thread, converted to YUV by a
+ * pool of worker threads and written out in order by a writer thread.
+ * Each frame goes through one slot of a ring, slot seq % n_slots. */
+
+enum yuv_slot_state {
+	YUV_SLOT_FREE,
+	YUV_SLOT_DECODED,
+	YUV_SLOT_CONVERTING,
+	YUV_SLOT_CONVERTED,
+};
+
+struct yuv_slot {
+	enum yuv_slot_state state;
+	int seq;
+	uint32_t *frame;
+	unsigned char *out;
+};
+
+struct yuv_pipeline {
+	int depth;
+	uint32_t format;
+	int width, height;
+	size_t out_size;
+
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	struct yuv_slot *slots;
+	int n_slots;
+	int queued;
+	int written;
+	bool quit;
+
+	pthread_t *workers;
+	int n_workers;
+	pthread_t writer;
+};
+
+static struct yuv_slot *
+next_decoded_slot(struct yuv_pipeline *pipeline)
 {
-	int r, g, b, y;
-
-	switch (format) {
-	case WCAP_FORMAT_XRGB8888:
-		r = (p >> 16) & 0xff;
-		g = (p >> 8) & 0xff;
-		b = (p >> 0) & 0xff;
-		break;
-	case WCAP_FORMAT_XBGR8888:
-		r = (p >> 0) & 0xff;
-		g = (p >> 8) & 0xff;
-		b = (p >> 16) & 0xff;
-		break;
-	default:
-		assert(0);
+	struct yuv_slot *slot, *best = NULL;
+	int i;
+
+	for (i = 0; i < pipeline->n_slots; i++) {
+		slot = &pipeline->slots[i];
+		if (slot->state == YUV_SLOT_DECODED &&
+		    (!best || slot->seq < best->seq))
+			best = slot;
 	}
 
-	y = (19595 * r + 38469 * g + 7472 * b) >> 16;
-	if (y > 255)
-		y = 255;
+	return best;
+}
+
+static void *
+yuv_worker_thread(void *data)
+{
+	struct yuv_pipeline *pipeline = data;
+	struct yuv_slot *slot;
+
+	pthread_mutex_lock(&pipeline->mutex);
+	while (true) {
+		slot = next_decoded_slot(pipeline);
+		if (!slot) {
+			if (pipeline->quit)
+				break;
+			pthread_cond_wait(&pipeline->cond, &pipeline->mutex);
+			continue;
+		}
 
-	*u += 46727 * (r - y);
-	*v += 36962 * (b - y);
+		slot->state = YUV_SLOT_CONVERTING;
+		pthread_mutex_unlock(&pipeline->mutex);
+
+		if (pipeline->depth == 444)
+			wcap_yuv_convert_yuv444(pipeline->format, slot->frame,
+						pipeline->width,
+						pipeline->height, slot->out);
+		else
+			wcap_yuv_convert_yv12(pipeline->format, slot->frame,
+					      pipeline->width,
+					      pipeline->height, slot->out);
+
+		pthread_mutex_lock(&pipeline->mutex);
+		slot->state = YUV_SLOT_CONVERTED;
+		pthread_cond_broadcast(&pipeline->cond);
+	}
+	pthread_mutex_unlock(&pipeline->mutex);
 
-	return y;
+	return NULL;
 }
 
-static inline
-int clamp_uv(int u)
+static void *
+yuv_writer_thread(void *data)
 {
-	int clamp = (u >> 18) + 128;
+	struct yuv_pipeline *pipeline = data;
+	struct yuv_slot *slot;
 
-	if (clamp < 0)
-		return 0;
-	else if (clamp > 255)
-		return 255;
-	else
-		return clamp;
+	pthread_mutex_lock(&pipeline->mutex);
+	while (true) {
+		slot = &pipeline->slots[pipeline->written % pipeline->n_slots];
+		if (pipeline->written == pipeline->queued && pipeline->quit)
+			break;
+		if (pipeline->written == pipeline->queued ||
+		    slot->state != YUV_SLOT_CONVERTED) {
+			pthread_cond_wait(&pipeline->cond, &pipeline->mutex);
+			continue;
+		}
+
+		pthread_mutex_unlock(&pipeline->mutex);
+
+		printf("FRAME\n");
+		fwrite(slot->out, 1, pipeline->out_size, stdout);
+
+		pthread_mutex_lock(&pipeline->mutex);
+		slot->state = YUV_SLOT_FREE;
+		pipeline->written++;
+		pthread_cond_broadcast(&pipeline->cond);
+	}
+	pthread_mutex_unlock(&pipeline->mutex);
+
+	return NULL;
 }
 
 static void
-convert_to_yv12(struct wcap_decoder *decoder, unsigned char *out)
+yuv_pipeline_destroy(struct yuv_pipeline *pipeline)
 {
-	unsigned char *y1, *y2, *u, *v;
-	uint32_t *p1, *p2, *end;
-	int i, u_accum, v_accum, stride0, stride1;
-	uint32_t format = decoder->format;
-
-	stride0 = decoder->width;
-	stride1 = decoder->width / 2;
-	for (i = 0; i < decoder->height; i += 2) {
-		y1 = out + stride0 * i;
-		y2 = y1 + stride0;
-		v = out + stride0 * decoder->height + stride1 * i / 2;
-		u = v + stride1 * decoder->height / 2;
-		p1 = decoder->frame + decoder->width * i;
-		p2 = p1 + decoder->width;
-		end = p1 + decoder->width;
-
-		while (p1 < end) {
-			u_accum = 0;
-			v_accum = 0;
-			y1[0] = rgb_to_yuv(format, p1[0], &u_accum, &v_accum);
-			y1[1] = rgb_to_yuv(format, p1[1], &u_accum, &v_accum);
-			y2[0] = rgb_to_yuv(format, p2[0], &u_accum, &v_accum);
-			y2[1] = rgb_to_yuv(format, p2[1], &u_accum, &v_accum);
-			u[0] = clamp_uv(u_accum);
-			v[0] = clamp_uv(v_accum);
-
-			y1 += 2;
-			p1 += 2;
-			y2 += 2;
-			p2 += 2;
-			u++;
-			v++;
-		}
+	int i;
+
+	for (i = 0; i < pipeline->n_slots; i++) {
+		free(pipeline->slots[i].frame);
+		free(pipeline->slots[i].out);
 	}
+	free(pipeline->slots);
+	free(pipeline->workers);
+	pthread_cond_destroy(&pipeline->cond);
+	pthread_mutex_destroy(&pipeline->mutex);
+	free(pipeline);
 }
 
-static void
-convert_to_yuv444(struct wcap_decoder *decoder, unsigned char *out)
+static struct yuv_pipeline *
+yuv_pipeline_create(struct wcap_decoder *decoder, int depth, int n_workers)
 {
+	struct yuv_pipeline *pipeline;
+	size_t frame_size;
+	int i;
+
+	pipeline = calloc(1, sizeof *pipeline);
+	if (!pipeline)
+		return NULL;
+
+	pipeline->depth = depth;
+	pipeline->format = decoder->format;
+	pipeline->width = decoder->width;
+	pipeline->height = decoder->height;
+	if (depth == 444)
+		pipeline->out_size = decoder->width * decoder->height * 3;
+	else
+		pipeline->out_size = decoder->width * decoder->height * 3 / 2;
+	frame_size = decoder->width * decoder->height * 4;
+
+	pthread_mutex_init(&pipeline->mutex, NULL);
+	pthread_cond_init(&pipeline->cond, NULL);
+
+	/* Enough slots to keep every worker busy while the oldest frame
+	 * is being written and the next one decoded. */
+	pipeline->n_slots = n_workers + 2;
+	pipeline->slots = calloc(pipeline->n_slots, sizeof *pipeline->slots);
+	pipeline->workers = calloc(n_workers, sizeof *pipeline->workers);
+	if (!pipeline->slots || !pipeline->workers)
+		goto err;
+
+	for (i = 0; i < pipeline->n_slots; i++) {
+		pipeline->slots[i].frame = malloc(frame_size);
+		pipeline->slots[i].out = malloc(pipeline->out_size);
+		if (!pipeline->slots[i].frame || !pipeline->slots[i].out)
+			goto err;
+	}
 
-	unsigned char *yp, *up, *vp;
-	uint32_t *rp, *end;
-	int u, v;
-	int i, stride, psize;
-	uint32_t format = decoder->format;
-
-	stride = decoder->width;
-	psize = stride * decoder->height;
-	for (i = 0; i < decoder->height; i++) {
-		yp = out + stride * i;
-		up = yp + (psize * 2);
-		vp = yp + (psize * 1);
-		rp = decoder->frame + decoder->width * i;
-		end = rp + decoder->width;
-		while (rp < end) {
-			u = 0;
-			v = 0;
-			yp[0] = rgb_to_yuv(format, rp[0], &u, &v);
-			up[0] = clamp_uv(u/.3);
-			vp[0] = clamp_uv(v/.3);
-			up++;
-			vp++;
-			yp++;
-			rp++;
-		}
+	for (i = 0; i < n_workers; i++) {
+		if (pthread_create(&pipeline->workers[i], NULL,
+				   yuv_worker_thread, pipeline) != 0)
+			break;
 	}
+	pipeline->n_workers = i;
+	if (pipeline->n_workers == 0 ||
+	    pthread_create(&pipeline->writer, NULL,
+			   yuv_writer_thread, pipeline) != 0) {
+		pthread_mutex_lock(&pipeline->mutex);
+		pipeline->quit = true;
+		pthread_cond_broadcast(&pipeline->cond);
+		pthread_mutex_unlock(&pipeline->mutex);
+		for (i = 0; i < pipeline->n_workers; i++)
+			pthread_join(pipeline->workers[i], NULL);
+		goto err;
+	}
+
+	return pipeline;
+
+err:
+	yuv_pipeline_destroy(pipeline);
+	return NULL;
 }
 
+/* Hands the decoder's current frame to the pipeline, waiting for a free
+ * slot if the workers or the writer are behind. */
 static void
-output_yuv_frame(struct wcap_decoder *decoder, int depth)
+yuv_pipeline_push(struct yuv_pipeline *pipeline, struct wcap_decoder *decoder)
 {
-	static unsigned char *out;
-	int size;
+	struct yuv_slot *slot;
+
+	pthread_mutex_lock(&pipeline->mutex);
+	slot = &pipeline->slots[pipeline->queued % pipeline->n_slots];
+	while (slot->state != YUV_SLOT_FREE)
+		pthread_cond_wait(&pipeline->cond, &pipeline->mutex);
+	pthread_mutex_unlock(&pipeline->mutex);
+
+	memcpy(slot->frame, decoder->frame,
+	       decoder->width * decoder->height * 4);
+
+	pthread_mutex_lock(&pipeline->mutex);
+	slot->state = YUV_SLOT_DECODED;
+	slot->seq = pipeline->queued++;
+	pthread_cond_broadcast(&pipeline->cond);
+	pthread_mutex_unlock(&pipeline->mutex);
+}
 
-	if (depth == 444) {
-		size = decoder->width * decoder->height * 3;
-	} else {
-		size = decoder->width * decoder->height * 3 / 2;
-	}
-	if (out == NULL)
-		out = malloc(size);
+/* Waits until every pushed frame is written, then tears down. */
+static void
+yuv_pipeline_finish(struct yuv_pipeline *pipeline)
+{
+	int i;
 
-	if (depth == 444) {
-		convert_to_yuv444(decoder, out);
-	} else {
-		convert_to_yv12(decoder, out);
-	}
+	pthread_mutex_lock(&pipeline->mutex);
+	pipeline->quit = true;
+	pthread_cond_broadcast(&pipeline->cond);
+	pthread_mutex_unlock(&pipeline->mutex);
+
+	for (i = 0; i < pipeline->n_workers; i++)
+		pthread_join(pipeline->workers[i], NULL);
+	pthread_join(pipeline->writer, NULL);
+
+	fflush(stdout);
+	yuv_pipeline_destroy(pipeline);
+}
+
+static int
+default_thread_count(void)
+{
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
 
-	printf("FRAME\n");
-	fwrite(out, 1, size, stdout);
+	if (n < 1)
+		return 1;
+
+	/* Beyond this the decoder, which cannot be parallelized, is the
+	 * bottleneck, and every thread costs another pair of buffers. */
+	return n > 8 ? 8 : n;
 }
 
 static void
@@ -198,14 +321,15 @@ usage(int exit_code)
 {
 	fprintf(stderr, "usage: wcap-decode "
 		"[--help] [--yuv4mpeg2] [--frame=<frame>] [--all] \n"
-		"\t[--rate=<num:denom>] <wcap file>\n\n"
+		"\t[--rate=<num:denom>] [--threads=<n>] <wcap file>\n\n"
 		"\t--help\t\t\tthis help text\n"
 		"\t--yuv4mpeg2\t\tdump wcap file to stdout in yuv4mpeg2 format\n"
 		"\t--yuv4mpeg2-444\t\tdump wcap file to stdout in yuv4mpeg2 444 format\n"
 		"\t--frame=<frame>\t\twrite out the given frame number as png\n"
 		"\t--all\t\t\twrite all frames as pngs\n"
 		"\t--rate=<num:denom>\treplay frame rate for yuv4mpeg2,\n"
-		"\t\t\t\tspecified as an integer fraction\n\n");
+		"\t\t\t\tspecified as an integer fraction\n"
+		"\t--threads=<n>\t\tnumber of yuv4mpeg2 conversion threads\n\n");
 
 	exit(exit_code);
 }
@@ -213,11 +337,14 @@ usage(int exit_code)
 int main(int argc, char *argv[])
 {
 	struct wcap_decoder *decoder;
+	struct yuv_pipeline *pipeline = NULL;
 	int i, j, output_frame = -1, yuv4mpeg2 = 0, all = 0, has_frame;
-	int num = 30, denom = 1;
+	int num = 30, denom = 1, n_threads = default_thread_count();
 	char filename[200];
 	char *mode;
 	uint32_t msecs, frame_time;
+	struct timespec begin, end;
+	double secs;
 
 	for (i = 1, j = 1; i < argc; i++) {
 		if (strcmp(argv[i], "--yuv4mpeg2-444") == 0) {
@@ -234,6 +361,8 @@ int main(int argc, char *argv[])
 			;
 		} else if (sscanf(argv[i], "--rate=%d:%d", &num, &denom) == 2) {
 			;
+		} else if (sscanf(argv[i], "--threads=%d", &n_threads) == 1) {
+			;
 		} else if (strcmp(argv[i], "--") == 0) {
 			break;
 		} else if (argv[i][0] == '-') {
@@ -252,6 +381,10 @@ int main(int argc, char *argv[])
 		fprintf(stderr, "invalid rate, denom can not be 0\n");
 		exit(EXIT_FAILURE);
 	}
+	if (n_threads < 1) {
+		fprintf(stderr, "invalid thread count, must be at least 1\n");
+		exit(EXIT_FAILURE);
+	}
 
 	decoder = wcap_decoder_create(argv[1]);
 	if (decoder == NULL) {
@@ -268,7 +401,21 @@ int main(int argc, char *argv[])
 		exit(EXIT_FAILURE);
 	}
 
+	if (yuv4mpeg2 && !wcap_yuv_format_supported(decoder->format)) {
+		fprintf(stderr, "yuv4mpeg2 output is not supported for "
+			"format 0x%08x\n", decoder->format);
+		exit(EXIT_FAILURE);
+	}
+
 	if (yuv4mpeg2) {
+		wcap_yuv_select_impl(WCAP_YUV_IMPL_AUTO);
+		pipeline = yuv_pipeline_create(decoder, yuv4mpeg2, n_threads);
+		if (!pipeline) {
+			fprintf(stderr, "Creating conversion threads failed\n");
+			exit(EXIT_FAILURE);
+		}
+		n_threads = pipeline->n_workers;
+
 		if (yuv4mpeg2 == 444) {
 			mode = "C444";
 		} else {
@@ -279,6 +426,7 @@ int main(int argc, char *argv[])
 		fflush(stdout);
 	}
 
+	clock_gettime(CLOCK_MONOTONIC, &begin);
 	i = 0;
 	has_frame = wcap_decoder_get_frame(decoder);
 	msecs = decoder->msecs;
@@ -290,17 +438,29 @@ int main(int argc, char *argv[])
 			write_png(decoder, filename);
 			fprintf(stderr, "wrote %s\n", filename);
 		}
-		if (yuv4mpeg2)
-			output_yuv_frame(decoder, yuv4mpeg2);
+		if (pipeline)
+			yuv_pipeline_push(pipeline, decoder);
 		i++;
 		msecs += frame_time;
 		while (decoder->msecs < msecs && has_frame)
 			has_frame = wcap_decoder_get_frame(decoder);
 	}
 
+	if (pipeline)
+		yuv_pipeline_finish(pipeline);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
 	fprintf(stderr, "wcap file: size %dx%d, %d frames\n",
 		decoder->width, decoder->height, i);
 
+	secs = (end.tv_sec - begin.tv_sec) +
+	       (end.tv_nsec - begin.tv_nsec) / 1e9;
+	if (yuv4mpeg2 && secs > 0)
+		fprintf(stderr, "converted in %.2f s: %.1f frames/s, "
+			"%.1fx real time (%d threads, %s)\n",
+			secs, i / secs, i / secs * denom / num,
+			n_threads, wcap_yuv_impl_name());
+
 	wcap_decoder_destroy(decoder);
 
 	return EXIT_SUCCESS;
@@ -0,0 +1,425 @@
+/*
+ * Copyright © 2026 The Annland Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define WCAP_RLE_X86 1
+#include <immintrin.h>
+#endif
+
+#include "wcap-rle.h"
+
+#define DELTA_MASK 0x00ffffff
+#define ALPHA_MASK 0xff000000
+
+/* Runs shorter than this are decoded without calling into the
+ * vectorized code. */
+#define SHORT_RUN 8
+
+struct rle_impl {
+	const char *name;
+	void (*encode_row)(struct wcap_rle_encoder *enc,
+			   const uint32_t *src, uint32_t *ref, int width);
+	void (*add_delta)(uint32_t *d, int n, uint32_t delta);
+};
+
+static const struct rle_impl *rle_impl;
+
+static inline uint32_t *
+output_run(uint32_t *p, uint32_t delta, int run)
+{
+	int i;
+
+	while (run > 0) {
+		if (run <= 0xe0) {
+			*p++ = delta | ((run - 1) << 24);
+			break;
+		}
+
+		i = 24 - __builtin_clz(run);
+		*p++ = delta | ((i + 0xe0) << 24);
+		run -= 1 << (7 + i);
+	}
+
+	return p;
+}
+
+static inline uint32_t
+component_delta(uint32_t next, uint32_t prev)
+{
+	unsigned char dr, dg, db;
+
+	dr = (next >> 16) - (prev >> 16);
+	dg = (next >>  8) - (prev >>  8);
+	db = (next >>  0) - (prev >>  0);
+
+	return (dr << 16) | (dg << 8) | (db << 0);
+}
+
+static inline uint32_t
+component_add(uint32_t prev, uint32_t delta)
+{
+	unsigned char r, g, b;
+
+	r = (prev >> 16) + (delta >> 16);
+	g = (prev >>  8) + (delta >>  8);
+	b = (prev >>  0) + (delta >>  0);
+
+	return ALPHA_MASK | (r << 16) | (g << 8) | b;
+}
+
+/* Feed one delta to the run-length coder. */
+#define ENCODE_DELTA(p, prev, run, delta) do {			\
+	if ((run) == 0 || (delta) == (prev)) {			\
+		(run)++;					\
+	} else {						\
+		(p) = output_run((p), (prev), (run));		\
+		(run) = 1;					\
+	}							\
+	(prev) = (delta);					\
+} while (0)
+
+static void
+encode_row_scalar(struct wcap_rle_encoder *enc,
+		  const uint32_t *src, uint32_t *ref, int width)
+{
+	uint32_t *p = enc->p;
+	uint32_t prev = enc->prev;
+	uint32_t delta;
+	int run = enc->run;
+	int k;
+
+	for (k = 0; k < width; k++) {
+		delta = component_delta(src[k], ref[k]);
+		ref[k] = src[k];
+		ENCODE_DELTA(p, prev, run, delta);
+	}
+
+	enc->p = p;
+	enc->prev = prev;
+	enc->run = run;
+}
+
+static void
+add_delta_scalar(uint32_t *d, int n, uint32_t delta)
+{
+	int k;
+
+	for (k = 0; k < n; k++)
+		d[k] = component_add(d[k], delta);
+}
+
+static const struct rle_impl rle_impl_scalar = {
+	"scalar", encode_row_scalar, add_delta_scalar
+};
+
+#ifdef WCAP_RLE_X86
+
+/* Four pixels at a time. When all four deltas continue the current run,
+ * which is the common case for static content, only the run length is
+ * bumped. */
+__attribute__((target("sse2")))
+static void
+encode_row_sse2(struct wcap_rle_encoder *enc,
+		const uint32_t *src, uint32_t *ref, int width)
+{
+	const __m128i mask = _mm_set1_epi32(DELTA_MASK);
+	uint32_t *p = enc->p;
+	uint32_t prev = enc->prev;
+	uint32_t delta, deltas[4];
+	int run = enc->run;
+	__m128i next, old, vdelta, same;
+	int k, i;
+
+	for (k = 0; k + 4 <= width; k += 4) {
+		next = _mm_loadu_si128((const __m128i *)(src + k));
+		old = _mm_loadu_si128((const __m128i *)(ref + k));
+		vdelta = _mm_and_si128(_mm_sub_epi8(next, old), mask);
+		_mm_storeu_si128((__m128i *)(ref + k), next);
+
+		same = _mm_cmpeq_epi32(vdelta, _mm_set1_epi32(prev));
+		if (run > 0 && _mm_movemask_epi8(same) == 0xffff) {
+			run += 4;
+			continue;
+		}
+
+		_mm_storeu_si128((__m128i *)deltas, vdelta);
+		for (i = 0; i < 4; i++)
+			ENCODE_DELTA(p, prev, run, deltas[i]);
+	}
+
+	for (; k < width; k++) {
+		delta = component_delta(src[k], ref[k]);
+		ref[k] = src[k];
+		ENCODE_DELTA(p, prev, run, delta);
+	}
+
+	enc->p = p;
+	enc->prev = prev;
+	enc->run = run;
+}
+
+__attribute__((target("sse2")))
+static void
+add_delta_sse2(uint32_t *d, int n, uint32_t delta)
+{
+	const __m128i vdelta = _mm_set1_epi32(delta);
+	const __m128i alpha = _mm_set1_epi32(ALPHA_MASK);
+	__m128i v;
+	int k;
+
+	for (k = 0; k + 4 <= n; k += 4) {
+		v = _mm_loadu_si128((const __m128i *)(d + k));
+		v = _mm_or_si128(_mm_add_epi8(v, vdelta), alpha);
+		_mm_storeu_si128((__m128i *)(d + k), v);
+	}
+
+	for (; k < n; k++)
+		d[k] = component_add(d[k], delta);
+}
+
+static const struct rle_impl rle_impl_sse2 = {
+	"sse2", encode_row_sse2, add_delta_sse2
+};
+
+__attribute__((target("avx2")))
+static void
+encode_row_avx2(struct wcap_rle_encoder *enc,
+		const uint32_t *src, uint32_t *ref, int width)
+{
+	const __m256i mask = _mm256_set1_epi32(DELTA_MASK);
+	uint32_t *p = enc->p;
+	uint32_t prev = enc->prev;
+	uint32_t delta, deltas[8];
+	int run = enc->run;
+	__m256i next, old, vdelta, same;
+	int k, i;
+
+	for (k = 0; k + 8 <= width; k += 8) {
+		next = _mm256_loadu_si256((const __m256i *)(src + k));
+		old = _mm256_loadu_si256((const __m256i *)(ref + k));
+		vdelta = _mm256_and_si256(_mm256_sub_epi8(next, old), mask);
+		_mm256_storeu_si256((__m256i *)(ref + k), next);
+
+		same = _mm256_cmpeq_epi32(vdelta, _mm256_set1_epi32(prev));
+		if (run > 0 && _mm256_movemask_epi8(same) == -1) {
+			run += 8;
+			continue;
+		}
+
+		_mm256_storeu_si256((__m256i *)deltas, vdelta);
+		for (i = 0; i < 8; i++)
+			ENCODE_DELTA(p, prev, run, deltas[i]);
+	}
+
+	for (; k < width; k++) {
+		delta = component_delta(src[k], ref[k]);
+		ref[k] = src[k];
+		ENCODE_DELTA(p, prev, run, delta);
+	}
+
+	enc->p = p;
+	enc->prev = prev;
+	enc->run = run;
+}
+
+__attribute__((target("avx2")))
+static void
+add_delta_avx2(uint32_t *d, int n, uint32_t delta)
+{
+	const __m256i vdelta = _mm256_set1_epi32(delta);
+	const __m256i alpha = _mm256_set1_epi32(ALPHA_MASK);
+	__m256i v;
+	int k;
+
+	for (k = 0; k + 8 <= n; k += 8) {
+		v = _mm256_loadu_si256((const __m256i *)(d + k));
+		v = _mm256_or_si256(_mm256_add_epi8(v, vdelta), alpha);
+		_mm256_storeu_si256((__m256i *)(d + k), v);
+	}
+
+	for (; k < n; k++)
+		d[k] = component_add(d[k], delta);
+}
+
+static const struct rle_impl rle_impl_avx2 = {
+	"avx2", encode_row_avx2, add_delta_avx2
+};
+
+#endif /* WCAP_RLE_X86 */
+
+/** Choose the implementation used by all wcap_rle_* functions
+ *
+ * \param impl The implementation, or WCAP_RLE_IMPL_AUTO for the best one
+ * the CPU supports.
+ * \return false if the CPU or the build does not support \c impl, in which
+ * case the current choice is kept.
+ *
+ * Every implementation produces the same output.
+ */
+bool
+wcap_rle_select_impl(enum wcap_rle_impl impl)
+{
+	switch (impl) {
+	case WCAP_RLE_IMPL_AUTO:
+		if (wcap_rle_select_impl(WCAP_RLE_IMPL_AVX2) ||
+		    wcap_rle_select_impl(WCAP_RLE_IMPL_SSE2))
+			return true;
+		return wcap_rle_select_impl(WCAP_RLE_IMPL_SCALAR);
+	case WCAP_RLE_IMPL_SCALAR:
+		rle_impl = &rle_impl_scalar;
+		return true;
+#ifdef WCAP_RLE_X86
+	case WCAP_RLE_IMPL_SSE2:
+		if (!__builtin_cpu_supports("sse2"))
+			return false;
+		rle_impl = &rle_impl_sse2;
+		return true;
+	case WCAP_RLE_IMPL_AVX2:
+		if (!__builtin_cpu_supports("avx2"))
+			return false;
+		rle_impl = &rle_impl_avx2;
+		return true;
+#endif
+	default:
+		return false;
+	}
+}
+
+static const struct rle_impl *
+get_impl(void)
+{
+	if (!rle_impl)
+		wcap_rle_select_impl(WCAP_RLE_IMPL_AUTO);
+
+	return rle_impl;
+}
+
+const char *
+wcap_rle_impl_name(void)
+{
+	return get_impl()->name;
+}
+
+/** Start encoding a rectangle into \c out */
+void
+wcap_rle_encode_begin(struct wcap_rle_encoder *enc, uint32_t *out)
+{
+	enc->p = out;
+	enc->prev = 0;
+	enc->run = 0;
+}
+
+/** Encode one row of a rectangle
+ *
+ * \param enc The encoder.
+ * \param src The new pixels.
+ * \param ref The previous frame's pixels at the same place, updated to
+ * \c src.
+ * \param width Number of pixels.
+ */
+void
+wcap_rle_encode_row(struct wcap_rle_encoder *enc,
+		    const uint32_t *src, uint32_t *ref, int width)
+{
+	get_impl()->encode_row(enc, src, ref, width);
+}
+
+/** Finish a rectangle, returning the end of the encoded data */
+uint32_t *
+wcap_rle_encode_end(struct wcap_rle_encoder *enc)
+{
+	enc->p = output_run(enc->p, enc->prev, enc->run);
+	enc->run = 0;
+
+	return enc->p;
+}
+
+/** Apply one encoded rectangle to a frame
+ *
+ * \param p The encoded data.
+ * \param frame The frame, updated in place.
+ * \param stride Frame stride in pixels.
+ * \param rect The rectangle; rows are coded bottom-up.
+ * \param n_pixels Set to the number of pixels the data encodes, which
+ * should match the rectangle size. Excess pixels are not written.
+ * \return The end of the rectangle's encoded data.
+ */
+const uint32_t *
+wcap_rle_decode_rect(const uint32_t *p, uint32_t *frame, int stride,
+		     const struct wcap_rectangle *rect, int *n_pixels)
+{
+	const struct rle_impl *impl = get_impl();
+	int width = rect->x2 - rect->x1, height = rect->y2 - rect->y1;
+	int count = width * height;
+	int i, j, l, k, n, left, x;
+	uint32_t v, delta, *d;
+
+	d = frame + (rect->y2 - 1) * stride;
+	x = rect->x1;
+	i = 0;
+	while (i < count) {
+		v = *p++;
+		l = v >> 24;
+		if (l < 0xe0)
+			j = l + 1;
+		else
+			j = 1 << (l - 0xe0 + 7);
+
+		delta = v & DELTA_MASK;
+		left = j < count - i ? j : count - i;
+		i += j;
+
+		while (left > 0) {
+			n = rect->x2 - x;
+			if (n > left)
+				n = left;
+
+			if (n < SHORT_RUN) {
+				for (k = 0; k < n; k++)
+					d[x + k] = component_add(d[x + k],
+								 delta);
+			} else {
+				impl->add_delta(d + x, n, delta);
+			}
+
+			x += n;
+			left -= n;
+			if (x == rect->x2) {
+				x = rect->x1;
+				d -= stride;
+			}
+		}
+	}
+
+	*n_pixels = i;
+
+	return p;
+}
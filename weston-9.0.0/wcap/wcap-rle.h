@@ -0,0 +1,77 @@
+/*
+ * Copyright © 2026 The Annland Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _WCAP_RLE_
+#define _WCAP_RLE_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "wcap-decode.h"
+
+/*
+ * The run-length delta coding of wcap rectangles, shared by the recorder
+ * in libweston and the decoder. Each 32-bit word holds the per-channel
+ * difference to the previous frame in its low 24 bits and a run length
+ * code in the top 8 bits; see README.
+ *
+ * Vectorized implementations are picked at runtime when the CPU has them.
+ */
+
+enum wcap_rle_impl {
+	WCAP_RLE_IMPL_AUTO = 0,
+	WCAP_RLE_IMPL_SCALAR,
+	WCAP_RLE_IMPL_SSE2,
+	WCAP_RLE_IMPL_AVX2,
+};
+
+/* Runs may continue from one row of a rectangle to the next. */
+struct wcap_rle_encoder {
+	uint32_t *p;
+	uint32_t prev;
+	int run;
+};
+
+bool
+wcap_rle_select_impl(enum wcap_rle_impl impl);
+
+const char *
+wcap_rle_impl_name(void);
+
+void
+wcap_rle_encode_begin(struct wcap_rle_encoder *enc, uint32_t *out);
+
+void
+wcap_rle_encode_row(struct wcap_rle_encoder *enc,
+		    const uint32_t *src, uint32_t *ref, int width);
+
+uint32_t *
+wcap_rle_encode_end(struct wcap_rle_encoder *enc);
+
+const uint32_t *
+wcap_rle_decode_rect(const uint32_t *p, uint32_t *frame, int stride,
+		     const struct wcap_rectangle *rect, int *n_pixels);
+
+#endif
@@ -0,0 +1,544 @@
+/*
+ * Copyright © 2026 The Annland Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define WCAP_YUV_X86 1
+#include <immintrin.h>
+#endif
+
+#include "wcap-decode.h"
+#include "wcap-yuv.h"
+
+/* BT.601 full range luma weights in 16.16 fixed point. They add up to
+ * 1 << 16, so luma never exceeds 255. */
+#define Y_R 19595
+#define Y_G 38469
+#define Y_B 7472
+
+/* Chroma scales applied to r - y and b - y, before the final >> 18. */
+#define U_SCALE 46727
+#define V_SCALE 36962
+
+/* Position of the red and blue channels in a pixel; green is always in the
+ * second byte. */
+struct yuv_format {
+	uint32_t format;
+	int r_shift, b_shift;
+};
+
+static const struct yuv_format yuv_formats[] = {
+	{ WCAP_FORMAT_XRGB8888, 16, 0 },
+	{ WCAP_FORMAT_XBGR8888, 0, 16 },
+};
+
+struct yuv_impl {
+	const char *name;
+	void (*rows_yv12)(const struct yuv_format *f,
+			  const uint32_t *p1, const uint32_t *p2,
+			  unsigned char *y1, unsigned char *y2,
+			  unsigned char *u, unsigned char *v, int width);
+	void (*row_yuv444)(const struct yuv_format *f, const uint32_t *p,
+			   unsigned char *y, unsigned char *u, unsigned char *v,
+			   int width);
+};
+
+static const struct yuv_impl *yuv_impl;
+
+/* Chroma of a 4:4:4 pixel only depends on r - y or b - y, so the
+ * vectorized code looks it up here. */
+static unsigned char u444[511], v444[511];
+static bool chroma444_ready;
+
+static inline int
+rgb_to_yuv(const struct yuv_format *f, uint32_t p, int *u, int *v)
+{
+	int r, g, b, y;
+
+	r = (p >> f->r_shift) & 0xff;
+	g = (p >> 8) & 0xff;
+	b = (p >> f->b_shift) & 0xff;
+
+	y = (Y_R * r + Y_G * g + Y_B * b) >> 16;
+	if (y > 255)
+		y = 255;
+
+	*u += U_SCALE * (r - y);
+	*v += V_SCALE * (b - y);
+
+	return y;
+}
+
+static inline int
+clamp_uv(int u)
+{
+	int clamp = (u >> 18) + 128;
+
+	if (clamp < 0)
+		return 0;
+	else if (clamp > 255)
+		return 255;
+	else
+		return clamp;
+}
+
+static void
+rows_yv12_scalar(const struct yuv_format *f,
+		 const uint32_t *p1, const uint32_t *p2,
+		 unsigned char *y1, unsigned char *y2,
+		 unsigned char *u, unsigned char *v, int width)
+{
+	int u_accum, v_accum, k;
+
+	for (k = 0; k + 2 <= width; k += 2) {
+		u_accum = 0;
+		v_accum = 0;
+		y1[k] = rgb_to_yuv(f, p1[k], &u_accum, &v_accum);
+		y1[k + 1] = rgb_to_yuv(f, p1[k + 1], &u_accum, &v_accum);
+		y2[k] = rgb_to_yuv(f, p2[k], &u_accum, &v_accum);
+		y2[k + 1] = rgb_to_yuv(f, p2[k + 1], &u_accum, &v_accum);
+		u[k / 2] = clamp_uv(u_accum);
+		v[k / 2] = clamp_uv(v_accum);
+	}
+}
+
+static void
+row_yuv444_scalar(const struct yuv_format *f, const uint32_t *p,
+		  unsigned char *y, unsigned char *u, unsigned char *v,
+		  int width)
+{
+	int u_accum, v_accum, k;
+
+	for (k = 0; k < width; k++) {
+		u_accum = 0;
+		v_accum = 0;
+		y[k] = rgb_to_yuv(f, p[k], &u_accum, &v_accum);
+		u[k] = clamp_uv(u_accum / .3);
+		v[k] = clamp_uv(v_accum / .3);
+	}
+}
+
+static const struct yuv_impl yuv_impl_scalar = {
+	"scalar", rows_yv12_scalar, row_yuv444_scalar
+};
+
+#ifdef WCAP_YUV_X86
+
+/* The luma sum is computed with pmaddwd: red and blue sit in the low
+ * halves of the two 16-bit words of (p & 0x00ff00ff), and green is
+ * multiplied by Y_G - 65536, which fits in an int16, and then has its
+ * missing g << 16 added back. */
+#define RB_WEIGHTS(f) \
+	((f)->r_shift ? (Y_R << 16) | Y_B : (Y_B << 16) | Y_R)
+
+/* scale * s as the pmaddwd of (s, s) with two weights that fit in
+ * int16. */
+#define SPLIT_SCALE(scale) ((((scale) - (scale) / 2) << 16) | ((scale) / 2))
+
+__attribute__((target("sse2")))
+static inline void
+pixels_sse2(const struct yuv_format *f, const uint32_t *p,
+	    __m128i *y, __m128i *dr, __m128i *db)
+{
+	const __m128i byte = _mm_set1_epi32(0xff);
+	__m128i v, rb, g, r, b, sum;
+
+	v = _mm_loadu_si128((const __m128i *)p);
+	rb = _mm_and_si128(v, _mm_set1_epi32(0x00ff00ff));
+	g = _mm_and_si128(_mm_srli_epi32(v, 8), byte);
+
+	sum = _mm_madd_epi16(rb, _mm_set1_epi32(RB_WEIGHTS(f)));
+	sum = _mm_add_epi32(sum, _mm_madd_epi16(g, _mm_set1_epi32(Y_G)));
+	sum = _mm_add_epi32(sum, _mm_slli_epi32(g, 16));
+	*y = _mm_srli_epi32(sum, 16);
+
+	r = _mm_and_si128(_mm_srl_epi32(v, _mm_cvtsi32_si128(f->r_shift)),
+			  byte);
+	b = _mm_and_si128(_mm_srl_epi32(v, _mm_cvtsi32_si128(f->b_shift)),
+			  byte);
+	*dr = _mm_sub_epi32(r, *y);
+	*db = _mm_sub_epi32(b, *y);
+}
+
+/* Four chroma samples from four sums of 2x2 differences. */
+__attribute__((target("sse2")))
+static inline uint32_t
+chroma420_sse2(__m128i s, int scale)
+{
+	__m128i c;
+
+	s = _mm_or_si128(_mm_and_si128(s, _mm_set1_epi32(0xffff)),
+			 _mm_slli_epi32(s, 16));
+	c = _mm_madd_epi16(s, _mm_set1_epi32(SPLIT_SCALE(scale)));
+	c = _mm_add_epi32(_mm_srai_epi32(c, 18), _mm_set1_epi32(128));
+	c = _mm_packs_epi32(c, c);
+
+	return _mm_cvtsi128_si32(_mm_packus_epi16(c, c));
+}
+
+__attribute__((target("sse2")))
+static void
+rows_yv12_sse2(const struct yuv_format *f,
+	       const uint32_t *p1, const uint32_t *p2,
+	       unsigned char *y1, unsigned char *y2,
+	       unsigned char *u, unsigned char *v, int width)
+{
+	const __m128i ones = _mm_set1_epi16(1);
+	__m128i ya, yb, ra, rb, ba, bb, dr, db;
+	uint32_t c;
+	int k;
+
+	for (k = 0; k + 8 <= width; k += 8) {
+		pixels_sse2(f, p1 + k, &ya, &ra, &ba);
+		pixels_sse2(f, p1 + k + 4, &yb, &rb, &bb);
+		ya = _mm_packs_epi32(ya, yb);
+		_mm_storel_epi64((__m128i *)(y1 + k),
+				 _mm_packus_epi16(ya, ya));
+		dr = _mm_packs_epi32(ra, rb);
+		db = _mm_packs_epi32(ba, bb);
+
+		pixels_sse2(f, p2 + k, &ya, &ra, &ba);
+		pixels_sse2(f, p2 + k + 4, &yb, &rb, &bb);
+		ya = _mm_packs_epi32(ya, yb);
+		_mm_storel_epi64((__m128i *)(y2 + k),
+				 _mm_packus_epi16(ya, ya));
+		dr = _mm_add_epi16(dr, _mm_packs_epi32(ra, rb));
+		db = _mm_add_epi16(db, _mm_packs_epi32(ba, bb));
+
+		c = chroma420_sse2(_mm_madd_epi16(dr, ones), U_SCALE);
+		memcpy(u + k / 2, &c, sizeof c);
+		c = chroma420_sse2(_mm_madd_epi16(db, ones), V_SCALE);
+		memcpy(v + k / 2, &c, sizeof c);
+	}
+
+	rows_yv12_scalar(f, p1 + k, p2 + k, y1 + k, y2 + k,
+			 u + k / 2, v + k / 2, width - k);
+}
+
+__attribute__((target("sse2")))
+static void
+row_yuv444_sse2(const struct yuv_format *f, const uint32_t *p,
+		unsigned char *y, unsigned char *u, unsigned char *v,
+		int width)
+{
+	int16_t dr[8], db[8];
+	__m128i ya, yb, ra, rb, ba, bb;
+	int k, i;
+
+	for (k = 0; k + 8 <= width; k += 8) {
+		pixels_sse2(f, p + k, &ya, &ra, &ba);
+		pixels_sse2(f, p + k + 4, &yb, &rb, &bb);
+		ya = _mm_packs_epi32(ya, yb);
+		_mm_storel_epi64((__m128i *)(y + k),
+				 _mm_packus_epi16(ya, ya));
+		_mm_storeu_si128((__m128i *)dr, _mm_packs_epi32(ra, rb));
+		_mm_storeu_si128((__m128i *)db, _mm_packs_epi32(ba, bb));
+
+		for (i = 0; i < 8; i++) {
+			u[k + i] = u444[dr[i] + 255];
+			v[k + i] = v444[db[i] + 255];
+		}
+	}
+
+	row_yuv444_scalar(f, p + k, y + k, u + k, v + k, width - k);
+}
+
+static const struct yuv_impl yuv_impl_sse2 = {
+	"sse2", rows_yv12_sse2, row_yuv444_sse2
+};
+
+__attribute__((target("avx2")))
+static inline void
+pixels_avx2(const struct yuv_format *f, const uint32_t *p,
+	    __m256i *y, __m256i *dr, __m256i *db)
+{
+	const __m256i byte = _mm256_set1_epi32(0xff);
+	__m256i v, rb, g, r, b, sum;
+
+	v = _mm256_loadu_si256((const __m256i *)p);
+	rb = _mm256_and_si256(v, _mm256_set1_epi32(0x00ff00ff));
+	g = _mm256_and_si256(_mm256_srli_epi32(v, 8), byte);
+
+	sum = _mm256_madd_epi16(rb, _mm256_set1_epi32(RB_WEIGHTS(f)));
+	sum = _mm256_add_epi32(sum,
+			       _mm256_madd_epi16(g, _mm256_set1_epi32(Y_G)));
+	sum = _mm256_add_epi32(sum, _mm256_slli_epi32(g, 16));
+	*y = _mm256_srli_epi32(sum, 16);
+
+	r = _mm256_and_si256(_mm256_srl_epi32(v,
+			     _mm_cvtsi32_si128(f->r_shift)), byte);
+	b = _mm256_and_si256(_mm256_srl_epi32(v,
+			     _mm_cvtsi32_si128(f->b_shift)), byte);
+	*dr = _mm256_sub_epi32(r, *y);
+	*db = _mm256_sub_epi32(b, *y);
+}
+
+/* Packs 2x8 int32 into 16 int16 in order; packssdw works per 128-bit
+ * lane, so the middle quadwords need swapping back. */
+__attribute__((target("avx2")))
+static inline __m256i
+pack16_avx2(__m256i a, __m256i b)
+{
+	return _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), 0xd8);
+}
+
+__attribute__((target("avx2")))
+static inline void
+store_luma_avx2(unsigned char *y, __m256i y16)
+{
+	__m256i y8 = _mm256_packus_epi16(y16, y16);
+
+	y8 = _mm256_permute4x64_epi64(y8, 0x08);
+	_mm_storeu_si128((__m128i *)y, _mm256_castsi256_si128(y8));
+}
+
+__attribute__((target("avx2")))
+static inline void
+store_chroma420_avx2(unsigned char *out, __m256i s, int scale)
+{
+	__m256i c;
+
+	s = _mm256_or_si256(_mm256_and_si256(s, _mm256_set1_epi32(0xffff)),
+			    _mm256_slli_epi32(s, 16));
+	c = _mm256_madd_epi16(s, _mm256_set1_epi32(SPLIT_SCALE(scale)));
+	c = _mm256_add_epi32(_mm256_srai_epi32(c, 18),
+			     _mm256_set1_epi32(128));
+	c = _mm256_packs_epi32(c, c);
+	c = _mm256_packus_epi16(c, c);
+	c = _mm256_permutevar8x32_epi32(c, _mm256_setr_epi32(0, 4, 0, 0,
+							     0, 0, 0, 0));
+	_mm_storel_epi64((__m128i *)out, _mm256_castsi256_si128(c));
+}
+
+__attribute__((target("avx2")))
+static void
+rows_yv12_avx2(const struct yuv_format *f,
+	       const uint32_t *p1, const uint32_t *p2,
+	       unsigned char *y1, unsigned char *y2,
+	       unsigned char *u, unsigned char *v, int width)
+{
+	const __m256i ones = _mm256_set1_epi16(1);
+	__m256i ya, yb, ra, rb, ba, bb, dr, db;
+	int k;
+
+	for (k = 0; k + 16 <= width; k += 16) {
+		pixels_avx2(f, p1 + k, &ya, &ra, &ba);
+		pixels_avx2(f, p1 + k + 8, &yb, &rb, &bb);
+		store_luma_avx2(y1 + k, pack16_avx2(ya, yb));
+		dr = pack16_avx2(ra, rb);
+		db = pack16_avx2(ba, bb);
+
+		pixels_avx2(f, p2 + k, &ya, &ra, &ba);
+		pixels_avx2(f, p2 + k + 8, &yb, &rb, &bb);
+		store_luma_avx2(y2 + k, pack16_avx2(ya, yb));
+		dr = _mm256_add_epi16(dr, pack16_avx2(ra, rb));
+		db = _mm256_add_epi16(db, pack16_avx2(ba, bb));
+
+		store_chroma420_avx2(u + k / 2, _mm256_madd_epi16(dr, ones),
+				     U_SCALE);
+		store_chroma420_avx2(v + k / 2, _mm256_madd_epi16(db, ones),
+				     V_SCALE);
+	}
+
+	rows_yv12_sse2(f, p1 + k, p2 + k, y1 + k, y2 + k,
+		       u + k / 2, v + k / 2, width - k);
+}
+
+__attribute__((target("avx2")))
+static void
+row_yuv444_avx2(const struct yuv_format *f, const uint32_t *p,
+		unsigned char *y, unsigned char *u, unsigned char *v,
+		int width)
+{
+	int16_t dr[16], db[16];
+	__m256i ya, yb, ra, rb, ba, bb;
+	int k, i;
+
+	for (k = 0; k + 16 <= width; k += 16) {
+		pixels_avx2(f, p + k, &ya, &ra, &ba);
+		pixels_avx2(f, p + k + 8, &yb, &rb, &bb);
+		store_luma_avx2(y + k, pack16_avx2(ya, yb));
+		_mm256_storeu_si256((__m256i *)dr, pack16_avx2(ra, rb));
+		_mm256_storeu_si256((__m256i *)db, pack16_avx2(ba, bb));
+
+		for (i = 0; i < 16; i++) {
+			u[k + i] = u444[dr[i] + 255];
+			v[k + i] = v444[db[i] + 255];
+		}
+	}
+
+	row_yuv444_sse2(f, p + k, y + k, u + k, v + k, width - k);
+}
+
+static const struct yuv_impl yuv_impl_avx2 = {
+	"avx2", rows_yv12_avx2, row_yuv444_avx2
+};
+
+#endif /* WCAP_YUV_X86 */
+
+static void
+init_chroma444(void)
+{
+	int d;
+
+	for (d = -255; d <= 255; d++) {
+		u444[d + 255] = clamp_uv(U_SCALE * d / .3);
+		v444[d + 255] = clamp_uv(V_SCALE * d / .3);
+	}
+
+	chroma444_ready = true;
+}
+
+/** Choose the implementation used by the conversion functions
+ *
+ * \param impl The implementation, or WCAP_YUV_IMPL_AUTO for the best one
+ * the CPU supports.
+ * \return false if the CPU or the build does not support \c impl, in which
+ * case the current choice is kept.
+ *
+ * Must not be called while a conversion is running in another thread.
+ */
+bool
+wcap_yuv_select_impl(enum wcap_yuv_impl impl)
+{
+	if (!chroma444_ready)
+		init_chroma444();
+
+	switch (impl) {
+	case WCAP_YUV_IMPL_AUTO:
+		if (wcap_yuv_select_impl(WCAP_YUV_IMPL_AVX2) ||
+		    wcap_yuv_select_impl(WCAP_YUV_IMPL_SSE2))
+			return true;
+		return wcap_yuv_select_impl(WCAP_YUV_IMPL_SCALAR);
+	case WCAP_YUV_IMPL_SCALAR:
+		yuv_impl = &yuv_impl_scalar;
+		return true;
+#ifdef WCAP_YUV_X86
+	case WCAP_YUV_IMPL_SSE2:
+		if (!__builtin_cpu_supports("sse2"))
+			return false;
+		yuv_impl = &yuv_impl_sse2;
+		return true;
+	case WCAP_YUV_IMPL_AVX2:
+		if (!__builtin_cpu_supports("avx2"))
+			return false;
+		yuv_impl = &yuv_impl_avx2;
+		return true;
+#endif
+	default:
+		return false;
+	}
+}
+
+static const struct yuv_impl *
+get_impl(void)
+{
+	if (!yuv_impl)
+		wcap_yuv_select_impl(WCAP_YUV_IMPL_AUTO);
+
+	return yuv_impl;
+}
+
+const char *
+wcap_yuv_impl_name(void)
+{
+	return get_impl()->name;
+}
+
+static const struct yuv_format *
+lookup_format(uint32_t format)
+{
+	unsigned i;
+
+	for (i = 0; i < sizeof yuv_formats / sizeof yuv_formats[0]; i++)
+		if (yuv_formats[i].format == format)
+			return &yuv_formats[i];
+
+	return NULL;
+}
+
+bool
+wcap_yuv_format_supported(uint32_t format)
+{
+	return lookup_format(format) != NULL;
+}
+
+/** Convert a frame to YV12
+ *
+ * \param format A format for which wcap_yuv_format_supported() is true.
+ * \param frame The decoded frame, \c width pixels per row.
+ * \param out Receives width * height * 3 / 2 bytes: the luma plane, then
+ * the V and U planes subsampled by two in both directions.
+ */
+void
+wcap_yuv_convert_yv12(uint32_t format, const uint32_t *frame,
+		      int width, int height, unsigned char *out)
+{
+	const struct yuv_impl *impl = get_impl();
+	const struct yuv_format *f = lookup_format(format);
+	int stride0 = width, stride1 = width / 2;
+	unsigned char *y1, *u, *v;
+	const uint32_t *p1;
+	int i;
+
+	for (i = 0; i + 2 <= height; i += 2) {
+		y1 = out + stride0 * i;
+		v = out + stride0 * height + stride1 * i / 2;
+		u = v + stride1 * height / 2;
+		p1 = frame + width * i;
+
+		impl->rows_yv12(f, p1, p1 + width, y1, y1 + stride0,
+				u, v, width);
+	}
+}
+
+/** Convert a frame to planar 4:4:4
+ *
+ * \param format A format for which wcap_yuv_format_supported() is true.
+ * \param frame The decoded frame, \c width pixels per row.
+ * \param out Receives width * height * 3 bytes: the Y, V and U planes.
+ */
+void
+wcap_yuv_convert_yuv444(uint32_t format, const uint32_t *frame,
+			int width, int height, unsigned char *out)
+{
+	const struct yuv_impl *impl = get_impl();
+	const struct yuv_format *f = lookup_format(format);
+	int psize = width * height;
+	unsigned char *y;
+	int i;
+
+	for (i = 0; i < height; i++) {
+		y = out + width * i;
+		impl->row_yuv444(f, frame + width * i,
+				 y, y + psize * 2, y + psize, width);
+	}
+}
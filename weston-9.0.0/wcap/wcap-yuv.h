@@ -0,0 +1,67 @@
+/*
+ * Copyright © 2026 The Annland Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _WCAP_YUV_
+#define _WCAP_YUV_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Conversion of decoded wcap frames to the planar YUV layouts written by
+ * wcap-decode --yuv4mpeg2: YV12 (Y, V, U with 2x2 subsampled chroma) and
+ * planar 4:4:4 (Y, V, U).
+ *
+ * Vectorized implementations are picked at runtime when the CPU has them,
+ * and produce the same output as the scalar one. The conversion functions
+ * may be called from several threads at once, but only after an
+ * implementation has been selected.
+ */
+
+enum wcap_yuv_impl {
+	WCAP_YUV_IMPL_AUTO = 0,
+	WCAP_YUV_IMPL_SCALAR,
+	WCAP_YUV_IMPL_SSE2,
+	WCAP_YUV_IMPL_AVX2,
+};
+
+bool
+wcap_yuv_select_impl(enum wcap_yuv_impl impl);
+
+const char *
+wcap_yuv_impl_name(void);
+
+bool
+wcap_yuv_format_supported(uint32_t format);
+
+void
+wcap_yuv_convert_yv12(uint32_t format, const uint32_t *frame,
+		      int width, int height, unsigned char *out);
+
+void
+wcap_yuv_convert_yuv444(uint32_t format, const uint32_t *frame,
+			int width, int height, unsigned char *out);
+
+#endif
@@ -25,9 +25,12 @@
 
 #include "config.h"
 
+#include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <errno.h>
@@ -35,6 +38,7 @@
 #include <libweston/libweston.h>
 #include "xwayland.h"
 #include "shared/helpers.h"
+#include "shared/timespec-util.h"
 
 #ifdef WM_DEBUG
 #define wm_log(...) weston_log(__VA_ARGS__)
@@ -42,67 +46,111 @@
 #define wm_log(...) do {} while (0)
 #endif
 
+/* Chunks are sized to fit one ChangeProperty request, up to this. */
+#define SELECTION_CHUNK_MAX (4 * 1024 * 1024)
+
+static void
+weston_wm_transfer_begin(struct weston_wm_transfer *transfer)
+{
+	clock_gettime(CLOCK_MONOTONIC, &transfer->start);
+	transfer->size = 0;
+}
+
+static void
+weston_wm_transfer_end(struct weston_wm_transfer *transfer,
+		       const char *direction)
+{
+	struct timespec now;
+	int64_t usec;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	usec = timespec_sub_to_nsec(&now, &transfer->start) / 1000;
+
+	weston_log("selection transfer %s complete: %zu bytes in %.1f ms, "
+		   "%.1f MB/s\n", direction, transfer->size, usec / 1000.0,
+		   usec > 0 ? (double) transfer->size / usec : 0.0);
+}
+
+/*
+ * X11 to Wayland: each chunk is fetched and its property deleted right
+ * away, so the owner prepares the next chunk while this one is written
+ * to the Wayland client. Fetching stops while a chunk is still buffered.
+ */
+
+static void weston_wm_target_step(struct weston_wm *wm);
+
+static void
+weston_wm_target_done(struct weston_wm *wm)
+{
+	if (wm->property_source)
+		wl_event_source_remove(wm->property_source);
+	wm->property_source = NULL;
+
+	close(wm->data_source_fd);
+	wm->data_source_fd = -1;
+
+	wl_array_release(&wm->target_data);
+	wl_array_init(&wm->target_data);
+	wm->target_data_start = 0;
+	wm->incr = 0;
+	wm->incr_chunk_pending = 0;
+	wm->incr_done = 0;
+}
+
 static int
 writable_callback(int fd, uint32_t mask, void *data)
 {
 	struct weston_wm *wm = data;
-	unsigned char *property;
 	int len, remainder;
 
-	property = xcb_get_property_value(wm->property_reply);
-	remainder = xcb_get_property_value_length(wm->property_reply) -
-		wm->property_start;
-
-	len = write(fd, property + wm->property_start, remainder);
+	remainder = wm->target_data.size - wm->target_data_start;
+	len = write(fd, (char *) wm->target_data.data + wm->target_data_start,
+		    remainder);
+	if (len == -1 && errno == EAGAIN)
+		return 1;
 	if (len == -1) {
-		free(wm->property_reply);
-		wm->property_reply = NULL;
-		if (wm->property_source)
-			wl_event_source_remove(wm->property_source);
-		wm->property_source = NULL;
-		close(fd);
 		weston_log("write error to target fd: %s\n", strerror(errno));
+		weston_wm_target_done(wm);
 		return 1;
 	}
 
-	weston_log("wrote %d (chunk size %d) of %d bytes\n",
-		wm->property_start + len,
-		len, xcb_get_property_value_length(wm->property_reply));
-
-	wm->property_start += len;
-	if (len == remainder) {
-		free(wm->property_reply);
-		wm->property_reply = NULL;
-		if (wm->property_source)
-			wl_event_source_remove(wm->property_source);
-		wm->property_source = NULL;
-
-		if (wm->incr) {
-			xcb_delete_property(wm->conn,
-					    wm->selection_window,
-					    wm->atom.wl_selection);
-		} else {
-			weston_log("transfer complete\n");
-			close(fd);
-		}
+	wm_log("wrote %d (chunk size %d) of %zu bytes\n",
+	       len, remainder, wm->target_data.size);
+
+	wm->target_data_start += len;
+	if (wm->target_data_start == wm->target_data.size) {
+		wm->target_data.size = 0;
+		wm->target_data_start = 0;
 	}
 
+	weston_wm_target_step(wm);
+
 	return 1;
 }
 
 static void
-weston_wm_write_property(struct weston_wm *wm, xcb_get_property_reply_t *reply)
+weston_wm_target_append(struct weston_wm *wm, xcb_get_property_reply_t *reply)
 {
-	wm->property_start = 0;
-	wm->property_reply = reply;
-	writable_callback(wm->data_source_fd, WL_EVENT_WRITABLE, wm);
-
-	if (wm->property_reply)
-		wm->property_source =
-			wl_event_loop_add_fd(wm->server->loop,
-					     wm->data_source_fd,
-					     WL_EVENT_WRITABLE,
-					     writable_callback, wm);
+	size_t pending = wm->target_data.size - wm->target_data_start;
+	int len = xcb_get_property_value_length(reply);
+	void *p;
+
+	if (wm->target_data_start > 0) {
+		memmove(wm->target_data.data,
+			(char *) wm->target_data.data + wm->target_data_start,
+			pending);
+		wm->target_data.size = pending;
+		wm->target_data_start = 0;
+	}
+
+	p = wl_array_add(&wm->target_data, len);
+	if (p == NULL) {
+		weston_log("out of memory for %d selection bytes\n", len);
+		return;
+	}
+
+	memcpy(p, xcb_get_property_value(reply), len);
+	wm->target_transfer.size += len;
 }
 
 static void
@@ -114,8 +162,15 @@ weston_wm_get_incr_chunk(struct weston_wm *wm)
 	char *logstr;
 	size_t logsize;
 
+	/* The client has not taken the previous chunk yet. */
+	if (wm->target_data.size - wm->target_data_start >=
+	    wm->selection_chunk_size) {
+		wm->incr_chunk_pending = 1;
+		return;
+	}
+
 	cookie = xcb_get_property(wm->conn,
-				  0, /* delete */
+				  1, /* delete */
 				  wm->selection_window,
 				  wm->atom.wl_selection,
 				  XCB_GET_PROPERTY_TYPE_ANY,
@@ -134,14 +189,47 @@ weston_wm_get_incr_chunk(struct weston_wm *wm)
 		free(logstr);
 	}
 
-	if (xcb_get_property_value_length(reply) > 0) {
-		/* reply's ownership is transferred to wm, which is responsible
-		 * for freeing it */
-		weston_wm_write_property(wm, reply);
-	} else {
-		weston_log("transfer complete\n");
-		close(wm->data_source_fd);
-		free(reply);
+	if (xcb_get_property_value_length(reply) > 0)
+		weston_wm_target_append(wm, reply);
+	else
+		wm->incr_done = 1;
+	free(reply);
+
+	weston_wm_target_step(wm);
+}
+
+/* Write what is buffered, fetch the next chunk once there is room, and
+ * close the fd when all is written. */
+static void
+weston_wm_target_step(struct weston_wm *wm)
+{
+	size_t pending = wm->target_data.size - wm->target_data_start;
+
+	if (wm->incr && wm->incr_chunk_pending &&
+	    pending < wm->selection_chunk_size) {
+		wm->incr_chunk_pending = 0;
+		weston_wm_get_incr_chunk(wm);
+		return;
+	}
+
+	if (pending > 0) {
+		if (!wm->property_source)
+			wm->property_source =
+				wl_event_loop_add_fd(wm->server->loop,
+						     wm->data_source_fd,
+						     WL_EVENT_WRITABLE,
+						     writable_callback, wm);
+		return;
+	}
+
+	if (wm->property_source)
+		wl_event_source_remove(wm->property_source);
+	wm->property_source = NULL;
+
+	if (!wm->incr || wm->incr_done) {
+		weston_wm_transfer_end(&wm->target_transfer,
+				       "X11 to Wayland");
+		weston_wm_target_done(wm);
 	}
 }
 
@@ -280,17 +368,25 @@ weston_wm_get_selection_data(struct weston_wm *wm)
 		free(logstr);
 	}
 
-	if (reply == NULL) {
+	if (reply == NULL)
 		return;
-	} else if (reply->type == wm->atom.incr) {
+
+	weston_wm_transfer_begin(&wm->target_transfer);
+	wm->target_data.size = 0;
+	wm->target_data_start = 0;
+	wm->incr_chunk_pending = 0;
+	wm->incr_done = 0;
+
+	if (reply->type == wm->atom.incr) {
+		/* Deleting the INCR property asked for the first chunk. */
 		wm->incr = 1;
-		free(reply);
 	} else {
 		wm->incr = 0;
-		/* reply's ownership is transferred to wm, which is responsible
-		 * for freeing it */
-		weston_wm_write_property(wm, reply);
+		weston_wm_target_append(wm, reply);
+		weston_wm_target_step(wm);
 	}
+
+	free(reply);
 }
 
 static void
@@ -309,8 +405,6 @@ weston_wm_handle_selection_notify(struct weston_wm *wm,
 	}
 }
 
-static const size_t incr_chunk_size = 64 * 1024;
-
 static void
 weston_wm_send_selection_notify(struct weston_wm *wm, xcb_atom_t property)
 {
@@ -367,10 +461,18 @@ weston_wm_send_timestamp(struct weston_wm *wm)
 	weston_wm_send_selection_notify(wm, wm->selection_request.property);
 }
 
+/*
+ * Wayland to X11: while the requestor holds one chunk in its property, up
+ * to another chunk is read ahead from the Wayland client, and handed over
+ * as soon as the requestor deletes the property.
+ */
+
+/* Set the next chunk, or the zero-length property ending an INCR
+ * transfer when nothing is left. */
 static int
 weston_wm_flush_source_data(struct weston_wm *wm)
 {
-	int length;
+	size_t length = MIN(wm->source_data.size, wm->selection_chunk_size);
 
 	xcb_change_property(wm->conn,
 			    XCB_PROP_MODE_REPLACE,
@@ -378,114 +480,150 @@ weston_wm_flush_source_data(struct weston_wm *wm)
 			    wm->selection_request.property,
 			    wm->selection_target,
 			    8, /* format */
-			    wm->source_data.size,
+			    length,
 			    wm->source_data.data);
 	wm->selection_property_set = 1;
-	length = wm->source_data.size;
-	wm->source_data.size = 0;
+
+	wm->source_data.size -= length;
+	memmove(wm->source_data.data,
+		(char *) wm->source_data.data + length,
+		wm->source_data.size);
 
 	return length;
 }
 
-static int
-weston_wm_read_data_source(int fd, uint32_t mask, void *data)
+static void
+weston_wm_source_done(struct weston_wm *wm)
 {
-	struct weston_wm *wm = data;
-	int len, current, available;
-	void *p;
+	if (wm->source_watch)
+		wl_event_source_remove(wm->source_watch);
+	wm->source_watch = NULL;
 
-	current = wm->source_data.size;
-	if (wm->source_data.size < incr_chunk_size)
-		p = wl_array_add(&wm->source_data, incr_chunk_size);
-	else
-		p = (char *) wm->source_data.data + wm->source_data.size;
-	available = wm->source_data.alloc - current;
+	if (wm->source_fd >= 0)
+		close(wm->source_fd);
+	wm->source_fd = -1;
 
-	len = read(fd, p, available);
-	if (len == -1) {
-		weston_log("read error from data source: %s\n",
-			   strerror(errno));
-		weston_wm_send_selection_notify(wm, XCB_ATOM_NONE);
-		if (wm->property_source)
-			wl_event_source_remove(wm->property_source);
-		wm->property_source = NULL;
-		close(fd);
-		wl_array_release(&wm->source_data);
-		return 1;
-	}
+	wl_array_release(&wm->source_data);
+	wl_array_init(&wm->source_data);
+	wm->selection_request.requestor = XCB_NONE;
+}
+
+static int
+weston_wm_read_data_source(int fd, uint32_t mask, void *data);
 
-	weston_log("read %d (available %d, mask 0x%x) bytes: \"%.*s\"\n",
-		len, available, mask, len, (char *) p);
+static void
+weston_wm_source_step(struct weston_wm *wm)
+{
+	uint32_t incr_size = wm->selection_chunk_size;
+	bool eof = wm->source_fd < 0;
+
+	if (!wm->source_incr) {
+		if (eof) {
+			/* Everything fits in one property. */
+			weston_wm_flush_source_data(wm);
+			weston_wm_send_selection_notify(wm, wm->selection_request.property);
+			weston_wm_transfer_end(&wm->source_transfer,
+					       "Wayland to X11");
+			weston_wm_source_done(wm);
+			xcb_flush(wm->conn);
+			return;
+		}
 
-	wm->source_data.size = current + len;
-	if (wm->source_data.size >= incr_chunk_size) {
-		if (!wm->incr) {
-			weston_log("got %zu bytes, starting incr\n",
-				wm->source_data.size);
-			wm->incr = 1;
+		if (wm->source_data.size >= wm->selection_chunk_size) {
+			wm_log("got %zu bytes, starting incr\n",
+			       wm->source_data.size);
+			wm->source_incr = 1;
 			xcb_change_property(wm->conn,
 					    XCB_PROP_MODE_REPLACE,
 					    wm->selection_request.requestor,
 					    wm->selection_request.property,
 					    wm->atom.incr,
 					    32, /* format */
-					    1, &incr_chunk_size);
+					    1, &incr_size);
 			wm->selection_property_set = 1;
-			wm->flush_property_on_delete = 1;
-			if (wm->property_source)
-				wl_event_source_remove(wm->property_source);
-			wm->property_source = NULL;
 			weston_wm_send_selection_notify(wm, wm->selection_request.property);
-		} else if (wm->selection_property_set) {
-			weston_log("got %zu bytes, waiting for "
-				"property delete\n", wm->source_data.size);
-
-			wm->flush_property_on_delete = 1;
-			if (wm->property_source)
-				wl_event_source_remove(wm->property_source);
-			wm->property_source = NULL;
-		} else {
-			weston_log("got %zu bytes, "
-				"property deleted, setting new property\n",
-				wm->source_data.size);
-			weston_wm_flush_source_data(wm);
 		}
-	} else if (len == 0 && !wm->incr) {
-		weston_log("non-incr transfer complete\n");
-		/* Non-incr transfer all done. */
-		weston_wm_flush_source_data(wm);
-		weston_wm_send_selection_notify(wm, wm->selection_request.property);
-		xcb_flush(wm->conn);
-		if (wm->property_source)
-			wl_event_source_remove(wm->property_source);
-		wm->property_source = NULL;
-		close(fd);
-		wl_array_release(&wm->source_data);
-		wm->selection_request.requestor = XCB_NONE;
-	} else if (len == 0 && wm->incr) {
-		weston_log("incr transfer complete\n");
-
-		wm->flush_property_on_delete = 1;
-		if (wm->selection_property_set) {
-			weston_log("got %zu bytes, waiting for "
-				"property delete\n", wm->source_data.size);
-		} else {
-			weston_log("got %zu bytes, "
-				"property deleted, setting new property\n",
-				wm->source_data.size);
+	} else if (!wm->selection_property_set) {
+		if (wm->source_data.size > 0) {
 			weston_wm_flush_source_data(wm);
+		} else if (eof) {
+			/* The zero-length property ends the transfer. */
+			weston_wm_flush_source_data(wm);
+			weston_wm_transfer_end(&wm->source_transfer,
+					       "Wayland to X11");
+			weston_wm_source_done(wm);
+			xcb_flush(wm->conn);
+			return;
 		}
-		xcb_flush(wm->conn);
-		if (wm->property_source)
-			wl_event_source_remove(wm->property_source);
-		wm->property_source = NULL;
-		close(wm->data_source_fd);
-		wm->data_source_fd = -1;
+	}
+
+	xcb_flush(wm->conn);
+
+	if (eof)
+		return;
+
+	/* Read ahead while the requestor holds the previous chunk. */
+	if (wm->source_data.size < wm->selection_chunk_size) {
+		if (!wm->source_watch)
+			wm->source_watch =
+				wl_event_loop_add_fd(wm->server->loop,
+						     wm->source_fd,
+						     WL_EVENT_READABLE,
+						     weston_wm_read_data_source,
+						     wm);
+	} else if (wm->source_watch) {
+		wl_event_source_remove(wm->source_watch);
+		wm->source_watch = NULL;
+	}
+}
+
+static int
+weston_wm_read_data_source(int fd, uint32_t mask, void *data)
+{
+	struct weston_wm *wm = data;
+	size_t available;
+	int len;
+	void *p;
+
+	available = wm->selection_chunk_size - wm->source_data.size;
+	if (wm->source_data.alloc - wm->source_data.size < available) {
+		p = wl_array_add(&wm->source_data, available);
+		if (p == NULL) {
+			weston_log("out of memory for selection data\n");
+			weston_wm_send_selection_notify(wm, XCB_ATOM_NONE);
+			weston_wm_source_done(wm);
+			return 1;
+		}
+		wm->source_data.size -= available;
+	}
+	p = (char *) wm->source_data.data + wm->source_data.size;
+
+	len = read(fd, p, available);
+	if (len == -1 && errno == EAGAIN)
+		return 1;
+	if (len == -1) {
+		weston_log("read error from data source: %s\n",
+			   strerror(errno));
+		weston_wm_send_selection_notify(wm, XCB_ATOM_NONE);
+		weston_wm_source_done(wm);
+		return 1;
+	}
+
+	wm_log("read %d (available %zu, mask 0x%x) bytes\n",
+	       len, available, mask);
+
+	wm->source_data.size += len;
+	wm->source_transfer.size += len;
+
+	if (len == 0) {
+		wl_event_source_remove(wm->source_watch);
+		wm->source_watch = NULL;
 		close(fd);
-	} else {
-		weston_log("nothing happened, buffered the bytes\n");
+		wm->source_fd = -1;
 	}
 
+	weston_wm_source_step(wm);
+
 	return 1;
 }
 
@@ -502,14 +640,22 @@ weston_wm_send_data(struct weston_wm *wm, xcb_atom_t target, const char *mime_ty
 		return;
 	}
 
+	/* Fewer wake-ups per chunk; the default size works too, and the
+	 * call fails once the user has too many pages in pipes. */
+	if (wm->selection_pipe_size > 0 &&
+	    fcntl(p[0], F_SETPIPE_SZ, (int) wm->selection_pipe_size) < 0)
+		wm_log("F_SETPIPE_SZ %zu failed: %s\n",
+		       wm->selection_pipe_size, strerror(errno));
+
+	weston_wm_transfer_begin(&wm->source_transfer);
 	wl_array_init(&wm->source_data);
 	wm->selection_target = target;
-	wm->data_source_fd = p[0];
-	wm->property_source = wl_event_loop_add_fd(wm->server->loop,
-						   wm->data_source_fd,
-						   WL_EVENT_READABLE,
-						   weston_wm_read_data_source,
-						   wm);
+	wm->source_fd = p[0];
+	wm->source_watch = wl_event_loop_add_fd(wm->server->loop,
+						wm->source_fd,
+						WL_EVENT_READABLE,
+						weston_wm_read_data_source,
+						wm);
 
 	source = seat->selection_data_source;
 	source->send(source, mime_type, p[1]);
@@ -519,35 +665,10 @@ weston_wm_send_data(struct weston_wm *wm, xcb_atom_t target, const char *mime_ty
 static void
 weston_wm_send_incr_chunk(struct weston_wm *wm)
 {
-	int length;
-
-	weston_log("property deleted\n");
+	wm_log("property deleted\n");
 
 	wm->selection_property_set = 0;
-	if (wm->flush_property_on_delete) {
-		weston_log("setting new property, %zu bytes\n",
-			wm->source_data.size);
-		wm->flush_property_on_delete = 0;
-		length = weston_wm_flush_source_data(wm);
-
-		if (wm->data_source_fd >= 0) {
-			wm->property_source =
-				wl_event_loop_add_fd(wm->server->loop,
-						     wm->data_source_fd,
-						     WL_EVENT_READABLE,
-						     weston_wm_read_data_source,
-						     wm);
-		} else if (length > 0) {
-			/* Transfer is all done, but queue a flush for
-			 * the delete of the last chunk so we can set
-			 * the 0 sized property to signal the end of
-			 * the transfer. */
-			wm->flush_property_on_delete = 1;
-			wl_array_release(&wm->source_data);
-		} else {
-			wm->selection_request.requestor = XCB_NONE;
-		}
-	}
+	weston_wm_source_step(wm);
 }
 
 static int
@@ -566,7 +687,7 @@ weston_wm_handle_selection_property_notify(struct weston_wm *wm,
 	} else if (property_notify->window == wm->selection_request.requestor) {
 		if (property_notify->state == XCB_PROPERTY_DELETE &&
 		    property_notify->atom == wm->selection_request.property &&
-		    wm->incr)
+		    wm->source_incr)
 			weston_wm_send_incr_chunk(wm);
 		return 1;
 	}
@@ -589,8 +710,7 @@ weston_wm_handle_selection_request(struct weston_wm *wm,
 		get_atom_name(wm->conn, selection_request->property));
 
 	wm->selection_request = *selection_request;
-	wm->incr = 0;
-	wm->flush_property_on_delete = 0;
+	wm->source_incr = 0;
 
 	if (selection_request->selection == wm->atom.clipboard_manager) {
 		/* The weston clipboard should already have grabbed
@@ -717,15 +837,47 @@ weston_wm_set_selection(struct wl_listener *listener, void *data)
 				XCB_TIME_CURRENT_TIME);
 }
 
+/* Unprivileged processes get EPERM from F_SETPIPE_SZ above this. */
+static size_t
+pipe_max_size(void)
+{
+	unsigned long size;
+	FILE *fp;
+	int ret;
+
+	fp = fopen("/proc/sys/fs/pipe-max-size", "r");
+	if (!fp)
+		return 0;
+
+	ret = fscanf(fp, "%lu", &size);
+	fclose(fp);
+
+	return ret == 1 ? size : 0;
+}
+
 void
 weston_wm_selection_init(struct weston_wm *wm)
 {
 	struct weston_seat *seat;
 	uint32_t values[1], mask;
+	size_t max_request;
 
 	wl_list_init(&wm->selection_listener.link);
 
 	wm->selection_request.requestor = XCB_NONE;
+	wm->data_source_fd = -1;
+	wm->source_fd = -1;
+	wl_array_init(&wm->source_data);
+	wl_array_init(&wm->target_data);
+
+	/* Each chunk goes in one ChangeProperty request. With BIG-REQUESTS
+	 * the limit is far above what is worth buffering. */
+	max_request = xcb_get_maximum_request_length(wm->conn) * 4;
+	wm->selection_chunk_size =
+		MIN(max_request - sizeof(xcb_change_property_request_t),
+		    SELECTION_CHUNK_MAX);
+	wm->selection_pipe_size = MIN(wm->selection_chunk_size,
+				      pipe_max_size());
 
 	values[0] = XCB_EVENT_MASK_PROPERTY_CHANGE;
 	wm->selection_window = xcb_generate_id(wm->conn);
@@ -133,11 +133,15 @@ struct weston_output_weak_ref {
 	struct wl_listener destroy_listener;
 };
 
+/* Number of properties weston_wm_window_read_properties() reads */
+#define WM_WINDOW_PROPERTY_COUNT 11
+
 struct weston_wm_window {
 	struct weston_wm *wm;
 	xcb_window_t id;
 	xcb_window_t frame_id;
 	struct frame *frame;
+	uint32_t frame_buttons;
 	cairo_surface_t *cairo_surface;
 	uint32_t surface_id;
 	struct weston_surface *surface;
@@ -146,6 +150,10 @@ struct weston_wm_window {
 	struct wl_event_source *repaint_source;
 	struct wl_event_source *configure_source;
 	int properties_dirty;
+	bool properties_fetching;
+	uint32_t properties_batch;
+	xcb_get_property_cookie_t property_cookies[WM_WINDOW_PROPERTY_COUNT];
+	xcb_get_geometry_cookie_t geometry_cookie;
 	int pid;
 	char *machine;
 	char *class;
@@ -500,17 +508,20 @@ read_and_dump_property(FILE *fp, struct weston_wm *wm,
 #define TYPE_NET_WM_STATE	XCB_ATOM_CUT_BUFFER2
 #define TYPE_WM_NORMAL_HINTS	XCB_ATOM_CUT_BUFFER3
 
+struct wm_window_property {
+	xcb_atom_t atom;
+	xcb_atom_t type;
+	void *ptr;
+};
+
 static void
-weston_wm_window_read_properties(struct weston_wm_window *window)
+weston_wm_window_get_property_table(struct weston_wm_window *window,
+				    struct wm_window_property *props)
 {
 	struct weston_wm *wm = window->wm;
 
 #define F(field) (&window->field)
-	const struct {
-		xcb_atom_t atom;
-		xcb_atom_t type;
-		void *ptr;
-	} props[] = {
+	const struct wm_window_property table[] = {
 		{ XCB_ATOM_WM_CLASS,           XCB_ATOM_STRING,            F(class) },
 		{ XCB_ATOM_WM_NAME,            XCB_ATOM_STRING,            F(name) },
 		{ XCB_ATOM_WM_TRANSIENT_FOR,   XCB_ATOM_WINDOW,            F(transient_for) },
@@ -525,32 +536,88 @@ weston_wm_window_read_properties(struct weston_wm_window *window)
 	};
 #undef F
 
-	xcb_get_property_cookie_t cookie[ARRAY_LENGTH(props)];
+	static_assert(ARRAY_LENGTH(table) == WM_WINDOW_PROPERTY_COUNT,
+		      "WM_WINDOW_PROPERTY_COUNT does not match the table");
+	memcpy(props, table, sizeof table);
+}
+
+static void
+weston_wm_window_discard_properties(struct weston_wm_window *window)
+{
+	uint32_t i;
+
+	for (i = 0; i < WM_WINDOW_PROPERTY_COUNT; i++)
+		xcb_discard_reply(window->wm->conn,
+				  window->property_cookies[i].sequence);
+	window->properties_fetching = false;
+}
+
+/* Sends the property requests without waiting for the replies, so that
+ * the requests for all windows in an event batch share one round trip.
+ * A fetch sent during a batch reflects every event of that batch. */
+static void
+weston_wm_window_fetch_properties(struct weston_wm_window *window)
+{
+	struct weston_wm *wm = window->wm;
+	struct wm_window_property props[WM_WINDOW_PROPERTY_COUNT];
+	uint32_t i;
+
+	if (window->properties_fetching)
+		return;
+
+	weston_wm_window_get_property_table(window, props);
+	for (i = 0; i < WM_WINDOW_PROPERTY_COUNT; i++)
+		window->property_cookies[i] =
+			xcb_get_property(wm->conn,
+					 0, /* delete */
+					 window->id,
+					 props[i].atom,
+					 XCB_ATOM_ANY, 0, 2048);
+
+	window->properties_fetching = true;
+	window->properties_batch = wm->event_batch;
+}
+
+/* A fetch sent before the current batch may miss the change. */
+static void
+weston_wm_window_properties_changed(struct weston_wm_window *window)
+{
+	window->properties_dirty = 1;
+
+	if (window->properties_fetching &&
+	    window->properties_batch != window->wm->event_batch)
+		weston_wm_window_discard_properties(window);
+}
+
+static void
+weston_wm_window_read_properties(struct weston_wm_window *window)
+{
+	struct weston_wm *wm = window->wm;
+	struct wm_window_property props[WM_WINDOW_PROPERTY_COUNT];
 	xcb_get_property_reply_t *reply;
 	void *p;
 	uint32_t *xid;
 	xcb_atom_t *atom;
-	uint32_t i;
+	uint32_t i, j;
 	char name[1024];
 
 	if (!window->properties_dirty)
 		return;
 	window->properties_dirty = 0;
 
-	for (i = 0; i < ARRAY_LENGTH(props); i++)
-		cookie[i] = xcb_get_property(wm->conn,
-					     0, /* delete */
-					     window->id,
-					     props[i].atom,
-					     XCB_ATOM_ANY, 0, 2048);
+	weston_wm_window_fetch_properties(window);
+	window->properties_fetching = false;
+	weston_wm_window_get_property_table(window, props);
 
 	window->decorate = window->override_redirect ? 0 : MWM_DECOR_EVERYTHING;
 	window->size_hints.flags = 0;
 	window->motif_hints.flags = 0;
 	window->delete_window = 0;
 
-	for (i = 0; i < ARRAY_LENGTH(props); i++)  {
-		reply = xcb_get_property_reply(wm->conn, cookie[i], NULL);
+	for (i = 0; i < WM_WINDOW_PROPERTY_COUNT; i++)  {
+		reply = xcb_get_property_reply(wm->conn,
+					       window->property_cookies[i],
+					       NULL);
 		if (!reply)
 			/* Bad window, typically */
 			continue;
@@ -587,8 +654,8 @@ weston_wm_window_read_properties(struct weston_wm_window *window)
 			break;
 		case TYPE_WM_PROTOCOLS:
 			atom = xcb_get_property_value(reply);
-			for (i = 0; i < reply->value_len; i++)
-				if (atom[i] == wm->atom.wm_delete_window) {
+			for (j = 0; j < reply->value_len; j++)
+				if (atom[j] == wm->atom.wm_delete_window) {
 					window->delete_window = 1;
 					break;
 				}
@@ -601,12 +668,12 @@ weston_wm_window_read_properties(struct weston_wm_window *window)
 		case TYPE_NET_WM_STATE:
 			window->fullscreen = 0;
 			atom = xcb_get_property_value(reply);
-			for (i = 0; i < reply->value_len; i++) {
-				if (atom[i] == wm->atom.net_wm_state_fullscreen)
+			for (j = 0; j < reply->value_len; j++) {
+				if (atom[j] == wm->atom.net_wm_state_fullscreen)
 					window->fullscreen = 1;
-				if (atom[i] == wm->atom.net_wm_state_maximized_vert)
+				if (atom[j] == wm->atom.net_wm_state_maximized_vert)
 					window->maximized_vert = 1;
-				if (atom[i] == wm->atom.net_wm_state_maximized_horz)
+				if (atom[j] == wm->atom.net_wm_state_maximized_horz)
 					window->maximized_horz = 1;
 			}
 			break;
@@ -1085,6 +1152,7 @@ weston_wm_window_create_frame(struct weston_wm_window *window)
 
 	if (!window->frame)
 		return;
+	window->frame_buttons = buttons;
 
 	frame_resize_inside(window->frame, window->width, window->height);
 
@@ -1280,6 +1348,181 @@ weston_wm_handle_unmap_notify(struct weston_wm *wm, xcb_generic_event_t *event)
 	xcb_unmap_window(wm->conn, window->frame_id);
 }
 
+/*
+ * Decoration backgrounds, without the buttons, rendered once into a
+ * pixmap and shared by all windows that look the same. The cache belongs
+ * to the WM and so to its theme; the rest of the key is the frame size,
+ * title, flags and buttons.
+ *
+ * Each entry is a whole frame, so the cache is bounded by the pixmap
+ * memory it holds rather than by its length: a handful of maximized
+ * windows already fills it. Frames larger than the budget are never
+ * cached and are painted directly.
+ */
+#define DECORATION_CACHE_MAX_BYTES (8 * 1024 * 1024)
+
+struct weston_wm_decoration {
+	struct wl_list link;
+	cairo_surface_t *surface;
+	int width, height;
+	bool decorated; /* or only a shadow */
+	uint32_t flags;
+	uint32_t buttons;
+	char *title;
+};
+
+static bool
+weston_wm_decoration_matches(const struct weston_wm_decoration *deco,
+			     const struct weston_wm_decoration *key)
+{
+	if (deco->width != key->width || deco->height != key->height ||
+	    deco->decorated != key->decorated)
+		return false;
+
+	if (!key->decorated)
+		return true;
+
+	if (deco->flags != key->flags || deco->buttons != key->buttons)
+		return false;
+
+	if (deco->title == NULL || key->title == NULL)
+		return deco->title == key->title;
+
+	return strcmp(deco->title, key->title) == 0;
+}
+
+static size_t
+weston_wm_decoration_bytes(int width, int height)
+{
+	return (size_t) width * height * 4;
+}
+
+static void
+weston_wm_decoration_destroy(struct weston_wm *wm,
+			     struct weston_wm_decoration *deco)
+{
+	wm->decoration_cache_bytes -=
+		weston_wm_decoration_bytes(deco->width, deco->height);
+	wl_list_remove(&deco->link);
+	cairo_surface_destroy(deco->surface);
+	free(deco->title);
+	free(deco);
+}
+
+static void
+weston_wm_decoration_cache_release(struct weston_wm *wm)
+{
+	struct weston_wm_decoration *deco, *tmp;
+
+	wl_list_for_each_safe(deco, tmp, &wm->decoration_cache, link)
+		weston_wm_decoration_destroy(wm, deco);
+}
+
+static void
+weston_wm_window_render_background(struct weston_wm_window *window,
+				   cairo_t *cr, int width, int height,
+				   bool decorated)
+{
+	if (decorated) {
+		frame_repaint_background(window->frame, cr);
+		return;
+	}
+
+	cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+	cairo_set_source_rgba(cr, 0, 0, 0, 0);
+	cairo_paint(cr);
+
+	render_shadow(cr, window->wm->theme->shadow,
+		      2, 2, width + 8, height + 8, 64, 64);
+}
+
+static struct weston_wm_decoration *
+weston_wm_window_get_decoration(struct weston_wm_window *window,
+				int width, int height, bool decorated)
+{
+	struct weston_wm *wm = window->wm;
+	struct weston_wm_decoration key = { 0 }, *deco;
+	size_t bytes = weston_wm_decoration_bytes(width, height);
+	cairo_t *cr;
+
+	key.width = width;
+	key.height = height;
+	key.decorated = decorated;
+	if (decorated) {
+		key.flags = frame_flags(window->frame);
+		key.buttons = window->frame_buttons;
+		key.title = window->name;
+	}
+
+	wl_list_for_each(deco, &wm->decoration_cache, link) {
+		if (weston_wm_decoration_matches(deco, &key)) {
+			wl_list_remove(&deco->link);
+			wl_list_insert(&wm->decoration_cache, &deco->link);
+			return deco;
+		}
+	}
+
+	if (bytes > DECORATION_CACHE_MAX_BYTES)
+		return NULL;
+
+	deco = zalloc(sizeof *deco);
+	if (deco == NULL)
+		return NULL;
+
+	*deco = key;
+	deco->title = key.title ? strdup(key.title) : NULL;
+	deco->surface = cairo_surface_create_similar(window->cairo_surface,
+						     CAIRO_CONTENT_COLOR_ALPHA,
+						     width, height);
+	if ((key.title && !deco->title) ||
+	    cairo_surface_status(deco->surface) != CAIRO_STATUS_SUCCESS) {
+		cairo_surface_destroy(deco->surface);
+		free(deco->title);
+		free(deco);
+		return NULL;
+	}
+
+	cr = cairo_create(deco->surface);
+	weston_wm_window_render_background(window, cr, width, height,
+					   decorated);
+	cairo_destroy(cr);
+
+	wm_printf(wm, "XWM: render decoration %dx%d%s\n", width, height,
+		  decorated ? "" : ", shadow");
+
+	/* Most recently used first; evict from the tail. */
+	while (wm->decoration_cache_bytes + bytes > DECORATION_CACHE_MAX_BYTES)
+		weston_wm_decoration_destroy(wm,
+			container_of(wm->decoration_cache.prev,
+				     struct weston_wm_decoration, link));
+	wl_list_insert(&wm->decoration_cache, &deco->link);
+	wm->decoration_cache_bytes += bytes;
+
+	return deco;
+}
+
+static void
+weston_wm_window_paint_background(struct weston_wm_window *window,
+				  cairo_t *cr, int width, int height,
+				  bool decorated)
+{
+	struct weston_wm_decoration *deco;
+
+	deco = weston_wm_window_get_decoration(window, width, height,
+					       decorated);
+	if (deco == NULL) {
+		weston_wm_window_render_background(window, cr, width, height,
+						   decorated);
+		return;
+	}
+
+	cairo_save(cr);
+	cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+	cairo_set_source_surface(cr, deco->surface, 0, 0);
+	cairo_paint(cr);
+	cairo_restore(cr);
+}
+
 static void
 weston_wm_window_draw_decoration(struct weston_wm_window *window)
 {
@@ -1298,15 +1541,13 @@ weston_wm_window_draw_decoration(struct weston_wm_window *window)
 	} else if (window->decorate) {
 		how = "decorate";
 		frame_set_title(window->frame, window->name);
-		frame_repaint(window->frame, cr);
+		weston_wm_window_paint_background(window, cr, width, height,
+						  true);
+		frame_repaint_buttons(window->frame, cr);
 	} else {
 		how = "shadow";
-		cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
-		cairo_set_source_rgba(cr, 0, 0, 0, 0);
-		cairo_paint(cr);
-
-		render_shadow(cr, window->wm->theme->shadow,
-			      2, 2, width + 8, height + 8, 64, 64);
+		weston_wm_window_paint_background(window, cr, width, height,
+						  false);
 	}
 
 	wm_printf(window->wm, "XWM: draw decoration, win %d, %s\n",
@@ -1445,7 +1686,7 @@ weston_wm_handle_property_notify(struct weston_wm *wm, xcb_generic_event_t *even
 	if (!wm_lookup_window(wm, property_notify->window, &window))
 		return;
 
-	window->properties_dirty = 1;
+	weston_wm_window_properties_changed(window);
 
 	if (wm_debug_is_enabled(wm))
 		fp = open_memstream(&logstr, &logsize);
@@ -1479,22 +1720,22 @@ weston_wm_handle_property_notify(struct weston_wm *wm, xcb_generic_event_t *even
 		weston_wm_window_schedule_repaint(window);
 }
 
-static void
-weston_wm_window_create(struct weston_wm *wm,
-			xcb_window_t id, int width, int height, int x, int y, int override)
+/* Allocates a window and sends the requests its creation needs, without
+ * waiting for the replies. Property changes are selected before any
+ * property is fetched, so that no change goes unnoticed. */
+static struct weston_wm_window *
+weston_wm_window_prepare(struct weston_wm *wm, xcb_window_t id)
 {
 	struct weston_wm_window *window;
 	uint32_t values[1];
-	xcb_get_geometry_cookie_t geometry_cookie;
-	xcb_get_geometry_reply_t *geometry_reply;
 
 	window = zalloc(sizeof *window);
 	if (window == NULL) {
 		wm_printf(wm, "failed to allocate window\n");
-		return;
+		return NULL;
 	}
 
-	geometry_cookie = xcb_get_geometry(wm->conn, id);
+	window->geometry_cookie = xcb_get_geometry(wm->conn, id);
 
 	values[0] = XCB_EVENT_MASK_PROPERTY_CHANGE |
                     XCB_EVENT_MASK_FOCUS_CHANGE;
@@ -1503,6 +1744,48 @@ weston_wm_window_create(struct weston_wm *wm,
 	window->wm = wm;
 	window->id = id;
 	window->properties_dirty = 1;
+
+	return window;
+}
+
+static void
+weston_wm_window_release_prepared(void *element, void *data)
+{
+	struct weston_wm_window *window = element;
+	struct weston_wm *wm = data;
+
+	hash_table_remove(wm->prefetch_hash, window->id);
+	if (window->properties_fetching)
+		weston_wm_window_discard_properties(window);
+	xcb_discard_reply(wm->conn, window->geometry_cookie.sequence);
+	free(window);
+}
+
+/* Frees what weston_wm_prefetch_properties() prepared for windows whose
+ * CreateNotify was not handled after all. */
+static void
+weston_wm_release_prefetched(struct weston_wm *wm)
+{
+	hash_table_for_each(wm->prefetch_hash,
+			    weston_wm_window_release_prepared, wm);
+}
+
+static void
+weston_wm_window_create(struct weston_wm *wm,
+			xcb_window_t id, int width, int height, int x, int y, int override)
+{
+	struct weston_wm_window *window;
+	xcb_get_geometry_reply_t *geometry_reply;
+
+	/* Prepared while looking ahead in the event batch, or now. */
+	window = hash_table_lookup(wm->prefetch_hash, id);
+	if (window)
+		hash_table_remove(wm->prefetch_hash, id);
+	else
+		window = weston_wm_window_prepare(wm, id);
+	if (window == NULL)
+		return;
+
 	window->override_redirect = override;
 	window->width = width;
 	window->height = height;
@@ -1513,7 +1796,8 @@ weston_wm_window_create(struct weston_wm *wm,
 	window->map_request_y = INT_MIN; /* out of range for valid positions */
 	weston_output_weak_ref_init(&window->legacy_fullscreen_output);
 
-	geometry_reply = xcb_get_geometry_reply(wm->conn, geometry_cookie, NULL);
+	geometry_reply = xcb_get_geometry_reply(wm->conn,
+						window->geometry_cookie, NULL);
 	/* technically we should use XRender and check the visual format's
 	alpha_mask, but checking depth is simpler and works in all known cases */
 	if (geometry_reply != NULL)
@@ -1536,6 +1820,8 @@ weston_wm_window_destroy(struct weston_wm_window *window)
 		wl_event_source_remove(window->repaint_source);
 	if (window->cairo_surface)
 		cairo_surface_destroy(window->cairo_surface);
+	if (window->properties_fetching)
+		weston_wm_window_discard_properties(window);
 
 	if (window->frame_id) {
 		xcb_reparent_window(wm->conn, window->id, wm->wm_window, 0, 0);
@@ -2249,81 +2535,167 @@ weston_wm_handle_focus_in(struct weston_wm *wm, xcb_generic_event_t *event)
 		weston_wm_send_focus_window(wm, wm->focus_window);
 }
 
+/* Looks ahead in an event batch for windows that will read their
+ * properties while it is handled, and fetches them all at once.
+ *
+ * A client creating and mapping windows back to back, as a session restore
+ * does, has the CreateNotify and the MapRequest of each window in the same
+ * batch: those windows are prepared here, kept in prefetch_hash, and picked
+ * up by weston_wm_window_create(). */
+static void
+weston_wm_prefetch_properties(struct weston_wm *wm, xcb_generic_event_t *event)
+{
+	xcb_create_notify_event_t *create_notify;
+	xcb_property_notify_event_t *property_notify;
+	xcb_map_request_event_t *map_request;
+	struct weston_wm_window *window;
+
+	switch (EVENT_TYPE(event)) {
+	case XCB_CREATE_NOTIFY:
+		create_notify = (xcb_create_notify_event_t *) event;
+		if (our_resource(wm, create_notify->window) ||
+		    hash_table_lookup(wm->prefetch_hash, create_notify->window))
+			return;
+
+		window = weston_wm_window_prepare(wm, create_notify->window);
+		if (window == NULL)
+			return;
+
+		if (hash_table_insert(wm->prefetch_hash, window->id, window) < 0)
+			weston_wm_window_release_prepared(window, wm);
+		break;
+	case XCB_PROPERTY_NOTIFY:
+		property_notify = (xcb_property_notify_event_t *) event;
+		if (!wm_lookup_window(wm, property_notify->window, &window))
+			return;
+
+		weston_wm_window_properties_changed(window);
+
+		/* A new title repaints the decoration. */
+		if (property_notify->atom == wm->atom.net_wm_name ||
+		    property_notify->atom == XCB_ATOM_WM_NAME)
+			weston_wm_window_fetch_properties(window);
+		break;
+	case XCB_MAP_REQUEST:
+		map_request = (xcb_map_request_event_t *) event;
+		window = hash_table_lookup(wm->prefetch_hash,
+					   map_request->window);
+		if (!window && !wm_lookup_window(wm, map_request->window, &window))
+			return;
+
+		if (window->properties_dirty)
+			weston_wm_window_fetch_properties(window);
+		break;
+	}
+}
+
+static void
+weston_wm_dispatch_event(struct weston_wm *wm, xcb_generic_event_t *event)
+{
+	if (weston_wm_handle_selection_event(wm, event)) {
+		free(event);
+		return;
+	}
+
+	if (weston_wm_handle_dnd_event(wm, event)) {
+		free(event);
+		return;
+	}
+
+	switch (EVENT_TYPE(event)) {
+	case XCB_BUTTON_PRESS:
+	case XCB_BUTTON_RELEASE:
+		weston_wm_handle_button(wm, event);
+		break;
+	case XCB_ENTER_NOTIFY:
+		weston_wm_handle_enter(wm, event);
+		break;
+	case XCB_LEAVE_NOTIFY:
+		weston_wm_handle_leave(wm, event);
+		break;
+	case XCB_MOTION_NOTIFY:
+		weston_wm_handle_motion(wm, event);
+		break;
+	case XCB_CREATE_NOTIFY:
+		weston_wm_handle_create_notify(wm, event);
+		break;
+	case XCB_MAP_REQUEST:
+		weston_wm_handle_map_request(wm, event);
+		break;
+	case XCB_MAP_NOTIFY:
+		weston_wm_handle_map_notify(wm, event);
+		break;
+	case XCB_UNMAP_NOTIFY:
+		weston_wm_handle_unmap_notify(wm, event);
+		break;
+	case XCB_REPARENT_NOTIFY:
+		weston_wm_handle_reparent_notify(wm, event);
+		break;
+	case XCB_CONFIGURE_REQUEST:
+		weston_wm_handle_configure_request(wm, event);
+		break;
+	case XCB_CONFIGURE_NOTIFY:
+		weston_wm_handle_configure_notify(wm, event);
+		break;
+	case XCB_DESTROY_NOTIFY:
+		weston_wm_handle_destroy_notify(wm, event);
+		break;
+	case XCB_MAPPING_NOTIFY:
+		wm_printf(wm, "XCB_MAPPING_NOTIFY\n");
+		break;
+	case XCB_PROPERTY_NOTIFY:
+		weston_wm_handle_property_notify(wm, event);
+		break;
+	case XCB_CLIENT_MESSAGE:
+		weston_wm_handle_client_message(wm, event);
+		break;
+	case XCB_FOCUS_IN:
+		weston_wm_handle_focus_in(wm, event);
+		break;
+	}
+
+	free(event);
+}
+
 static int
 weston_wm_handle_event(int fd, uint32_t mask, void *data)
 {
 	struct weston_wm *wm = data;
-	xcb_generic_event_t *event;
+	xcb_generic_event_t *event, **e;
+	struct wl_array batch;
 	int count = 0;
 
-	while (event = xcb_poll_for_event(wm->conn), event != NULL) {
-		if (weston_wm_handle_selection_event(wm, event)) {
-			free(event);
-			count++;
-			continue;
+	/* Handlers may do round trips that queue more events; those go in
+	 * the next batch. */
+	wl_array_init(&batch);
+	do {
+		batch.size = 0;
+		wm->event_batch++;
+
+		while (event = xcb_poll_for_event(wm->conn), event != NULL) {
+			e = wl_array_add(&batch, sizeof *e);
+			if (e == NULL)
+				break;
+			*e = event;
 		}
 
-		if (weston_wm_handle_dnd_event(wm, event)) {
-			free(event);
+		wl_array_for_each(e, &batch)
+			weston_wm_prefetch_properties(wm, *e);
+
+		wl_array_for_each(e, &batch) {
+			weston_wm_dispatch_event(wm, *e);
 			count++;
-			continue;
 		}
 
-		switch (EVENT_TYPE(event)) {
-		case XCB_BUTTON_PRESS:
-		case XCB_BUTTON_RELEASE:
-			weston_wm_handle_button(wm, event);
-			break;
-		case XCB_ENTER_NOTIFY:
-			weston_wm_handle_enter(wm, event);
-			break;
-		case XCB_LEAVE_NOTIFY:
-			weston_wm_handle_leave(wm, event);
-			break;
-		case XCB_MOTION_NOTIFY:
-			weston_wm_handle_motion(wm, event);
-			break;
-		case XCB_CREATE_NOTIFY:
-			weston_wm_handle_create_notify(wm, event);
-			break;
-		case XCB_MAP_REQUEST:
-			weston_wm_handle_map_request(wm, event);
-			break;
-		case XCB_MAP_NOTIFY:
-			weston_wm_handle_map_notify(wm, event);
-			break;
-		case XCB_UNMAP_NOTIFY:
-			weston_wm_handle_unmap_notify(wm, event);
-			break;
-		case XCB_REPARENT_NOTIFY:
-			weston_wm_handle_reparent_notify(wm, event);
-			break;
-		case XCB_CONFIGURE_REQUEST:
-			weston_wm_handle_configure_request(wm, event);
-			break;
-		case XCB_CONFIGURE_NOTIFY:
-			weston_wm_handle_configure_notify(wm, event);
-			break;
-		case XCB_DESTROY_NOTIFY:
-			weston_wm_handle_destroy_notify(wm, event);
-			break;
-		case XCB_MAPPING_NOTIFY:
-			wm_printf(wm, "XCB_MAPPING_NOTIFY\n");
-			break;
-		case XCB_PROPERTY_NOTIFY:
-			weston_wm_handle_property_notify(wm, event);
-			break;
-		case XCB_CLIENT_MESSAGE:
-			weston_wm_handle_client_message(wm, event);
-			break;
-		case XCB_FOCUS_IN:
-			weston_wm_handle_focus_in(wm, event);
-			break;
+		/* Out of memory: the event that did not fit goes last. */
+		if (event) {
+			weston_wm_dispatch_event(wm, event);
+			count++;
 		}
 
-		free(event);
-		count++;
-	}
+		weston_wm_release_prefetched(wm);
+	} while (batch.size > 0 || event != NULL);
+	wl_array_release(&batch);
 
 	if (count != 0)
 		xcb_flush(wm->conn);
@@ -2582,11 +2954,19 @@ weston_wm_create(struct weston_xserver *wxs, int fd)
 		return NULL;
 	}
 
+	wm->prefetch_hash = hash_table_create();
+	if (wm->prefetch_hash == NULL) {
+		hash_table_destroy(wm->window_hash);
+		free(wm);
+		return NULL;
+	}
+
 	/* xcb_connect_to_fd takes ownership of the fd. */
 	wm->conn = xcb_connect_to_fd(fd, NULL);
 	if (xcb_connection_has_error(wm->conn)) {
 		weston_log("xcb_connect_to_fd failed\n");
 		close(fd);
+		hash_table_destroy(wm->prefetch_hash);
 		hash_table_destroy(wm->window_hash);
 		free(wm);
 		return NULL;
@@ -2649,6 +3029,7 @@ weston_wm_create(struct weston_xserver *wxs, int fd)
 	wl_signal_add(&wxs->compositor->kill_signal,
 		      &wm->kill_listener);
 	wl_list_init(&wm->unpaired_window_list);
+	wl_list_init(&wm->decoration_cache);
 
 	weston_wm_create_cursors(wm);
 	weston_wm_window_set_cursor(wm, wm->screen->root, XWM_CURSOR_LEFT_PTR);
@@ -2667,10 +3048,14 @@ weston_wm_destroy(struct weston_wm *wm)
 {
 	/* FIXME: Free windows in hash. */
 	hash_table_destroy(wm->window_hash);
+	hash_table_destroy(wm->prefetch_hash);
+	weston_wm_decoration_cache_release(wm);
 	weston_wm_destroy_cursors(wm);
 	xcb_disconnect(wm->conn);
 	wl_event_source_remove(wm->source);
 	wl_list_remove(&wm->selection_listener.link);
+	wl_array_release(&wm->target_data);
+	wl_array_release(&wm->source_data);
 	wl_list_remove(&wm->activate_listener.link);
 	wl_list_remove(&wm->kill_listener.link);
 	wl_list_remove(&wm->create_surface_listener.link);
@@ -24,6 +24,7 @@
  */
 
 #include <stdio.h>
+#include <time.h>
 #include <wayland-server.h>
 #include <xcb/xcb.h>
 #include <xcb/xfixes.h>
@@ -56,12 +57,19 @@ struct weston_xserver {
 	struct weston_log_scope *wm_debug;
 };
 
+struct weston_wm_transfer {
+	struct timespec start;
+	size_t size;
+};
+
 struct weston_wm {
 	xcb_connection_t *conn;
 	const xcb_query_extension_reply_t *xfixes;
 	struct wl_event_source *source;
 	xcb_screen_t *screen;
 	struct hash_table *window_hash;
+	/* Windows prepared ahead of their CreateNotify, within a batch */
+	struct hash_table *prefetch_hash;
 	struct weston_xserver *server;
 	xcb_window_t wm_window;
 	struct weston_wm_window *focus_window;
@@ -75,20 +83,34 @@ struct weston_wm {
 	struct wl_listener activate_listener;
 	struct wl_listener kill_listener;
 	struct wl_list unpaired_window_list;
+	uint32_t event_batch;
+	struct wl_list decoration_cache;
+	size_t decoration_cache_bytes;
 
 	xcb_window_t selection_window;
 	xcb_window_t selection_owner;
 	int incr;
 	int data_source_fd;
 	struct wl_event_source *property_source;
-	xcb_get_property_reply_t *property_reply;
-	int property_start;
+	/* X11 to Wayland: received, not written to data_source_fd yet */
+	struct wl_array target_data;
+	size_t target_data_start;
+	int incr_chunk_pending;
+	int incr_done;
+	struct weston_wm_transfer target_transfer;
+	/* Wayland to X11: read ahead of the chunk the requestor holds */
+	int source_incr;
+	int source_fd;
+	struct wl_event_source *source_watch;
 	struct wl_array source_data;
+	struct weston_wm_transfer source_transfer;
+	size_t selection_chunk_size;
+	/* F_SETPIPE_SZ for source pipes, 0 to keep the default */
+	size_t selection_pipe_size;
 	xcb_selection_request_event_t selection_request;
 	xcb_atom_t selection_target;
 	xcb_timestamp_t selection_timestamp;
 	int selection_property_set;
-	int flush_property_on_delete;
 	struct wl_listener selection_listener;
 
 	xcb_window_t dnd_window;